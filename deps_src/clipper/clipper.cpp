@@ -766,16 +766,33 @@ bool ClipperBase::AddPath(const Path &pg, PolyType PolyTyp, bool Closed)
   if ((Closed && highI < 2) || (!Closed && highI < 1))
     return false;
 
-  // Allocate a new edge array.
-  Edges edges(highI + 1);
+  // Allocate a new edge array or reuse one released by Clear().
+  Edges edges = AllocateEdges(highI + 1);
   // Fill in the edge array.
   bool result = AddPathInternal(pg, highI, PolyTyp, Closed, edges.data());
   if (result)
     // Success, remember the edge array.
     m_edges.emplace_back(std::move(edges));
+  else
+    m_edges_free.emplace_back(std::move(edges));
   return result;
 }
 
+ClipperBase::Edges ClipperBase::AllocateEdges(size_t num_edges)
+{
+  Edges edges;
+  if (! m_edges_free.empty()) {
+    // Take the largest of the last two released arrays to limit reallocations.
+    size_t idx = m_edges_free.size() - 1;
+    if (idx > 0 && m_edges_free[idx - 1].capacity() > m_edges_free[idx].capacity())
+      -- idx;
+    edges = std::move(m_edges_free[idx]);
+    m_edges_free.erase(m_edges_free.begin() + idx);
+  }
+  edges.assign(num_edges, TEdge());
+  return edges;
+}
+
 bool ClipperBase::AddPathInternal(const Path &pg, int highI, PolyType PolyTyp, bool Closed, TEdge* edges)
 {
 #ifdef use_lines
@@ -959,6 +976,10 @@ bool ClipperBase::AddPathInternal(const Path &pg, int highI, PolyType PolyTyp, b
 void ClipperBase::Clear()
 {
   m_MinimaList.clear();
+  for (Edges &edges : m_edges) {
+    edges.clear();
+    m_edges_free.emplace_back(std::move(edges));
+  }
   m_edges.clear();
 #ifndef CLIPPERLIB_INT32
   m_UseFullRange = false;
@@ -967,6 +988,22 @@ void ClipperBase::Clear()
 }
 //------------------------------------------------------------------------------
 
+void ClipperBase::ReleaseMemory()
+{
+  m_edges_free.clear();
+  m_edges_free.shrink_to_fit();
+}
+//------------------------------------------------------------------------------
+
+size_t ClipperBase::NumFreeEdges() const
+{
+  size_t num_edges = 0;
+  for (const Edges &edges : m_edges_free)
+    num_edges += edges.capacity();
+  return num_edges;
+}
+//------------------------------------------------------------------------------
+
 // Initialize the Local Minima List:
 // Sort the LML entries, initialize the left / right bound edges of each Local Minima.
 void ClipperBase::Reset()
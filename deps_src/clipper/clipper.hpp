@@ -357,8 +357,8 @@ public:
     if (num_edges_total == 0)
       return false;
 
-    // Allocate a new edge array.
-    std::vector<TEdge, Allocator<TEdge>> edges(num_edges_total);
+    // Allocate a new edge array or reuse one released by Clear().
+    Edges edges = AllocateEdges(num_edges_total);
     // Fill in the edge array.
     bool result = false;
     TEdge *p_edge = edges.data();
@@ -376,10 +376,17 @@ public:
     if (result)
       // At least some edges were generated. Remember the edge array.
       m_edges.emplace_back(std::move(edges));
+    else
+      m_edges_free.emplace_back(std::move(edges));
     return result;
   }
 
+  // Removes the paths, keeping the edge arrays allocated for the paths added after Clear().
   void Clear();
+  // Frees the edge arrays kept by Clear().
+  void ReleaseMemory();
+  // Number of edges kept allocated by Clear().
+  size_t NumFreeEdges() const;
   IntRect GetBounds();
   // By default, when three or more vertices are collinear in input polygons (subject or clip), the Clipper object removes the 'inner' vertices before clipping.
   // When enabled the PreserveCollinear property prevents this default behavior to allow these inner vertices to appear in the solution.
@@ -407,6 +414,9 @@ protected:
   // A vector of edges per each input path.
   using Edges = std::vector<TEdge, Allocator<TEdge>>;
   std::vector<Edges, Allocator<Edges>> m_edges;
+  // Edge arrays released by Clear() to be reused by AddPath() / AddPaths().
+  std::vector<Edges, Allocator<Edges>> m_edges_free;
+  Edges AllocateEdges(size_t num_edges);
   // Don't remove intermediate vertices of a collinear sequence of points.
   bool             m_PreserveCollinear;
   // Is any of the paths inserted by AddPath() or AddPaths() open?
@@ -57,6 +57,7 @@ using namespace nlohmann;
 #include "libslic3r/ModelArrange.hpp"
 #include "libslic3r/Platform.hpp"
 #include "libslic3r/Print.hpp"
+#include "libslic3r/Profiling.hpp"
 #include "libslic3r/SLAPrint.hpp"
 #include "libslic3r/TriangleMesh.hpp"
 #include "libslic3r/Format/AMF.hpp"
@@ -1218,7 +1219,7 @@ int CLI::run(int argc, char **argv)
     std::vector<std::string> current_filaments_name, current_filaments_system_name, current_inherits_group;
     DynamicPrintConfig load_process_config, load_machine_config;
     bool new_process_config_is_system = true, new_printer_config_is_system = true;
-    std::string pipe_name, makerlab_name, makerlab_version, different_process_setting;
+    std::string pipe_name, makerlab_name, makerlab_version, different_process_setting, slice_cache_dir;
     const std::vector<std::string>              &metadata_name               = m_config.option<ConfigOptionStrings>("metadata_name", true)->values;
     const std::vector<std::string>              &metadata_value              = m_config.option<ConfigOptionStrings>("metadata_value", true)->values;
 
@@ -1296,6 +1297,19 @@ int CLI::run(int argc, char **argv)
     if (makerlab_version_option)
         makerlab_version = makerlab_version_option->value;
 
+    ConfigOptionString* slice_cache_dir_option = m_config.option<ConfigOptionString>("slice_cache_dir");
+    if (slice_cache_dir_option)
+        slice_cache_dir = slice_cache_dir_option->value;
+
+    ConfigOptionBool* parallel_gcode_layers_option = m_config.option<ConfigOptionBool>("parallel_gcode_layers");
+    bool parallel_gcode_layers = parallel_gcode_layers_option && parallel_gcode_layers_option->value;
+    ConfigOptionBool* analytic_cooling_slowdown_option = m_config.option<ConfigOptionBool>("analytic_cooling_slowdown");
+    bool analytic_cooling_slowdown = analytic_cooling_slowdown_option && analytic_cooling_slowdown_option->value;
+
+    // Profile everything until CLI::run() returns, the trace is written when the session goes out of scope.
+    ConfigOptionString* profile_trace_option = m_config.option<ConfigOptionString>("profile_trace");
+    Profiling::Session  profiling_session(profile_trace_option ? profile_trace_option->value : std::string());
+
     //skip model object map construct
     if (need_skip) {
         BOOST_LOG_TRIVIAL(info) << boost::format("need to skip objects, size %1%:")%skip_objects.size();
@@ -4811,6 +4825,11 @@ int CLI::run(int argc, char **argv)
                         part_plate->get_print(&print, &gcode_result, &print_index);
 
                         print_fff = dynamic_cast<Print *>(print);
+                        if (print_fff) {
+                            print_fff->set_slice_cache_dir(slice_cache_dir);
+                            print_fff->set_parallel_gcode_layers(parallel_gcode_layers);
+                            print_fff->set_analytic_cooling_slowdown(analytic_cooling_slowdown);
+                        }
                         /*if (outfile_config.empty())
                         {
                             outfile = "plate_" + std::to_string(index + 1) + ".gcode";
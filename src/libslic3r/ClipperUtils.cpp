@@ -2,6 +2,8 @@
 #include "Geometry.hpp"
 #include "ShortestPath.hpp"
 
+#include <atomic>
+
 // #define CLIPPER_UTILS_DEBUG
 
 #ifdef CLIPPER_UTILS_DEBUG
@@ -164,6 +166,60 @@ void clip_clipper_polygon_with_subject_bbox(const Polygon &src, const BoundingBo
     out.erase(std::remove_if(out.begin(), out.end(), [](const Polygon &polygon) {return polygon.empty(); }), out.end());
     return out;
 }
+
+static std::atomic<bool> g_clipper_workspace_enabled { true };
+// Edges kept allocated by the Clipper of a workspace after an operation, more of them are freed.
+static constexpr const size_t ClipperWorkspaceMaxFreeEdges = 1 << 16;
+
+static ClipperWorkspace& thread_clipper_workspace()
+{
+    static thread_local ClipperWorkspace workspace;
+    return workspace;
+}
+
+ClipperWorkspace::Lease::Lease()
+{
+    m_workspace = g_clipper_workspace_enabled.load(std::memory_order_relaxed) ? &thread_clipper_workspace() : nullptr;
+    if (m_workspace == nullptr || m_workspace->m_leased) {
+        m_private   = std::make_unique<ClipperWorkspace>();
+        m_workspace = m_private.get();
+    }
+    m_workspace->m_leased = true;
+}
+
+ClipperWorkspace::Lease::~Lease()
+{
+    if (! m_private)
+        m_workspace->reset();
+    m_workspace->m_leased = false;
+}
+
+void ClipperWorkspace::reset()
+{
+    m_clipper.Clear();
+    m_clipper.ReverseSolution(false);
+    m_clipper.StrictlySimple(false);
+    m_clipper.PreserveCollinear(false);
+    if (m_clipper.NumFreeEdges() > ClipperWorkspaceMaxFreeEdges)
+        m_clipper.ReleaseMemory();
+    m_offsetter.Clear();
+    m_offsetter.MiterLimit         = 2.;
+    m_offsetter.ArcTolerance       = 0.25;
+    m_offsetter.ShortestEdgeLength = 0.;
+    m_polytree.Clear();
+}
+
+void ClipperWorkspace::release_memory()
+{
+    ClipperWorkspace &workspace = thread_clipper_workspace();
+    if (! workspace.m_leased) {
+        workspace.m_clipper.ReleaseMemory();
+        workspace.m_polytree = ClipperLib::PolyTree();
+    }
+}
+
+void ClipperWorkspace::set_enabled(bool enabled) { g_clipper_workspace_enabled = enabled; }
+bool ClipperWorkspace::enabled() { return g_clipper_workspace_enabled; }
 }
 
 static ExPolygons PolyTreeToExPolygons(ClipperLib::PolyTree &&polytree)
@@ -266,7 +322,8 @@ bool has_duplicate_points(const ClipperLib::PolyTree &polytree)
 template<typename PathsProvider>
 static ClipperLib::Paths raw_offset(PathsProvider &&paths, float offset, ClipperLib::JoinType joinType, double miterLimit, ClipperLib::EndType endType = ClipperLib::etClosedPolygon)
 {
-    ClipperLib::ClipperOffset co;
+    ClipperUtils::ClipperWorkspace::Lease lease;
+    ClipperLib::ClipperOffset &co = lease.offsetter();
     ClipperLib::Paths out;
     out.reserve(paths.size());
     ClipperLib::Paths out_this;
@@ -300,6 +357,19 @@ static ClipperLib::Paths safety_offset(PathsProvider &&paths)
     return raw_offset(std::forward<PathsProvider>(paths), ClipperSafetyOffset, DefaultJoinType, DefaultMiterLimit);
 }
 
+// Executes the operation prepared in the Clipper of the lease. ExPolygons are extracted from the PolyTree of the lease.
+template<class TResult>
+static TResult clipper_execute(ClipperUtils::ClipperWorkspace::Lease &lease, const ClipperLib::ClipType clipType, const ClipperLib::PolyFillType fillType)
+{
+    TResult retval;
+    if constexpr (std::is_same_v<TResult, ExPolygons>) {
+        lease.clipper().Execute(clipType, lease.polytree(), fillType, fillType);
+        retval = PolyTreeToExPolygons(std::move(lease.polytree()));
+    } else
+        lease.clipper().Execute(clipType, retval, fillType, fillType);
+    return retval;
+}
+
 template<class TResult, class TSubj, class TClip>
 TResult clipper_do(
     const ClipperLib::ClipType     clipType,
@@ -307,12 +377,10 @@ TResult clipper_do(
     TClip &&                       clip,
     const ClipperLib::PolyFillType fillType)
 {
-    ClipperLib::Clipper clipper;
-    clipper.AddPaths(std::forward<TSubj>(subject), ClipperLib::ptSubject, true);
-    clipper.AddPaths(std::forward<TClip>(clip),    ClipperLib::ptClip,    true);
-    TResult retval;
-    clipper.Execute(clipType, retval, fillType, fillType);
-    return retval;
+    ClipperUtils::ClipperWorkspace::Lease lease;
+    lease.clipper().AddPaths(std::forward<TSubj>(subject), ClipperLib::ptSubject, true);
+    lease.clipper().AddPaths(std::forward<TClip>(clip),    ClipperLib::ptClip,    true);
+    return clipper_execute<TResult>(lease, clipType, fillType);
 }
 
 template<class TResult, class TSubj, class TClip>
@@ -336,18 +404,16 @@ TResult clipper_union(
     // fillType pftNonZero and pftPositive "should" produce the same result for "normalized with implicit union" set of polygons
     const ClipperLib::PolyFillType fillType = ClipperLib::pftNonZero)
 {
-    ClipperLib::Clipper clipper;
-    clipper.AddPaths(std::forward<TSubj>(subject), ClipperLib::ptSubject, true);
-    TResult retval;
-    clipper.Execute(ClipperLib::ctUnion, retval, fillType, fillType);
-    return retval;
+    ClipperUtils::ClipperWorkspace::Lease lease;
+    lease.clipper().AddPaths(std::forward<TSubj>(subject), ClipperLib::ptSubject, true);
+    return clipper_execute<TResult>(lease, ClipperLib::ctUnion, fillType);
 }
 
 // Perform union of input polygons using the positive rule, convert to ExPolygons.
 //FIXME is there any benefit of not doing the boolean / using pftEvenOdd?
 inline ExPolygons ClipperPaths_to_Slic3rExPolygons(const ClipperLib::Paths &input, bool do_union)
 {
-    return PolyTreeToExPolygons(clipper_union<ClipperLib::PolyTree>(input, do_union ? ClipperLib::pftNonZero : ClipperLib::pftEvenOdd));
+    return clipper_union<ExPolygons>(input, do_union ? ClipperLib::pftNonZero : ClipperLib::pftEvenOdd);
 }
 
 template<typename PathsProvider>
@@ -379,13 +445,20 @@ static TResult shrink_paths(PathsProvider &&paths, float offset, ClipperLib::Joi
     //assert(offset > 0);
     TResult out;
     if (auto raw = raw_offset(std::forward<PathsProvider>(paths), - offset, joinType, miterLimit); ! raw.empty()) {
-        ClipperLib::Clipper clipper;
+        ClipperUtils::ClipperWorkspace::Lease lease;
+        ClipperLib::Clipper &clipper = lease.clipper();
         clipper.AddPaths(raw, ClipperLib::ptSubject, true);
         ClipperLib::IntRect r = clipper.GetBounds();
         clipper.AddPath({ { r.left - 10, r.bottom + 10 }, { r.right + 10, r.bottom + 10 }, { r.right + 10, r.top - 10 }, { r.left - 10, r.top - 10 } }, ClipperLib::ptSubject, true);
         clipper.ReverseSolution(true);
-        clipper.Execute(ClipperLib::ctUnion, out, ClipperLib::pftNegative, ClipperLib::pftNegative);
-        remove_outermost_polygon(out);
+        if constexpr (std::is_same_v<TResult, ExPolygons>) {
+            clipper.Execute(ClipperLib::ctUnion, lease.polytree(), ClipperLib::pftNegative, ClipperLib::pftNegative);
+            remove_outermost_polygon(lease.polytree());
+            out = PolyTreeToExPolygons(std::move(lease.polytree()));
+        } else {
+            clipper.Execute(ClipperLib::ctUnion, out, ClipperLib::pftNegative, ClipperLib::pftNegative);
+            remove_outermost_polygon(out);
+        }
     }
     return out;
 }
@@ -407,7 +480,7 @@ Slic3r::Polygons offset(const Slic3r::Polygon &polygon, const float delta, Clipp
 Slic3r::Polygons offset(const Slic3r::Polygons &polygons, const float delta, ClipperLib::JoinType joinType, double miterLimit)
     { return to_polygons(offset_paths<ClipperLib::Paths>(ClipperUtils::PolygonsProvider(polygons), delta, joinType, miterLimit)); }
 Slic3r::ExPolygons offset_ex(const Slic3r::Polygons &polygons, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return PolyTreeToExPolygons(offset_paths<ClipperLib::PolyTree>(ClipperUtils::PolygonsProvider(polygons), delta, joinType, miterLimit)); }
+    { return offset_paths<ExPolygons>(ClipperUtils::PolygonsProvider(polygons), delta, joinType, miterLimit); }
 
 Slic3r::Polygons offset(const Slic3r::Polyline &polyline, const float delta, ClipperLib::JoinType joinType, double miterLimit, ClipperLib::EndType end_type)
     { assert(delta > 0); return to_polygons(clipper_union<ClipperLib::Paths>(raw_offset_polyline(ClipperUtils::SinglePathProvider(polyline.points), delta, joinType, miterLimit, end_type))); }
@@ -427,7 +500,8 @@ static int offset_expolygon_inner(const Slic3r::ExPolygon &expoly, const float d
     // 1) Offset the outer contour.
     ClipperLib::Paths contours;
     {
-        ClipperLib::ClipperOffset co;
+        ClipperUtils::ClipperWorkspace::Lease lease;
+        ClipperLib::ClipperOffset &co = lease.offsetter();
         if (joinType == jtRound)
             co.ArcTolerance = miterLimit;
         else
@@ -447,13 +521,15 @@ static int offset_expolygon_inner(const Slic3r::ExPolygon &expoly, const float d
         // 2) Offset the holes one by one, collect the offsetted holes.
         ClipperLib::Paths holes;
         {
+            ClipperUtils::ClipperWorkspace::Lease lease;
+            ClipperLib::ClipperOffset &co = lease.offsetter();
+            if (joinType == jtRound)
+                co.ArcTolerance = miterLimit;
+            else
+                co.MiterLimit = miterLimit;
+            co.ShortestEdgeLength = std::abs(delta * ClipperOffsetShortestEdgeFactor);
             for (const Polygon &hole : expoly.holes) {
-                ClipperLib::ClipperOffset co;
-                if (joinType == jtRound)
-                    co.ArcTolerance = miterLimit;
-                else
-                    co.MiterLimit = miterLimit;
-                co.ShortestEdgeLength = std::abs(delta * ClipperOffsetShortestEdgeFactor);
+                co.Clear();
                 co.AddPath(hole.points, joinType, ClipperLib::etClosedPolygon);
                 ClipperLib::Paths out2;
                 // Execute reorients the contours so that the outer most contour has a positive area. Thus the output
@@ -535,13 +611,13 @@ static ClipperLib::Paths expolygons_offset(const ExPolygonVector &expolygons, co
         output;
 }
 
-// See comment on expolygons_offset_raw. In addition, the polygons are always united to conver to polytree.
+// See comment on expolygons_offset_raw. In addition, the polygons are always united to conver to ExPolygons.
 template<typename ExPolygonVector>
-static ClipperLib::PolyTree expolygons_offset_pt(const ExPolygonVector &expolygons, const float delta, ClipperLib::JoinType joinType, double miterLimit)
+static ExPolygons expolygons_offset_ex(const ExPolygonVector &expolygons, const float delta, ClipperLib::JoinType joinType, double miterLimit)
 {
     auto [output, expolygons_collected] = expolygons_offset_raw(expolygons, delta, joinType, miterLimit);
     // Unite the offsetted expolygons for both the 
-    return clipper_union<ClipperLib::PolyTree>(output);
+    return clipper_union<ExPolygons>(output);
 }
 
 Slic3r::Polygons offset(const Slic3r::ExPolygon &expolygon, const float delta, ClipperLib::JoinType joinType, double miterLimit)
@@ -556,11 +632,11 @@ Slic3r::ExPolygons offset_ex(const Slic3r::ExPolygon &expolygon, const float del
     //FIXME one may spare one Clipper Union call.
     { return ClipperPaths_to_Slic3rExPolygons(expolygon_offset(expolygon, delta, joinType, miterLimit)); }
 Slic3r::ExPolygons offset_ex(const Slic3r::ExPolygons &expolygons, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return PolyTreeToExPolygons(expolygons_offset_pt(expolygons, delta, joinType, miterLimit)); }
+    { return expolygons_offset_ex(expolygons, delta, joinType, miterLimit); }
 Slic3r::ExPolygons offset_ex(const Slic3r::Surfaces &surfaces, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return PolyTreeToExPolygons(expolygons_offset_pt(surfaces, delta, joinType, miterLimit)); }
+    { return expolygons_offset_ex(surfaces, delta, joinType, miterLimit); }
 Slic3r::ExPolygons offset_ex(const Slic3r::SurfacesPtr &surfaces, const float delta, ClipperLib::JoinType joinType, double miterLimit)
-    { return PolyTreeToExPolygons(expolygons_offset_pt(surfaces, delta, joinType, miterLimit)); }
+    { return expolygons_offset_ex(surfaces, delta, joinType, miterLimit); }
 
 Polygons offset2(const ExPolygons &expolygons, const float delta1, const float delta2, ClipperLib::JoinType joinType, double miterLimit)
 {
@@ -568,12 +644,12 @@ Polygons offset2(const ExPolygons &expolygons, const float delta1, const float d
 }
 ExPolygons offset2_ex(const ExPolygons &expolygons, const float delta1, const float delta2, ClipperLib::JoinType joinType, double miterLimit)
 {
-    return PolyTreeToExPolygons(offset_paths<ClipperLib::PolyTree>(expolygons_offset(expolygons, delta1, joinType, miterLimit), delta2, joinType, miterLimit));
+    return offset_paths<ExPolygons>(expolygons_offset(expolygons, delta1, joinType, miterLimit), delta2, joinType, miterLimit);
 }
 ExPolygons offset2_ex(const Surfaces &surfaces, const float delta1, const float delta2, ClipperLib::JoinType joinType, double miterLimit)
 {
     //FIXME it may be more efficient to offset to_expolygons(surfaces) instead of to_polygons(surfaces).
-    return PolyTreeToExPolygons(offset_paths<ClipperLib::PolyTree>(expolygons_offset(surfaces, delta1, joinType, miterLimit), delta2, joinType, miterLimit));
+    return offset_paths<ExPolygons>(expolygons_offset(surfaces, delta1, joinType, miterLimit), delta2, joinType, miterLimit);
 }
 
 // Offset outside, then inside produces morphological closing. All deltas should be positive.
@@ -587,14 +663,14 @@ Slic3r::ExPolygons closing_ex(const Slic3r::Polygons &polygons, const float delt
 {
     assert(delta1 > 0);
     assert(delta2 > 0);
-    return PolyTreeToExPolygons(shrink_paths<ClipperLib::PolyTree>(expand_paths<ClipperLib::Paths>(ClipperUtils::PolygonsProvider(polygons), delta1, joinType, miterLimit), delta2, joinType, miterLimit));
+    return shrink_paths<ExPolygons>(expand_paths<ClipperLib::Paths>(ClipperUtils::PolygonsProvider(polygons), delta1, joinType, miterLimit), delta2, joinType, miterLimit);
 }
 Slic3r::ExPolygons closing_ex(const Slic3r::Surfaces &surfaces, const float delta1, const float delta2, ClipperLib::JoinType joinType, double miterLimit)
 {
     assert(delta1 > 0);
     assert(delta2 > 0);
     //FIXME it may be more efficient to offset to_expolygons(surfaces) instead of to_polygons(surfaces).
-    return PolyTreeToExPolygons(shrink_paths<ClipperLib::PolyTree>(expand_paths<ClipperLib::Paths>(ClipperUtils::SurfacesProvider(surfaces), delta1, joinType, miterLimit), delta2, joinType, miterLimit));
+    return shrink_paths<ExPolygons>(expand_paths<ClipperLib::Paths>(ClipperUtils::SurfacesProvider(surfaces), delta1, joinType, miterLimit), delta2, joinType, miterLimit);
 }
 
 // Offset inside, then outside produces morphological opening. All deltas should be positive.
@@ -626,7 +702,7 @@ Slic3r::Polygons opening(const Slic3r::Surfaces &surfaces, const float delta1, c
 // 1) Peform the Clipper operation with the output to Paths. This method handles overlaps in a reasonable time.
 // 2) Run Clipper Union once again to extract the PolyTree from the result of 1).
 template<typename PathProvider1, typename PathProvider2>
-inline ClipperLib::PolyTree clipper_do_polytree(
+inline ExPolygons clipper_do_ex(
     const ClipperLib::ClipType       clipType,
     PathProvider1                  &&subject,
     PathProvider2                  &&clip,
@@ -637,11 +713,11 @@ inline ClipperLib::PolyTree clipper_do_polytree(
     // if there are overapping edges.
     if (auto output = clipper_do<ClipperLib::Paths>(clipType, subject, clip, fillType); ! output.empty())
         // Perform an additional Union operation to generate the PolyTree ordering.
-        return clipper_union<ClipperLib::PolyTree>(output, fillType);
-    return ClipperLib::PolyTree();
+        return clipper_union<ExPolygons>(output, fillType);
+    return ExPolygons();
 }
 template<typename PathProvider1, typename PathProvider2>
-inline ClipperLib::PolyTree clipper_do_polytree(
+inline ExPolygons clipper_do_ex(
     const ClipperLib::ClipType       clipType,
     PathProvider1                  &&subject,
     PathProvider2                  &&clip,
@@ -650,8 +726,8 @@ inline ClipperLib::PolyTree clipper_do_polytree(
 {
     assert(do_safety_offset == ApplySafetyOffset::No || clipType != ClipperLib::ctUnion);
     return do_safety_offset == ApplySafetyOffset::Yes ? 
-        clipper_do_polytree(clipType, std::forward<PathProvider1>(subject), safety_offset(std::forward<PathProvider2>(clip)), fillType) :
-        clipper_do_polytree(clipType, std::forward<PathProvider1>(subject), std::forward<PathProvider2>(clip), fillType);
+        clipper_do_ex(clipType, std::forward<PathProvider1>(subject), safety_offset(std::forward<PathProvider2>(clip)), fillType) :
+        clipper_do_ex(clipType, std::forward<PathProvider1>(subject), std::forward<PathProvider2>(clip), fillType);
 }
 
 template<class TSubj, class TClip>
@@ -723,7 +799,7 @@ Slic3r::Polygons union_(const Slic3r::Polygons &subject, const Slic3r::Polygons
 
 template <typename TSubject, typename TClip>
 static ExPolygons _clipper_ex(ClipperLib::ClipType clipType, TSubject &&subject,  TClip &&clip, ApplySafetyOffset do_safety_offset, ClipperLib::PolyFillType fill_type = ClipperLib::pftNonZero)
-    { return PolyTreeToExPolygons(clipper_do_polytree(clipType, std::forward<TSubject>(subject), std::forward<TClip>(clip), fill_type, do_safety_offset)); }
+    { return clipper_do_ex(clipType, std::forward<TSubject>(subject), std::forward<TClip>(clip), fill_type, do_safety_offset); }
 
 Slic3r::ExPolygons diff_ex(const Slic3r::Polygons &subject, const Slic3r::Polygons &clip, ApplySafetyOffset do_safety_offset)
     { return _clipper_ex(ClipperLib::ctDifference, ClipperUtils::PolygonsProvider(subject), ClipperUtils::PolygonsProvider(clip), do_safety_offset); }
@@ -800,11 +876,11 @@ Slic3r::ExPolygons intersection_ex(const Slic3r::SurfacesPtr &subject, const Sli
 Slic3r::ExPolygons union_ex(const Slic3r::Polygons &subject, ClipperLib::PolyFillType fill_type)
     { return _clipper_ex(ClipperLib::ctUnion, ClipperUtils::PolygonsProvider(subject), ClipperUtils::EmptyPathsProvider(), ApplySafetyOffset::No, fill_type); }
 Slic3r::ExPolygons union_ex(const Slic3r::ExPolygons &subject)
-    { return PolyTreeToExPolygons(clipper_do_polytree(ClipperLib::ctUnion, ClipperUtils::ExPolygonsProvider(subject), ClipperUtils::EmptyPathsProvider(), ClipperLib::pftNonZero)); }
+    { return clipper_do_ex(ClipperLib::ctUnion, ClipperUtils::ExPolygonsProvider(subject), ClipperUtils::EmptyPathsProvider(), ClipperLib::pftNonZero); }
 Slic3r::ExPolygons union_ex(const Slic3r::ExPolygons &subject, const Slic3r::Polygons &subject2)
-    { return PolyTreeToExPolygons(clipper_do_polytree(ClipperLib::ctUnion, ClipperUtils::ExPolygonsProvider(subject), ClipperUtils::PolygonsProvider(subject2), ClipperLib::pftNonZero)); }
+    { return clipper_do_ex(ClipperLib::ctUnion, ClipperUtils::ExPolygonsProvider(subject), ClipperUtils::PolygonsProvider(subject2), ClipperLib::pftNonZero); }
 Slic3r::ExPolygons union_ex(const Slic3r::Surfaces &subject)
-    { return PolyTreeToExPolygons(clipper_do_polytree(ClipperLib::ctUnion, ClipperUtils::SurfacesProvider(subject), ClipperUtils::EmptyPathsProvider(), ClipperLib::pftNonZero)); }
+    { return clipper_do_ex(ClipperLib::ctUnion, ClipperUtils::SurfacesProvider(subject), ClipperUtils::EmptyPathsProvider(), ClipperLib::pftNonZero); }
 // BBS
 Slic3r::ExPolygons union_ex(const Slic3r::ExPolygons& poly1, const Slic3r::ExPolygons& poly2, bool safety_offset_)
     {
@@ -824,12 +900,11 @@ Slic3r::ExPolygons xor_ex(const Slic3r::ExPolygons &subject, const Slic3r::ExPol
 template<typename PathsProvider1, typename PathsProvider2>
 Polylines _clipper_pl_open(ClipperLib::ClipType clipType, PathsProvider1 &&subject, PathsProvider2 &&clip)
 {
-    ClipperLib::Clipper clipper;
-    clipper.AddPaths(std::forward<PathsProvider1>(subject), ClipperLib::ptSubject, false);
-    clipper.AddPaths(std::forward<PathsProvider2>(clip), ClipperLib::ptClip, true);
-    ClipperLib::PolyTree retval;
-    clipper.Execute(clipType, retval, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
-    return PolyTreeToPolylines(std::move(retval));
+    ClipperUtils::ClipperWorkspace::Lease lease;
+    lease.clipper().AddPaths(std::forward<PathsProvider1>(subject), ClipperLib::ptSubject, false);
+    lease.clipper().AddPaths(std::forward<PathsProvider2>(clip), ClipperLib::ptClip, true);
+    lease.clipper().Execute(clipType, lease.polytree(), ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+    return PolyTreeToPolylines(std::move(lease.polytree()));
 }
 
 // If the split_at_first_point() call above happens to split the polygon inside the clipping area
@@ -321,6 +321,44 @@ namespace ClipperUtils {
     [[nodiscard]] Polygons clip_clipper_polygons_with_subject_bbox(const ExPolygon &src, const BoundingBox &bbox, const bool get_entire_polygons = false);
     [[nodiscard]] Polygons clip_clipper_polygons_with_subject_bbox(const ExPolygons &src, const BoundingBox &bbox, const bool get_entire_polygons = false);
 
+    // Clipper, ClipperOffset and PolyTree of the calling thread, reused by the boolean operations and offsets below so that
+    // their edge arrays, scanbeam, join and output point lists stay allocated from one call to the next.
+    class ClipperWorkspace {
+    public:
+        // Exclusive use of the workspace of the calling thread for the scope of a single operation. A nested operation
+        // on the same thread or any operation with the workspaces disabled gets a private workspace.
+        class Lease {
+        public:
+            Lease();
+            ~Lease();
+            Lease(const Lease &) = delete;
+            Lease& operator=(const Lease &) = delete;
+
+            // Cleared, with the default options.
+            ClipperLib::Clipper&       clipper()   { return m_workspace->m_clipper; }
+            // Cleared, with the default parameters.
+            ClipperLib::ClipperOffset& offsetter() { return m_workspace->m_offsetter; }
+            ClipperLib::PolyTree&      polytree()  { return m_workspace->m_polytree; }
+
+        private:
+            ClipperWorkspace                  *m_workspace;
+            std::unique_ptr<ClipperWorkspace>  m_private;
+        };
+
+        // Frees the memory kept by the workspace of the calling thread.
+        static void release_memory();
+        // The workspaces are enabled by default, disabling them is meant for benchmarking.
+        static void set_enabled(bool enabled);
+        static bool enabled();
+
+    private:
+        void reset();
+
+        ClipperLib::Clipper       m_clipper;
+        ClipperLib::ClipperOffset m_offsetter;
+        ClipperLib::PolyTree      m_polytree;
+        bool                      m_leased { false };
+    };
     }
 
 // Perform union of input polygons using the non-zero rule, convert to ExPolygons.
@@ -55,7 +55,15 @@ public:
     void   set_position(double e) { m_E = e; }
     // Sets current retraction value & restart extra filament amount if retracted > 0.
     void   set_retracted(double retracted, double restart_extra);
-    
+    // Continues with the state of an extruder, which started with the retraction state of this extruder and with its axis
+    // and tachometer reset, accumulating the filament it used. See GCodeWriter::continue_from().
+    void   continue_from(const Extruder &other) {
+        m_E             = other.m_E;
+        m_absolute_E   += other.m_absolute_E;
+        m_retracted     = other.m_retracted;
+        m_restart_extra = other.m_restart_extra;
+    }
+
     double filament_diameter() const;
     double filament_crossection() const { return this->filament_diameter() * this->filament_diameter() * 0.25 * PI; }
     double filament_density() const;
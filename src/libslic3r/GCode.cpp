@@ -12,14 +12,17 @@
 #include "GCode/PrintExtents.hpp"
 #include "GCode/Thumbnails.hpp"
 #include "GCode/WipeTower.hpp"
+#include "MultiMaterialSegmentation.hpp"
 #include "ShortestPath.hpp"
 #include "Print.hpp"
+#include "Profiling.hpp"
 #include "Utils.hpp"
 #include "ClipperUtils.hpp"
 #include "libslic3r.h"
 #include "LocalesUtils.hpp"
 #include "libslic3r/format.hpp"
 #include "Time.hpp"
+#include "Thread.hpp"
 #include "GCode/ExtrusionProcessor.hpp"
 #include <algorithm>
 #include <cmath>
@@ -263,14 +266,14 @@ std::string OozePrevention::pre_toolchange(GCode& gcodegen)
         // Use the delta value from print config.
         if (gcodegen.config().standby_temperature_delta.value != 0) {
             // we assume that heating is always slower than cooling, so no need to block
-            gcode += gcodegen.writer().set_temperature(this->_get_temp(gcodegen) + gcodegen.config().standby_temperature_delta.value, false,
-                                                       extruder_id);
+            gcodegen.writer().set_temperature(gcode, this->_get_temp(gcodegen) + gcodegen.config().standby_temperature_delta.value, false,
+                                              extruder_id);
             gcode.pop_back();
             gcode += " ;cooldown\n"; // this is a marker for GCodeProcessor, so it can supress the commands when needed
         }
     } else {
         // Use the value from filament settings. That one is absolute, not delta.
-        gcode += gcodegen.writer().set_temperature(filament_idle_temp.get_at(extruder_id), false, extruder_id);
+        gcodegen.writer().set_temperature(gcode, filament_idle_temp.get_at(extruder_id), false, extruder_id);
         gcode.pop_back();
         gcode += " ;cooldown\n"; // this is a marker for GCodeProcessor, so it can supress the commands when needed
     }
@@ -398,7 +401,7 @@ std::string Wipe::wipe(GCode& gcodegen, double length, bool toolchange, bool is_
             if (gcodegen.enable_cooling_markers() && !is_last)
                 cooling_mark = /*gcodegen.config().role_based_wipe_speed ? ";_EXTERNAL_PERIMETER" : */ ";_WIPE";
 
-            gcode += gcodegen.writer().set_speed(_wipe_speed * 60, "", cooling_mark);
+            gcodegen.writer().set_speed(gcode, _wipe_speed * 60, "", cooling_mark);
             for (const Line& line : wipe_path.lines()) {
                 double segment_length = line.length();
                 double dE             = length * (segment_length / wipe_dist);
@@ -658,7 +661,7 @@ std::string WipeTowerIntegration::append_tcr(GCode& gcodegen, const WipeTower::T
 
     // SoftFever: set new PA for new filament
     if (gcodegen.config().enable_pressure_advance.get_at(new_extruder_id)) {
-        gcode += gcodegen.writer().set_pressure_advance(gcodegen.config().pressure_advance.get_at(new_extruder_id));
+        gcodegen.writer().set_pressure_advance(gcode, gcodegen.config().pressure_advance.get_at(new_extruder_id));
         // Orca: Adaptive PA
         // Reset Adaptive PA processor last PA value
         gcodegen.m_pa_processor->resetPreviousPA(gcodegen.config().pressure_advance.get_at(new_extruder_id));
@@ -798,7 +801,7 @@ std::string WipeTowerIntegration::append_tcr2(GCode& gcodegen, const WipeTower::
 
     // SoftFever: set new PA for new filament
     if (new_extruder_id != -1 && gcodegen.config().enable_pressure_advance.get_at(new_extruder_id)) {
-        gcode += gcodegen.writer().set_pressure_advance(gcodegen.config().pressure_advance.get_at(new_extruder_id));
+        gcodegen.writer().set_pressure_advance(gcode, gcodegen.config().pressure_advance.get_at(new_extruder_id));
         // Orca: Adaptive PA
         // Reset Adaptive PA processor last PA value
         gcodegen.m_pa_processor->resetPreviousPA(gcodegen.config().pressure_advance.get_at(new_extruder_id));
@@ -1514,8 +1517,17 @@ void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* resu
     std::string path_tmp(path);
     path_tmp += ".tmp";
 
+    // The statistics are patched in place only if no M73 lines have to be inserted, thus the M73 lines are written with the G-code,
+    // estimated by a pre-pass generating the same G-code.
+    const bool in_place_statistics = print->config().gcode_in_place_statistics.value;
+    const bool progress_prepass    = in_place_statistics && ! print->config().disable_m73.value;
+    std::vector<std::string> layer_change_progress;
+    if (progress_prepass)
+        layer_change_progress = estimate_layer_change_progress(*print);
+
     m_processor.initialize(path_tmp);
     m_processor.set_print(print);
+    m_processor.enable_in_place_post_process(in_place_statistics, progress_prepass);
     GCodeOutputStream file(boost::nowide::fopen(path_tmp.c_str(), "wb"), m_processor);
     if (!file.is_open()) {
         BOOST_LOG_TRIVIAL(error) << std::string("G-code export to ") + path + " failed.\nCannot open the file for writing.\n" << std::endl;
@@ -1525,6 +1537,7 @@ void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* resu
         }
         throw Slic3r::RuntimeError(std::string("G-code export to ") + path + " failed.\nCannot open the file for writing.\n");
     }
+    file.set_layer_change_lines(std::move(layer_change_progress));
 
     try {
         this->_do_export(*print, file, thumbnail_cb);
@@ -1631,6 +1644,23 @@ void GCode::do_export(Print* print, const char* path, GCodeProcessorResult* resu
     PROFILE_OUTPUT(debug_out_path("gcode-export-profile.txt").c_str());
 }
 
+std::vector<std::string> GCode::estimate_layer_change_progress(Print& print)
+{
+    Profiling::Scope scope("Estimate M73 progress", "GCode");
+    BOOST_LOG_TRIVIAL(info) << "Estimating the M73 progress..." << log_memory_info();
+    GCode prepass;
+    prepass.m_curr_print = &print;
+    prepass.m_processor.initialize(std::string());
+    prepass.m_processor.set_print(&print);
+    GCodeOutputStream file(nullptr, prepass.m_processor);
+    // Thumbnails are not generated, they add no moves.
+    prepass._do_export(print, file, nullptr);
+    file.flush();
+    file.close();
+    prepass.m_processor.finalize(false);
+    return prepass.m_processor.layer_change_progress_lines();
+}
+
 // free functions called by GCode::_do_export()
 namespace DoExport {
 static void init_gcode_processor(const PrintConfig& config, GCodeProcessor& processor, bool& silent_time_estimator_enabled)
@@ -1770,6 +1800,24 @@ static std::string update_print_stats_and_format_filament_stats(const bool
     }
     return filament_stats_string_out;
 }
+
+// Pads each of the lines with spaces to width, reserving room for the G-code processor to patch the statistics in place,
+// see GCodeProcessor::enable_in_place_post_process().
+static std::string reserve_statistics_lines(const std::string& lines, size_t width)
+{
+    std::string out;
+    for (size_t line_begin = 0, line_end; line_begin < lines.size(); line_begin = line_end + 1) {
+        line_end = lines.find('\n', line_begin);
+        if (line_end == std::string::npos)
+            line_end = lines.size();
+        const size_t line_size = line_end - line_begin + 1;
+        out.append(lines, line_begin, line_end - line_begin);
+        if (line_size < width)
+            out.append(width - line_size, ' ');
+        out += '\n';
+    }
+    return out;
+}
 } // namespace DoExport
 
 #if 0
@@ -1868,6 +1916,10 @@ void GCode::_do_export(Print& print, GCodeOutputStream& file, ThumbnailsGenerato
     // modifies m_silent_time_estimator_enabled
     DoExport::init_gcode_processor(print.config(), m_processor, m_silent_time_estimator_enabled);
     const bool is_bbl_printers = print.is_BBL_printer();
+    // Writes the lines replaced by the G-code processor with the statistics, padded to width if it patches them in place.
+    auto write_statistics = [&file, in_place_statistics = print.config().gcode_in_place_statistics.value](std::string lines, size_t width) {
+        file.write(in_place_statistics ? DoExport::reserve_statistics_lines(lines, width) : std::move(lines));
+    };
     m_calib_config.clear();
     // resets analyzer's tracking data
     m_last_height  = 0.f;
@@ -1957,9 +2009,9 @@ void GCode::_do_export(Print& print, GCodeOutputStream& file, ThumbnailsGenerato
         // Write information on the generator.
         file.write_format("; generated by %s on %s\n", Slic3r::header_slic3r_generated().c_str(), Slic3r::Utils::local_timestamp().c_str());
         if (is_bbl_printers)
-            file.write_format(";%s\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Estimated_Printing_Time_Placeholder).c_str());
+            write_statistics(";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Estimated_Printing_Time_Placeholder) + "\n", 512);
         // BBS: total layer number
-        file.write_format(";%s\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Total_Layer_Number_Placeholder).c_str());
+        write_statistics(";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Total_Layer_Number_Placeholder) + "\n", 64);
         // Orca: extra check for bbl printer
         if (is_bbl_printers) {
             if (print.calib_params().mode == CalibMode::Calib_None) { // Don't support skipping in cali mode
@@ -2067,7 +2119,7 @@ void GCode::_do_export(Print& print, GCodeOutputStream& file, ThumbnailsGenerato
         file.write(set_object_info(&print));
 
     // adds tags for time estimators
-    file.write_format(";%s\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::First_Line_M73_Placeholder).c_str());
+    write_statistics(";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::First_Line_M73_Placeholder) + "\n", 128);
 
     // Prepare the helper object for replacing placeholders in custom G-code and output filename.
     m_placeholder_parser_integration.parser = print.placeholder_parser();
@@ -2197,6 +2249,9 @@ void GCode::_do_export(Print& print, GCodeOutputStream& file, ThumbnailsGenerato
 
     m_cooling_buffer = make_unique<CoolingBuffer>(*this);
     m_cooling_buffer->set_current_extruder(initial_extruder_id);
+    m_cooling_buffer->set_analytic_slowdown(print.analytic_cooling_slowdown());
+    // The moves of the layers are handed over to the cooling buffer and the fan mover typed, see process_layer().
+    m_writer.set_record_moves(true);
 
     // Orca: Initialise AdaptivePA processor filter
     m_pa_processor = std::make_unique<AdaptivePAProcessor>(*this, tool_ordering.all_extruders());
@@ -2500,13 +2555,13 @@ void GCode::_do_export(Print& print, GCodeOutputStream& file, ThumbnailsGenerato
         std::string gcode;
         if ((print.default_object_config().outer_wall_acceleration.value > 0 &&
              print.default_object_config().outer_wall_acceleration.value > 0)) {
-            gcode += m_writer.set_print_acceleration(
+            m_writer.set_print_acceleration(gcode,
                 (unsigned int) floor(print.default_object_config().outer_wall_acceleration.value + 0.5));
         }
 
         if (print.default_object_config().outer_wall_jerk.value > 0) {
             double jerk = print.default_object_config().outer_wall_jerk.value;
-            gcode += m_writer.set_jerk_xy(jerk);
+            m_writer.set_jerk_xy(gcode, jerk);
         }
 
         auto params = print.calib_params();
@@ -2670,6 +2725,8 @@ void GCode::_do_export(Print& print, GCodeOutputStream& file, ThumbnailsGenerato
                 file.write(m_wipe_tower->finalize(*this));
         }
     }
+    m_writer.set_record_moves(false);
+    m_writer.moves().clear();
     // BBS: the last retraction
     //  Write end commands to file.
     file.write(this->retract(false, true));
@@ -2734,25 +2791,30 @@ void GCode::_do_export(Print& print, GCodeOutputStream& file, ThumbnailsGenerato
         file.write(m_writer.set_exhaust_fan(complete_print_exhaust_fan_speed, true));
     }
     // adds tags for time estimators
-    file.write_format(";%s\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Last_Line_M73_Placeholder).c_str());
+    write_statistics(";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Last_Line_M73_Placeholder) + "\n", 128);
     file.write_format("; EXECUTABLE_BLOCK_END\n\n");
 
     print.throw_if_canceled();
 
     // Get filament stats.
-    file.write(DoExport::update_print_stats_and_format_filament_stats(
+    write_statistics(DoExport::update_print_stats_and_format_filament_stats(
         // Const inputs
         has_wipe_tower, print.wipe_tower_data(), m_writer.extruders(),
         // Modifies
-        print.m_print_statistics));
+        print.m_print_statistics),
+        // The G-code processor writes a value per filament.
+        32 + 24 * print.config().filament_diameter.size());
     print.m_print_statistics.initial_tool = initial_extruder_id;
     if (!is_bbl_printers) {
-        file.write_format("; total filament used [g] = %.2lf\n", print.m_print_statistics.total_weight);
-        file.write_format("; total filament cost = %.2lf\n", print.m_print_statistics.total_cost);
+        char buf[128];
+        sprintf(buf, "; total filament used [g] = %.2lf\n", print.m_print_statistics.total_weight);
+        write_statistics(buf, 64);
+        sprintf(buf, "; total filament cost = %.2lf\n", print.m_print_statistics.total_cost);
+        write_statistics(buf, 64);
         if (print.m_print_statistics.total_toolchanges > 0)
             file.write_format("; total filament change = %i\n", print.m_print_statistics.total_toolchanges);
         file.write_format("; total layers count = %i\n", m_layer_count);
-        file.write_format(";%s\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Estimated_Printing_Time_Placeholder).c_str());
+        write_statistics(";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Estimated_Printing_Time_Placeholder) + "\n", 512);
         file.write("\n");
         file.write("; CONFIG_BLOCK_START\n");
         std::string full_config;
@@ -2790,6 +2852,226 @@ void GCode::check_placeholder_parser_failed()
     }
 }
 
+bool GCode::LayerGeneratorState::matches(const LayerGeneratorState& rhs) const
+{
+    if (extruder_id != rhs.extruder_id || layer_index != rhs.layer_index || wipe_tower_layer_idx != rhs.wipe_tower_layer_idx ||
+        !is_approx(last_layer_z, rhs.last_layer_z) || !is_approx(max_layer_z, rhs.max_layer_z) ||
+        !is_approx(last_height, rhs.last_height) || extruders.size() != rhs.extruders.size() || objs_with_brim != rhs.objs_with_brim ||
+        obj_supports_with_brim != rhs.obj_supports_with_brim || skirt_done != rhs.skirt_done || !is_approx(zhop, rhs.zhop) ||
+        !is_approx(zhop_to_lift, rhs.zhop_to_lift) || zhop_to_lift_type != rhs.zhop_to_lift_type)
+        return false;
+    for (size_t i = 0; i < extruders.size(); ++i)
+        if (extruders[i].id() != rhs.extruders[i].id() || !is_approx(extruders[i].E(), rhs.extruders[i].E()) ||
+            !is_approx(extruders[i].retracted(), rhs.extruders[i].retracted()) ||
+            !is_approx(extruders[i].restart_extra(), rhs.extruders[i].restart_extra()))
+            return false;
+    return true;
+}
+
+GCode::LayerGeneratorState GCode::layer_generator_state() const
+{
+    LayerGeneratorState state;
+    state.extruder_id            = m_writer.extruder() != nullptr ? m_writer.extruder()->id() : 0;
+    state.layer_index            = m_layer_index;
+    state.last_layer_z           = m_last_layer_z;
+    state.max_layer_z            = m_max_layer_z;
+    state.last_height            = m_last_height;
+    state.wipe_tower_layer_idx   = m_wipe_tower ? m_wipe_tower->layer_idx() : -1;
+    state.extruders              = m_writer.extruders();
+    state.objs_with_brim         = m_objsWithBrim;
+    state.obj_supports_with_brim = m_objSupportsWithBrim;
+    state.skirt_done             = m_skirt_done;
+    state.zhop                   = m_writer.get_zhop();
+    state.zhop_to_lift           = m_writer.get_zhop_to_lift();
+    state.zhop_to_lift_type      = m_writer.get_zhop_to_lift_type();
+    return state;
+}
+
+// Layers are only generated ahead if their G-code does not depend on a state, which is not known ahead of the serial
+// stage or which the serial stage could not take over from the copy generating the layer.
+bool GCode::can_generate_layers_ahead(const Print& print) const
+{
+    if (!print.parallel_gcode_layers() || m_spiral_vase || print.is_BBL_printer() || print.calib_mode() != CalibMode::Calib_None ||
+        m_pa_processor->is_active() || m_config.single_extruder_multi_material.value || m_config.manual_filament_change.value ||
+        m_config.z_offset.value != 0. || (m_wipe_tower && m_config.wipe_tower_no_sparse_layers.value))
+        return false;
+    // The retraction at the layer change brings E and the retraction to a state known ahead.
+    for (unsigned int extruder_id : m_writer.extruder_ids())
+        if (!m_config.retract_when_changing_layer.get_at(extruder_id))
+            return false;
+    // Variables of the custom G-code, which are not known to the copy.
+    auto uses_unknown_variables = [](const std::string& templ) {
+        return boost::contains(templ, "global") || boost::contains(templ, "extruded_") || boost::contains(templ, "toolchange_count");
+    };
+    for (const std::string* templ :
+         {&m_config.before_layer_change_gcode.value, &m_config.layer_change_gcode.value, &m_config.time_lapse_gcode.value,
+          &m_config.change_filament_gcode.value, &m_config.change_extrusion_role_gcode.value})
+        if (uses_unknown_variables(*templ))
+            return false;
+    for (const ConfigOptionStrings* templs : {&m_config.filament_start_gcode, &m_config.filament_end_gcode})
+        for (const std::string& templ : templs->values)
+            if (uses_unknown_variables(templ))
+                return false;
+    return true;
+}
+
+std::unique_ptr<GCode> GCode::make_layer_generator(const GCode& parent, const Print& print, const ToolOrdering& tool_ordering) const
+{
+    auto generator                                = std::make_unique<GCode>();
+    generator->m_layer_generator.parent           = &parent;
+    generator->m_curr_print                       = m_curr_print;
+    generator->m_config                           = m_config;
+    generator->m_calib_config                     = m_calib_config;
+    generator->m_scaled_resolution                = m_scaled_resolution;
+    generator->m_writer                           = m_writer;
+    // Bind the extruders to the configuration of the copied writer.
+    generator->set_extruders(m_writer.extruder_ids());
+    generator->m_placeholder_parser_integration.parser                = m_placeholder_parser_integration.parser;
+    generator->m_placeholder_parser_integration.context.global_config = std::make_unique<DynamicConfig>();
+    generator->m_placeholder_parser_integration.init(generator->m_writer);
+    generator->m_ooze_prevention                  = m_ooze_prevention;
+    generator->m_enable_cooling_markers           = m_enable_cooling_markers;
+    generator->m_enable_exclude_object            = m_enable_exclude_object;
+    generator->m_label_objects_ids                = m_label_objects_ids;
+    generator->m_enable_extrusion_role_markers    = m_enable_extrusion_role_markers;
+    generator->m_layer_count                      = m_layer_count;
+    generator->m_silent_time_estimator_enabled    = m_silent_time_estimator_enabled;
+    generator->m_brim_done                        = m_brim_done;
+    generator->m_second_layer_things_done         = true;
+    if (m_wipe_tower)
+        generator->m_wipe_tower = std::make_unique<WipeTowerIntegration>(*m_wipe_tower);
+    if (!print.config().small_area_infill_flow_compensation_model.empty())
+        generator->m_small_area_infill_flow_compensator = make_unique<SmallAreaInfillFlowCompensator>(print.config());
+    generator->m_pa_processor = std::make_unique<AdaptivePAProcessor>(*generator, tool_ordering.all_extruders());
+    return generator;
+}
+
+void GCode::start_layer_generator(const GCode& prototype, const LayerGeneratorState& start, const std::vector<LayerToPrint>& layers)
+{
+    m_layer_generator.failed       = false;
+    m_layer_generator.started      = false;
+    m_layer_generator.start_offset = 0;
+
+    // Region configs applied while generating the previous layer are reverted.
+    m_config = prototype.m_config;
+    // The position is unknown until the first move, see placeholder_parser_process().
+    m_writer.start_after(start.extruders, start.extruder_id);
+    m_writer.set_position(Vec3d(0., 0., start.last_layer_z));
+    this->placeholder_parser().set("current_extruder", start.extruder_id);
+    this->placeholder_parser().set("retraction_distance_when_cut", m_config.retraction_distances_when_cut.get_at(start.extruder_id));
+    this->placeholder_parser().set("long_retraction_when_cut", m_config.long_retractions_when_cut.get_at(start.extruder_id));
+    m_placeholder_parser_integration.failed_templates.clear();
+#if ORCA_CHECK_GCODE_PLACEHOLDERS
+    m_placeholder_error_messages.clear();
+#endif
+
+    m_layer_index  = start.layer_index;
+    m_last_layer_z = start.last_layer_z;
+    m_max_layer_z  = start.max_layer_z;
+    m_last_height  = start.last_height;
+    if (m_wipe_tower)
+        m_wipe_tower->start_layer(start.wipe_tower_layer_idx);
+    m_objsWithBrim                  = start.objs_with_brim;
+    m_objSupportsWithBrim           = start.obj_supports_with_brim;
+    m_skirt_done                    = start.skirt_done;
+    m_toolchange_count              = 0;
+    m_support_traditional_timelapse = true;
+
+    m_last_pos         = Point(0, 0);
+    m_last_pos_defined = false;
+    m_origin           = Vec2d::Zero();
+    m_wipe.reset_path();
+    m_avoid_crossing_perimeters     = AvoidCrossingPerimeters();
+    m_last_obj_copy                 = {nullptr, Point(std::numeric_limits<coord_t>::max(), std::numeric_limits<coord_t>::max())};
+    m_last_processor_extrusion_role = erNone;
+    m_last_extrusion_role           = erNone;
+    m_last_notgapfill_extrusion_role = erNone;
+    m_last_width                    = 0.f;
+    m_last_mm3_mm                   = 0.;
+#if ENABLE_GCODE_VIEWER_DATA_CHECKING
+    m_last_mm3_per_mm = 0.;
+#endif // ENABLE_GCODE_VIEWER_DATA_CHECKING
+    m_is_role_based_fan_on.fill(false);
+    m_layer                    = nullptr;
+    m_object_layer_over_raft   = false;
+    m_need_change_layer_lift_z = false;
+    m_next_wipe_x              = 0.f;
+    m_next_wipe_y              = 0.f;
+
+    // Overhangs are estimated against the layers below, which the serial stage prepared while generating them.
+    m_extrusion_quality_estimator = ExtrusionQualityEstimator();
+    for (const LayerToPrint& layer_to_print : layers)
+        if (layer_to_print.object_layer != nullptr && layer_to_print.object_layer->lower_layer != nullptr) {
+            const auto& regions = layer_to_print.object_layer->regions();
+            if (std::any_of(regions.begin(), regions.end(),
+                            [](const LayerRegion* r) { return r->has_extrusions() && r->region().config().enable_overhang_speed; }))
+                m_extrusion_quality_estimator.prepare_for_new_layer(layer_to_print.original_object, layer_to_print.object_layer->lower_layer);
+        }
+}
+
+bool GCode::continue_from_layer_generator(GCode& generator)
+{
+    if (generator.m_layer_generator.failed || !generator.m_layer_generator.started || !m_writer.is_object_start_str_empty() ||
+        !m_writer.is_object_end_str_empty() ||
+        std::find(m_is_role_based_fan_on.begin(), m_is_role_based_fan_on.end(), true) != m_is_role_based_fan_on.end() ||
+        !generator.m_layer_generator.state.matches(this->layer_generator_state()))
+        return false;
+
+    m_config = generator.m_config;
+    m_writer.continue_from(generator.m_writer);
+    const unsigned int extruder_id = m_writer.extruder()->id();
+    this->placeholder_parser().set("current_extruder", extruder_id);
+    this->placeholder_parser().set("retraction_distance_when_cut", m_config.retraction_distances_when_cut.get_at(extruder_id));
+    this->placeholder_parser().set("long_retraction_when_cut", m_config.long_retractions_when_cut.get_at(extruder_id));
+    for (const auto& name_and_error : generator.m_placeholder_parser_integration.failed_templates)
+        m_placeholder_parser_integration.failed_templates.insert(name_and_error);
+#if ORCA_CHECK_GCODE_PLACEHOLDERS
+    for (const auto& [name, keys] : generator.m_placeholder_error_messages) {
+        std::vector<std::string>& vector = m_placeholder_error_messages[name];
+        for (const std::string& key : keys)
+            if (std::find(vector.begin(), vector.end(), key) == vector.end())
+                vector.emplace_back(key);
+    }
+#endif
+
+    m_last_layer_z = generator.m_last_layer_z;
+    m_max_layer_z  = generator.m_max_layer_z;
+    m_last_height  = generator.m_last_height;
+    if (m_wipe_tower)
+        m_wipe_tower->continue_from(*generator.m_wipe_tower);
+    m_objsWithBrim        = generator.m_objsWithBrim;
+    m_objSupportsWithBrim = generator.m_objSupportsWithBrim;
+    m_skirt_done          = generator.m_skirt_done;
+    if (generator.m_toolchange_count > 0)
+        m_start_gcode_filament = -1;
+    m_toolchange_count += generator.m_toolchange_count;
+    m_support_traditional_timelapse = m_support_traditional_timelapse && generator.m_support_traditional_timelapse;
+
+    m_last_pos                      = generator.m_last_pos;
+    m_last_pos_defined              = generator.m_last_pos_defined;
+    m_origin                        = generator.m_origin;
+    m_wipe.path                     = std::move(generator.m_wipe.path);
+    m_avoid_crossing_perimeters     = std::move(generator.m_avoid_crossing_perimeters);
+    m_last_obj_copy                 = generator.m_last_obj_copy;
+    m_last_processor_extrusion_role = generator.m_last_processor_extrusion_role;
+    m_last_extrusion_role           = generator.m_last_extrusion_role;
+    m_last_notgapfill_extrusion_role = generator.m_last_notgapfill_extrusion_role;
+    m_last_width                    = generator.m_last_width;
+    m_last_mm3_mm                   = generator.m_last_mm3_mm;
+#if ENABLE_GCODE_VIEWER_DATA_CHECKING
+    m_last_mm3_per_mm = generator.m_last_mm3_per_mm;
+#endif // ENABLE_GCODE_VIEWER_DATA_CHECKING
+    m_is_role_based_fan_on     = generator.m_is_role_based_fan_on;
+    m_layer                    = generator.m_layer;
+    m_object_layer_over_raft   = generator.m_object_layer_over_raft;
+    m_need_change_layer_lift_z = generator.m_need_change_layer_lift_z;
+    m_next_wipe_x              = generator.m_next_wipe_x;
+    m_next_wipe_y              = generator.m_next_wipe_y;
+    m_enable_loop_clipping     = generator.m_enable_loop_clipping;
+    m_extrusion_quality_estimator.continue_from(std::move(generator.m_extrusion_quality_estimator));
+    return true;
+}
+
 // Process all layers of all objects (non-sequential mode) with a parallel pipeline:
 // Generate G-code, run the filters (vase mode, cooling buffer), run the G-code analyser
 // and export G-code into file.
@@ -2800,33 +3082,169 @@ void GCode::process_layers(const Print&
                            GCodeOutputStream&                                                 output_stream)
 {
     // The pipeline is variable: The vase mode filter is optional.
+    // Layers are scheduled in order, their extrusions are grouped by extruder in parallel (group_layer_extrusions()
+    // does not touch any G-code state), then the G-code is emitted serially, threading the writer state through.
+    // With Print::parallel_gcode_layers(), copies of this generator generate the extrusions of the layers in parallel
+    // to the grouping, starting from a state predicted by the scheduler. See process_layer().
+    struct LayerToProcess
+    {
+        size_t                                idx { 0 };
+        bool                                  nop { false };
+        std::shared_ptr<LayerExtrusionGroups> groups;
+        std::shared_ptr<LayerGeneratedAhead>  ahead;
+    };
+    // Layers in flight. A layer is only scheduled after the layer max_live_tokens back left the pipeline.
+    constexpr size_t max_live_tokens = 12;
+    const bool       generate_ahead  = this->can_generate_layers_ahead(print);
+    // The copies are made of a prototype, which is not modified while the layers are generated.
+    std::unique_ptr<GCode>              layer_generator_prototype;
+    std::vector<std::unique_ptr<GCode>> layer_generators;
+    std::mutex                          layer_generators_mutex;
+    // State of this generator after each layer. The state of the extruders, brims and skirts is predicted from the
+    // state max_live_tokens layers back, the rest of the state follows from the layers scheduled.
+    std::vector<LayerGeneratorState>    layer_end_states;
+    std::mutex                          layer_end_states_mutex;
+    LayerGeneratorState                 predicted;
+    bool                                second_layer_things_done = m_second_layer_things_done;
+    size_t                              layers_generated_ahead   = 0;
+    if (generate_ahead) {
+        layer_generator_prototype = this->make_layer_generator(*this, print, tool_ordering);
+        layer_end_states.assign(layers_to_print.size(), {});
+        predicted = this->layer_generator_state();
+    }
     size_t     layer_to_print_idx = 0;
-    const auto generator          = tbb::make_filter<void, LayerResult>(
+    const auto scheduler          = tbb::make_filter<void, LayerToProcess>(
         slic3r_tbb_filtermode::serial_in_order,
-        [this, &print, &tool_ordering, &print_object_instances_ordering, &layers_to_print,
-         &layer_to_print_idx](tbb::flow_control& fc) -> LayerResult {
+        [this, &tool_ordering, &layers_to_print, &layer_to_print_idx, generate_ahead, &layer_end_states, &layer_end_states_mutex,
+         &predicted, &second_layer_things_done](tbb::flow_control& fc) -> LayerToProcess {
             if (layer_to_print_idx >= layers_to_print.size()) {
                 if (layer_to_print_idx == layers_to_print.size() + (m_pressure_equalizer ? 1 : 0)) {
                     fc.stop();
                     return {};
-                } else {
-                    // Pressure equalizer need insert empty input. Because it returns one layer back.
-                    // Insert NOP (no operation) layer;
-                    ++layer_to_print_idx;
-                    return LayerResult::make_nop_layer_result();
                 }
-            } else {
-                const std::pair<coordf_t, std::vector<LayerToPrint>>& layer       = layers_to_print[layer_to_print_idx++];
-                const LayerTools&                                     layer_tools = tool_ordering.tools_for_layer(layer.first);
-                print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(layer_to_print_idx)));
-                if (m_wipe_tower && layer_tools.has_wipe_tower)
-                    m_wipe_tower->next_layer();
-                // BBS
-                check_placeholder_parser_failed();
-                print.throw_if_canceled();
-                return this->process_layer(print, layer.second, layer_tools, &layer == &layers_to_print.back(),
-                                                    &print_object_instances_ordering, size_t(-1));
+                // Pressure equalizer need insert empty input. Because it returns one layer back.
+                // Insert NOP (no operation) layer;
+                ++layer_to_print_idx;
+                return {0, true, nullptr};
+            }
+            LayerToProcess out{layer_to_print_idx++, false, nullptr};
+            if (!generate_ahead)
+                return out;
+            const LayerTools& layer_tools = tool_ordering.tools_for_layer(layers_to_print[out.idx].first);
+            if (m_wipe_tower && layer_tools.has_wipe_tower)
+                ++predicted.wipe_tower_layer_idx;
+            if (layer_tools.extruders.empty())
+                // process_layer() does not touch the state.
+                return out;
+            // Layers with custom G-code and the first two layers are generated serially.
+            if (second_layer_things_done && layer_tools.custom_gcode == nullptr) {
+                out.ahead        = std::make_shared<LayerGeneratedAhead>();
+                out.ahead->start = predicted;
+                if (out.idx >= max_live_tokens) {
+                    std::lock_guard<std::mutex> lock(layer_end_states_mutex);
+                    const LayerGeneratorState&  end          = layer_end_states[out.idx - max_live_tokens];
+                    out.ahead->start.extruders              = end.extruders;
+                    out.ahead->start.objs_with_brim         = end.objs_with_brim;
+                    out.ahead->start.obj_supports_with_brim = end.obj_supports_with_brim;
+                    out.ahead->start.skirt_done             = end.skirt_done;
+                }
+            }
+            // Follow the state updates of process_layer() before the extrusions of the layer.
+            const Layer* layer = nullptr;
+            for (const LayerToPrint& l : layers_to_print[out.idx].second)
+                if (l.object_layer != nullptr) {
+                    layer = l.object_layer;
+                    break;
+                }
+            if (layer == nullptr)
+                layer = layers_to_print[out.idx].second.front().support_layer;
+            if (m_layer_count > 0)
+                ++predicted.layer_index;
+            predicted.last_layer_z = float(layer->print_z);
+            predicted.max_layer_z  = std::max(predicted.max_layer_z, predicted.last_layer_z);
+            predicted.extruder_id  = layer_tools.extruders.back();
+            if (layer->id() != 0 || std::abs(layer->bottom_z()) >= EPSILON)
+                second_layer_things_done = true;
+            return out;
+        });
+    const auto grouping = tbb::make_filter<LayerToProcess, LayerToProcess>(
+        slic3r_tbb_filtermode::parallel,
+        [this, &print, &tool_ordering, &print_object_instances_ordering, &layers_to_print, &layer_generator_prototype, &layer_generators,
+         &layer_generators_mutex](LayerToProcess in) -> LayerToProcess {
+            if (in.nop || print.canceled()) {
+                in.ahead.reset();
+                return in;
+            }
+            Profiling::Scope scope("Group layer extrusions", "GCode");
+            const std::pair<coordf_t, std::vector<LayerToPrint>>& layer       = layers_to_print[in.idx];
+            const LayerTools&                                     layer_tools = tool_ordering.tools_for_layer(layer.first);
+            // Extruder overrides of the wiping extrusions are resolved lazily, leave those layers to the serial stage.
+            if (!layer_tools.extruders.empty() && !const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden())
+                in.groups = std::make_shared<LayerExtrusionGroups>(
+                    group_layer_extrusions(print, layer.second, layer_tools, layer_tools.has_wipe_tower && m_wipe_tower));
+            if (!in.ahead || !in.groups) {
+                in.ahead.reset();
+                return in;
+            }
+            Profiling::Scope        generate_scope("Generate layer ahead", "GCode");
+            std::unique_ptr<GCode>& generator = in.ahead->generator;
+            {
+                std::lock_guard<std::mutex> lock(layer_generators_mutex);
+                if (!layer_generators.empty()) {
+                    generator = std::move(layer_generators.back());
+                    layer_generators.pop_back();
+                }
+            }
+            if (!generator)
+                generator = layer_generator_prototype->make_layer_generator(*this, print, tool_ordering);
+            generator->start_layer_generator(*layer_generator_prototype, in.ahead->start, layer.second);
+            try {
+                std::string gcode = generator
+                                        ->process_layer(print, layer.second, layer_tools, &layer == &layers_to_print.back(),
+                                                        &print_object_instances_ordering, size_t(-1), false, in.groups.get())
+                                        .gcode;
+                if (generator->m_layer_generator.started)
+                    in.ahead->gcode = gcode.substr(generator->m_layer_generator.start_offset);
+            } catch (...) {
+                // The layer is generated serially, reporting the error if any.
+                generator->m_layer_generator.failed = true;
+            }
+            return in;
+        });
+    const auto generator = tbb::make_filter<LayerToProcess, LayerResult>(
+        slic3r_tbb_filtermode::serial_in_order,
+        [this, &print, &tool_ordering, &print_object_instances_ordering, &layers_to_print, generate_ahead, &layer_generators,
+         &layer_generators_mutex, &layer_end_states, &layer_end_states_mutex, &layers_generated_ahead](LayerToProcess in) -> LayerResult {
+            if (in.nop)
+                return LayerResult::make_nop_layer_result();
+            Profiling::Scope scope("Process layer", "GCode");
+            const std::pair<coordf_t, std::vector<LayerToPrint>>& layer       = layers_to_print[in.idx];
+            const LayerTools&                                     layer_tools = tool_ordering.tools_for_layer(layer.first);
+            print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(in.idx + 1)));
+            if (m_wipe_tower && layer_tools.has_wipe_tower)
+                m_wipe_tower->next_layer();
+            // BBS
+            check_placeholder_parser_failed();
+            print.throw_if_canceled();
+            LayerGeneratedAhead* generated_ahead = in.ahead && in.ahead->generator->m_layer_generator.started &&
+                                                           !in.ahead->generator->m_layer_generator.failed ?
+                                                       in.ahead.get() :
+                                                       nullptr;
+            LayerResult result = this->process_layer(print, layer.second, layer_tools, &layer == &layers_to_print.back(),
+                                                     &print_object_instances_ordering, size_t(-1), false, in.groups.get(), generated_ahead);
+            if (generate_ahead) {
+                {
+                    std::lock_guard<std::mutex> lock(layer_end_states_mutex);
+                    layer_end_states[in.idx] = this->layer_generator_state();
+                }
+                if (in.ahead) {
+                    if (in.ahead->adopted)
+                        ++layers_generated_ahead;
+                    std::lock_guard<std::mutex> lock(layer_generators_mutex);
+                    layer_generators.emplace_back(std::move(in.ahead->generator));
+                }
             }
+            return result;
         });
     if (m_spiral_vase) {
         float nozzle_diameter  = EXTRUDER_CONFIG(nozzle_diameter);
@@ -2838,6 +3256,7 @@ void GCode::process_layers(const Print&
         LayerResult>(slic3r_tbb_filtermode::serial_in_order, [&spiral_mode = *this->m_spiral_vase.get(), &layers_to_print](LayerResult in) -> LayerResult {
         if (in.nop_layer_result)
             return in;
+        Profiling::Scope scope("Spiral vase", "GCode");
 
         spiral_mode.enable(in.spiral_vase_enable);
         bool last_layer = in.layer_id == layers_to_print.size() - 1;
@@ -2846,51 +3265,68 @@ void GCode::process_layers(const Print&
     const auto pressure_equalizer  = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
                                                                                [pressure_equalizer = this->m_pressure_equalizer.get()](
                                                                                    LayerResult in) -> LayerResult {
+                                                                                   Profiling::Scope scope("Pressure equalizer", "GCode");
                                                                                    return pressure_equalizer->process_layer(std::move(in));
                                                                                });
-    const auto cooling             = tbb::make_filter<LayerResult, std::string>(slic3r_tbb_filtermode::serial_in_order,
+    const auto cooling             = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
                                                                     [&cooling_buffer = *this->m_cooling_buffer.get()](
-                                                                        LayerResult in) -> std::string {
+                                                                        LayerResult in) -> LayerResult {
                                                                         if (in.nop_layer_result)
-                                                                            return in.gcode;
-                                                                        return cooling_buffer.process_layer(std::move(in.gcode),
+                                                                            return in;
+                                                                        Profiling::Scope scope("Cooling buffer", "GCode");
+                                                                        // The typed moves of the layer are replaced by the typed moves of the output.
+                                                                        in.gcode = cooling_buffer.process_layer(std::move(in.gcode),
                                                                                                                         in.layer_id,
-                                                                                                                        in.cooling_buffer_flush);
+                                                                                                                        in.cooling_buffer_flush,
+                                                                                                                        &in.moves);
+                                                                        return in;
                                                                     });
     const auto pa_processor_filter = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
                                                                                 [&pa_processor = *this->m_pa_processor](
                                                                                     std::string in) -> std::string {
+                                                                                    Profiling::Scope scope("Adaptive pressure advance", "GCode");
                                                                                     return pa_processor.process_layer(std::move(in));
                                                                                 });
 
     const auto output = tbb::make_filter<std::string, void>(slic3r_tbb_filtermode::serial_in_order,
-                                                            [&output_stream](std::string s) { output_stream.write(s); });
+                                                            [&output_stream](std::string s) {
+                                                                Profiling::Scope scope("Write G-code", "GCode");
+                                                                output_stream.write(std::move(s));
+                                                            });
 
-    const auto fan_mover = tbb::make_filter<std::string, std::string>(
+    const auto fan_mover = tbb::make_filter<LayerResult, std::string>(
         slic3r_tbb_filtermode::serial_in_order,
-        [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](std::string in) -> std::string {
-            CNumericLocalesSetter locales_setter;
-
+        [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](LayerResult in) -> std::string {
             if (config.fan_speedup_time.value != 0 || config.fan_kickstart.value > 0) {
+                CNumericLocalesSetter locales_setter;
+                Profiling::Scope scope("Fan mover", "GCode");
                 if (fan_mover.get() == nullptr)
                     fan_mover.reset(new Slic3r::FanMover(writer, std::abs((float) config.fan_speedup_time.value),
                                                          config.fan_speedup_time.value > 0, config.use_relative_e_distances.value,
                                                          config.fan_speedup_overhangs.value, (float) config.fan_kickstart.value));
                 // flush as it's a whole layer
-                return fan_mover->process_gcode(in, true);
+                return fan_mover->process_gcode(in.gcode, true, &in.moves);
             }
-            return in;
+            return std::move(in.gcode);
         });
 
     // The pipeline elements are joined using const references, thus no copying is performed.
+    // The adaptive pressure advance filter re-parses each layer, it is left out if it has no model to apply.
+    const bool adaptive_pa = m_pa_processor->is_active();
     if (m_spiral_vase && m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
+        tbb::parallel_pipeline(max_live_tokens, scheduler & grouping & generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
     else if (m_spiral_vase)
-        tbb::parallel_pipeline(12, generator & spiral_mode & cooling & fan_mover & output);
+        tbb::parallel_pipeline(max_live_tokens, scheduler & grouping & generator & spiral_mode & cooling & fan_mover & output);
+    else if (m_pressure_equalizer && adaptive_pa)
+        tbb::parallel_pipeline(max_live_tokens, scheduler & grouping & generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
     else if (m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
+        tbb::parallel_pipeline(max_live_tokens, scheduler & grouping & generator & pressure_equalizer & cooling & fan_mover & output);
+    else if (adaptive_pa)
+        tbb::parallel_pipeline(max_live_tokens, scheduler & grouping & generator & cooling & fan_mover & pa_processor_filter & output);
     else
-        tbb::parallel_pipeline(12, generator & cooling & fan_mover & pa_processor_filter & output);
+        tbb::parallel_pipeline(max_live_tokens, scheduler & grouping & generator & cooling & fan_mover & output);
+    if (generate_ahead)
+        BOOST_LOG_TRIVIAL(debug) << "Layers generated ahead: " << layers_generated_ahead << " of " << layers_to_print.size();
 }
 
 // Process all layers of a single object instance (sequential mode) with a parallel pipeline:
@@ -2905,34 +3341,56 @@ void GCode::process_layers(const Print&              print,
                            const bool prime_extruder)
 {
     // The pipeline is variable: The vase mode filter is optional.
+    // Extrusions are grouped in parallel ahead of the serial G-code emission, see the non-sequential variant above.
+    struct LayerToProcess
+    {
+        size_t                                idx { 0 };
+        bool                                  nop { false };
+        std::shared_ptr<LayerExtrusionGroups> groups;
+    };
     size_t     layer_to_print_idx = 0;
-    const auto generator =
-        tbb::make_filter<void, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
-                                            [this, &print, &tool_ordering, &layers_to_print, &layer_to_print_idx, single_object_idx,
-                                             prime_extruder](tbb::flow_control& fc) -> LayerResult {
-                                                if (layer_to_print_idx >= layers_to_print.size()) {
-                                                    if (layer_to_print_idx == layers_to_print.size() + (m_pressure_equalizer ? 1 : 0)) {
-                                                        fc.stop();
-                                                        return {};
-                                                    } else {
-                                                        // Pressure equalizer need insert empty input. Because it returns one layer back.
-                                                        // Insert NOP (no operation) layer;
-                                                        ++layer_to_print_idx;
-                                                        return LayerResult::make_nop_layer_result();
-                                                    }
-                                                } else {
-                                                    LayerToPrint& layer = layers_to_print[layer_to_print_idx++];
-                                                    print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")),
-                                                                                        std::to_string(layer_to_print_idx)));
-                                                    // BBS
-                                                    check_placeholder_parser_failed();
-                                                    print.throw_if_canceled();
-                                                    return this->process_layer(print, {std::move(layer)},
-                                                                               tool_ordering.tools_for_layer(layer.print_z()),
-                                                                               &layer == &layers_to_print.back(), nullptr,
-                                                                               single_object_idx, prime_extruder);
-                                                }
-                                            });
+    const auto scheduler          = tbb::make_filter<void, LayerToProcess>(
+        slic3r_tbb_filtermode::serial_in_order,
+        [this, &layers_to_print, &layer_to_print_idx](tbb::flow_control& fc) -> LayerToProcess {
+            if (layer_to_print_idx >= layers_to_print.size()) {
+                if (layer_to_print_idx == layers_to_print.size() + (m_pressure_equalizer ? 1 : 0)) {
+                    fc.stop();
+                    return {};
+                }
+                // Pressure equalizer need insert empty input. Because it returns one layer back.
+                // Insert NOP (no operation) layer;
+                ++layer_to_print_idx;
+                return {0, true, nullptr};
+            }
+            return {layer_to_print_idx++, false, nullptr};
+        });
+    const auto grouping = tbb::make_filter<LayerToProcess, LayerToProcess>(
+        slic3r_tbb_filtermode::parallel,
+        [this, &print, &tool_ordering, &layers_to_print](LayerToProcess in) -> LayerToProcess {
+            if (in.nop || print.canceled())
+                return in;
+            Profiling::Scope scope("Group layer extrusions", "GCode");
+            const LayerToPrint& layer       = layers_to_print[in.idx];
+            const LayerTools&   layer_tools = tool_ordering.tools_for_layer(layer.print_z());
+            if (!layer_tools.extruders.empty() && !const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden())
+                in.groups = std::make_shared<LayerExtrusionGroups>(
+                    group_layer_extrusions(print, {layer}, layer_tools, layer_tools.has_wipe_tower && m_wipe_tower));
+            return in;
+        });
+    const auto generator = tbb::make_filter<LayerToProcess, LayerResult>(
+        slic3r_tbb_filtermode::serial_in_order,
+        [this, &print, &tool_ordering, &layers_to_print, single_object_idx, prime_extruder](LayerToProcess in) -> LayerResult {
+            if (in.nop)
+                return LayerResult::make_nop_layer_result();
+            Profiling::Scope scope("Process layer", "GCode");
+            LayerToPrint& layer = layers_to_print[in.idx];
+            print.set_status(80, Slic3r::format(_(L("Generating G-code: layer %1%")), std::to_string(in.idx + 1)));
+            // BBS
+            check_placeholder_parser_failed();
+            print.throw_if_canceled();
+            return this->process_layer(print, {std::move(layer)}, tool_ordering.tools_for_layer(layer.print_z()),
+                                       &layer == &layers_to_print.back(), nullptr, single_object_idx, prime_extruder, in.groups.get());
+        });
     if (m_spiral_vase) {
         float nozzle_diameter  = EXTRUDER_CONFIG(nozzle_diameter);
         float max_xy_smoothing = m_config.get_abs_value("spiral_mode_max_xy_smoothing", nozzle_diameter);
@@ -2943,6 +3401,7 @@ void GCode::process_layers(const Print&              print,
         LayerResult>(slic3r_tbb_filtermode::serial_in_order, [&spiral_mode = *this->m_spiral_vase.get(), &layers_to_print](LayerResult in) -> LayerResult {
         if (in.nop_layer_result)
             return in;
+        Profiling::Scope scope("Spiral vase", "GCode");
         spiral_mode.enable(in.spiral_vase_enable);
         bool last_layer = in.layer_id == layers_to_print.size() - 1;
         return {spiral_mode.process_layer(std::move(in.gcode), last_layer), in.layer_id, in.spiral_vase_enable, in.cooling_buffer_flush};
@@ -2950,49 +3409,65 @@ void GCode::process_layers(const Print&              print,
     const auto pressure_equalizer  = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
                                                                                [pressure_equalizer = this->m_pressure_equalizer.get()](
                                                                                    LayerResult in) -> LayerResult {
+                                                                                   Profiling::Scope scope("Pressure equalizer", "GCode");
                                                                                    return pressure_equalizer->process_layer(std::move(in));
                                                                                });
-    const auto cooling             = tbb::make_filter<LayerResult, std::string>(slic3r_tbb_filtermode::serial_in_order,
+    const auto cooling             = tbb::make_filter<LayerResult, LayerResult>(slic3r_tbb_filtermode::serial_in_order,
                                                                     [&cooling_buffer = *this->m_cooling_buffer.get()](
-                                                                        LayerResult in) -> std::string {
+                                                                        LayerResult in) -> LayerResult {
                                                                         if (in.nop_layer_result)
-                                                                            return in.gcode;
-                                                                        return cooling_buffer.process_layer(std::move(in.gcode),
+                                                                            return in;
+                                                                        Profiling::Scope scope("Cooling buffer", "GCode");
+                                                                        // The typed moves of the layer are replaced by the typed moves of the output.
+                                                                        in.gcode = cooling_buffer.process_layer(std::move(in.gcode),
                                                                                                                         in.layer_id,
-                                                                                                                        in.cooling_buffer_flush);
+                                                                                                                        in.cooling_buffer_flush,
+                                                                                                                        &in.moves);
+                                                                        return in;
                                                                     });
     const auto pa_processor_filter = tbb::make_filter<std::string, std::string>(slic3r_tbb_filtermode::serial_in_order,
                                                                                 [&pa_processor = *this->m_pa_processor](
                                                                                     std::string in) -> std::string {
+                                                                                    Profiling::Scope scope("Adaptive pressure advance", "GCode");
                                                                                     return pa_processor.process_layer(std::move(in));
                                                                                 });
 
     const auto output = tbb::make_filter<std::string, void>(slic3r_tbb_filtermode::serial_in_order,
-                                                            [&output_stream](std::string s) { output_stream.write(s); });
+                                                            [&output_stream](std::string s) {
+                                                                Profiling::Scope scope("Write G-code", "GCode");
+                                                                output_stream.write(std::move(s));
+                                                            });
 
-    const auto fan_mover = tbb::make_filter<std::string, std::string>(
+    const auto fan_mover = tbb::make_filter<LayerResult, std::string>(
         slic3r_tbb_filtermode::serial_in_order,
-        [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](std::string in) -> std::string {
+        [&fan_mover = this->m_fan_mover, &config = this->config(), &writer = this->m_writer](LayerResult in) -> std::string {
             if (config.fan_speedup_time.value != 0 || config.fan_kickstart.value > 0) {
+                Profiling::Scope scope("Fan mover", "GCode");
                 if (fan_mover.get() == nullptr)
                     fan_mover.reset(new Slic3r::FanMover(writer, std::abs((float) config.fan_speedup_time.value),
                                                          config.fan_speedup_time.value > 0, config.use_relative_e_distances.value,
                                                          config.fan_speedup_overhangs.value, (float) config.fan_kickstart.value));
                 // flush as it's a whole layer
-                return fan_mover->process_gcode(in, true);
+                return fan_mover->process_gcode(in.gcode, true, &in.moves);
             }
-            return in;
+            return std::move(in.gcode);
         });
 
     // The pipeline elements are joined using const references, thus no copying is performed.
+    // The adaptive pressure advance filter re-parses each layer, it is left out if it has no model to apply.
+    const bool adaptive_pa = m_pa_processor->is_active();
     if (m_spiral_vase && m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
+        tbb::parallel_pipeline(12, scheduler & grouping & generator & spiral_mode & pressure_equalizer & cooling & fan_mover & output);
     else if (m_spiral_vase)
-        tbb::parallel_pipeline(12, generator & spiral_mode & cooling & fan_mover & output);
+        tbb::parallel_pipeline(12, scheduler & grouping & generator & spiral_mode & cooling & fan_mover & output);
+    else if (m_pressure_equalizer && adaptive_pa)
+        tbb::parallel_pipeline(12, scheduler & grouping & generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
     else if (m_pressure_equalizer)
-        tbb::parallel_pipeline(12, generator & pressure_equalizer & cooling & fan_mover & pa_processor_filter & output);
+        tbb::parallel_pipeline(12, scheduler & grouping & generator & pressure_equalizer & cooling & fan_mover & output);
+    else if (adaptive_pa)
+        tbb::parallel_pipeline(12, scheduler & grouping & generator & cooling & fan_mover & pa_processor_filter & output);
     else
-        tbb::parallel_pipeline(12, generator & cooling & fan_mover & pa_processor_filter & output);
+        tbb::parallel_pipeline(12, scheduler & grouping & generator & cooling & fan_mover & output);
 }
 
 std::string GCode::placeholder_parser_process(const std::string&   name,
@@ -3037,6 +3512,10 @@ std::string GCode::placeholder_parser_process(const std::string&   name,
     }
 #endif
 
+    // A copy generating a layer ahead does not know the position before its first move.
+    if (m_layer_generator.started && m_writer.get_position().head<2>() == Vec2d::Zero())
+        m_layer_generator.failed = true;
+
     PlaceholderParserIntegration& ppi = m_placeholder_parser_integration;
     try {
         ppi.update_from_gcodewriter(m_writer);
@@ -3044,6 +3523,8 @@ std::string GCode::placeholder_parser_process(const std::string&   name,
         ppi.validate_output_vector_variables();
 
         if (const std::vector<double>& pos = ppi.opt_position->values; ppi.position != pos) {
+            if (m_layer_generator.parent != nullptr)
+                m_layer_generator.failed = true;
             // Update G-code writer.
             m_writer.set_position({pos[0], pos[1], pos[2]});
             this->set_last_pos(this->gcode_to_point({pos[0], pos[1]}));
@@ -3294,153 +3775,6 @@ inline GCode::ObjectByExtruder& object_by_extruder(std::map<unsigned int, std::v
     return objects_by_extruder[object_idx];
 }
 
-static inline void apply_local_z_flow_height_override(ExtrusionPath& path, const double flow_height_override)
-{
-    if (flow_height_override <= EPSILON)
-        return;
-    if (path.height > EPSILON) {
-        const double ratio = flow_height_override / path.height;
-        path.mm3_per_mm *= ratio;
-    }
-    path.height = float(flow_height_override);
-}
-
-static inline void append_clipped_path(const ExtrusionPath& src_path,
-                                       const ExPolygons*    include_masks,
-                                       const ExPolygons*    exclude_masks,
-                                       const double         flow_height_override,
-                                       ExtrusionEntityCollection& dst)
-{
-    Polylines segments{src_path.polyline};
-    if (include_masks != nullptr && !include_masks->empty())
-        segments = intersection_pl(std::move(segments), *include_masks);
-    if (exclude_masks != nullptr && !exclude_masks->empty())
-        segments = diff_pl(std::move(segments), *exclude_masks);
-
-    for (Polyline& segment : segments) {
-        if (!segment.is_valid())
-            continue;
-        ExtrusionPath clipped(segment, src_path);
-        apply_local_z_flow_height_override(clipped, flow_height_override);
-        dst.append(std::move(clipped));
-    }
-}
-
-static inline ExPolygons local_z_compensate_masks(const ExPolygons& src_masks,
-                                                  const float       delta_scaled,
-                                                  const bool        fallback_to_source)
-{
-    if (src_masks.empty() || std::abs(delta_scaled) <= EPSILON)
-        return src_masks;
-
-    ExPolygons compensated = offset_ex(src_masks, delta_scaled);
-    if (!compensated.empty() && compensated.size() > 1)
-        compensated = union_ex(compensated);
-
-    if (compensated.empty() && fallback_to_source)
-        return src_masks;
-    return compensated;
-}
-
-struct LocalZPathHeightStats
-{
-    size_t count { 0 };
-    double min   { std::numeric_limits<double>::max() };
-    double max   { 0.0 };
-};
-
-static inline LocalZPathHeightStats collect_local_z_path_height_stats(const ExtrusionEntityCollection& source)
-{
-    LocalZPathHeightStats stats;
-    ExtrusionEntityCollection flattened = source.flatten(false);
-    for (const ExtrusionEntity* entity : flattened.entities) {
-        if (const auto* path = dynamic_cast<const ExtrusionPath*>(entity)) {
-            const double h = path->height;
-            ++stats.count;
-            stats.min = std::min(stats.min, h);
-            stats.max = std::max(stats.max, h);
-        } else if (const auto* multipath = dynamic_cast<const ExtrusionMultiPath*>(entity)) {
-            for (const ExtrusionPath& p : multipath->paths) {
-                const double h = p.height;
-                ++stats.count;
-                stats.min = std::min(stats.min, h);
-                stats.max = std::max(stats.max, h);
-            }
-        } else if (const auto* loop = dynamic_cast<const ExtrusionLoop*>(entity)) {
-            for (const ExtrusionPath& p : loop->paths) {
-                const double h = p.height;
-                ++stats.count;
-                stats.min = std::min(stats.min, h);
-                stats.max = std::max(stats.max, h);
-            }
-        }
-    }
-    if (stats.count == 0) {
-        stats.min = 0.;
-        stats.max = 0.;
-    }
-    return stats;
-}
-
-static inline Polylines collect_local_z_polylines(const ExtrusionEntityCollection& source)
-{
-    Polylines lines;
-    ExtrusionEntityCollection flattened = source.flatten(false);
-    for (const ExtrusionEntity* entity : flattened.entities) {
-        if (const auto* path = dynamic_cast<const ExtrusionPath*>(entity)) {
-            lines.emplace_back(path->polyline);
-        } else if (const auto* multipath = dynamic_cast<const ExtrusionMultiPath*>(entity)) {
-            for (const ExtrusionPath& p : multipath->paths)
-                lines.emplace_back(p.polyline);
-        } else if (const auto* loop = dynamic_cast<const ExtrusionLoop*>(entity)) {
-            for (const ExtrusionPath& p : loop->paths)
-                lines.emplace_back(p.polyline);
-        }
-    }
-    return lines;
-}
-
-static std::unique_ptr<ExtrusionEntityCollection> clip_extrusion_collection_for_local_z(
-    const ExtrusionEntityCollection& source,
-    const ExPolygons*                include_masks,
-    const ExPolygons*                exclude_masks,
-    const double                     flow_height_override)
-{
-    if (source.entities.empty())
-        return nullptr;
-
-    if ((include_masks == nullptr || include_masks->empty()) &&
-        (exclude_masks == nullptr || exclude_masks->empty()) &&
-        flow_height_override <= EPSILON) {
-        return std::make_unique<ExtrusionEntityCollection>(source);
-    }
-
-    auto out = std::make_unique<ExtrusionEntityCollection>();
-    out->no_sort = source.no_sort;
-
-    ExtrusionEntityCollection flattened = source.flatten(false);
-    for (const ExtrusionEntity* entity : flattened.entities) {
-        if (const auto* path = dynamic_cast<const ExtrusionPath*>(entity)) {
-            append_clipped_path(*path, include_masks, exclude_masks, flow_height_override, *out);
-        } else if (const auto* multipath = dynamic_cast<const ExtrusionMultiPath*>(entity)) {
-            for (const ExtrusionPath& path : multipath->paths)
-                append_clipped_path(path, include_masks, exclude_masks, flow_height_override, *out);
-        } else if (const auto* loop = dynamic_cast<const ExtrusionLoop*>(entity)) {
-            for (const ExtrusionPath& path : loop->paths)
-                append_clipped_path(path, include_masks, exclude_masks, flow_height_override, *out);
-        } else {
-            // Fallback for unknown entity subclasses: keep behavior unchanged for now.
-            if (include_masks == nullptr && exclude_masks == nullptr && flow_height_override <= EPSILON)
-                out->append(*entity);
-        }
-    }
-
-    if (out->entities.empty())
-        return nullptr;
-
-    return out;
-}
-
 static std::vector<unsigned int> decode_manual_pattern_sequence_for_gcode(const MixedFilament& mf, size_t num_physical)
 {
     std::vector<unsigned int> sequence;
@@ -3712,6 +4046,66 @@ static bool trim_polyline_for_pointillism_gap(Polyline& src, const double trim_e
     return src.is_valid() && src.points.size() >= 2;
 }
 
+// Splits the path at the lines of the grid of cells of cell_size anchored at the origin, each piece running through a single cell
+// gets the extruder of its cell in the tile. Consecutive pieces of the same extruder are merged into a single run, thus the grid
+// is walked once per path and the runs are only as fine as the dither changes along it.
+static void split_polyline_by_dither_tile_for_pointillism(const Polyline&                                 src,
+                                                          const DitherTile&                               tile,
+                                                          const double                                    cell_size,
+                                                          std::vector<std::pair<unsigned int, Polyline>>& out)
+{
+    out.clear();
+    if (!src.is_valid() || tile.empty() || cell_size <= EPSILON)
+        return;
+
+    unsigned int run_extruder = 0;
+    Polyline     run;
+    auto append_to_run = [&](unsigned int extruder_id, const Point& from, const Point& to) {
+        if (from == to)
+            return;
+        if (run.points.empty() || extruder_id != run_extruder) {
+            if (run.points.size() >= 2)
+                out.emplace_back(run_extruder, std::move(run));
+            run.points.clear();
+            run.points.emplace_back(from);
+            run_extruder = extruder_id;
+        }
+        run.points.emplace_back(to);
+    };
+
+    std::vector<double> params;
+    for (size_t i = 1; i < src.points.size(); ++i) {
+        const Vec2d a = src.points[i - 1].cast<double>();
+        const Vec2d b = src.points[i].cast<double>();
+        const Vec2d d = b - a;
+        // Parameters of the crossings of the segment with the grid lines, both axes merged.
+        params.assign(1, 0.);
+        for (int axis = 0; axis < 2; ++axis) {
+            if (std::abs(d[axis]) <= EPSILON)
+                continue;
+            const double lo = std::min(a[axis], b[axis]);
+            const double hi = std::max(a[axis], b[axis]);
+            for (double line = (std::floor(lo / cell_size) + 1.) * cell_size; line < hi; line += cell_size)
+                params.emplace_back((line - a[axis]) / d[axis]);
+        }
+        std::sort(params.begin() + 1, params.end());
+        params.emplace_back(1.);
+
+        Point from = src.points[i - 1];
+        for (size_t j = 1; j < params.size(); ++j) {
+            if (params[j] <= params[j - 1])
+                continue;
+            const Vec2d mid = a + d * (0.5 * (params[j - 1] + params[j]));
+            const Vec2d end = a + d * params[j];
+            const Point to  = j + 1 == params.size() ? src.points[i] : Point(end.x(), end.y());
+            append_to_run(tile.extruder(int64_t(std::floor(mid.x() / cell_size)), int64_t(std::floor(mid.y() / cell_size))), from, to);
+            from = to;
+        }
+    }
+    if (run.points.size() >= 2)
+        out.emplace_back(run_extruder, std::move(run));
+}
+
 struct PointillismPathSplitStats
 {
     size_t segment_count { 0 };
@@ -3730,6 +4124,7 @@ static bool split_extrusion_collection_for_pointillism_paths(
     const double                                             split_length_scaled,
     const double                                             split_gap_scaled,
     size_t                                                   sequence_phase,
+    const DitherTile*                                        dither_tile,
     std::vector<std::unique_ptr<ExtrusionEntityCollection>>& out_by_extruder,
     PointillismPathSplitStats&                               out_stats)
 {
@@ -3770,6 +4165,16 @@ static bool split_extrusion_collection_for_pointillism_paths(
     ExtrusionEntityCollection flattened = source.flatten(false);
     for (const ExtrusionEntity* entity : flattened.entities) {
         auto split_one_path = [&](const ExtrusionPath& path) {
+            if (dither_tile != nullptr) {
+                // The gap separates the runs of different extruders only, the cells of a run are printed as a single piece.
+                std::vector<std::pair<unsigned int, Polyline>> runs;
+                split_polyline_by_dither_tile_for_pointillism(path.polyline, *dither_tile, split_length_scaled, runs);
+                const double trim_each_end = std::max(0.0, split_gap_scaled * 0.5);
+                for (auto& [extruder_id, run] : runs)
+                    if (trim_each_end <= EPSILON || trim_polyline_for_pointillism_gap(run, trim_each_end))
+                        append_piece(extruder_id, path, run);
+                return;
+            }
             Polylines pieces;
             split_polyline_by_length_for_pointillism(path.polyline, split_length_scaled, pieces);
             const double trim_each_end = std::max(0.0, split_gap_scaled * 0.5);
@@ -4155,603 +4560,162 @@ std::string GCode::generate_skirt(const Print&                     print,
 // In non-sequential mode, process_layer is called per each print_z height with all object and support layers accumulated.
 // For multi-material prints, this routine minimizes extruder switches by gathering extruder specific extrusion paths
 // and performing the extruder specific extrusions together.
-LayerResult GCode::process_layer(const Print& print,
-                                 // Set of object & print layers of the same PrintObject and with the same print_z.
-                                 const std::vector<LayerToPrint>& layers,
-                                 const LayerTools&                layer_tools,
-                                 const bool                       last_layer,
-                                 // Pairs of PrintObject index and its instance index.
-                                 const std::vector<const PrintInstance*>* ordering,
-                                 // If set to size_t(-1), then print all copies of all objects.
-                                 // Otherwise print a single copy of a single object.
-                                 const size_t single_object_instance_idx,
-                                 // BBS
-                                 const bool prime_extruder)
+// Group the extrusions of a single print_z by extruder, then by object, island and region. Painted Local-Z
+// perimeters are clipped into sub-layer pass buckets and same-layer pointillisme paths are split per extruder here.
+// Only reads the Print, the layers and the layer tools, never the writer or any other G-code emission state, thus
+// GCode::process_layers() runs it for several layers in parallel ahead of the serial process_layer() stage.
+GCode::LayerExtrusionGroups GCode::group_layer_extrusions(const Print&                     print,
+                                                          const std::vector<LayerToPrint>& layers,
+                                                          const LayerTools&                layer_tools,
+                                                          const bool                       has_wipe_tower)
 {
-    assert(!layers.empty());
-    // Either printing all copies of all objects, or just a single copy of a single object.
-    assert(single_object_instance_idx == size_t(-1) || layers.size() == 1);
-
-    // First object, support and raft layer, if available.
-    const Layer*        object_layer  = nullptr;
-    const SupportLayer* support_layer = nullptr;
-    const SupportLayer* raft_layer    = nullptr;
-    for (const LayerToPrint& l : layers) {
-        if (l.object_layer && !object_layer)
-            object_layer = l.object_layer;
-        if (l.support_layer) {
-            if (!support_layer)
-                support_layer = l.support_layer;
-            if (!raft_layer && support_layer->id() < support_layer->object()->slicing_parameters().raft_layers())
-                raft_layer = support_layer;
-        }
-    }
-
-    const Layer* layer_ptr = nullptr;
-    if (object_layer != nullptr)
-        layer_ptr = object_layer;
-    else if (support_layer != nullptr)
-        layer_ptr = support_layer;
-    const Layer& layer = *layer_ptr;
-    LayerResult  result{{}, layer.id(), false, last_layer};
+    LayerExtrusionGroups groups;
     if (layer_tools.extruders.empty())
-        // Nothing to extrude.
-        return result;
+        return groups;
 
-    // Extract 1st object_layer and support_layer of this set of layers with an equal print_z.
-    coordf_t print_z = layer.print_z;
-    // BBS: using layer id to judge whether the layer is first layer is wrong. Because if the normal
-    // support is attached above the object, and support layers has independent layer height, then the lowest support
-    // interface layer id is 0.
-    bool first_layer = (layer.id() == 0 && abs(layer.bottom_z()) < EPSILON);
-    m_writer.set_is_first_layer(first_layer);
-    unsigned int first_extruder_id = layer_tools.extruders.front();
+    const unsigned int first_extruder_id = layer_tools.extruders.front();
 
-    // Initialize config with the 1st object to be printed at this layer.
-    m_config.apply(layer.object()->config(), true);
+    std::map<unsigned int, std::vector<ObjectByExtruder>>& by_extruder = groups.by_extruder;
+    const bool is_anything_overridden = const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden();
+    const double nozzle_0_mm = print.config().nozzle_diameter.values.empty() ? 0.4 : print.config().nozzle_diameter.get_at(0);
+    const double pointillism_pixel_size_cfg = std::max(0.0, double(print.config().mixed_filament_pointillism_pixel_size.value));
+    const double pointillism_segment_len_mm = pointillism_pixel_size_cfg > EPSILON ?
+        std::max(0.10, pointillism_pixel_size_cfg) :
+        std::max(0.60, 1.60 * nozzle_0_mm);
+    const double pointillism_line_gap_cfg_mm = std::max(0.0, double(print.config().mixed_filament_pointillism_line_gap.value));
+    const double pointillism_line_gap_mm = std::min(pointillism_line_gap_cfg_mm, pointillism_segment_len_mm * 0.90);
+    const double pointillism_segment_len_scaled = std::max<double>(scale_(0.10), scale_(pointillism_segment_len_mm));
+    const double pointillism_line_gap_scaled = std::max<double>(0.0, scale_(pointillism_line_gap_mm));
+    std::map<unsigned int, std::vector<unsigned int>> pointillism_sequence_cache;
+    const PointillismPattern pointillism_pattern = print.config().mixed_filament_pointillism_pattern.value;
+    std::map<unsigned int, DitherTile> pointillism_tile_cache;
+    groups.pointillism_segment_len_mm = pointillism_segment_len_mm;
+    groups.pointillism_line_gap_mm    = pointillism_line_gap_mm;
 
-    // Check whether it is possible to apply the spiral vase logic for this layer.
-    // Just a reminder: A spiral vase mode is allowed for a single object, single material print only.
-    m_enable_loop_clipping = true;
-    if (m_spiral_vase && layers.size() == 1 && support_layer == nullptr) {
-        bool enable = (layer.id() > 0 || !print.has_brim()) &&
-                      (layer.id() >= (size_t) print.config().skirt_height.value && !print.has_infinite_skirt());
-        if (enable) {
-            for (const LayerRegion* layer_region : layer.regions())
-                if (size_t(layer_region->region().config().bottom_shell_layers.value) > layer.id() ||
-                    layer_region->perimeters.items_count() > 1u || layer_region->fills.items_count() > 0) {
-                    enable = false;
-                    break;
-                }
-        }
-        result.spiral_vase_enable = enable;
-        // If we're going to apply spiralvase to this layer, disable loop clipping.
-        m_enable_loop_clipping = !enable;
-    }
-
-    std::string gcode;
-    assert(is_decimal_separator_point()); // for the sprintfs
-
-    // add tag for processor
-    gcode += ";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Layer_Change) + "\n";
-    // export layer z
-    char buf[64];
-    sprintf(buf, print.is_BBL_printer() ? "; Z_HEIGHT: %g\n" : ";Z:%g\n", print_z);
-    gcode += buf;
-    // export layer height
-    float height = first_layer ? static_cast<float>(print_z) : static_cast<float>(print_z) - m_last_layer_z;
-    sprintf(buf, ";%s%g\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Height).c_str(), height);
-    gcode += buf;
-    // update caches
-    m_last_layer_z = static_cast<float>(print_z);
-    m_max_layer_z  = std::max(m_max_layer_z, m_last_layer_z);
-    m_last_height  = height;
+    auto configured_filament_id_1based = [&layer_tools](const ExtrusionEntityCollection& entities, const PrintRegion& region) -> unsigned int {
+        if (layer_tools.extruder_override != 0)
+            return layer_tools.extruder_override;
+        if (entities.has_infill()) {
+            if (entities.has_solid_infill())
+                return region.config().solid_infill_filament.value;
+            return region.config().sparse_infill_filament.value;
+        }
+        return region.config().wall_filament.value;
+    };
 
-    // Set new layer - this will change Z and force a retraction if retract_when_changing_layer is enabled.
-    if (!m_config.before_layer_change_gcode.value.empty()) {
-        DynamicConfig config;
-        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index + 1));
-        config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
-        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
-        gcode += this->placeholder_parser_process("before_layer_change_gcode", print.config().before_layer_change_gcode.value,
-                                                  m_writer.extruder()->id(), &config) +
-                 "\n";
-    }
+    auto pointillism_sequence_for_filament = [&](unsigned int filament_id_1based) -> const std::vector<unsigned int>* {
+        if (filament_id_1based == 0 || layer_tools.mixed_mgr == nullptr || layer_tools.num_physical == 0)
+            return nullptr;
+        auto cache_it = pointillism_sequence_cache.find(filament_id_1based);
+        if (cache_it != pointillism_sequence_cache.end())
+            return cache_it->second.empty() ? nullptr : &cache_it->second;
 
-    PrinterStructure printer_structure                           = m_config.printer_structure.value;
-    bool             need_insert_timelapse_gcode_for_traditional = false;
-    if (printer_structure == PrinterStructure::psI3 && !m_spiral_vase && (!m_wipe_tower || !m_wipe_tower->enable_timelapse_print()) &&
-        print.config().print_sequence == PrintSequence::ByLayer) {
-        need_insert_timelapse_gcode_for_traditional = true;
-    }
-    bool has_insert_timelapse_gcode = false;
-    bool has_wipe_tower             = (layer_tools.has_wipe_tower && m_wipe_tower);
+        std::vector<unsigned int> sequence;
+        if (layer_tools.mixed_mgr->is_mixed(filament_id_1based, layer_tools.num_physical)) {
+            const MixedFilament* mixed_row = layer_tools.mixed_mgr->mixed_filament_from_id(filament_id_1based, layer_tools.num_physical);
+            if (mixed_row != nullptr)
+                sequence = pointillism_sequence_for_row_for_gcode(*mixed_row, layer_tools.num_physical);
+            if (unique_extruder_count_for_gcode(sequence, layer_tools.num_physical) < 2)
+                sequence.clear();
+        }
 
-    auto insert_timelapse_gcode = [this, print_z, &print]() -> std::string {
-        std::string gcode_res;
-        if (!m_config.time_lapse_gcode.value.empty()) {
-            DynamicConfig config;
-            config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
-            config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
-            config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
-            gcode_res = this->placeholder_parser_process("timelapse_gcode", print.config().time_lapse_gcode.value,
-                                                         m_writer.extruder()->id(), &config) +
-                        "\n";
+        auto inserted = pointillism_sequence_cache.emplace(filament_id_1based, std::move(sequence));
+        return inserted.first->second.empty() ? nullptr : &inserted.first->second;
+    };
+    // Dither tile of a mixed filament for this layer, the layer index rotating the sequence over the cells like it rotates the stripes.
+    auto pointillism_tile_for_filament = [&](unsigned int filament_id_1based, const std::vector<unsigned int>& sequence) -> const DitherTile* {
+        if (pointillism_pattern == PointillismPattern::Stripes)
+            return nullptr;
+        auto cache_it = pointillism_tile_cache.find(filament_id_1based);
+        if (cache_it == pointillism_tile_cache.end()) {
+            const size_t phase = size_t(std::max(0, layer_tools.layer_index)) % sequence.size();
+            cache_it = pointillism_tile_cache.emplace(filament_id_1based,
+                build_dither_tile(sequence, phase, pointillism_pattern == PointillismPattern::BlueNoise)).first;
         }
-        return gcode_res;
+        return &cache_it->second;
     };
+    groups.local_z_runtime_supported = !has_wipe_tower && !is_anything_overridden;
+    std::vector<LocalZLayerContext>& local_z_layer_contexts = groups.local_z_layer_contexts;
+    if (groups.local_z_runtime_supported) {
+        local_z_layer_contexts.resize(layers.size());
+        for (size_t layer_to_print_idx = 0; layer_to_print_idx < layers.size(); ++layer_to_print_idx) {
+            const LayerToPrint& layer_to_print = layers[layer_to_print_idx];
+            if (layer_to_print.object_layer == nullptr)
+                continue;
 
-    // BBS: don't use lazy_raise when enable spiral vase
-    gcode += this->change_layer(print_z); // this will increase m_layer_index
-    m_layer                  = &layer;
-    m_object_layer_over_raft = false;
-    if (is_BBL_Printer()) {
-        if (printer_structure == PrinterStructure::psI3 && !need_insert_timelapse_gcode_for_traditional && !m_spiral_vase &&
-            print.config().print_sequence == PrintSequence::ByLayer) {
-            std::string timepals_gcode = insert_timelapse_gcode();
-            if (!timepals_gcode.empty()) {
-                gcode += timepals_gcode;
-                m_writer.set_current_position_clear(false);
-                // BBS: check whether custom gcode changes the z position. Update if changed
-                double temp_z_after_timepals_gcode;
-                if (GCodeProcessor::get_last_z_from_gcode(timepals_gcode, temp_z_after_timepals_gcode)) {
-                    Vec3d pos = m_writer.get_position();
-                    pos(2)    = temp_z_after_timepals_gcode;
-                    m_writer.set_position(pos);
-                }
+            const PrintObject* print_object = layer_to_print.original_object != nullptr ? layer_to_print.original_object : layer_to_print.object();
+            if (print_object == nullptr)
+                continue;
+
+            const size_t layer_id = size_t(layer_to_print.object_layer->id());
+            const auto& intervals = print_object->local_z_intervals();
+            auto it_interval = std::find_if(intervals.begin(), intervals.end(), [layer_id](const LocalZInterval& interval) {
+                return interval.layer_id == layer_id;
+            });
+            if (it_interval == intervals.end() || !it_interval->has_mixed_paint || it_interval->sublayer_count <= 1)
+                continue;
+            groups.local_z_phase_b_requested = true;
+
+            // The masks and the clipped perimeters were prepared after slicing, see PrintObject::build_local_z_extrusions().
+            LocalZLayerContext& ctx = local_z_layer_contexts[layer_to_print_idx];
+            ctx.extrusions = print_object->local_z_layer_extrusions(layer_id);
+            ctx.enabled    = ctx.extrusions != nullptr;
+            if (ctx.enabled) {
+                ctx.pass_buckets.resize(ctx.extrusions->passes.size());
+                for (size_t pass_idx = 0; pass_idx < ctx.pass_buckets.size(); ++pass_idx)
+                    ctx.pass_buckets[pass_idx].plan = ctx.extrusions->passes[pass_idx].plan;
             }
         }
     } else {
-        if (!m_config.time_lapse_gcode.value.empty()) {
-            DynamicConfig config;
-            config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
-            config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
-            config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
-            gcode += this->placeholder_parser_process("timelapse_gcode", print.config().time_lapse_gcode.value, m_writer.extruder()->id(),
-                                                      &config) +
-                     "\n";
-        }
-    }
-    if (!m_config.layer_change_gcode.value.empty()) {
-        DynamicConfig config;
-        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
-        config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
-        gcode += this->placeholder_parser_process("layer_change_gcode", print.config().layer_change_gcode.value, m_writer.extruder()->id(),
-                                                  &config) +
-                 "\n";
-        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
-    }
-    // BBS: set layer time fan speed after layer change gcode
-    gcode += ";_SET_FAN_SPEED_CHANGING_LAYER\n";
-
-    // Calibration Layer-specific GCode
-    switch (print.calib_mode()) {
-    case CalibMode::Calib_PA_Tower: {
-        gcode += writer().set_pressure_advance(print.calib_params().start + static_cast<int>(print_z) * print.calib_params().step);
-        break;
-    }
-    case CalibMode::Calib_Temp_Tower: {
-        auto offset = static_cast<unsigned int>(print_z / 10.001) * 5;
-        gcode += writer().set_temperature(print.calib_params().start - offset);
-        break;
-    }
-    case CalibMode::Calib_VFA_Tower: {
-        auto _speed = print.calib_params().start + std::floor(print_z / 5.0) * print.calib_params().step;
-        m_calib_config.set_key_value("outer_wall_speed", new ConfigOptionFloat(std::round(_speed)));
-        break;
-    }
-    case CalibMode::Calib_Vol_speed_Tower: {
-        auto _speed = print.calib_params().start + print_z * print.calib_params().step;
-        m_calib_config.set_key_value("outer_wall_speed", new ConfigOptionFloat(std::round(_speed)));
-        break;
-    }
-    case CalibMode::Calib_Retraction_tower: {
-        auto          _length = print.calib_params().start + std::floor(std::max(0.0, print_z - 0.4)) * print.calib_params().step;
-        DynamicConfig _cfg;
-        _cfg.set_key_value("retraction_length", new ConfigOptionFloats{_length});
-        writer().config.apply(_cfg);
-        sprintf(buf, "; Calib_Retraction_tower: Z_HEIGHT: %g, length:%g\n", print_z, _length);
-        gcode += buf;
-        break;
-    }
-    case CalibMode::Calib_Input_shaping_freq: {
-        if (m_layer_index == 1) {
-            gcode += writer().set_input_shaping('A', print.calib_params().start, 0.f);
-        } else {
-            if (print.calib_params().freqStartX == print.calib_params().freqStartY &&
-                print.calib_params().freqEndX == print.calib_params().freqEndY) {
-                gcode += writer().set_input_shaping('A', 0.f,
-                                                    (print.calib_params().freqStartX) +
-                                                        ((print.calib_params().freqEndX) - (print.calib_params().freqStartX)) *
-                                                            (m_layer_index - 2) / (m_layer_count - 3));
-            } else {
-                gcode += writer().set_input_shaping('X', 0.f,
-                                                    (print.calib_params().freqStartX) +
-                                                        ((print.calib_params().freqEndX) - (print.calib_params().freqStartX)) *
-                                                            (m_layer_index - 2) / (m_layer_count - 3));
-                gcode += writer().set_input_shaping('Y', 0.f,
-                                                    (print.calib_params().freqStartY) +
-                                                        ((print.calib_params().freqEndY) - (print.calib_params().freqStartY)) *
-                                                            (m_layer_index - 2) / (m_layer_count - 3));
+        for (const LayerToPrint& layer_to_print : layers) {
+            if (layer_to_print.object_layer == nullptr)
+                continue;
+            const PrintObject* print_object = layer_to_print.original_object != nullptr ? layer_to_print.original_object : layer_to_print.object();
+            if (print_object == nullptr)
+                continue;
+            const size_t layer_id = size_t(layer_to_print.object_layer->id());
+            const auto& intervals = print_object->local_z_intervals();
+            auto it_interval = std::find_if(intervals.begin(), intervals.end(), [layer_id](const LocalZInterval& interval) {
+                return interval.layer_id == layer_id;
+            });
+            if (it_interval != intervals.end() && it_interval->has_mixed_paint && it_interval->sublayer_count > 1) {
+                groups.local_z_phase_b_requested = true;
+                break;
             }
         }
-        break;
-    }
-    case CalibMode::Calib_Input_shaping_damp: {
-        if (m_layer_index == 1) {
-            gcode += writer().set_input_shaping('X', 0.f, print.calib_params().freqStartX);
-            gcode += writer().set_input_shaping('Y', 0.f, print.calib_params().freqStartY);
-        } else {
-            gcode += writer().set_input_shaping('A',
-                                                print.calib_params().start + ((print.calib_params().end) - (print.calib_params().start)) *
-                                                                                 (m_layer_index) / (m_layer_count),
-                                                0.f);
-        }
-        break;
-    }
-    case CalibMode::Calib_Junction_Deviation: {
-        gcode += writer().set_junction_deviation(print.calib_params().start + ((print.calib_params().end) - (print.calib_params().start)) *
-                                                                                  (m_layer_index) / (m_layer_count));
-        break;
-    }
     }
 
-    // BBS
-    if (first_layer) {
-        // Orca: we don't need to optimize the Klipper as only set once
-        if (m_config.default_acceleration.value > 0 && m_config.initial_layer_acceleration.value > 0) {
-            gcode += m_writer.set_print_acceleration((unsigned int) floor(m_config.initial_layer_acceleration.value + 0.5));
-        }
+    groups.local_z_phase_b_enabled =
+        groups.local_z_runtime_supported &&
+        std::any_of(local_z_layer_contexts.begin(), local_z_layer_contexts.end(), [](const LocalZLayerContext& ctx) { return ctx.enabled; });
 
-        if (m_config.default_jerk.value > 0 && m_config.initial_layer_jerk.value > 0) {
-            gcode += m_writer.set_jerk_xy(m_config.initial_layer_jerk.value);
-        }
+    for (const LayerToPrint& layer_to_print : layers) {
+        const size_t layer_to_print_idx = &layer_to_print - layers.data();
+        if (layer_to_print.support_layer != nullptr) {
+            const SupportLayer& support_layer = *layer_to_print.support_layer;
+            const PrintObject&  object        = *layer_to_print.original_object;
+            if (!support_layer.support_fills.entities.empty()) {
+                ExtrusionRole role          = support_layer.support_fills.role();
+                bool          has_support   = role == erMixed || role == erSupportMaterial || role == erSupportTransition;
+                bool          has_interface = role == erMixed || role == erSupportMaterialInterface;
+                // Extruder ID of the support base. -1 if "don't care".
+                unsigned int support_extruder = object.config().support_filament.value - 1;
+                // Shall the support be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
+                bool support_dontcare = object.config().support_filament.value == 0;
+                // Extruder ID of the support interface. -1 if "don't care".
+                unsigned int interface_extruder = object.config().support_interface_filament.value - 1;
+                // Shall the support interface be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
+                bool interface_dontcare = object.config().support_interface_filament.value == 0;
 
-        if (m_writer.get_gcode_flavor() == gcfMarlinFirmware && m_config.default_junction_deviation.value > 0) {
-            gcode += m_writer.set_junction_deviation(m_config.default_junction_deviation.value);
-        }
-    }
-
-    if (!first_layer && !m_second_layer_things_done) {
-        if (print.is_BBL_printer()) {
-            // BBS: open powerlost recovery
-            {
-                gcode += "; open powerlost recovery\n";
-                gcode += "M1003 S1\n";
-            }
-            // BBS: open first layer inspection at second layer
-            if (print.config().scan_first_layer.value) {
-                // BBS: retract first to avoid droping when scan model
-                gcode += this->retract();
-                gcode += "M976 S1 P1 ; scan model before printing 2nd layer\n";
-                gcode += "M400 P100\n";
-                gcode += this->unretract();
-            }
-        }
-        // Reset acceleration at sencond layer
-        // Orca: only set once, don't need to call set_accel_and_jerk
-        if (m_config.default_acceleration.value > 0 && m_config.initial_layer_acceleration.value > 0) {
-            gcode += m_writer.set_print_acceleration((unsigned int) floor(m_config.default_acceleration.value + 0.5));
-        }
-
-        if (m_config.default_jerk.value > 0 && m_config.initial_layer_jerk.value > 0) {
-            gcode += m_writer.set_jerk_xy(m_config.default_jerk.value);
-        }
-
-        // Transition from 1st to 2nd layer. Adjust nozzle temperatures as prescribed by the nozzle dependent
-        // nozzle_temperature_initial_layer vs. temperature settings.
-        for (const Extruder& extruder : m_writer.extruders()) {
-            if ((print.config().single_extruder_multi_material.value || m_ooze_prevention.enable) &&
-                extruder.id() != m_writer.extruder()->id())
-                // In single extruder multi material mode, set the temperature for the current extruder only.
-                continue;
-            int temperature = print.config().nozzle_temperature.get_at(extruder.id());
-            if (temperature > 0 && temperature != print.config().nozzle_temperature_initial_layer.get_at(extruder.id()))
-                gcode += m_writer.set_temperature(temperature, false, extruder.id());
-        }
-
-        // BBS
-        int bed_temp = get_bed_temperature(first_extruder_id, false, print.config().curr_bed_type);
-        gcode += m_writer.set_bed_temperature(bed_temp);
-        // Mark the temperature transition from 1st to 2nd layer to be finished.
-        m_second_layer_things_done = true;
-    }
-
-    if (single_object_instance_idx == size_t(-1)) {
-        // Normal (non-sequential) print.
-        gcode += ProcessLayer::emit_custom_gcode_per_print_z(*this, layer_tools.custom_gcode, m_writer.extruder()->id(), first_extruder_id,
-                                                             print.config());
-    }
-
-    // BBS: get next extruder according to flush and soluble
-    auto get_next_extruder = [&](int current_extruder, const std::vector<unsigned int>& extruders) {
-        std::vector<float> flush_matrix(cast<float>(m_config.flush_volumes_matrix.values));
-        const unsigned int number_of_extruders = (unsigned int) (sqrt(flush_matrix.size()) + EPSILON);
-        // Extract purging volumes for each extruder pair:
-        std::vector<std::vector<float>> wipe_volumes;
-        for (unsigned int i = 0; i < number_of_extruders; ++i)
-            wipe_volumes.push_back(
-                std::vector<float>(flush_matrix.begin() + i * number_of_extruders, flush_matrix.begin() + (i + 1) * number_of_extruders));
-        unsigned int next_extruder = current_extruder;
-        float        min_flush     = std::numeric_limits<float>::max();
-        for (auto extruder_id : extruders) {
-            if (print.config().filament_soluble.get_at(extruder_id) || extruder_id == current_extruder)
-                continue;
-            if (wipe_volumes[current_extruder][extruder_id] < min_flush) {
-                next_extruder = extruder_id;
-                min_flush     = wipe_volumes[current_extruder][extruder_id];
-            }
-        }
-        return next_extruder;
-    };
-
-    for (const auto& layer_to_print : layers) {
-        if (layer_to_print.object_layer) {
-            const auto& regions               = layer_to_print.object_layer->regions();
-            const bool  enable_overhang_speed = std::any_of(regions.begin(), regions.end(), [](const LayerRegion* r) {
-                return r->has_extrusions() && r->region().config().enable_overhang_speed;
-            });
-            if (enable_overhang_speed) {
-                m_extrusion_quality_estimator.prepare_for_new_layer(layer_to_print.original_object, layer_to_print.object_layer);
-            }
-        }
-    }
-
-    // Group extrusions by an extruder, then by an object, an island and a region.
-    std::map<unsigned int, std::vector<ObjectByExtruder>> by_extruder;
-    bool is_anything_overridden = const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden();
-    const double nozzle_0_mm = m_config.nozzle_diameter.values.empty() ? 0.4 : m_config.nozzle_diameter.get_at(0);
-    const double pointillism_pixel_size_cfg = std::max(0.0, double(m_config.mixed_filament_pointillism_pixel_size.value));
-    const double pointillism_segment_len_mm = pointillism_pixel_size_cfg > EPSILON ?
-        std::max(0.10, pointillism_pixel_size_cfg) :
-        std::max(0.60, 1.60 * nozzle_0_mm);
-    const double pointillism_line_gap_cfg_mm = std::max(0.0, double(m_config.mixed_filament_pointillism_line_gap.value));
-    const double pointillism_line_gap_mm = std::min(pointillism_line_gap_cfg_mm, pointillism_segment_len_mm * 0.90);
-    const double pointillism_segment_len_scaled = std::max<double>(scale_(0.10), scale_(pointillism_segment_len_mm));
-    const double pointillism_line_gap_scaled = std::max<double>(0.0, scale_(pointillism_line_gap_mm));
-    std::map<unsigned int, std::vector<unsigned int>> pointillism_sequence_cache;
-    size_t pointillism_path_split_entities  = 0;
-    size_t pointillism_path_split_segments  = 0;
-    size_t pointillism_path_split_fallbacks = 0;
-
-    auto configured_filament_id_1based = [&layer_tools](const ExtrusionEntityCollection& entities, const PrintRegion& region) -> unsigned int {
-        if (layer_tools.extruder_override != 0)
-            return layer_tools.extruder_override;
-        if (entities.has_infill()) {
-            if (entities.has_solid_infill())
-                return region.config().solid_infill_filament.value;
-            return region.config().sparse_infill_filament.value;
-        }
-        return region.config().wall_filament.value;
-    };
-
-    auto pointillism_sequence_for_filament = [&](unsigned int filament_id_1based) -> const std::vector<unsigned int>* {
-        if (filament_id_1based == 0 || layer_tools.mixed_mgr == nullptr || layer_tools.num_physical == 0)
-            return nullptr;
-        auto cache_it = pointillism_sequence_cache.find(filament_id_1based);
-        if (cache_it != pointillism_sequence_cache.end())
-            return cache_it->second.empty() ? nullptr : &cache_it->second;
-
-        std::vector<unsigned int> sequence;
-        if (layer_tools.mixed_mgr->is_mixed(filament_id_1based, layer_tools.num_physical)) {
-            const MixedFilament* mixed_row = layer_tools.mixed_mgr->mixed_filament_from_id(filament_id_1based, layer_tools.num_physical);
-            if (mixed_row != nullptr)
-                sequence = pointillism_sequence_for_row_for_gcode(*mixed_row, layer_tools.num_physical);
-            if (unique_extruder_count_for_gcode(sequence, layer_tools.num_physical) < 2)
-                sequence.clear();
-        }
-
-        auto inserted = pointillism_sequence_cache.emplace(filament_id_1based, std::move(sequence));
-        return inserted.first->second.empty() ? nullptr : &inserted.first->second;
-    };
-    // Compensate perimeter clipping at mixed-mask boundaries to avoid cracks from exact centerline clipping.
-    constexpr double LOCAL_Z_PERIMETER_MASK_EXPAND_MM = 0.10;
-    // Keep base exclusion smaller than mixed-pass inclusion to guarantee a slight overlap
-    // instead of a moat at the boundary.
-    constexpr double LOCAL_Z_BASE_MASK_EXPAND_MM      = 0.04;
-    const float      local_z_perimeter_mask_expand    = float(scale_(LOCAL_Z_PERIMETER_MASK_EXPAND_MM));
-    const float      local_z_base_mask_expand         = float(scale_(LOCAL_Z_BASE_MASK_EXPAND_MM));
-
-    struct LocalZPassBucket {
-        const SubLayerPlan*                                   plan { nullptr };
-        std::vector<ExPolygons>                               compensated_masks_by_extruder;
-        std::map<unsigned int, std::vector<ObjectByExtruder>> by_extruder;
-    };
-    struct LocalZLayerContext {
-        bool                    enabled { false };
-        ExPolygons              raw_mixed_masks_union;
-        ExPolygons              mixed_masks_union;
-        ExPolygons              mixed_masks_union_for_base_exclude;
-        size_t                  local_clipped_collections { 0 };
-        size_t                  base_clipped_collections { 0 };
-        size_t                  base_clip_leak_warnings { 0 };
-        std::vector<LocalZPassBucket> pass_buckets;
-    };
-
-    const bool local_z_perimeter_runtime_supported = !has_wipe_tower && !is_anything_overridden;
-    bool       local_z_phase_b_requested_for_layer = false;
-    std::vector<LocalZLayerContext> local_z_layer_contexts;
-    std::vector<std::unique_ptr<ExtrusionEntityCollection>> local_z_clipped_collections;
-    size_t local_z_rejected_context_logs = 0;
-    if (local_z_perimeter_runtime_supported) {
-        local_z_layer_contexts.resize(layers.size());
-        for (size_t layer_to_print_idx = 0; layer_to_print_idx < layers.size(); ++layer_to_print_idx) {
-            const LayerToPrint& layer_to_print = layers[layer_to_print_idx];
-            if (layer_to_print.object_layer == nullptr)
-                continue;
-
-            const PrintObject* print_object = layer_to_print.original_object != nullptr ? layer_to_print.original_object : layer_to_print.object();
-            if (print_object == nullptr)
-                continue;
-
-            const size_t layer_id = size_t(layer_to_print.object_layer->id());
-            const auto& intervals = print_object->local_z_intervals();
-            const auto& plans     = print_object->local_z_sublayer_plan();
-            if (intervals.empty() || plans.empty())
-                continue;
-
-            auto it_interval = std::find_if(intervals.begin(), intervals.end(), [layer_id](const LocalZInterval& interval) {
-                return interval.layer_id == layer_id;
-            });
-            if (it_interval == intervals.end())
-                continue;
-            if (!it_interval->has_mixed_paint || it_interval->sublayer_count <= 1 || it_interval->first_sublayer_idx >= plans.size())
-                continue;
-            local_z_phase_b_requested_for_layer = true;
-
-            LocalZLayerContext& ctx = local_z_layer_contexts[layer_to_print_idx];
-            ctx.enabled = true;
-            const size_t first_idx = it_interval->first_sublayer_idx;
-            const size_t end_idx   = std::min(plans.size(), first_idx + it_interval->sublayer_count);
-            size_t       split_plan_count                    = 0;
-            size_t       split_plan_with_raw_masks           = 0;
-            size_t       split_plan_with_compensated_masks   = 0;
-            size_t       raw_mask_polygon_count              = 0;
-            size_t       compensated_mask_polygon_count      = 0;
-            ExPolygons   raw_mixed_masks_union;
-            for (size_t plan_idx = first_idx; plan_idx < end_idx; ++plan_idx) {
-                const SubLayerPlan& plan = plans[plan_idx];
-                if (!plan.split_interval)
-                    continue;
-                ++split_plan_count;
-
-                LocalZPassBucket bucket;
-                bucket.plan = &plan;
-                bucket.compensated_masks_by_extruder.assign(plan.painted_masks_by_extruder.size(), ExPolygons());
-                bool pass_has_raw_masks         = false;
-                bool pass_has_compensated_masks = false;
-                for (size_t extruder_id = 0; extruder_id < plan.painted_masks_by_extruder.size(); ++extruder_id) {
-                    const ExPolygons& raw_masks = plan.painted_masks_by_extruder[extruder_id];
-                    if (raw_masks.empty())
-                        continue;
-                    pass_has_raw_masks = true;
-                    raw_mask_polygon_count += raw_masks.size();
-                    append(raw_mixed_masks_union, raw_masks);
-                    ExPolygons compensated = local_z_compensate_masks(raw_masks, local_z_perimeter_mask_expand, true);
-                    if (!compensated.empty()) {
-                        pass_has_compensated_masks = true;
-                        compensated_mask_polygon_count += compensated.size();
-                    }
-                    bucket.compensated_masks_by_extruder[extruder_id] = std::move(compensated);
-                }
-                if (pass_has_raw_masks)
-                    ++split_plan_with_raw_masks;
-                if (pass_has_compensated_masks) {
-                    ++split_plan_with_compensated_masks;
-                    ctx.pass_buckets.emplace_back(std::move(bucket));
-
-                    const LocalZPassBucket& appended_bucket = ctx.pass_buckets.back();
-                    for (const ExPolygons& masks : appended_bucket.compensated_masks_by_extruder)
-                        append(ctx.mixed_masks_union, masks);
-                }
-            }
-            if (!raw_mixed_masks_union.empty() && raw_mixed_masks_union.size() > 1)
-                raw_mixed_masks_union = union_ex(raw_mixed_masks_union);
-            ctx.raw_mixed_masks_union = raw_mixed_masks_union;
-            if (!ctx.mixed_masks_union.empty() && ctx.mixed_masks_union.size() > 1) {
-                ExPolygons merged_masks = union_ex(ctx.mixed_masks_union);
-                if (!merged_masks.empty())
-                    ctx.mixed_masks_union = std::move(merged_masks);
-                else if (!raw_mixed_masks_union.empty())
-                    ctx.mixed_masks_union = raw_mixed_masks_union;
-            }
-            if (ctx.mixed_masks_union.empty() && !raw_mixed_masks_union.empty())
-                ctx.mixed_masks_union = raw_mixed_masks_union;
-            const ExPolygons &base_exclude_source = !ctx.raw_mixed_masks_union.empty() ? ctx.raw_mixed_masks_union : ctx.mixed_masks_union;
-            if (!base_exclude_source.empty()) {
-                ctx.mixed_masks_union_for_base_exclude =
-                    local_z_compensate_masks(base_exclude_source, local_z_base_mask_expand, true);
-            }
-            if (ctx.pass_buckets.empty() || ctx.mixed_masks_union.empty()) {
-                ctx.enabled = false;
-                if (local_z_rejected_context_logs < 50) {
-                    ++local_z_rejected_context_logs;
-                    BOOST_LOG_TRIVIAL(warning) << "Local-Z context rejected"
-                                               << " print_z=" << print_z
-                                               << " layer_id=" << layer_id
-                                               << " first_idx=" << first_idx
-                                               << " end_idx=" << end_idx
-                                               << " interval_sublayer_count=" << it_interval->sublayer_count
-                                               << " split_plan_count=" << split_plan_count
-                                               << " split_plan_with_raw_masks=" << split_plan_with_raw_masks
-                                               << " split_plan_with_compensated_masks=" << split_plan_with_compensated_masks
-                                               << " raw_mask_polygon_count=" << raw_mask_polygon_count
-                                               << " compensated_mask_polygon_count=" << compensated_mask_polygon_count
-                                               << " pass_buckets=" << ctx.pass_buckets.size()
-                                               << " mixed_mask_count=" << ctx.mixed_masks_union.size();
-                }
-            }
-            BOOST_LOG_TRIVIAL(debug) << "Local-Z context"
-                                     << " print_z=" << print_z
-                                     << " layer_id=" << layer_id
-                                     << " enabled=" << ctx.enabled
-                                     << " split_pass_count=" << ctx.pass_buckets.size()
-                                     << " mixed_mask_count=" << ctx.mixed_masks_union.size()
-                                     << " base_exclude_mask_count=" << ctx.mixed_masks_union_for_base_exclude.size()
-                                     << " perimeter_mask_expand_mm=" << LOCAL_Z_PERIMETER_MASK_EXPAND_MM
-                                     << " base_mask_expand_mm=" << LOCAL_Z_BASE_MASK_EXPAND_MM;
-        }
-    } else {
-        for (const LayerToPrint& layer_to_print : layers) {
-            if (layer_to_print.object_layer == nullptr)
-                continue;
-            const PrintObject* print_object = layer_to_print.original_object != nullptr ? layer_to_print.original_object : layer_to_print.object();
-            if (print_object == nullptr)
-                continue;
-            const size_t layer_id = size_t(layer_to_print.object_layer->id());
-            const auto& intervals = print_object->local_z_intervals();
-            auto it_interval = std::find_if(intervals.begin(), intervals.end(), [layer_id](const LocalZInterval& interval) {
-                return interval.layer_id == layer_id;
-            });
-            if (it_interval != intervals.end() && it_interval->has_mixed_paint && it_interval->sublayer_count > 1) {
-                local_z_phase_b_requested_for_layer = true;
-                break;
-            }
-        }
-    }
-
-    const bool local_z_perimeter_phase_b_enabled =
-        local_z_perimeter_runtime_supported &&
-        std::any_of(local_z_layer_contexts.begin(), local_z_layer_contexts.end(), [](const LocalZLayerContext& ctx) { return ctx.enabled; });
-    if (local_z_phase_b_requested_for_layer && !local_z_perimeter_runtime_supported) {
-        BOOST_LOG_TRIVIAL(warning) << "Local-Z phase-b disabled"
-                                   << " print_z=" << print_z
-                                   << " wipe_tower=" << has_wipe_tower
-                                   << " wiping_overrides=" << is_anything_overridden;
-        gcode += "; local-z perimeter phase-b disabled for this layer (wipe tower or wiping overrides active)\n";
-    } else if (local_z_phase_b_requested_for_layer && !local_z_perimeter_phase_b_enabled) {
-        BOOST_LOG_TRIVIAL(warning) << "Local-Z phase-b requested but no eligible contexts"
-                                   << " print_z=" << print_z
-                                   << " runtime_supported=" << local_z_perimeter_runtime_supported;
-    }
-
-    for (const LayerToPrint& layer_to_print : layers) {
-        const size_t layer_to_print_idx = &layer_to_print - layers.data();
-        if (layer_to_print.support_layer != nullptr) {
-            const SupportLayer& support_layer = *layer_to_print.support_layer;
-            const PrintObject&  object        = *layer_to_print.original_object;
-            if (!support_layer.support_fills.entities.empty()) {
-                ExtrusionRole role          = support_layer.support_fills.role();
-                bool          has_support   = role == erMixed || role == erSupportMaterial || role == erSupportTransition;
-                bool          has_interface = role == erMixed || role == erSupportMaterialInterface;
-                // Extruder ID of the support base. -1 if "don't care".
-                unsigned int support_extruder = object.config().support_filament.value - 1;
-                // Shall the support be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
-                bool support_dontcare = object.config().support_filament.value == 0;
-                // Extruder ID of the support interface. -1 if "don't care".
-                unsigned int interface_extruder = object.config().support_interface_filament.value - 1;
-                // Shall the support interface be printed with the active extruder, preferably with non-soluble, to avoid tool changes?
-                bool interface_dontcare = object.config().support_interface_filament.value == 0;
-
-                // BBS: apply wiping overridden extruders
-                WipingExtrusions& wiping_extrusions = const_cast<LayerTools&>(layer_tools).wiping_extrusions();
-                if (support_dontcare) {
-                    int extruder_override = wiping_extrusions.get_support_extruder_overrides(&object);
-                    if (extruder_override >= 0) {
-                        support_extruder = extruder_override;
-                        support_dontcare = false;
-                    }
-                }
+                // BBS: apply wiping overridden extruders
+                WipingExtrusions& wiping_extrusions = const_cast<LayerTools&>(layer_tools).wiping_extrusions();
+                if (support_dontcare) {
+                    int extruder_override = wiping_extrusions.get_support_extruder_overrides(&object);
+                    if (extruder_override >= 0) {
+                        support_extruder = extruder_override;
+                        support_dontcare = false;
+                    }
+                }
 
                 if (interface_dontcare) {
                     int extruder_override = wiping_extrusions.get_support_interface_extruder_overrides(&object);
@@ -4823,7 +4787,7 @@ LayerResult GCode::process_layer(const Print& print,
         if (layer_to_print.object_layer != nullptr) {
             const Layer& layer = *layer_to_print.object_layer;
             LocalZLayerContext* local_z_ctx =
-                (local_z_perimeter_phase_b_enabled && layer_to_print_idx < local_z_layer_contexts.size() && local_z_layer_contexts[layer_to_print_idx].enabled)
+                (groups.local_z_phase_b_enabled && layer_to_print_idx < local_z_layer_contexts.size() && local_z_layer_contexts[layer_to_print_idx].enabled)
                     ? &local_z_layer_contexts[layer_to_print_idx]
                     : nullptr;
             // We now define a strategy for building perimeters and fills. The separation
@@ -4862,207 +4826,547 @@ LayerResult GCode::process_layer(const Print& print,
                 // identify the content of PrintRegion accross the whole print uniquely. Translate to a Print specific PrintRegion.
                 const PrintRegion& region = print.get_print_region(layerm->region().print_region_id());
 
-                // Now we must process perimeters and infills and create islands of extrusions in by_region std::map.
-                // It is also necessary to save which extrusions are part of MM wiping and which are not.
-                // The process is almost the same for perimeters and infills - we will do it in a cycle that repeats twice:
-                std::vector<unsigned int> printing_extruders;
-                for (const ObjectByExtruder::Island::Region::Type entity_type :
-                     {ObjectByExtruder::Island::Region::INFILL, ObjectByExtruder::Island::Region::PERIMETERS}) {
-                    for (const ExtrusionEntity* ee :
-                         (entity_type == ObjectByExtruder::Island::Region::INFILL) ? layerm->fills.entities : layerm->perimeters.entities) {
-                        // extrusions represents infill or perimeter extrusions of a single island.
-                        assert(dynamic_cast<const ExtrusionEntityCollection*>(ee) != nullptr);
-                        const auto* extrusions = static_cast<const ExtrusionEntityCollection*>(ee);
-                        if (extrusions->entities.empty()) // This shouldn't happen but first_point() would fail.
-                            continue;
+                // Now we must process perimeters and infills and create islands of extrusions in by_region std::map.
+                // It is also necessary to save which extrusions are part of MM wiping and which are not.
+                // The process is almost the same for perimeters and infills - we will do it in a cycle that repeats twice:
+                std::vector<unsigned int> printing_extruders;
+                for (const ObjectByExtruder::Island::Region::Type entity_type :
+                     {ObjectByExtruder::Island::Region::INFILL, ObjectByExtruder::Island::Region::PERIMETERS}) {
+                    const ExtrusionEntitiesPtr& entities =
+                        (entity_type == ObjectByExtruder::Island::Region::INFILL) ? layerm->fills.entities : layerm->perimeters.entities;
+                    for (size_t entity_idx = 0; entity_idx < entities.size(); ++entity_idx) {
+                        // extrusions represents infill or perimeter extrusions of a single island.
+                        assert(dynamic_cast<const ExtrusionEntityCollection*>(entities[entity_idx]) != nullptr);
+                        const auto* extrusions = static_cast<const ExtrusionEntityCollection*>(entities[entity_idx]);
+                        if (extrusions->entities.empty()) // This shouldn't happen but first_point() would fail.
+                            continue;
+
+                        const ExtrusionEntityCollection* filtered_extrusions = extrusions;
+                        if (entity_type == ObjectByExtruder::Island::Region::PERIMETERS && local_z_ctx != nullptr &&
+                            region_id < local_z_ctx->extrusions->perimeters.size() &&
+                            entity_idx < local_z_ctx->extrusions->perimeters[region_id].size()) {
+                            const LocalZLayerExtrusions::ClippedPerimeters& clipped = local_z_ctx->extrusions->perimeters[region_id][entity_idx];
+                            for (size_t pass_idx = 0; pass_idx < clipped.by_pass.size() && pass_idx < local_z_ctx->pass_buckets.size(); ++pass_idx) {
+                                LocalZPassBucket& pass_bucket = local_z_ctx->pass_buckets[pass_idx];
+                                for (size_t pass_extruder_id = 0; pass_extruder_id < clipped.by_pass[pass_idx].size(); ++pass_extruder_id) {
+                                    const ExtrusionEntityCollection* clipped_ptr = clipped.by_pass[pass_idx][pass_extruder_id].get();
+                                    if (clipped_ptr == nullptr)
+                                        continue;
+                                    ++local_z_ctx->local_clipped_collections;
+                                    std::vector<ObjectByExtruder::Island>& islands = object_islands_by_extruder(
+                                        pass_bucket.by_extruder, unsigned(pass_extruder_id), layer_to_print_idx, layers.size(), n_slices + 1);
+
+                                    for (size_t i = 0; i <= n_slices; ++i) {
+                                        const bool   last       = i == n_slices;
+                                        const size_t island_idx = last ? n_slices : slices_test_order[i];
+                                        if (last || point_inside_surface(island_idx, clipped_ptr->first_point())) {
+                                            if (islands[island_idx].by_region.empty())
+                                                islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
+                                            islands[island_idx].by_region[region.print_region_id()].append(
+                                                ObjectByExtruder::Island::Region::PERIMETERS, clipped_ptr, nullptr);
+                                            break;
+                                        }
+                                    }
+                                }
+                            }
+                            if (!clipped.base)
+                                continue;
+                            ++local_z_ctx->base_clipped_collections;
+                            filtered_extrusions = clipped.base.get();
+                        }
+
+                        const unsigned int configured_filament_id = configured_filament_id_1based(*filtered_extrusions, region);
+                        const std::vector<unsigned int>* pointillism_sequence =
+                            is_anything_overridden ? nullptr : pointillism_sequence_for_filament(configured_filament_id);
+                        if (pointillism_sequence != nullptr) {
+                            std::vector<std::unique_ptr<ExtrusionEntityCollection>> split_by_extruder;
+                            PointillismPathSplitStats split_stats;
+                            const size_t sequence_phase = pointillism_sequence->empty() ?
+                                0 : size_t(std::max(0, layer_tools.layer_index)) % pointillism_sequence->size();
+                            if (split_extrusion_collection_for_pointillism_paths(*filtered_extrusions,
+                                                                                  *pointillism_sequence,
+                                                                                  layer_tools.num_physical,
+                                                                                  pointillism_segment_len_scaled,
+                                                                                  pointillism_line_gap_scaled,
+                                                                                  sequence_phase,
+                                                                                  pointillism_tile_for_filament(configured_filament_id, *pointillism_sequence),
+                                                                                  split_by_extruder,
+                                                                                  split_stats) &&
+                                split_stats.bucket_count >= 2) {
+                                ++groups.pointillism_path_split_entities;
+                                groups.pointillism_path_split_segments += split_stats.segment_count;
+                                for (size_t extruder_idx = 0; extruder_idx < split_by_extruder.size(); ++extruder_idx) {
+                                    std::unique_ptr<ExtrusionEntityCollection>& split_collection = split_by_extruder[extruder_idx];
+                                    if (!split_collection || split_collection->entities.empty())
+                                        continue;
+                                    const ExtrusionEntityCollection* split_ptr = split_collection.get();
+                                    groups.owned_collections.emplace_back(std::move(split_collection));
+                                    std::vector<ObjectByExtruder::Island>& islands =
+                                        object_islands_by_extruder(by_extruder, unsigned(extruder_idx), layer_to_print_idx, layers.size(), n_slices + 1);
+                                    for (size_t i = 0; i <= n_slices; ++i) {
+                                        const bool   last       = i == n_slices;
+                                        const size_t island_idx = last ? n_slices : slices_test_order[i];
+                                        if (last || point_inside_surface(island_idx, split_ptr->first_point())) {
+                                            if (islands[island_idx].by_region.empty())
+                                                islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
+                                            islands[island_idx].by_region[region.print_region_id()].append(entity_type, split_ptr, nullptr);
+                                            break;
+                                        }
+                                    }
+                                }
+                                continue;
+                            }
+                            ++groups.pointillism_path_split_fallbacks;
+                        }
+
+                        // This extrusion is part of certain Region, which tells us which extruder should be used for it:
+                        int correct_extruder_id = layer_tools.extruder(*filtered_extrusions, region);
+
+                        // Let's recover vector of extruder overrides:
+                        const WipingExtrusions::ExtruderPerCopy* entity_overrides = nullptr;
+                        if (!layer_tools.has_extruder(correct_extruder_id)) {
+                            // this entity is not overridden, but its extruder is not in layer_tools - we'll print it
+                            // by last extruder on this layer (could happen e.g. when a wiping object is taller than others - dontcare
+                            // extruders are eradicated from layer_tools)
+                            correct_extruder_id = layer_tools.extruders.back();
+                        }
+                        printing_extruders.clear();
+                        if (is_anything_overridden) {
+                            entity_overrides = const_cast<LayerTools&>(layer_tools)
+                                                   .wiping_extrusions()
+                                                   .get_extruder_overrides(filtered_extrusions, layer_to_print.original_object, correct_extruder_id,
+                                                                           layer_to_print.object()->instances().size());
+                            if (entity_overrides == nullptr) {
+                                printing_extruders.emplace_back(correct_extruder_id);
+                            } else {
+                                printing_extruders.reserve(entity_overrides->size());
+                                for (int extruder : *entity_overrides)
+                                    printing_extruders.emplace_back(extruder >= 0 ?
+                                                                        // at least one copy is overridden to use this extruder
+                                                                        extruder :
+                                                                        // at least one copy would normally be printed with this extruder
+                                                                        // (see get_extruder_overrides function for explanation)
+                                                                        static_cast<unsigned int>(-extruder - 1));
+                                Slic3r::sort_remove_duplicates(printing_extruders);
+                            }
+                        } else
+                            printing_extruders.emplace_back(correct_extruder_id);
+
+                        // Now we must add this extrusion into the by_extruder map, once for each extruder that will print it:
+                        for (unsigned int extruder : printing_extruders) {
+                            std::vector<ObjectByExtruder::Island>& islands =
+                                object_islands_by_extruder(by_extruder, extruder, layer_to_print_idx, layers.size(), n_slices + 1);
+                            for (size_t i = 0; i <= n_slices; ++i) {
+                                bool   last       = i == n_slices;
+                                size_t island_idx = last ? n_slices : slices_test_order[i];
+                                if ( // extrusions->first_point does not fit inside any slice
+                                    last ||
+                                    // extrusions->first_point fits inside ith slice
+                                    point_inside_surface(island_idx, filtered_extrusions->first_point())) {
+                                    if (islands[island_idx].by_region.empty())
+                                        islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
+                                    islands[island_idx].by_region[region.print_region_id()].append(entity_type, filtered_extrusions,
+                                                                                                   entity_overrides);
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+            } // for regions
+        }
+    } // for objects
+
+    return groups;
+}
+
+LayerResult GCode::process_layer(const Print& print,
+                                 // Set of object & print layers of the same PrintObject and with the same print_z.
+                                 const std::vector<LayerToPrint>& layers,
+                                 const LayerTools&                layer_tools,
+                                 const bool                       last_layer,
+                                 // Pairs of PrintObject index and its instance index.
+                                 const std::vector<const PrintInstance*>* ordering,
+                                 // If set to size_t(-1), then print all copies of all objects.
+                                 // Otherwise print a single copy of a single object.
+                                 const size_t single_object_instance_idx,
+                                 // BBS
+                                 const bool prime_extruder,
+                                 LayerExtrusionGroups* prebuilt_groups,
+                                 LayerGeneratedAhead*  generated_ahead)
+{
+    assert(!layers.empty());
+    // Either printing all copies of all objects, or just a single copy of a single object.
+    assert(single_object_instance_idx == size_t(-1) || layers.size() == 1);
+
+    // First object, support and raft layer, if available.
+    const Layer*        object_layer  = nullptr;
+    const SupportLayer* support_layer = nullptr;
+    const SupportLayer* raft_layer    = nullptr;
+    for (const LayerToPrint& l : layers) {
+        if (l.object_layer && !object_layer)
+            object_layer = l.object_layer;
+        if (l.support_layer) {
+            if (!support_layer)
+                support_layer = l.support_layer;
+            if (!raft_layer && support_layer->id() < support_layer->object()->slicing_parameters().raft_layers())
+                raft_layer = support_layer;
+        }
+    }
+
+    const Layer* layer_ptr = nullptr;
+    if (object_layer != nullptr)
+        layer_ptr = object_layer;
+    else if (support_layer != nullptr)
+        layer_ptr = support_layer;
+    const Layer& layer = *layer_ptr;
+    LayerResult  result{{}, layer.id(), false, last_layer};
+    // The moves formatted while generating this layer are bound to its G-code at the end.
+    m_writer.moves().clear();
+    if (layer_tools.extruders.empty())
+        // Nothing to extrude.
+        return result;
+
+    // Extract 1st object_layer and support_layer of this set of layers with an equal print_z.
+    coordf_t print_z = layer.print_z;
+    // BBS: using layer id to judge whether the layer is first layer is wrong. Because if the normal
+    // support is attached above the object, and support layers has independent layer height, then the lowest support
+    // interface layer id is 0.
+    bool first_layer = (layer.id() == 0 && abs(layer.bottom_z()) < EPSILON);
+    m_writer.set_is_first_layer(first_layer);
+    unsigned int first_extruder_id = layer_tools.extruders.front();
+
+    // Initialize config with the 1st object to be printed at this layer.
+    m_config.apply(layer.object()->config(), true);
+
+    // Check whether it is possible to apply the spiral vase logic for this layer.
+    // Just a reminder: A spiral vase mode is allowed for a single object, single material print only.
+    m_enable_loop_clipping = true;
+    if (m_spiral_vase && layers.size() == 1 && support_layer == nullptr) {
+        bool enable = (layer.id() > 0 || !print.has_brim()) &&
+                      (layer.id() >= (size_t) print.config().skirt_height.value && !print.has_infinite_skirt());
+        if (enable) {
+            for (const LayerRegion* layer_region : layer.regions())
+                if (size_t(layer_region->region().config().bottom_shell_layers.value) > layer.id() ||
+                    layer_region->perimeters.items_count() > 1u || layer_region->fills.items_count() > 0) {
+                    enable = false;
+                    break;
+                }
+        }
+        result.spiral_vase_enable = enable;
+        // If we're going to apply spiralvase to this layer, disable loop clipping.
+        m_enable_loop_clipping = !enable;
+    }
+
+    std::string gcode;
+    assert(is_decimal_separator_point()); // for the sprintfs
+
+    // add tag for processor
+    gcode += ";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Layer_Change) + "\n";
+    // export layer z
+    char buf[64];
+    sprintf(buf, print.is_BBL_printer() ? "; Z_HEIGHT: %g\n" : ";Z:%g\n", print_z);
+    gcode += buf;
+    // export layer height
+    float height = first_layer ? static_cast<float>(print_z) : static_cast<float>(print_z) - m_last_layer_z;
+    sprintf(buf, ";%s%g\n", GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Height).c_str(), height);
+    gcode += buf;
+    // update caches
+    m_last_layer_z = static_cast<float>(print_z);
+    m_max_layer_z  = std::max(m_max_layer_z, m_last_layer_z);
+    m_last_height  = height;
+
+    // Set new layer - this will change Z and force a retraction if retract_when_changing_layer is enabled.
+    if (!m_config.before_layer_change_gcode.value.empty()) {
+        DynamicConfig config;
+        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index + 1));
+        config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
+        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
+        gcode += this->placeholder_parser_process("before_layer_change_gcode", print.config().before_layer_change_gcode.value,
+                                                  m_writer.extruder()->id(), &config) +
+                 "\n";
+    }
+
+    PrinterStructure printer_structure                           = m_config.printer_structure.value;
+    bool             need_insert_timelapse_gcode_for_traditional = false;
+    if (printer_structure == PrinterStructure::psI3 && !m_spiral_vase && (!m_wipe_tower || !m_wipe_tower->enable_timelapse_print()) &&
+        print.config().print_sequence == PrintSequence::ByLayer) {
+        need_insert_timelapse_gcode_for_traditional = true;
+    }
+    bool has_insert_timelapse_gcode = false;
+    bool has_wipe_tower             = (layer_tools.has_wipe_tower && m_wipe_tower);
+
+    auto insert_timelapse_gcode = [this, print_z, &print]() -> std::string {
+        std::string gcode_res;
+        if (!m_config.time_lapse_gcode.value.empty()) {
+            DynamicConfig config;
+            config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
+            config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
+            config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
+            gcode_res = this->placeholder_parser_process("timelapse_gcode", print.config().time_lapse_gcode.value,
+                                                         m_writer.extruder()->id(), &config) +
+                        "\n";
+        }
+        return gcode_res;
+    };
+
+    // BBS: don't use lazy_raise when enable spiral vase
+    gcode += this->change_layer(print_z); // this will increase m_layer_index
+    m_layer                  = &layer;
+    m_object_layer_over_raft = false;
+    if (is_BBL_Printer()) {
+        if (printer_structure == PrinterStructure::psI3 && !need_insert_timelapse_gcode_for_traditional && !m_spiral_vase &&
+            print.config().print_sequence == PrintSequence::ByLayer) {
+            std::string timepals_gcode = insert_timelapse_gcode();
+            if (!timepals_gcode.empty()) {
+                gcode += timepals_gcode;
+                m_writer.set_current_position_clear(false);
+                // BBS: check whether custom gcode changes the z position. Update if changed
+                double temp_z_after_timepals_gcode;
+                if (GCodeProcessor::get_last_z_from_gcode(timepals_gcode, temp_z_after_timepals_gcode)) {
+                    Vec3d pos = m_writer.get_position();
+                    pos(2)    = temp_z_after_timepals_gcode;
+                    m_writer.set_position(pos);
+                }
+            }
+        }
+    } else {
+        if (!m_config.time_lapse_gcode.value.empty()) {
+            DynamicConfig config;
+            config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
+            config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
+            config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
+            gcode += this->placeholder_parser_process("timelapse_gcode", print.config().time_lapse_gcode.value, m_writer.extruder()->id(),
+                                                      &config) +
+                     "\n";
+        }
+    }
+    if (!m_config.layer_change_gcode.value.empty()) {
+        DynamicConfig config;
+        config.set_key_value("layer_num", new ConfigOptionInt(m_layer_index));
+        config.set_key_value("layer_z", new ConfigOptionFloat(print_z));
+        gcode += this->placeholder_parser_process("layer_change_gcode", print.config().layer_change_gcode.value, m_writer.extruder()->id(),
+                                                  &config) +
+                 "\n";
+        config.set_key_value("max_layer_z", new ConfigOptionFloat(m_max_layer_z));
+    }
+    // BBS: set layer time fan speed after layer change gcode
+    gcode += ";_SET_FAN_SPEED_CHANGING_LAYER\n";
+
+    // Calibration Layer-specific GCode
+    switch (print.calib_mode()) {
+    case CalibMode::Calib_PA_Tower: {
+        writer().set_pressure_advance(gcode, print.calib_params().start + static_cast<int>(print_z) * print.calib_params().step);
+        break;
+    }
+    case CalibMode::Calib_Temp_Tower: {
+        auto offset = static_cast<unsigned int>(print_z / 10.001) * 5;
+        writer().set_temperature(gcode, print.calib_params().start - offset);
+        break;
+    }
+    case CalibMode::Calib_VFA_Tower: {
+        auto _speed = print.calib_params().start + std::floor(print_z / 5.0) * print.calib_params().step;
+        m_calib_config.set_key_value("outer_wall_speed", new ConfigOptionFloat(std::round(_speed)));
+        break;
+    }
+    case CalibMode::Calib_Vol_speed_Tower: {
+        auto _speed = print.calib_params().start + print_z * print.calib_params().step;
+        m_calib_config.set_key_value("outer_wall_speed", new ConfigOptionFloat(std::round(_speed)));
+        break;
+    }
+    case CalibMode::Calib_Retraction_tower: {
+        auto          _length = print.calib_params().start + std::floor(std::max(0.0, print_z - 0.4)) * print.calib_params().step;
+        DynamicConfig _cfg;
+        _cfg.set_key_value("retraction_length", new ConfigOptionFloats{_length});
+        writer().config.apply(_cfg);
+        sprintf(buf, "; Calib_Retraction_tower: Z_HEIGHT: %g, length:%g\n", print_z, _length);
+        gcode += buf;
+        break;
+    }
+    case CalibMode::Calib_Input_shaping_freq: {
+        if (m_layer_index == 1) {
+            gcode += writer().set_input_shaping('A', print.calib_params().start, 0.f);
+        } else {
+            if (print.calib_params().freqStartX == print.calib_params().freqStartY &&
+                print.calib_params().freqEndX == print.calib_params().freqEndY) {
+                gcode += writer().set_input_shaping('A', 0.f,
+                                                    (print.calib_params().freqStartX) +
+                                                        ((print.calib_params().freqEndX) - (print.calib_params().freqStartX)) *
+                                                            (m_layer_index - 2) / (m_layer_count - 3));
+            } else {
+                gcode += writer().set_input_shaping('X', 0.f,
+                                                    (print.calib_params().freqStartX) +
+                                                        ((print.calib_params().freqEndX) - (print.calib_params().freqStartX)) *
+                                                            (m_layer_index - 2) / (m_layer_count - 3));
+                gcode += writer().set_input_shaping('Y', 0.f,
+                                                    (print.calib_params().freqStartY) +
+                                                        ((print.calib_params().freqEndY) - (print.calib_params().freqStartY)) *
+                                                            (m_layer_index - 2) / (m_layer_count - 3));
+            }
+        }
+        break;
+    }
+    case CalibMode::Calib_Input_shaping_damp: {
+        if (m_layer_index == 1) {
+            gcode += writer().set_input_shaping('X', 0.f, print.calib_params().freqStartX);
+            gcode += writer().set_input_shaping('Y', 0.f, print.calib_params().freqStartY);
+        } else {
+            gcode += writer().set_input_shaping('A',
+                                                print.calib_params().start + ((print.calib_params().end) - (print.calib_params().start)) *
+                                                                                 (m_layer_index) / (m_layer_count),
+                                                0.f);
+        }
+        break;
+    }
+    case CalibMode::Calib_Junction_Deviation: {
+        writer().set_junction_deviation(gcode, print.calib_params().start + ((print.calib_params().end) - (print.calib_params().start)) *
+                                                                         (m_layer_index) / (m_layer_count));
+        break;
+    }
+    }
+
+    // BBS
+    if (first_layer) {
+        // Orca: we don't need to optimize the Klipper as only set once
+        if (m_config.default_acceleration.value > 0 && m_config.initial_layer_acceleration.value > 0) {
+            m_writer.set_print_acceleration(gcode, (unsigned int) floor(m_config.initial_layer_acceleration.value + 0.5));
+        }
+
+        if (m_config.default_jerk.value > 0 && m_config.initial_layer_jerk.value > 0) {
+            m_writer.set_jerk_xy(gcode, m_config.initial_layer_jerk.value);
+        }
 
-                        const ExtrusionEntityCollection* filtered_extrusions = extrusions;
-                        if (entity_type == ObjectByExtruder::Island::Region::PERIMETERS &&
-                            local_z_ctx != nullptr && !local_z_ctx->mixed_masks_union.empty()) {
-                            for (LocalZPassBucket& pass_bucket : local_z_ctx->pass_buckets) {
-                                if (pass_bucket.plan == nullptr)
-                                    continue;
-                                for (size_t pass_extruder_id = 0; pass_extruder_id < pass_bucket.plan->painted_masks_by_extruder.size();
-                                     ++pass_extruder_id) {
-                                    const ExPolygons& pass_masks = pass_bucket.compensated_masks_by_extruder.empty()
-                                        ? pass_bucket.plan->painted_masks_by_extruder[pass_extruder_id]
-                                        : pass_bucket.compensated_masks_by_extruder[pass_extruder_id];
-                                    if (pass_masks.empty())
-                                        continue;
-                                    auto clipped_local = clip_extrusion_collection_for_local_z(*extrusions, &pass_masks, nullptr, pass_bucket.plan->flow_height);
-                                    if (!clipped_local)
-                                        continue;
+        if (m_writer.get_gcode_flavor() == gcfMarlinFirmware && m_config.default_junction_deviation.value > 0) {
+            m_writer.set_junction_deviation(gcode, m_config.default_junction_deviation.value);
+        }
+    }
 
-                                    const ExtrusionEntityCollection* clipped_ptr = clipped_local.get();
-                                    const LocalZPathHeightStats local_height_stats = collect_local_z_path_height_stats(*clipped_ptr);
-                                    ++local_z_ctx->local_clipped_collections;
-                                    if (local_height_stats.count > 0 &&
-                                        (std::abs(local_height_stats.min - pass_bucket.plan->flow_height) > 1e-3 ||
-                                         std::abs(local_height_stats.max - pass_bucket.plan->flow_height) > 1e-3)) {
-                                        BOOST_LOG_TRIVIAL(warning) << "Local-Z local pass height mismatch"
-                                                                   << " print_z=" << print_z
-                                                                   << " layer_to_print_idx=" << layer_to_print_idx
-                                                                   << " plan_layer_id=" << pass_bucket.plan->layer_id
-                                                                   << " pass_index=" << pass_bucket.plan->pass_index
-                                                                   << " expected_height=" << pass_bucket.plan->flow_height
-                                                                   << " observed_min=" << local_height_stats.min
-                                                                   << " observed_max=" << local_height_stats.max
-                                                                   << " path_count=" << local_height_stats.count;
-                                    }
-                                    local_z_clipped_collections.emplace_back(std::move(clipped_local));
-                                    std::vector<ObjectByExtruder::Island>& islands = object_islands_by_extruder(
-                                        pass_bucket.by_extruder, unsigned(pass_extruder_id), layer_to_print_idx, layers.size(), n_slices + 1);
+    if (!first_layer && !m_second_layer_things_done) {
+        if (print.is_BBL_printer()) {
+            // BBS: open powerlost recovery
+            {
+                gcode += "; open powerlost recovery\n";
+                gcode += "M1003 S1\n";
+            }
+            // BBS: open first layer inspection at second layer
+            if (print.config().scan_first_layer.value) {
+                // BBS: retract first to avoid droping when scan model
+                gcode += this->retract();
+                gcode += "M976 S1 P1 ; scan model before printing 2nd layer\n";
+                gcode += "M400 P100\n";
+                gcode += this->unretract();
+            }
+        }
+        // Reset acceleration at sencond layer
+        // Orca: only set once, don't need to call set_accel_and_jerk
+        if (m_config.default_acceleration.value > 0 && m_config.initial_layer_acceleration.value > 0) {
+            m_writer.set_print_acceleration(gcode, (unsigned int) floor(m_config.default_acceleration.value + 0.5));
+        }
 
-                                    for (size_t i = 0; i <= n_slices; ++i) {
-                                        const bool   last       = i == n_slices;
-                                        const size_t island_idx = last ? n_slices : slices_test_order[i];
-                                        if (last || point_inside_surface(island_idx, clipped_ptr->first_point())) {
-                                            if (islands[island_idx].by_region.empty())
-                                                islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
-                                            islands[island_idx].by_region[region.print_region_id()].append(
-                                                ObjectByExtruder::Island::Region::PERIMETERS, clipped_ptr, nullptr);
-                                            break;
-                                        }
-                                    }
-                                }
-                            }
+        if (m_config.default_jerk.value > 0 && m_config.initial_layer_jerk.value > 0) {
+            m_writer.set_jerk_xy(gcode, m_config.default_jerk.value);
+        }
 
-                            const ExPolygons* base_exclude_masks =
-                                local_z_ctx->mixed_masks_union_for_base_exclude.empty() ? &local_z_ctx->mixed_masks_union
-                                                                                        : &local_z_ctx->mixed_masks_union_for_base_exclude;
-                            auto clipped_base = clip_extrusion_collection_for_local_z(*extrusions, nullptr, base_exclude_masks, 0.);
-                            if (!clipped_base)
-                                continue;
-                            const LocalZPathHeightStats base_height_stats = collect_local_z_path_height_stats(*clipped_base);
-                            ++local_z_ctx->base_clipped_collections;
-                            const ExPolygons &mixed_leak_ref =
-                                !local_z_ctx->raw_mixed_masks_union.empty() ? local_z_ctx->raw_mixed_masks_union : local_z_ctx->mixed_masks_union;
-                            if (local_z_ctx->base_clip_leak_warnings < 3 && !mixed_leak_ref.empty()) {
-                                Polylines clipped_base_lines = collect_local_z_polylines(*clipped_base);
-                                if (!clipped_base_lines.empty()) {
-                                    Polylines leaked_segments = intersection_pl(std::move(clipped_base_lines), mixed_leak_ref);
-                                    if (!leaked_segments.empty()) {
-                                        ++local_z_ctx->base_clip_leak_warnings;
-                                        BOOST_LOG_TRIVIAL(warning) << "Local-Z base clip leak"
-                                                                   << " print_z=" << print_z
-                                                                   << " layer_to_print_idx=" << layer_to_print_idx
-                                                                   << " leaked_segment_count=" << leaked_segments.size()
-                                                                   << " warn_index=" << local_z_ctx->base_clip_leak_warnings;
-                                    }
-                                }
-                            }
-                            if (base_height_stats.count > 0 && local_z_ctx->base_clipped_collections <= 5) {
-                                BOOST_LOG_TRIVIAL(debug) << "Local-Z base clip heights"
-                                                         << " print_z=" << print_z
-                                                         << " layer_to_print_idx=" << layer_to_print_idx
-                                                         << " observed_min=" << base_height_stats.min
-                                                         << " observed_max=" << base_height_stats.max
-                                                         << " path_count=" << base_height_stats.count;
-                            }
-                            filtered_extrusions = clipped_base.get();
-                            local_z_clipped_collections.emplace_back(std::move(clipped_base));
-                        }
+        // Transition from 1st to 2nd layer. Adjust nozzle temperatures as prescribed by the nozzle dependent
+        // nozzle_temperature_initial_layer vs. temperature settings.
+        for (const Extruder& extruder : m_writer.extruders()) {
+            if ((print.config().single_extruder_multi_material.value || m_ooze_prevention.enable) &&
+                extruder.id() != m_writer.extruder()->id())
+                // In single extruder multi material mode, set the temperature for the current extruder only.
+                continue;
+            int temperature = print.config().nozzle_temperature.get_at(extruder.id());
+            if (temperature > 0 && temperature != print.config().nozzle_temperature_initial_layer.get_at(extruder.id()))
+                m_writer.set_temperature(gcode, temperature, false, extruder.id());
+        }
 
-                        const unsigned int configured_filament_id = configured_filament_id_1based(*filtered_extrusions, region);
-                        const std::vector<unsigned int>* pointillism_sequence =
-                            is_anything_overridden ? nullptr : pointillism_sequence_for_filament(configured_filament_id);
-                        if (pointillism_sequence != nullptr) {
-                            std::vector<std::unique_ptr<ExtrusionEntityCollection>> split_by_extruder;
-                            PointillismPathSplitStats split_stats;
-                            const size_t sequence_phase = pointillism_sequence->empty() ?
-                                0 : size_t(std::max(0, layer_tools.layer_index)) % pointillism_sequence->size();
-                            if (split_extrusion_collection_for_pointillism_paths(*filtered_extrusions,
-                                                                                  *pointillism_sequence,
-                                                                                  layer_tools.num_physical,
-                                                                                  pointillism_segment_len_scaled,
-                                                                                  pointillism_line_gap_scaled,
-                                                                                  sequence_phase,
-                                                                                  split_by_extruder,
-                                                                                  split_stats) &&
-                                split_stats.bucket_count >= 2) {
-                                ++pointillism_path_split_entities;
-                                pointillism_path_split_segments += split_stats.segment_count;
-                                for (size_t extruder_idx = 0; extruder_idx < split_by_extruder.size(); ++extruder_idx) {
-                                    std::unique_ptr<ExtrusionEntityCollection>& split_collection = split_by_extruder[extruder_idx];
-                                    if (!split_collection || split_collection->entities.empty())
-                                        continue;
-                                    const ExtrusionEntityCollection* split_ptr = split_collection.get();
-                                    local_z_clipped_collections.emplace_back(std::move(split_collection));
-                                    std::vector<ObjectByExtruder::Island>& islands =
-                                        object_islands_by_extruder(by_extruder, unsigned(extruder_idx), layer_to_print_idx, layers.size(), n_slices + 1);
-                                    for (size_t i = 0; i <= n_slices; ++i) {
-                                        const bool   last       = i == n_slices;
-                                        const size_t island_idx = last ? n_slices : slices_test_order[i];
-                                        if (last || point_inside_surface(island_idx, split_ptr->first_point())) {
-                                            if (islands[island_idx].by_region.empty())
-                                                islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
-                                            islands[island_idx].by_region[region.print_region_id()].append(entity_type, split_ptr, nullptr);
-                                            break;
-                                        }
-                                    }
-                                }
-                                continue;
-                            }
-                            ++pointillism_path_split_fallbacks;
-                        }
+        // BBS
+        int bed_temp = get_bed_temperature(first_extruder_id, false, print.config().curr_bed_type);
+        m_writer.set_bed_temperature(gcode, bed_temp);
+        // Mark the temperature transition from 1st to 2nd layer to be finished.
+        m_second_layer_things_done = true;
+    }
 
-                        // This extrusion is part of certain Region, which tells us which extruder should be used for it:
-                        int correct_extruder_id = layer_tools.extruder(*filtered_extrusions, region);
+    if (single_object_instance_idx == size_t(-1)) {
+        // Normal (non-sequential) print.
+        gcode += ProcessLayer::emit_custom_gcode_per_print_z(*this, layer_tools.custom_gcode, m_writer.extruder()->id(), first_extruder_id,
+                                                             print.config());
+    }
 
-                        // Let's recover vector of extruder overrides:
-                        const WipingExtrusions::ExtruderPerCopy* entity_overrides = nullptr;
-                        if (!layer_tools.has_extruder(correct_extruder_id)) {
-                            // this entity is not overridden, but its extruder is not in layer_tools - we'll print it
-                            // by last extruder on this layer (could happen e.g. when a wiping object is taller than others - dontcare
-                            // extruders are eradicated from layer_tools)
-                            correct_extruder_id = layer_tools.extruders.back();
-                        }
-                        printing_extruders.clear();
-                        if (is_anything_overridden) {
-                            entity_overrides = const_cast<LayerTools&>(layer_tools)
-                                                   .wiping_extrusions()
-                                                   .get_extruder_overrides(filtered_extrusions, layer_to_print.original_object, correct_extruder_id,
-                                                                           layer_to_print.object()->instances().size());
-                            if (entity_overrides == nullptr) {
-                                printing_extruders.emplace_back(correct_extruder_id);
-                            } else {
-                                printing_extruders.reserve(entity_overrides->size());
-                                for (int extruder : *entity_overrides)
-                                    printing_extruders.emplace_back(extruder >= 0 ?
-                                                                        // at least one copy is overridden to use this extruder
-                                                                        extruder :
-                                                                        // at least one copy would normally be printed with this extruder
-                                                                        // (see get_extruder_overrides function for explanation)
-                                                                        static_cast<unsigned int>(-extruder - 1));
-                                Slic3r::sort_remove_duplicates(printing_extruders);
-                            }
-                        } else
-                            printing_extruders.emplace_back(correct_extruder_id);
+    // BBS: get next extruder according to flush and soluble
+    auto get_next_extruder = [&](int current_extruder, const std::vector<unsigned int>& extruders) {
+        std::vector<float> flush_matrix(cast<float>(m_config.flush_volumes_matrix.values));
+        const unsigned int number_of_extruders = (unsigned int) (sqrt(flush_matrix.size()) + EPSILON);
+        // Extract purging volumes for each extruder pair:
+        std::vector<std::vector<float>> wipe_volumes;
+        for (unsigned int i = 0; i < number_of_extruders; ++i)
+            wipe_volumes.push_back(
+                std::vector<float>(flush_matrix.begin() + i * number_of_extruders, flush_matrix.begin() + (i + 1) * number_of_extruders));
+        unsigned int next_extruder = current_extruder;
+        float        min_flush     = std::numeric_limits<float>::max();
+        for (auto extruder_id : extruders) {
+            if (print.config().filament_soluble.get_at(extruder_id) || extruder_id == current_extruder)
+                continue;
+            if (wipe_volumes[current_extruder][extruder_id] < min_flush) {
+                next_extruder = extruder_id;
+                min_flush     = wipe_volumes[current_extruder][extruder_id];
+            }
+        }
+        return next_extruder;
+    };
 
-                        // Now we must add this extrusion into the by_extruder map, once for each extruder that will print it:
-                        for (unsigned int extruder : printing_extruders) {
-                            std::vector<ObjectByExtruder::Island>& islands =
-                                object_islands_by_extruder(by_extruder, extruder, layer_to_print_idx, layers.size(), n_slices + 1);
-                            for (size_t i = 0; i <= n_slices; ++i) {
-                                bool   last       = i == n_slices;
-                                size_t island_idx = last ? n_slices : slices_test_order[i];
-                                if ( // extrusions->first_point does not fit inside any slice
-                                    last ||
-                                    // extrusions->first_point fits inside ith slice
-                                    point_inside_surface(island_idx, filtered_extrusions->first_point())) {
-                                    if (islands[island_idx].by_region.empty())
-                                        islands[island_idx].by_region.assign(print.num_print_regions(), ObjectByExtruder::Island::Region());
-                                    islands[island_idx].by_region[region.print_region_id()].append(entity_type, filtered_extrusions,
-                                                                                                   entity_overrides);
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-            } // for regions
+    // The extrusions of a layer generated ahead by a copy of this generator start from here, see process_layers().
+    if (m_layer_generator.parent != nullptr) {
+        m_layer_generator.state        = this->layer_generator_state();
+        m_layer_generator.start_offset = gcode.size();
+        m_layer_generator.started      = true;
+        m_writer.moves().clear();
+    } else if (generated_ahead != nullptr && this->continue_from_layer_generator(*generated_ahead->generator)) {
+        if (m_config.gcode_comments)
+            gcode += "; layer generated ahead\n";
+        gcode += generated_ahead->gcode;
+        generated_ahead->adopted    = true;
+        m_writer.moves().append(generated_ahead->generator->m_writer.moves());
+        result.moves                = m_writer.moves().bind(gcode);
+        result.gcode                = std::move(gcode);
+        result.cooling_buffer_flush = object_layer || raft_layer || last_layer;
+        return result;
+    }
+
+    for (const auto& layer_to_print : layers) {
+        if (layer_to_print.object_layer) {
+            const auto& regions               = layer_to_print.object_layer->regions();
+            const bool  enable_overhang_speed = std::any_of(regions.begin(), regions.end(), [](const LayerRegion* r) {
+                return r->has_extrusions() && r->region().config().enable_overhang_speed;
+            });
+            if (enable_overhang_speed) {
+                m_extrusion_quality_estimator.prepare_for_new_layer(layer_to_print.original_object, layer_to_print.object_layer);
+            }
         }
-    } // for objects
+    }
+
+    // Group extrusions by an extruder, then by an object, an island and a region.
+    const bool is_anything_overridden = const_cast<LayerTools&>(layer_tools).wiping_extrusions().is_anything_overridden();
+    LayerExtrusionGroups local_groups;
+    if (prebuilt_groups == nullptr)
+        local_groups = group_layer_extrusions(print, layers, layer_tools, has_wipe_tower);
+    LayerExtrusionGroups& groups = prebuilt_groups != nullptr ? *prebuilt_groups : local_groups;
+    std::map<unsigned int, std::vector<ObjectByExtruder>>& by_extruder = groups.by_extruder;
+    std::vector<LocalZLayerContext>& local_z_layer_contexts = groups.local_z_layer_contexts;
+    const bool local_z_perimeter_runtime_supported = groups.local_z_runtime_supported;
+    const bool local_z_phase_b_requested_for_layer = groups.local_z_phase_b_requested;
+    const bool local_z_perimeter_phase_b_enabled   = groups.local_z_phase_b_enabled;
+
+    if (local_z_phase_b_requested_for_layer && !local_z_perimeter_runtime_supported) {
+        BOOST_LOG_TRIVIAL(warning) << "Local-Z phase-b disabled"
+                                   << " print_z=" << print_z
+                                   << " wipe_tower=" << has_wipe_tower
+                                   << " wiping_overrides=" << is_anything_overridden;
+        gcode += "; local-z perimeter phase-b disabled for this layer (wipe tower or wiping overrides active)\n";
+    } else if (local_z_phase_b_requested_for_layer && !local_z_perimeter_phase_b_enabled) {
+        BOOST_LOG_TRIVIAL(warning) << "Local-Z phase-b requested but no eligible contexts"
+                                   << " print_z=" << print_z
+                                   << " runtime_supported=" << local_z_perimeter_runtime_supported;
+    }
 
     if (local_z_perimeter_phase_b_enabled) {
         for (size_t layer_to_print_idx = 0; layer_to_print_idx < local_z_layer_contexts.size(); ++layer_to_print_idx) {
@@ -5567,17 +5871,20 @@ LayerResult GCode::process_layer(const Print& print,
         }
     }
 
-    if (pointillism_path_split_entities > 0) {
+    if (groups.pointillism_path_split_entities > 0) {
         BOOST_LOG_TRIVIAL(warning) << "Same-layer pointillisme path-domain split"
                                    << " layer_id=" << layer.id()
                                    << " print_z=" << print_z
-                                   << " entities=" << pointillism_path_split_entities
-                                   << " segments=" << pointillism_path_split_segments
-                                   << " segment_len_mm=" << pointillism_segment_len_mm
-                                   << " line_gap_mm=" << pointillism_line_gap_mm
-                                   << " split_fallbacks=" << pointillism_path_split_fallbacks;
+                                   << " entities=" << groups.pointillism_path_split_entities
+                                   << " segments=" << groups.pointillism_path_split_segments
+                                   << " segment_len_mm=" << groups.pointillism_segment_len_mm
+                                   << " line_gap_mm=" << groups.pointillism_line_gap_mm
+                                   << " split_fallbacks=" << groups.pointillism_path_split_fallbacks;
     }
 
+    // A layer generated ahead is bound once adopted.
+    if (m_layer_generator.parent == nullptr)
+        result.moves = m_writer.moves().bind(gcode);
     result.gcode                = std::move(gcode);
     result.cooling_buffer_flush = object_layer || raft_layer || last_layer;
     return result;
@@ -5680,7 +5987,7 @@ std::string GCode::change_layer(coordf_t print_z)
     std::string gcode;
     if (m_layer_count > 0)
         // Increment a progress bar indicator.
-        gcode += m_writer.update_progress(++m_layer_index, m_layer_count);
+        m_writer.update_progress(gcode, ++m_layer_index, m_layer_count);
     // BBS
     coordf_t z = print_z + m_config.z_offset.value; // in unscaled coordinates
     if (EXTRUDER_CONFIG(retract_when_changing_layer) && m_writer.will_move_z(z)) {
@@ -5754,7 +6061,7 @@ std::string GCode::extrude_loop(
     float seam_overhang = std::numeric_limits<float>::lowest();
     if (!m_config.spiral_mode && description == "perimeter") {
         assert(m_layer != nullptr);
-        m_seam_placer.place_seam(m_layer, loop, last_pos, seam_overhang);
+        this->seam_placer().place_seam(m_layer, loop, last_pos, seam_overhang);
     } else
         loop.split_at(last_pos, false);
 
@@ -6192,12 +6499,21 @@ std::string GCode::extrude_support(const ExtrusionEntityCollection& support_fill
     return gcode;
 }
 
-bool GCode::GCodeOutputStream::is_error() const { return ::ferror(this->f); }
+bool GCode::GCodeOutputStream::is_error() const { return this->f != nullptr && ::ferror(this->f); }
 
-void GCode::GCodeOutputStream::flush() { ::fflush(this->f); }
+void GCode::GCodeOutputStream::flush()
+{
+    if (this->f)
+        ::fflush(this->f);
+    std::unique_lock<std::mutex> lock(m_queue_mutex);
+    m_queue_condition.wait(lock, [this]() { return (m_queue.empty() && ! m_processing) || m_processor_exception; });
+    if (m_processor_exception)
+        std::rethrow_exception(m_processor_exception);
+}
 
 void GCode::GCodeOutputStream::close()
 {
+    this->stop_processing();
     if (this->f) {
         ::fclose(this->f);
         this->f = nullptr;
@@ -6207,11 +6523,113 @@ void GCode::GCodeOutputStream::close()
 void GCode::GCodeOutputStream::write(const char* what)
 {
     if (what != nullptr) {
-        const char* gcode = what;
+        if (m_layer_changes < m_layer_change_lines.size()) {
+            this->write(std::string(what));
+            return;
+        }
+        const size_t len = ::strlen(what);
         // writes string to file
-        fwrite(gcode, 1, ::strlen(gcode), this->f);
-        // FIXME don't allocate a string, maybe process a batch of lines?
-        m_processor.process_buffer(std::string(gcode));
+        if (this->f)
+            fwrite(what, 1, len, this->f);
+        if (len > 0)
+            this->process(std::make_shared<const std::string>(what, len));
+    }
+}
+
+void GCode::GCodeOutputStream::write(std::string&& what)
+{
+    if (m_layer_changes < m_layer_change_lines.size())
+        this->insert_layer_change_lines(what);
+    // writes string to file
+    if (this->f)
+        fwrite(what.data(), 1, what.size(), this->f);
+    if (! what.empty())
+        this->process(std::make_shared<const std::string>(std::move(what)));
+}
+
+void GCode::GCodeOutputStream::insert_layer_change_lines(std::string& what)
+{
+    static const std::string tag = ";" + GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Layer_Change) + "\n";
+    std::string out;
+    size_t      copied = 0;
+    for (size_t pos = what.find(tag); pos != std::string::npos && m_layer_changes < m_layer_change_lines.size(); pos = what.find(tag, pos + tag.size())) {
+        // Only whole lines are tags, the buffers written start and end at line boundaries.
+        if (pos > 0 && what[pos - 1] != '\n')
+            continue;
+        const std::string& lines = m_layer_change_lines[m_layer_changes ++];
+        if (lines.empty())
+            continue;
+        if (out.empty())
+            out.reserve(what.size() + 256);
+        out.append(what, copied, pos - copied);
+        out += lines;
+        copied = pos;
+    }
+    if (! out.empty()) {
+        out.append(what, copied, std::string::npos);
+        what = std::move(out);
+    }
+}
+
+void GCode::GCodeOutputStream::process(std::shared_ptr<const std::string> buffer)
+{
+    std::unique_lock<std::mutex> lock(m_queue_mutex);
+    if (! m_processor_thread.joinable())
+        m_processor_thread = std::thread([this]() { this->process_queue(); });
+    m_queue_condition.wait(lock, [this]() { return m_queue.size() < max_queued_buffers || m_processor_exception; });
+    if (m_processor_exception)
+        std::rethrow_exception(m_processor_exception);
+    m_queue.emplace_back(std::move(buffer));
+    lock.unlock();
+    m_queue_condition.notify_all();
+}
+
+void GCode::GCodeOutputStream::process_queue()
+{
+    set_current_thread_name("slic3r_gcodeproc");
+    // Some of the G-code parameters are parsed with the C library, which is locale dependent.
+    CNumericLocalesSetter locales_setter;
+    std::unique_lock<std::mutex> lock(m_queue_mutex);
+    for (;;) {
+        m_queue_condition.wait(lock, [this]() { return m_stop || ! m_queue.empty(); });
+        if (m_stop)
+            break;
+        std::shared_ptr<const std::string> buffer = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_processing = true;
+        lock.unlock();
+        // Wake up the writer waiting for a free slot in the queue.
+        m_queue_condition.notify_all();
+        std::exception_ptr exception;
+        try {
+            m_processor.process_buffer(*buffer);
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        buffer.reset();
+        lock.lock();
+        m_processing = false;
+        m_processor_exception = exception;
+        // Wake up the writer waiting in flush() or for the exception.
+        m_queue_condition.notify_all();
+        if (exception) {
+            // The processor state is undefined, the rest of the G-code is dropped.
+            m_queue.clear();
+            break;
+        }
+    }
+}
+
+void GCode::GCodeOutputStream::stop_processing()
+{
+    if (m_processor_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_queue_mutex);
+            m_stop = true;
+        }
+        m_queue_condition.notify_all();
+        m_processor_thread.join();
+        m_queue.clear();
     }
 }
 
@@ -6372,11 +6790,11 @@ std::string GCode::_extrude(const ExtrusionPath& path, std::string description,
 
     if (!skip_accel_jerk_switch_for_short_pointillism) {
         if (m_writer.get_gcode_flavor() == gcfKlipper) {
-            gcode += m_writer.set_accel_and_jerk(acceleration_i, jerk);
+            m_writer.set_accel_and_jerk(gcode, acceleration_i, jerk);
 
         } else {
-            gcode += m_writer.set_print_acceleration(acceleration_i);
-            gcode += m_writer.set_jerk_xy(jerk);
+            m_writer.set_print_acceleration(gcode, acceleration_i);
+            m_writer.set_jerk_xy(gcode, jerk);
         }
     }
 
@@ -6778,7 +7196,7 @@ std::string GCode::_extrude(const ExtrusionPath& path, std::string description,
             // ORCA: End of adaptive PA code segment
         }
 
-        gcode += m_writer.set_speed(F, "", comment);
+        m_writer.set_speed(gcode, F, "", comment);
         {
             if (m_enable_cooling_markers) {
                 if (enable_overhang_bridge_fan) {
@@ -6818,16 +7236,16 @@ std::string GCode::_extrude(const ExtrusionPath& path, std::string description,
                     }
                     if (sloped == nullptr) {
                         // Normal extrusion
-                        gcode += m_writer.extrude_to_xy(this->point_to_gcode(line.b), dE,
-                                                        GCodeWriter::full_gcode_comment ? tempDescription : "",
-                                                        path.is_force_no_extrusion());
+                        m_writer.extrude_to_xy(gcode, this->point_to_gcode(line.b), dE,
+                                               GCodeWriter::full_gcode_comment ? tempDescription : "",
+                                               path.is_force_no_extrusion());
                     } else {
                         // Sloped extrusion
                         const auto [z_ratio, e_ratio] = sloped->interpolate(path_length / total_length);
                         Vec2d dest2d                  = this->point_to_gcode(line.b);
                         Vec3d dest3d(dest2d(0), dest2d(1), get_sloped_z(z_ratio));
-                        gcode += m_writer.extrude_to_xyz(dest3d, dE * e_ratio, GCodeWriter::full_gcode_comment ? tempDescription : "",
-                                                         path.is_force_no_extrusion());
+                        m_writer.extrude_to_xyz(gcode, dest3d, dE * e_ratio, GCodeWriter::full_gcode_comment ? tempDescription : "",
+                                                path.is_force_no_extrusion());
                     }
                 }
             } else {
@@ -6854,9 +7272,9 @@ std::string GCode::_extrude(const ExtrusionPath& path, std::string description,
                                     tempDescription += Slic3r::format(" | Old Flow Value: %0.5f Length: %0.5f", oldE, line_length);
                                 }
                             }
-                            gcode += m_writer.extrude_to_xy(this->point_to_gcode(line.b), dE,
-                                                            GCodeWriter::full_gcode_comment ? tempDescription : "",
-                                                            path.is_force_no_extrusion());
+                            m_writer.extrude_to_xy(gcode, this->point_to_gcode(line.b), dE,
+                                                   GCodeWriter::full_gcode_comment ? tempDescription : "",
+                                                   path.is_force_no_extrusion());
                         }
                         break;
                     }
@@ -6876,10 +7294,10 @@ std::string GCode::_extrude(const ExtrusionPath& path, std::string description,
                                 tempDescription += Slic3r::format(" | Old Flow Value: %0.5f Length: %0.5f", oldE, arc_length);
                             }
                         }
-                        gcode += m_writer.extrude_arc_to_xy(this->point_to_gcode(arc.end_point), center_offset, dE,
-                                                            arc.direction == ArcDirection::Arc_Dir_CCW,
-                                                            GCodeWriter::full_gcode_comment ? tempDescription : "",
-                                                            path.is_force_no_extrusion());
+                        m_writer.extrude_arc_to_xy(gcode, this->point_to_gcode(arc.end_point), center_offset, dE,
+                                                   arc.direction == ArcDirection::Arc_Dir_CCW,
+                                                   GCodeWriter::full_gcode_comment ? tempDescription : "",
+                                                   path.is_force_no_extrusion());
                         break;
                     }
                     default:
@@ -6902,7 +7320,7 @@ std::string GCode::_extrude(const ExtrusionPath& path, std::string description,
             Polyline l(p);
             total_length = l.length() * SCALING_FACTOR;
         }
-        gcode += m_writer.set_speed(last_set_speed, "", comment);
+        m_writer.set_speed(gcode, last_set_speed, "", comment);
         Vec2d prev            = this->point_to_gcode_quantized(new_points[0].p);
         bool  pre_fan_enabled = false;
         bool  cur_fan_enabled = false;
@@ -6979,10 +7397,10 @@ std::string GCode::_extrude(const ExtrusionPath& path, std::string description,
             // Ignore small speed variations - emit speed change if the delta between current and new is greater than 60mm/min / 1mm/sec
             // Reset speed to F if delta to F is less than 1mm/sec
             if ((std::abs(last_set_speed - new_speed) > 60)) {
-                gcode += m_writer.set_speed(new_speed, "", comment);
+                m_writer.set_speed(gcode, new_speed, "", comment);
                 last_set_speed = new_speed;
             } else if ((std::abs(F - new_speed) <= 60)) {
-                gcode += m_writer.set_speed(F, "", comment);
+                m_writer.set_speed(gcode, F, "", comment);
                 last_set_speed = F;
             }
             auto dE = e_per_mm * line_length;
@@ -6996,12 +7414,12 @@ std::string GCode::_extrude(const ExtrusionPath& path, std::string description,
             }
             if (sloped == nullptr) {
                 // Normal extrusion
-                gcode += m_writer.extrude_to_xy(p, dE, GCodeWriter::full_gcode_comment ? tempDescription : "");
+                m_writer.extrude_to_xy(gcode, p, dE, GCodeWriter::full_gcode_comment ? tempDescription : "");
             } else {
                 // Sloped extrusion
                 const auto [z_ratio, e_ratio] = sloped->interpolate(path_length / total_length);
                 Vec3d dest3d(p(0), p(1), get_sloped_z(z_ratio));
-                gcode += m_writer.extrude_to_xyz(dest3d, dE * e_ratio, GCodeWriter::full_gcode_comment ? tempDescription : "");
+                m_writer.extrude_to_xyz(gcode, dest3d, dE * e_ratio, GCodeWriter::full_gcode_comment ? tempDescription : "");
             }
 
             prev = p;
@@ -7115,10 +7533,10 @@ std::string GCode::travel_to(const Point& point, ExtrusionRole role, std::string
         }
     }
     if (m_writer.get_gcode_flavor() == gcfKlipper) {
-        gcode += m_writer.set_accel_and_jerk(acceleration_to_set, jerk_to_set);
+        m_writer.set_accel_and_jerk(gcode, acceleration_to_set, jerk_to_set);
     } else {
-        gcode += m_writer.set_travel_acceleration(acceleration_to_set);
-        gcode += m_writer.set_jerk_xy(jerk_to_set);
+        m_writer.set_travel_acceleration(gcode, acceleration_to_set);
+        m_writer.set_jerk_xy(gcode, jerk_to_set);
     }
 
     // if a retraction would be needed, try to use reduce_crossing_wall to plan a
@@ -7178,7 +7596,7 @@ std::string GCode::travel_to(const Point& point, ExtrusionRole role, std::string
         if (false /*m_spiral_vase*/) {
             // No lazy z lift for spiral vase mode
             for (size_t i = 1; i < travel.size(); ++i) {
-                gcode += m_writer.travel_to_xy(this->point_to_gcode(travel.points[i]), comment);
+                m_writer.travel_to_xy(gcode, this->point_to_gcode(travel.points[i]), comment);
             }
         } else {
             if (travel.size() == 2) {
@@ -7204,7 +7622,7 @@ std::string GCode::travel_to(const Point& point, ExtrusionRole role, std::string
                         gcode += m_writer.travel_to_xyz(dest3d, comment);
                     } else {
                         // For all points in between, no z change
-                        gcode += m_writer.travel_to_xy(this->point_to_gcode(travel.points[i]), comment);
+                        m_writer.travel_to_xy(gcode, this->point_to_gcode(travel.points[i]), comment);
                     }
                 }
             }
@@ -7384,7 +7802,7 @@ std::string GCode::retract(bool toolchange, bool is_last_retraction, LiftType li
         gcode += toolchange ? m_writer.retract_for_toolchange() : m_writer.retract();
     }
 
-    gcode += m_writer.reset_e();
+    m_writer.reset_e(gcode);
     // Orca: check if should + can lift (roughly from SuperSlicer)
     RetractLiftEnforceType retract_lift_type = RetractLiftEnforceType(EXTRUDER_CONFIG(retract_lift_enforce));
 
@@ -7441,13 +7859,13 @@ std::string GCode::set_extruder(unsigned int extruder_id, double print_z, bool b
             check_add_eol(gcode);
         }
         if (m_config.enable_pressure_advance.get_at(extruder_id)) {
-            gcode += m_writer.set_pressure_advance(m_config.pressure_advance.get_at(extruder_id));
+            m_writer.set_pressure_advance(gcode, m_config.pressure_advance.get_at(extruder_id));
             // Orca: Adaptive PA
             // Reset Adaptive PA processor last PA value
             m_pa_processor->resetPreviousPA(m_config.pressure_advance.get_at(extruder_id));
         }
 
-        gcode += m_writer.toolchange(extruder_id);
+        m_writer.toolchange(gcode, extruder_id);
         return gcode;
     }
 
@@ -7632,7 +8050,7 @@ std::string GCode::set_extruder(unsigned int extruder_id, double print_z, bool b
         int temp = (m_layer_index <= 0 ? m_config.nozzle_temperature_initial_layer.get_at(extruder_id) :
                                          m_config.nozzle_temperature.get_at(extruder_id));
 
-        gcode += m_writer.set_temperature(temp, false);
+        m_writer.set_temperature(gcode, temp, false);
     }
 
     this->placeholder_parser().set("current_extruder", extruder_id);
@@ -7656,7 +8074,7 @@ std::string GCode::set_extruder(unsigned int extruder_id, double print_z, bool b
         gcode += m_ooze_prevention.post_toolchange(*this);
 
     if (m_config.enable_pressure_advance.get_at(extruder_id)) {
-        gcode += m_writer.set_pressure_advance(m_config.pressure_advance.get_at(extruder_id));
+        m_writer.set_pressure_advance(gcode, m_config.pressure_advance.get_at(extruder_id));
     }
     // Orca: tool changer or IDEX's firmware may change Z position, so we set it to unknown/undefined
     m_last_pos_defined = false;
@@ -27,11 +27,16 @@
 // ORCA: post processor below used for Dynamic Pressure advance
 #include "GCode/AdaptivePAProcessor.hpp"
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <map>
 #include <set>
 #include <string>
 #include <cfloat>
+#include <thread>
 
 namespace Slic3r {
 
@@ -40,6 +45,8 @@ class GCode;
 
 namespace { struct Item; }
 struct PrintInstance;
+struct SubLayerPlan;
+struct LocalZLayerExtrusions;
 class ConstPrintObjectPtrsAdaptor;
 
 class OozePrevention {
@@ -98,6 +105,11 @@ public:
 
     std::string prime(GCode &gcodegen);
     void next_layer() { ++ m_layer_idx; m_tool_change_idx = 0; }
+    int  layer_idx() const { return m_layer_idx; }
+    // A copy generating a layer ahead of the serial G-code generation starts the tool changes of its layer,
+    // the G-code generator continues with the tool changes done by the copy. See GCode::process_layers().
+    void start_layer(int layer_idx) { m_layer_idx = layer_idx; m_tool_change_idx = 0; }
+    void continue_from(const WipeTowerIntegration &other) { m_tool_change_idx = other.m_tool_change_idx; m_is_first_print = other.m_is_first_print; }
     std::string tool_change(GCode &gcodegen, int extruder_id, bool finish_layer);
     bool is_empty_wipe_tower_gcode(GCode &gcodegen, int extruder_id, bool finish_layer);
     std::string finalize(GCode &gcodegen);
@@ -155,6 +167,8 @@ struct LayerResult {
 	// Is indicating if this LayerResult should be processed, or it is just inserted artificial LayerResult.
     // It is used for the pressure equalizer because it needs to buffer one layer back.
     bool        nop_layer_result { false };
+    // Typed moves of gcode as formatted by GCodeWriter, for the G-code filters not to parse them again.
+    GCodeMoves  moves;
 
     static LayerResult make_nop_layer_result() { return {"", std::numeric_limits<coord_t>::max(), false, false, true}; }
 };
@@ -277,19 +291,27 @@ public:
     };
 
 private:
+    // Writes G-code into a file and feeds it to the GCodeProcessor. The processor runs on its own thread consuming
+    // a bounded queue of the written buffers, thus the G-code analysis overlaps with the G-code generation.
     class GCodeOutputStream {
     public:
+        // Without a file the G-code is only passed to the GCodeProcessor.
         GCodeOutputStream(FILE *f, GCodeProcessor &processor) : f(f), m_processor(processor) {}
         ~GCodeOutputStream() { this->close(); }
 
         bool is_open() const { return f; }
         bool is_error() const;
 
+        // Flushes the file and waits for the GCodeProcessor to process all the G-code written.
+        // Rethrows the exception thrown by the GCodeProcessor, if any.
         void flush();
+        // Closes the file, the G-code not processed yet is dropped.
         void close();
 
         // Write a string into a file.
         void write(const std::string& what) { this->write(what.c_str()); }
+        // The buffer is handed over to the GCodeProcessor without being copied.
+        void write(std::string&& what);
         void write(const char* what);
 
         // Write a string into a file.
@@ -300,11 +322,36 @@ private:
         // Formats and write into a file the given data.
         void write_format(const char* format, ...);
 
+        // Lines to be written before the layer change tags, one entry per tag in the order written.
+        void set_layer_change_lines(std::vector<std::string> lines) { m_layer_change_lines = std::move(lines); m_layer_changes = 0; }
+
     private:
+        void insert_layer_change_lines(std::string &what);
+        void process(std::shared_ptr<const std::string> buffer);
+        void process_queue();
+        void stop_processing();
+
+        // Number of the buffers written ahead of the GCodeProcessor, the writer waits for the processor beyond that.
+        static constexpr size_t max_queued_buffers = 16;
+
         FILE *f = nullptr;
         GCodeProcessor &m_processor;
+        std::thread                                    m_processor_thread;
+        std::mutex                                     m_queue_mutex;
+        std::condition_variable                        m_queue_condition;
+        std::deque<std::shared_ptr<const std::string>> m_queue;
+        // The GCodeProcessor is processing a buffer already removed from m_queue.
+        bool                                           m_processing { false };
+        bool                                           m_stop { false };
+        std::exception_ptr                             m_processor_exception;
+        std::vector<std::string>                       m_layer_change_lines;
+        // Number of the layer change tags written so far.
+        size_t                                         m_layer_changes { 0 };
     };
     void            _do_export(Print &print, GCodeOutputStream &file, ThumbnailsGeneratorCallback thumbnail_cb);
+    // Generates the G-code of print without writing it to estimate the M73 lines written at its layer changes,
+    // see GCodeProcessor::layer_change_progress_lines().
+    static std::vector<std::string> estimate_layer_change_progress(Print &print);
 
     static std::vector<LayerToPrint>        		                   collect_layers_to_print(const PrintObject &object);
     static std::vector<std::pair<coordf_t, std::vector<LayerToPrint>>> collect_layers_to_print(const Print &print);
@@ -317,6 +364,8 @@ private:
         const Layer& layer,
         unsigned int extruder_id);
 
+    struct LayerExtrusionGroups;
+    struct LayerGeneratedAhead;
     LayerResult process_layer(
         const Print                     &print,
         // Set of object & print layers of the same PrintObject and with the same print_z.
@@ -329,7 +378,11 @@ private:
         // Otherwise print a single copy of a single object.
         const size_t                     single_object_idx = size_t(-1),
         // BBS
-        const bool                       prime_extruder = false);
+        const bool                       prime_extruder = false,
+        // Extrusions already grouped by group_layer_extrusions(), otherwise they are grouped here.
+        LayerExtrusionGroups            *prebuilt_groups = nullptr,
+        // The layer generated ahead by a copy of this generator, used if the copy started from the state of this generator.
+        LayerGeneratedAhead             *generated_ahead = nullptr);
     // Process all layers of all objects (non-sequential mode) with a parallel pipeline:
     // Generate G-code, run the filters (vase mode, cooling buffer), run the G-code analyser
     // and export G-code into file.
@@ -422,6 +475,89 @@ private:
         std::vector<Island>         islands;
     };
 
+    // Local-Z perimeter sub-pass of one object layer: the clipped perimeters grouped by extruder.
+    struct LocalZPassBucket {
+        const SubLayerPlan*                                   plan { nullptr };
+        std::map<unsigned int, std::vector<ObjectByExtruder>> by_extruder;
+    };
+    struct LocalZLayerContext {
+        bool                          enabled { false };
+        // Sub-passes and clipped perimeters of the layer, see PrintObject::build_local_z_extrusions().
+        const LocalZLayerExtrusions  *extrusions { nullptr };
+        size_t                        local_clipped_collections { 0 };
+        size_t                        base_clipped_collections { 0 };
+        // Indexed as LocalZLayerExtrusions::passes.
+        std::vector<LocalZPassBucket> pass_buckets;
+    };
+
+    // Extrusions of all the LayerToPrint of a single print_z grouped by extruder, object, island and region,
+    // see group_layer_extrusions().
+    struct LayerExtrusionGroups
+    {
+        std::map<unsigned int, std::vector<ObjectByExtruder>>   by_extruder;
+        // Indexed by the LayerToPrint index.
+        std::vector<LocalZLayerContext>                         local_z_layer_contexts;
+        // Clipped and split collections referenced from by_extruder and from the Local-Z pass buckets.
+        std::vector<std::unique_ptr<ExtrusionEntityCollection>> owned_collections;
+        bool                                                    local_z_runtime_supported { false };
+        bool                                                    local_z_phase_b_requested { false };
+        bool                                                    local_z_phase_b_enabled { false };
+        size_t                                                  pointillism_path_split_entities { 0 };
+        size_t                                                  pointillism_path_split_segments { 0 };
+        size_t                                                  pointillism_path_split_fallbacks { 0 };
+        double                                                  pointillism_segment_len_mm { 0. };
+        double                                                  pointillism_line_gap_mm { 0. };
+    };
+    static LayerExtrusionGroups group_layer_extrusions(const Print                     &print,
+                                                       const std::vector<LayerToPrint> &layers,
+                                                       const LayerTools                &layer_tools,
+                                                       const bool                       has_wipe_tower);
+
+    // With Print::parallel_gcode_layers(), the extrusions of a layer are generated ahead of the serial stage by a copy
+    // of the generator starting from a state predicted by process_layers(). The layer change retracts and resets E in
+    // both generators, after which the serial generator continues with the G-code of the copy if the copy reached the
+    // same state. Otherwise the layer is generated serially.
+    struct LayerGeneratorState
+    {
+        unsigned int            extruder_id { 0 };
+        int                     layer_index { -1 };
+        float                   last_layer_z { 0.f };
+        float                   max_layer_z { 0.f };
+        float                   last_height { 0.f };
+        int                     wipe_tower_layer_idx { -1 };
+        // Axis and retraction of all the extruders, sorted by their ID.
+        std::vector<Extruder>   extruders;
+        std::set<ObjectID>      objs_with_brim;
+        std::set<ObjectID>      obj_supports_with_brim;
+        std::vector<coordf_t>   skirt_done;
+        // Z hop of the writer, applied or pending.
+        double                  zhop { 0. };
+        double                  zhop_to_lift { 0. };
+        LiftType                zhop_to_lift_type { LiftType::NormalLift };
+
+        bool matches(const LayerGeneratorState &rhs) const;
+    };
+    struct LayerGeneratedAhead
+    {
+        // State predicted for the start of the layer.
+        LayerGeneratorState     start;
+        std::unique_ptr<GCode>  generator;
+        // G-code of the extrusions of the layer.
+        std::string             gcode;
+        // Set by process_layer() if the serial generator continued with the G-code.
+        bool                    adopted { false };
+    };
+    LayerGeneratorState layer_generator_state() const;
+    bool            can_generate_layers_ahead(const Print &print) const;
+    // Copy of this generator to generate layers ahead of the serial G-code generation of parent.
+    std::unique_ptr<GCode> make_layer_generator(const GCode &parent, const Print &print, const ToolOrdering &tool_ordering) const;
+    // Resets a copy made by make_layer_generator() to start a layer with the layers to print from the start state.
+    void            start_layer_generator(const GCode &prototype, const LayerGeneratorState &start, const std::vector<LayerToPrint> &layers);
+    // Continues with the state of a copy, which generated the extrusions of the current layer. Returns false
+    // if the copy did not start from the current state of this generator.
+    bool            continue_from_layer_generator(GCode &generator);
+    const SeamPlacer& seam_placer() const { return m_layer_generator.parent != nullptr ? m_layer_generator.parent->m_seam_placer : m_seam_placer; }
+
 	struct InstanceToPrint
 	{
 		InstanceToPrint(ObjectByExtruder &object_by_extruder, size_t layer_id, const PrintObject &print_object, size_t instance_id, size_t label_object_id) :
@@ -603,6 +739,17 @@ private:
     int m_start_gcode_filament = -1;
 
     std::set<unsigned int>                  m_initial_layer_extruders;
+
+    // Set for a copy of the generator generating layers ahead of the serial stage, see process_layers().
+    struct LayerGenerator {
+        const GCode                        *parent { nullptr };
+        // The G-code of the layer depends on a state of the serial generator, which was not predicted.
+        bool                                failed { false };
+        // The extrusions of the layer start at start_offset of its G-code with the generator in the state.
+        bool                                started { false };
+        size_t                              start_offset { 0 };
+        LayerGeneratorState                 state;
+    }                                       m_layer_generator;
     // BBS
     int get_bed_temperature(const int extruder_id, const bool is_first_layer, const BedType bed_type) const;
 
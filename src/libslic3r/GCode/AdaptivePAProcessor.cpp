@@ -45,6 +45,13 @@ AdaptivePAProcessor::AdaptivePAProcessor(GCode &gcodegen, const std::vector<unsi
     }
 }
 
+bool AdaptivePAProcessor::is_active() const {
+    for (size_t extruder_id = 0; extruder_id < m_config.adaptive_pressure_advance.size(); ++extruder_id)
+        if (m_config.adaptive_pressure_advance.get_at(extruder_id) && m_config.enable_pressure_advance.get_at(extruder_id))
+            return true;
+    return false;
+}
+
 // Method to get the interpolator for a specific tool ID
 AdaptivePAInterpolator* AdaptivePAProcessor::getInterpolator(unsigned int tool_id) {
     auto it = m_AdaptivePAInterpolators.find(tool_id);
@@ -45,6 +45,18 @@ public:
      * @return A string containing the processed G-code with adaptive pressure advance applied.
      */
     std::string process_layer(std::string &&gcode);
+
+    /**
+     * @brief Checks whether any extruder of the print has adaptive PA enabled.
+     *
+     * The PA change tags are only emitted for such extruders, thus the layers pass
+     * through process_layer() unchanged if this returns false. All the extruders
+     * are checked, not just the tools the processor was created for, as in the
+     * sequential (by object) mode those are the tools of the first object only.
+     *
+     * @return True if process_layer() may have a PA change to apply.
+     */
+    bool is_active() const;
     
     /**
      * @brief Manually sets adaptive PA internal value.
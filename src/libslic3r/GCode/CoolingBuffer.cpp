@@ -1,10 +1,10 @@
 #include "../GCode.hpp"
 #include "CoolingBuffer.hpp"
-#include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/log/trivial.hpp>
 #include <iostream>
 #include <float.h>
+#include <string_view>
 #include <system_error>
 #include <unordered_map>
 
@@ -18,22 +18,10 @@
 
 namespace Slic3r {
 
-CoolingBuffer::CoolingBuffer(GCode &gcodegen) : m_config(gcodegen.config()), m_toolchange_prefix(gcodegen.writer().toolchange_prefix()), m_current_extruder(0)
-{
-    this->reset(gcodegen.writer().get_position());
-
-    const std::vector<Extruder> &extruders = gcodegen.writer().extruders();
-    m_extruder_ids.reserve(extruders.size());
-    for (const Extruder &ex : extruders) {
-        m_num_extruders = std::max(ex.id() + 1, m_num_extruders);
-        m_extruder_ids.emplace_back(ex.id());
-    }
-}
-
 void CoolingBuffer::reset(const Vec3d &position)
 {
     // BBS: add I and J axis to store center of arc
-    m_current_pos.assign(7, 0.f);
+    m_current_pos.fill(0.f);
     m_current_pos[0] = float(position.x());
     m_current_pos[1] = float(position.y());
     m_current_pos[2] = float(position.z());
@@ -177,6 +165,42 @@ struct PerExtruderAdjustments
         return time_total;
     }
 
+    // Drop the lines of the previous layer, keeping their storage.
+    void clear_lines() {
+        lines.clear();
+        adjustable_lines.clear();
+        n_lines_adjustable  = 0;
+        time_non_adjustable = 0;
+        time_total          = 0;
+        time_maximum        = 0;
+        idx_line_begin      = 0;
+        idx_line_end        = 0;
+        running_time_total     = 0;
+        running_time_maximum   = 0;
+        running_time_unlimited = false;
+    }
+
+    // Account a parsed line or a move merged into a feedrate setting line to the running totals,
+    // time_max being the time of the move when slowed down to slow_down_min_speed if adjustable.
+    void add_running_time(float time, float time_max) {
+        running_time_total += time;
+        if (time_max == FLT_MAX)
+            running_time_unlimited = true;
+        else
+            running_time_maximum += time_max;
+    }
+
+    // Collect the adjustable lines sorted by decreasing feedrate, the lines are left in the order of the G-code.
+    // Used by the analytic slow down.
+    void collect_adjustable_lines_by_decreasing_feedrate() {
+        adjustable_lines.clear();
+        for (CoolingLine &line : lines)
+            if (line.adjustable())
+                adjustable_lines.emplace_back(&line);
+        std::sort(adjustable_lines.begin(), adjustable_lines.end(),
+            [](const CoolingLine *l1, const CoolingLine *l2) { return l1->feedrate > l2->feedrate; });
+    }
+
     // Sort the lines, adjustable first, higher feedrate first.
     // Used by non-proportional slow down.
     void sort_lines_by_decreasing_feedrate() {
@@ -252,6 +276,15 @@ struct PerExtruderAdjustments
     // Temporaries for processing the slow down. Both thresholds go from 0 to n_lines_adjustable.
     size_t                      idx_line_begin      = 0;
     size_t                      idx_line_end        = 0;
+
+    // Maintained while parsing by the analytic slow down, see CoolingBuffer::set_analytic_slowdown().
+    // Totals of elapsed_time_total() and of maximum_time_after_slowdown(), the latter unlimited
+    // if any of the lines may be slowed down without a limit.
+    double                      running_time_total     = 0;
+    double                      running_time_maximum   = 0;
+    bool                        running_time_unlimited = false;
+    // Set by collect_adjustable_lines_by_decreasing_feedrate().
+    std::vector<CoolingLine*>   adjustable_lines;
 };
 
 // Calculate a new feedrate when slowing down by time_stretch for segments faster than min_feedrate.
@@ -311,118 +344,182 @@ finished:
 	return new_feedrate;
 }
 
-std::string CoolingBuffer::process_layer(std::string &&gcode, size_t layer_id, bool flush)
+CoolingBuffer::CoolingBuffer(GCode &gcodegen) : m_config(gcodegen.config()), m_toolchange_prefix(gcodegen.writer().toolchange_prefix()), m_current_extruder(0)
 {
-    // Cache the input G-code.
-    if (m_gcode.empty())
+    this->reset(gcodegen.writer().get_position());
+
+    const std::vector<Extruder> &extruders = gcodegen.writer().extruders();
+    m_extruder_ids.reserve(extruders.size());
+    for (const Extruder &ex : extruders) {
+        m_num_extruders = std::max(ex.id() + 1, m_num_extruders);
+        m_extruder_ids.emplace_back(ex.id());
+    }
+
+    m_per_extruder_adjustments.assign(m_extruder_ids.size(), PerExtruderAdjustments());
+    m_map_extruder_to_per_extruder_adjustment.assign(m_num_extruders, 0);
+    for (size_t i = 0; i < m_extruder_ids.size(); ++ i) {
+        PerExtruderAdjustments &adj         = m_per_extruder_adjustments[i];
+        unsigned int            extruder_id = m_extruder_ids[i];
+        adj.extruder_id               = extruder_id;
+        adj.cooling_slow_down_enabled = m_config.slow_down_for_layer_cooling.get_at(extruder_id);
+        adj.slow_down_layer_time = float(m_config.slow_down_layer_time.get_at(extruder_id));
+        adj.slow_down_min_speed           = float(m_config.slow_down_min_speed.get_at(extruder_id));
+        // ORCA: To enable dont slow down external perimeters feature per filament (extruder)
+        adj.dont_slow_down_outer_wall   = m_config.dont_slow_down_outer_wall.get_at(extruder_id);
+        m_map_extruder_to_per_extruder_adjustment[extruder_id] = i;
+    }
+}
+
+CoolingBuffer::~CoolingBuffer() = default;
+
+std::string CoolingBuffer::process_layer(std::string &&gcode, size_t layer_id, bool flush, GCodeMoves *moves)
+{
+    // Cache the input G-code with its typed moves.
+    if (m_gcode.empty()) {
+        m_moves.clear();
+        m_parsed_move = 0;
+    }
+    if (moves != nullptr) {
+        append_moves(m_moves, moves->begin(), moves->end(), 0, m_gcode.size());
+        moves->clear();
+    }
+    if (m_gcode.empty()) {
+        // Start of a new layer. Reuse the storage of the lines of the previous layer.
+        for (PerExtruderAdjustments &adj : m_per_extruder_adjustments)
+            adj.clear_lines();
+        m_parsed_end            = 0;
+        m_parser_extruder       = m_current_extruder;
+        m_active_speed_modifier = size_t(-1);
+        m_layer_had_extrusion   = false;
         m_gcode = std::move(gcode);
-    else
+    } else
         m_gcode += gcode;
 
+    // Parse the new snippet right away, only the slow down is left for the flush.
+    this->parse_layer_gcode(flush);
+
     std::string out;
     if (flush) {
         // This is either an object layer or the very last print layer. Calculate cool down over the collected support layers
         // and one object layer.
-        std::vector<PerExtruderAdjustments> per_extruder_adjustments = this->parse_layer_gcode(m_gcode, m_current_pos);
-        float layer_time_stretched = this->calculate_layer_slowdown(per_extruder_adjustments);
-        out = this->apply_layer_cooldown(m_gcode, layer_id, layer_time_stretched, per_extruder_adjustments);
+        float layer_time_stretched = this->calculate_layer_slowdown(m_per_extruder_adjustments);
+        GCodeMoves moves_out;
+        out = this->apply_layer_cooldown(std::move(m_gcode), layer_id, layer_time_stretched, m_per_extruder_adjustments, moves_out);
         m_gcode.clear();
+        if (moves != nullptr)
+            *moves = std::move(moves_out);
     }
     return out;
 }
 
+static inline bool starts_with(std::string_view str, std::string_view prefix)
+{
+    return str.size() >= prefix.size() && str.compare(0, prefix.size(), prefix) == 0;
+}
+
 // Parse the layer G-code for the moves, which could be adjusted.
-// Return the list of parsed lines, bucketed by an extruder.
-std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::string &gcode, std::vector<float> &current_pos) const
+// The parsed lines are bucketed by an extruder.
+void CoolingBuffer::parse_layer_gcode(bool flush)
 {
-    std::vector<PerExtruderAdjustments> per_extruder_adjustments(m_extruder_ids.size());
-    std::vector<size_t>                 map_extruder_to_per_extruder_adjustment(m_num_extruders, 0);
-    for (size_t i = 0; i < m_extruder_ids.size(); ++ i) {
-        PerExtruderAdjustments &adj         = per_extruder_adjustments[i];
-        unsigned int            extruder_id = m_extruder_ids[i];
-        adj.extruder_id               = extruder_id;
-        adj.cooling_slow_down_enabled = m_config.slow_down_for_layer_cooling.get_at(extruder_id);
-        adj.slow_down_layer_time = float(m_config.slow_down_layer_time.get_at(extruder_id));
-        adj.slow_down_min_speed           = float(m_config.slow_down_min_speed.get_at(extruder_id));
-        // ORCA: To enable dont slow down external perimeters feature per filament (extruder)
-        adj.dont_slow_down_outer_wall   = m_config.dont_slow_down_outer_wall.get_at(extruder_id);
-        map_extruder_to_per_extruder_adjustment[extruder_id] = i;
+    const char *gcode_begin = m_gcode.c_str();
+    const char *gcode_end   = gcode_begin + m_gcode.size();
+    if (! flush) {
+        // Leave the incomplete last line for the next snippet.
+        size_t last_line_end = m_gcode.rfind('\n');
+        if (last_line_end == std::string::npos || last_line_end < m_parsed_end)
+            return;
+        gcode_end = gcode_begin + last_line_end + 1;
     }
 
-    unsigned int      current_extruder  = m_current_extruder;
-    PerExtruderAdjustments *adjustment  = &per_extruder_adjustments[map_extruder_to_per_extruder_adjustment[current_extruder]];
-    const char       *line_start = gcode.c_str();
-    const char       *line_end   = line_start;
-    // Index of an existing CoolingLine of the current adjustment, which holds the feedrate setting command
-    // for a sequence of extrusion moves.
-    size_t            active_speed_modifier = size_t(-1);
-
-    // Orca: Whether we had our first extrusion in this layer.
-    // Time of any other movements before the first extrusion will be excluded from the layer time.
-    bool layer_had_extrusion = false;
+    std::array<float, 7>   &current_pos = m_current_pos;
+    PerExtruderAdjustments *adjustment  = &m_per_extruder_adjustments[m_map_extruder_to_per_extruder_adjustment[m_parser_extruder]];
+    const char             *line_start  = gcode_begin + m_parsed_end;
+    const char             *line_end    = line_start;
 
-    for (; *line_start != 0; line_start = line_end) 
+    for (; line_start != gcode_end; line_start = line_end)
     {
-        while (*line_end != '\n' && *line_end != 0)
+        while (line_end != gcode_end && *line_end != '\n')
             ++ line_end;
         // sline will not contain the trailing '\n'.
-        std::string sline(line_start, line_end);
+        std::string_view sline(line_start, line_end - line_start);
         // CoolingLine will contain the trailing '\n'.
-        if (*line_end == '\n')
+        if (line_end != gcode_end)
             ++ line_end;
-        CoolingLine line(0, line_start - gcode.c_str(), line_end - gcode.c_str());
-        if (boost::starts_with(sline, "G0 "))
+        CoolingLine line(0, line_start - gcode_begin, line_end - gcode_begin);
+        // Typed move of this line, if GCodeWriter formatted it.
+        const GCodeMove *move = nullptr;
+        for (; m_parsed_move < m_moves.size() && m_moves[m_parsed_move].line_start < line.line_start; ++ m_parsed_move) ;
+        if (m_parsed_move < m_moves.size() && m_moves[m_parsed_move].line_start == line.line_start)
+            move = &m_moves[m_parsed_move ++];
+        if (move)
+            line.type = move->type == GCodeMove::G0 ? CoolingLine::TYPE_G0 : move->type == GCodeMove::G1 ? CoolingLine::TYPE_G1 :
+                        move->type == GCodeMove::G2 ? CoolingLine::TYPE_G2 : CoolingLine::TYPE_G3;
+        else if (starts_with(sline, "G0 "))
             line.type = CoolingLine::TYPE_G0;
-        else if (boost::starts_with(sline, "G1 "))
+        else if (starts_with(sline, "G1 "))
             line.type = CoolingLine::TYPE_G1;
-        else if (boost::starts_with(sline, "G92 "))
+        else if (starts_with(sline, "G92 "))
             line.type = CoolingLine::TYPE_G92;
-        else if (boost::starts_with(sline, "G2 "))
+        else if (starts_with(sline, "G2 "))
             line.type = CoolingLine::TYPE_G2;
-        else if (boost::starts_with(sline, "G3 "))
+        else if (starts_with(sline, "G3 "))
             line.type = CoolingLine::TYPE_G3;
         if (line.type) {
             // G0, G1 or G92
             // Parse the G-code line.
-            std::vector<float> new_pos(current_pos);
-            const char *c = sline.data() + 3;
-            for (;;) {
-                // Skip whitespaces.
-                for (; *c == ' ' || *c == '\t'; ++ c);
-                if (*c == 0 || *c == ';')
-                    break;
-
-                assert(is_decimal_separator_point()); // for atof
-                //BBS: Parse the axis.
-                size_t axis = (*c >= 'X' && *c <= 'Z') ? (*c - 'X') :
-                              (*c == 'E') ? 3 : (*c == 'F') ? 4 :
-                              (*c == 'I') ? 5 : (*c == 'J') ? 6 : size_t(-1);
-                if (axis != size_t(-1)) {
-                    new_pos[axis] = float(atof(++c));
-                    if (axis == 4) {
-                        // Convert mm/min to mm/sec.
-                        new_pos[4] /= 60.f;
-                        if ((line.type & CoolingLine::TYPE_G92) == 0)
-                            // This is G0 or G1 line and it sets the feedrate. This mark is used for reducing the duplicate F calls.
-                            line.type |= CoolingLine::TYPE_HAS_F;
-                    } else if (axis == 5 || axis == 6) {
-                        // BBS: get position of arc center
-                        new_pos[axis] += current_pos[axis - 5];
-                    }
+            std::array<float, 7> new_pos = current_pos;
+            auto set_axis = [&new_pos, &current_pos, &line](size_t axis, float value) {
+                new_pos[axis] = value;
+                if (axis == 4) {
+                    // Convert mm/min to mm/sec.
+                    new_pos[4] /= 60.f;
+                    if ((line.type & CoolingLine::TYPE_G92) == 0)
+                        // This is G0 or G1 line and it sets the feedrate. This mark is used for reducing the duplicate F calls.
+                        line.type |= CoolingLine::TYPE_HAS_F;
+                } else if (axis == 5 || axis == 6) {
+                    // BBS: get position of arc center
+                    new_pos[axis] += current_pos[axis - 5];
+                }
+            };
+            if (move) {
+                // X, Y, Z, E, F, I, J are indexed the same as Axis.
+                for (size_t axis = 0; axis < 7; ++ axis)
+                    if (move->has(Axis(axis)))
+                        set_axis(axis, move->value(Axis(axis)));
+            } else {
+                const char *c     = sline.data() + 3;
+                const char *c_end = sline.data() + sline.size();
+                for (;;) {
+                    // Skip whitespaces.
+                    for (; c != c_end && (*c == ' ' || *c == '\t'); ++ c);
+                    if (c == c_end || *c == ';')
+                        break;
+
+                    assert(is_decimal_separator_point()); // for atof
+                    //BBS: Parse the axis.
+                    size_t axis = (*c >= 'X' && *c <= 'Z') ? (*c - 'X') :
+                                  (*c == 'E') ? 3 : (*c == 'F') ? 4 :
+                                  (*c == 'I') ? 5 : (*c == 'J') ? 6 : size_t(-1);
+                    if (axis != size_t(-1))
+                        // An axis without a value at the end of the line reads zero.
+                        set_axis(axis, ++ c == c_end ? 0.f : float(atof(c)));
+                    // Skip this word.
+                    for (; c != c_end && *c != ' ' && *c != '\t'; ++ c);
                 }
-                // Skip this word.
-                for (; *c != ' ' && *c != '\t' && *c != 0; ++ c);
             }
-            bool external_perimeter = boost::contains(sline, ";_EXTERNAL_PERIMETER");
-            bool wipe               = boost::contains(sline, ";_WIPE");
+            // All the markers are comments, search them starting with the first comment of the line.
+            std::string_view comment            = sline.substr(std::min(sline.find(';'), sline.size()));
+            bool             external_perimeter = comment.find(";_EXTERNAL_PERIMETER") != std::string_view::npos;
+            bool             wipe               = comment.find(";_WIPE") != std::string_view::npos;
+            bool             set_speed          = comment.find(";_EXTRUDE_SET_SPEED") != std::string_view::npos;
             if (external_perimeter)
                 line.type |= CoolingLine::TYPE_EXTERNAL_PERIMETER;
             if (wipe)
                 line.type |= CoolingLine::TYPE_WIPE;
 
             // Orca: only slow down movements since the first extrusion
-            if (boost::contains(sline, ";_EXTRUDE_SET_SPEED"))
-                layer_had_extrusion = true;
+            if (set_speed)
+                m_layer_had_extrusion = true;
             
             // ORCA: Dont slowdown external perimeters for layer time feature
             // use the adjustment pointer to ensure the value for the current extruder (filament) is used.
@@ -431,9 +528,9 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
             
             // ORCA: Dont slowdown external perimeters for layer time works by not marking the external perimeter as adjustable, 
             // hence the slowdown algorithm ignores it.
-            if (boost::contains(sline, ";_EXTRUDE_SET_SPEED") && ! wipe && adjust_external) {
+            if (set_speed && ! wipe && adjust_external) {
                 line.type |= CoolingLine::TYPE_ADJUSTABLE;
-                active_speed_modifier = adjustment->lines.size();
+                m_active_speed_modifier = adjustment->lines.size();
             }
             if ((line.type & CoolingLine::TYPE_G92) == 0) {
                 //BBS: G0, G1, G2, G3. Calculate the duration.
@@ -468,16 +565,18 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
                 if (line.length > 0)
                     line.time = line.length / line.feedrate;
                 line.time_max = line.time;
-                if ((line.type & CoolingLine::TYPE_ADJUSTABLE) || active_speed_modifier != size_t(-1))
+                if ((line.type & CoolingLine::TYPE_ADJUSTABLE) || m_active_speed_modifier != size_t(-1))
                     line.time_max = (adjustment->slow_down_min_speed == 0.f) ? FLT_MAX : std::max(line.time, line.length / adjustment->slow_down_min_speed);
                 // BBS: add G2 and G3 support
-                if (active_speed_modifier < adjustment->lines.size() && ((line.type & CoolingLine::TYPE_G1) ||
+                if (m_active_speed_modifier < adjustment->lines.size() && ((line.type & CoolingLine::TYPE_G1) ||
                                                                          (line.type & CoolingLine::TYPE_G2) ||
                                                                          (line.type & CoolingLine::TYPE_G3))) {
                     // Inside the ";_EXTRUDE_SET_SPEED" blocks, there must not be a G1 Fxx entry.
                     assert((line.type & CoolingLine::TYPE_HAS_F) == 0);
-                    CoolingLine &sm = adjustment->lines[active_speed_modifier];
+                    CoolingLine &sm = adjustment->lines[m_active_speed_modifier];
                     assert(sm.feedrate > 0.f);
+                    if (m_analytic_slowdown)
+                        adjustment->add_running_time(line.time, line.time_max);
                     sm.length   += line.length;
                     sm.time     += line.time;
                     if (sm.time_max != FLT_MAX) {
@@ -490,69 +589,69 @@ std::vector<PerExtruderAdjustments> CoolingBuffer::parse_layer_gcode(const std::
                     line.type = 0;
                 }
             }
-            current_pos = std::move(new_pos);
-        } else if (boost::starts_with(sline, ";_EXTRUDE_END")) {
+            current_pos = new_pos;
+        } else if (starts_with(sline, ";_EXTRUDE_END")) {
             line.type = CoolingLine::TYPE_EXTRUDE_END;
-            active_speed_modifier = size_t(-1);
-        } else if (boost::starts_with(sline, m_toolchange_prefix)) {
+            m_active_speed_modifier = size_t(-1);
+        } else if (starts_with(sline, m_toolchange_prefix)) {
             unsigned int new_extruder = 0;
             auto ret = std::from_chars(sline.data() + m_toolchange_prefix.size(), sline.data() + sline.size(), new_extruder);
             if (std::errc::invalid_argument != ret.ec) {
                 // Only change extruder in case the number is meaningful. User could provide an out-of-range index through custom gcodes -
                 // those shall be ignored.
-                if (new_extruder < map_extruder_to_per_extruder_adjustment.size()) {
-                    if (new_extruder != current_extruder) {
+                if (new_extruder < m_map_extruder_to_per_extruder_adjustment.size()) {
+                    if (new_extruder != m_parser_extruder) {
                         // Switch the tool.
-                        line.type        = CoolingLine::TYPE_SET_TOOL;
-                        current_extruder = new_extruder;
-                        adjustment       = &per_extruder_adjustments[map_extruder_to_per_extruder_adjustment[current_extruder]];
+                        line.type         = CoolingLine::TYPE_SET_TOOL;
+                        m_parser_extruder = new_extruder;
+                        adjustment        = &m_per_extruder_adjustments[m_map_extruder_to_per_extruder_adjustment[m_parser_extruder]];
                     }
                 } else {
                     // Only log the error in case of MM printer. Single extruder printers likely ignore any T anyway.
-                    if (map_extruder_to_per_extruder_adjustment.size() > 1)
+                    if (m_map_extruder_to_per_extruder_adjustment.size() > 1)
                         BOOST_LOG_TRIVIAL(error) << "CoolingBuffer encountered an invalid toolchange, maybe from a custom gcode: " << sline;
                 }
             }
-        } else if (boost::starts_with(sline, ";_OVERHANG_FAN_START")) {
+        } else if (starts_with(sline, ";_OVERHANG_FAN_START")) {
             line.type = CoolingLine::TYPE_OVERHANG_FAN_START;
-        } else if (boost::starts_with(sline, ";_OVERHANG_FAN_END")) {
+        } else if (starts_with(sline, ";_OVERHANG_FAN_END")) {
             line.type = CoolingLine::TYPE_OVERHANG_FAN_END;
-        } else if (boost::starts_with(sline, ";_INTERNAL_BRIDGE_FAN_START")) { // ORCA: Add support for separate internal bridge fan speed control
+        } else if (starts_with(sline, ";_INTERNAL_BRIDGE_FAN_START")) { // ORCA: Add support for separate internal bridge fan speed control
             line.type = CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_START;
-        } else if (boost::starts_with(sline, ";_INTERNAL_BRIDGE_FAN_END")) { // ORCA: Add support for separate internal bridge fan speed control
+        } else if (starts_with(sline, ";_INTERNAL_BRIDGE_FAN_END")) { // ORCA: Add support for separate internal bridge fan speed control
             line.type = CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_END;
-        } else if (boost::starts_with(sline, ";_SUPP_INTERFACE_FAN_START")) {
+        } else if (starts_with(sline, ";_SUPP_INTERFACE_FAN_START")) {
             line.type = CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_START;
-        } else if (boost::starts_with(sline, ";_SUPP_INTERFACE_FAN_END")) {
+        } else if (starts_with(sline, ";_SUPP_INTERFACE_FAN_END")) {
             line.type = CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_END;
-        } else if (boost::starts_with(sline, ";_IRONING_FAN_START")) { // ORCA: Add support for ironing fan speed control
+        } else if (starts_with(sline, ";_IRONING_FAN_START")) { // ORCA: Add support for ironing fan speed control
             line.type = CoolingLine::TYPE_IRONING_FAN_START;
-        } else if (boost::starts_with(sline, ";_IRONING_FAN_END")) { // ORCA: Add support for ironing fan speed control
+        } else if (starts_with(sline, ";_IRONING_FAN_END")) { // ORCA: Add support for ironing fan speed control
             line.type = CoolingLine::TYPE_IRONING_FAN_END;
-        } else if (boost::starts_with(sline, "G4 ")) {
+        } else if (starts_with(sline, "G4 ")) {
             // Parse the wait time.
             line.type = CoolingLine::TYPE_G4;
             size_t pos_S = sline.find('S', 3);
-            size_t pos_P = sline.find('P', 3);
             assert(is_decimal_separator_point()); // for atof
-            line.time = line.time_max = float(
-                (pos_S > 0) ? atof(sline.c_str() + pos_S + 1) :
-                (pos_P > 0) ? atof(sline.c_str() + pos_P + 1) * 0.001 : 0.);
-        } else if (boost::starts_with(sline, ";_FORCE_RESUME_FAN_SPEED")) {
+            line.time = line.time_max = float((pos_S != std::string_view::npos) ? atof(sline.data() + pos_S + 1) : 0.);
+        } else if (starts_with(sline, ";_FORCE_RESUME_FAN_SPEED")) {
             line.type = CoolingLine::TYPE_FORCE_RESUME_FAN;
         }
 
         // Orca: For any movements before this layer's first ever extrusion, we exclude them from the layer time calculation.
-        if (!layer_had_extrusion) {
+        if (!m_layer_had_extrusion) {
             assert((line.type & CoolingLine::TYPE_ADJUSTABLE) == 0);
             line.time = line.time_max = 0;
         }
 
-        if (line.type != 0)
+        if (line.type != 0) {
+            if (m_analytic_slowdown)
+                adjustment->add_running_time(line.time, (line.type & CoolingLine::TYPE_ADJUSTABLE) ? line.time_max : line.time);
             adjustment->lines.emplace_back(std::move(line));
+        }
     }
 
-    return per_extruder_adjustments;
+    m_parsed_end = gcode_end - gcode_begin;
 }
 
 // Slow down an extruder range to slow_down_layer_time.
@@ -633,6 +732,92 @@ static inline void extruder_range_slow_down_non_proportional(
     }
 }
 
+// Slow down an extruder range by time_stretch, analytic counterpart of extruder_range_slow_down_non_proportional().
+// The adjustable lines are capped at a common feedrate, limited from below by slow_down_min_speed of each extruder.
+// Between the neighbor feedrates of the lines and the minimum speeds the time stretch is A / feedrate + B,
+// thus the common feedrate is solved in a single sweep over the lines sorted by decreasing feedrate.
+static inline void extruder_range_slow_down_analytic(
+    std::vector<PerExtruderAdjustments*>::iterator it_begin,
+    std::vector<PerExtruderAdjustments*>::iterator it_end,
+    float time_stretch)
+{
+    if (std::all_of(it_begin, it_end, [](const PerExtruderAdjustments *adj){ return adj->slow_down_min_speed == 0.f; })) {
+        // Without the minimum speeds the adjustable lines are slowed down proportionally, as extruder_range_slow_down_non_proportional() does.
+        float time_adjustable = 0.f;
+        for (auto it = it_begin; it != it_end; ++ it)
+            time_adjustable += (*it)->adjustable_time(true);
+        float rate = (time_adjustable + time_stretch) / time_adjustable;
+        for (auto it = it_begin; it != it_end; ++ it)
+            (*it)->slow_down_proportional(rate, true);
+        return;
+    }
+
+    // Breakpoints of the time stretch: feedrates of the adjustable lines faster than their minimum speed, and the minimum speeds.
+    struct Breakpoint {
+        float                    feedrate;
+        // Line starting to slow down below feedrate, or nullptr if adj reaches its minimum speed at feedrate.
+        const CoolingLine       *line;
+        size_t                   idx_adj;
+    };
+    std::vector<Breakpoint> breakpoints;
+    size_t                  n_adj = it_end - it_begin;
+    for (size_t idx_adj = 0; idx_adj < n_adj; ++ idx_adj) {
+        const PerExtruderAdjustments &adj = *it_begin[idx_adj];
+        for (const CoolingLine *line : adj.adjustable_lines)
+            if (line->feedrate > adj.slow_down_min_speed)
+                breakpoints.push_back({ line->feedrate, line, idx_adj });
+        if (adj.slow_down_min_speed > 0.f)
+            breakpoints.push_back({ adj.slow_down_min_speed, nullptr, idx_adj });
+    }
+    // Decreasing feedrate, a line at a feedrate is slowed down before its extruder reaches the same minimum speed.
+    std::sort(breakpoints.begin(), breakpoints.end(), [](const Breakpoint &b1, const Breakpoint &b2)
+        { return b1.feedrate > b2.feedrate || (b1.feedrate == b2.feedrate && b1.line != nullptr && b2.line == nullptr); });
+
+    // Above the current breakpoint, the time stretch at feedrate F is length_free / F - time_free + stretch_clamped,
+    // where length_free and time_free are accumulated over the lines of the extruders above their minimum speed
+    // and stretch_clamped is the stretch of the extruders already slowed down to their minimum speed.
+    std::vector<double> length_free_adj(n_adj, 0.), time_free_adj(n_adj, 0.);
+    double length_free     = 0.;
+    double time_free       = 0.;
+    double stretch_clamped = 0.;
+    double feedrate        = 0.;
+    bool   solved          = false;
+    for (const Breakpoint &bp : breakpoints) {
+        if (length_free > 0. && length_free / bp.feedrate - time_free + stretch_clamped >= time_stretch) {
+            feedrate = length_free / (time_stretch + time_free - stretch_clamped);
+            solved   = true;
+            break;
+        }
+        if (bp.line) {
+            double length = double(bp.line->time) * double(bp.line->feedrate);
+            length_free_adj[bp.idx_adj] += length;
+            time_free_adj[bp.idx_adj]   += bp.line->time;
+            length_free += length;
+            time_free   += bp.line->time;
+        } else {
+            stretch_clamped += length_free_adj[bp.idx_adj] / bp.feedrate - time_free_adj[bp.idx_adj];
+            length_free     -= length_free_adj[bp.idx_adj];
+            time_free       -= time_free_adj[bp.idx_adj];
+        }
+    }
+    if (! solved && length_free > 0. && time_stretch + time_free - stretch_clamped > 0.)
+        // Some extruder has no minimum speed, the time stretch grows without a limit.
+        feedrate = length_free / (time_stretch + time_free - stretch_clamped);
+
+    for (auto it = it_begin; it != it_end; ++ it) {
+        PerExtruderAdjustments &adj = **it;
+        float feedrate_limit = std::max(float(feedrate), adj.slow_down_min_speed);
+        for (CoolingLine *line : adj.adjustable_lines)
+            if (line->feedrate > feedrate_limit) {
+                float time = line->time * std::max(1.f, line->feedrate / feedrate_limit);
+                adj.time_total += time - line->time;
+                line->time      = time;
+                line->feedrate  = feedrate_limit;
+                line->slowdown  = true;
+            }
+    }
+}
+
 // Calculate slow down for all the extruders.
 float CoolingBuffer::calculate_layer_slowdown(std::vector<PerExtruderAdjustments> &per_extruder_adjustments)
 {
@@ -646,15 +831,20 @@ float CoolingBuffer::calculate_layer_slowdown(std::vector<PerExtruderAdjustments
     float elapsed_time_total0 = 0.f;
     for (PerExtruderAdjustments &adj : per_extruder_adjustments) {
         // Curren total time for this extruder.
-        adj.time_total  = adj.elapsed_time_total();
+        adj.time_total  = m_analytic_slowdown ? float(adj.running_time_total) : adj.elapsed_time_total();
         // Maximum time for this extruder, when all extrusion moves are slowed down to min_extrusion_speed.
-        adj.time_maximum = adj.maximum_time_after_slowdown(true);
+        adj.time_maximum = ! m_analytic_slowdown ? adj.maximum_time_after_slowdown(true) :
+            adj.running_time_unlimited ? FLT_MAX : float(adj.running_time_maximum);
         if (adj.cooling_slow_down_enabled && adj.lines.size() > 0) {
             by_slowdown_time.emplace_back(&adj);
-            // sorts the lines, also sets adj.time_non_adjustable
-            adj.sort_lines_by_decreasing_feedrate();
+            if (m_analytic_slowdown)
+                // Leaves the lines in the G-code order, so that apply_layer_cooldown() merges them instead of sorting.
+                adj.collect_adjustable_lines_by_decreasing_feedrate();
+            else
+                // sorts the lines, also sets adj.time_non_adjustable
+                adj.sort_lines_by_decreasing_feedrate();
         } else
-            elapsed_time_total0 += adj.elapsed_time_total();
+            elapsed_time_total0 += adj.time_total;
     }
 
     std::sort(by_slowdown_time.begin(), by_slowdown_time.end(),
@@ -677,30 +867,104 @@ float CoolingBuffer::calculate_layer_slowdown(std::vector<PerExtruderAdjustments
             for (auto it = cur_begin; it != by_slowdown_time.end(); ++ it)
                 max_time += (*it)->time_maximum;
             if (max_time > slow_down_layer_time) {
-                extruder_range_slow_down_non_proportional(cur_begin, by_slowdown_time.end(), slow_down_layer_time - total);
+                if (m_analytic_slowdown)
+                    extruder_range_slow_down_analytic(cur_begin, by_slowdown_time.end(), slow_down_layer_time - total);
+                else
+                    extruder_range_slow_down_non_proportional(cur_begin, by_slowdown_time.end(), slow_down_layer_time - total);
             } else {
                 // Slow down to maximum possible.
                 for (auto it = cur_begin; it != by_slowdown_time.end(); ++ it)
                     (*it)->slowdown_to_minimum_feedrate(true);
             }
         }
-        elapsed_time_total0 += adj.elapsed_time_total();
+        elapsed_time_total0 += m_analytic_slowdown ? adj.time_total : adj.elapsed_time_total();
     }
 
     return elapsed_time_total0;
 }
 
+// Writes the adjusted G-code over its source front to back, so that a layer is edited in place instead of being copied.
+// The source is read in increasing order, everything below the consumed position may be overwritten.
+// Output, which would overtake the consumed source, is held back until the source consumed makes room for it.
+class InPlaceGCodeWriter
+{
+public:
+    InPlaceGCodeWriter(std::string &gcode) : m_gcode(gcode) {}
+
+    // The source below pos will not be read anymore.
+    void consume(const char *pos) {
+        m_consumed = std::max(m_consumed, size_t(pos - m_gcode.data()));
+        if (! m_held_back.empty() && m_written + m_held_back.size() <= m_consumed) {
+            memcpy(m_gcode.data() + m_written, m_held_back.data(), m_held_back.size());
+            m_written += m_held_back.size();
+            m_held_back.clear();
+        }
+    }
+    // Append a part of the source, which is consumed.
+    void append_source(const char *begin, const char *end) {
+        if (m_held_back.empty() && m_written <= size_t(begin - m_gcode.data())) {
+            memmove(m_gcode.data() + m_written, begin, end - begin);
+            m_written += end - begin;
+        } else
+            m_held_back.append(begin, end);
+        this->consume(end);
+    }
+    // Append text not read from the source.
+    void append(const std::string &text) {
+        if (m_held_back.empty() && m_written + text.size() <= m_consumed) {
+            memcpy(m_gcode.data() + m_written, text.data(), text.size());
+            m_written += text.size();
+        } else
+            m_held_back += text;
+    }
+    void append(const char *text) { this->append(std::string(text)); }
+
+    // Length of the output written so far.
+    size_t size() const { return m_written + m_held_back.size(); }
+    // Does the complete output written so far equal to text?
+    bool output_equals(std::string_view text) const {
+        return m_written + m_held_back.size() == text.size() &&
+               text.compare(0, m_written, std::string_view(m_gcode.data(), m_written)) == 0 &&
+               text.compare(m_written, std::string_view::npos, m_held_back) == 0;
+    }
+    // Remove n characters from the end of the output.
+    void pop_back(size_t n) {
+        size_t n_held_back = std::min(n, m_held_back.size());
+        m_held_back.resize(m_held_back.size() - n_held_back);
+        m_written -= n - n_held_back;
+    }
+
+    // Consume the rest of the source and return the output.
+    std::string finalize() {
+        this->consume(m_gcode.data() + m_gcode.size());
+        m_gcode.resize(m_written);
+        m_gcode += m_held_back;
+        return std::move(m_gcode);
+    }
+
+private:
+    std::string &m_gcode;
+    // Length of the output written over the source.
+    size_t       m_written  { 0 };
+    // Length of the source, which will not be read anymore.
+    size_t       m_consumed { 0 };
+    // Output following m_written, which did not fit below m_consumed yet.
+    std::string  m_held_back;
+};
+
 // Apply slow down over G-code lines stored in per_extruder_adjustments, enable fan if needed.
-// Returns the adjusted G-code.
+// Returns the adjusted G-code and its typed moves.
 std::string CoolingBuffer::apply_layer_cooldown(
-    // Source G-code for the current layer.
-    const std::string                      &gcode,
+    // Source G-code for the current layer, adjusted in place.
+    std::string                           &&gcode,
     // ID of the current layer, used to disable fan for the first n layers.
     size_t                                  layer_id, 
     // Total time of this layer after slow down, used to control the fan.
     float                                   layer_time,
     // Per extruder list of G-code lines and their cool down attributes.
-    std::vector<PerExtruderAdjustments>    &per_extruder_adjustments)
+    std::vector<PerExtruderAdjustments>    &per_extruder_adjustments,
+    // Typed moves of the adjusted G-code, taken over from m_moves.
+    GCodeMoves                             &moves_out)
 {
     // First sort the adjustment lines by of multiple extruders by their position in the source G-code.
     std::vector<const CoolingLine*> lines;
@@ -709,14 +973,36 @@ std::string CoolingBuffer::apply_layer_cooldown(
         for (const PerExtruderAdjustments &adj : per_extruder_adjustments)
             n_lines += adj.lines.size();
         lines.reserve(n_lines);
-        for (const PerExtruderAdjustments &adj : per_extruder_adjustments)
+        auto line_start_lower = [](const CoolingLine *ln1, const CoolingLine *ln2) { return ln1->line_start < ln2->line_start; };
+        for (const PerExtruderAdjustments &adj : per_extruder_adjustments) {
+            size_t n_lines_merged = lines.size();
             for (const CoolingLine &line : adj.lines)
                 lines.emplace_back(&line);
-        std::sort(lines.begin(), lines.end(), [](const CoolingLine *ln1, const CoolingLine *ln2) { return ln1->line_start < ln2->line_start; } );
+            if (m_analytic_slowdown)
+                // The analytic slow down keeps the lines of each extruder in the G-code order.
+                std::inplace_merge(lines.begin(), lines.begin() + n_lines_merged, lines.end(), line_start_lower);
+        }
+        if (! m_analytic_slowdown)
+            std::sort(lines.begin(), lines.end(), line_start_lower);
     }
-    // Second generate the adjusted G-code.
-    std::string new_gcode;
-    new_gcode.reserve(gcode.size() * 2);
+    // Second generate the adjusted G-code over the source G-code.
+    InPlaceGCodeWriter new_gcode(gcode);
+    // Typed moves of the source G-code not processed yet.
+    auto it_move = m_moves.cbegin();
+    moves_out.clear();
+    moves_out.reserve(m_moves.size());
+    // Append complete lines of the source G-code together with their typed moves.
+    auto append_source_lines = [&gcode, &new_gcode, &it_move, this, &moves_out](const char *begin, const char *end) {
+        size_t src_begin = begin - gcode.c_str();
+        size_t src_end   = end - gcode.c_str();
+        size_t dst_begin = new_gcode.size();
+        for (; it_move != m_moves.cend() && it_move->line_start < src_begin; ++ it_move) ;
+        auto it_end = it_move;
+        for (; it_end != m_moves.cend() && it_end->line_start < src_end; ++ it_end) ;
+        append_moves(moves_out, it_move, it_end, src_begin, dst_begin);
+        it_move = it_end;
+        new_gcode.append_source(begin, end);
+    };
     bool overhang_fan_control= false;
     int  overhang_fan_speed   = 0;
     bool internal_bridge_fan_control= false; // ORCA: Add support for separate internal bridge fan speed control
@@ -804,13 +1090,13 @@ std::string CoolingBuffer::apply_layer_cooldown(
             m_fan_speed = fan_speed_new;
             m_current_fan_speed = fan_speed_new;
             if (immediately_apply)
-                new_gcode  += GCodeWriter::set_fan(m_config.gcode_flavor, m_fan_speed);
+                new_gcode.append(GCodeWriter::set_fan(m_config.gcode_flavor, m_fan_speed));
         }
         //BBS
         if (additional_fan_speed_new != m_additional_fan_speed) {
             m_additional_fan_speed = additional_fan_speed_new;
             if (immediately_apply && m_config.auxiliary_fan.value)
-                new_gcode += GCodeWriter::set_additional_fan(m_additional_fan_speed);
+                new_gcode.append(GCodeWriter::set_additional_fan(m_additional_fan_speed));
         }
     };
 
@@ -831,7 +1117,7 @@ std::string CoolingBuffer::apply_layer_cooldown(
         const char *line_start  = gcode.c_str() + line->line_start;
         const char *line_end    = gcode.c_str() + line->line_end;
         if (line_start > pos)
-            new_gcode.append(pos, line_start - pos);
+            append_source_lines(pos, line_start);
         if (line->type & CoolingLine::TYPE_SET_TOOL) {
             unsigned int new_extruder = 0;
             auto ret = std::from_chars(line_start + m_toolchange_prefix.size(), line_end, new_extruder);
@@ -841,7 +1127,7 @@ std::string CoolingBuffer::apply_layer_cooldown(
                     change_extruder_set_fan(true);
                 }
             }
-            new_gcode.append(line_start, line_end - line_start);
+            new_gcode.append_source(line_start, line_end);
         } else if (line->type & CoolingLine::TYPE_OVERHANG_FAN_START) {
             if (overhang_fan_control && !fan_speed_change_requests[CoolingLine::TYPE_OVERHANG_FAN_START]) {
                 need_set_fan = true;
@@ -889,11 +1175,18 @@ std::string CoolingBuffer::apply_layer_cooldown(
                 need_set_fan = true;
             }
             if (m_additional_fan_speed != -1 && m_config.auxiliary_fan.value)
-                new_gcode += GCodeWriter::set_additional_fan(m_additional_fan_speed);
+                new_gcode.append(GCodeWriter::set_additional_fan(m_additional_fan_speed));
         }
         else if (line->type & CoolingLine::TYPE_EXTRUDE_END) {
             // Just remove this comment.
         } else if (line->type & (CoolingLine::TYPE_ADJUSTABLE | CoolingLine::TYPE_EXTERNAL_PERIMETER | CoolingLine::TYPE_WIPE | CoolingLine::TYPE_HAS_F)) {
+            // Typed move of this line, it is kept if the line is emitted.
+            const GCodeMove *move = nullptr;
+            for (; it_move != m_moves.cend() && it_move->line_start < line->line_start; ++ it_move) ;
+            if (it_move != m_moves.cend() && it_move->line_start == line->line_start)
+                move = &*it_move ++;
+            size_t      out_begin       = new_gcode.size();
+            bool        move_kept       = false;
             // Find the start of a comment, or roll to the end of line.
             const char *end = line_start;
             for (; end < line_end && *end != ';'; ++ end);
@@ -920,17 +1213,19 @@ std::string CoolingBuffer::apply_layer_cooldown(
             } else {
                 // The F value is different from current_feedrate, but not slowed down, thus the G-code line will not be modified.
                 // Emit the line without the comment.
-                new_gcode.append(line_start, end - line_start);
+                new_gcode.append_source(line_start, end);
                 current_feedrate = new_feedrate;
+                move_kept = true;
             }
             if (modify || remove) {
                 if (modify) {
                     // Replace the feedrate.
-                    new_gcode.append(line_start, fpos - line_start);
+                    new_gcode.append_source(line_start, fpos);
                     current_feedrate = new_feedrate;
                     char buf[64];
                     sprintf(buf, "%d", int(current_feedrate));
-                    new_gcode += buf;
+                    new_gcode.append(buf);
+                    move_kept = true;
                 } else {
                     // Remove the feedrate word.
                     const char *f = fpos;
@@ -941,7 +1236,8 @@ std::string CoolingBuffer::apply_layer_cooldown(
                         // BBS: only remain "G1" or "G0" of this line after remove 'F' part, don't save
                     } else {
                         // Append up to the F word, without the trailing whitespace.
-                        new_gcode.append(line_start, f - line_start + 1);
+                        new_gcode.append_source(line_start, f + 1);
+                        move_kept = true;
                     }
                 }
                 // Skip the non-whitespaces of the F parameter up the comment or end of line.
@@ -949,11 +1245,12 @@ std::string CoolingBuffer::apply_layer_cooldown(
                 // Append the rest of the line without the comment.
                 if (fpos < end)
                     // The G-code line is not empty yet. Emit the rest of it.
-                    new_gcode.append(fpos, end - fpos);
-                else if (remove && new_gcode == "G1") {
+                    new_gcode.append_source(fpos, end);
+                else if (remove && new_gcode.output_equals("G1")) {
                     // The G-code line only contained the F word, now it is empty. Remove it completely including the comments.
-                    new_gcode.resize(new_gcode.size() - 2);
+                    new_gcode.pop_back(2);
                     end = line_end;
+                    move_kept = false;
                 }
             }
             // Process the rest of the line.
@@ -961,52 +1258,66 @@ std::string CoolingBuffer::apply_layer_cooldown(
                 if (line->type & (CoolingLine::TYPE_ADJUSTABLE | CoolingLine::TYPE_EXTERNAL_PERIMETER | CoolingLine::TYPE_WIPE)) {
                     // Process comments, remove ";_EXTRUDE_SET_SPEED", ";_EXTERNAL_PERIMETER", ";_WIPE"
                     std::string comment(end, line_end);
+                    new_gcode.consume(line_end);
                     boost::replace_all(comment, ";_EXTRUDE_SET_SPEED", "");
                     if (line->type & CoolingLine::TYPE_EXTERNAL_PERIMETER)
                         boost::replace_all(comment, ";_EXTERNAL_PERIMETER", "");
                     if (line->type & CoolingLine::TYPE_WIPE)
                         boost::replace_all(comment, ";_WIPE", "");
-                    new_gcode += comment;
+                    new_gcode.append(comment);
                 } else {
                     // Just attach the rest of the source line.
-                    new_gcode.append(end, line_end - end);
+                    new_gcode.append_source(end, line_end);
+                }
+            }
+            if (move != nullptr && move_kept) {
+                // The words of the line were kept except for the F word.
+                GCodeMove &move_out = moves_out.emplace_back(*move);
+                move_out.line_start = out_begin;
+                move_out.line_end   = new_gcode.size();
+                if (modify)
+                    move_out.axis[F] = float(current_feedrate);
+                else if (remove) {
+                    move_out.mask   &= ~(1 << int(F));
+                    move_out.axis[F] = 0.f;
                 }
             }
         } else {
-            new_gcode.append(line_start, line_end - line_start);
+            append_source_lines(line_start, line_end);
         }
+        new_gcode.consume(line_end);
 
         if (need_set_fan) {
             if (fan_speed_change_requests[CoolingLine::TYPE_OVERHANG_FAN_START]){
-                new_gcode += GCodeWriter::set_fan(m_config.gcode_flavor, overhang_fan_speed);
+                new_gcode.append(GCodeWriter::set_fan(m_config.gcode_flavor, overhang_fan_speed));
                 m_current_fan_speed = overhang_fan_speed;
             } else if (fan_speed_change_requests[CoolingLine::TYPE_INTERNAL_BRIDGE_FAN_START]){ // ORCA: Add support for separate internal bridge fan speed control
-                new_gcode += GCodeWriter::set_fan(m_config.gcode_flavor, internal_bridge_fan_speed);
+                new_gcode.append(GCodeWriter::set_fan(m_config.gcode_flavor, internal_bridge_fan_speed));
                 m_current_fan_speed = internal_bridge_fan_speed;
             }
             else if (fan_speed_change_requests[CoolingLine::TYPE_SUPPORT_INTERFACE_FAN_START]){
-                new_gcode += GCodeWriter::set_fan(m_config.gcode_flavor, supp_interface_fan_speed);
+                new_gcode.append(GCodeWriter::set_fan(m_config.gcode_flavor, supp_interface_fan_speed));
                 m_current_fan_speed = supp_interface_fan_speed;
             }
             else if (fan_speed_change_requests[CoolingLine::TYPE_IRONING_FAN_START]){
-                new_gcode += GCodeWriter::set_fan(m_config.gcode_flavor, ironing_fan_speed);
+                new_gcode.append(GCodeWriter::set_fan(m_config.gcode_flavor, ironing_fan_speed));
                 m_current_fan_speed = ironing_fan_speed;
             }
             else if(fan_speed_change_requests[CoolingLine::TYPE_FORCE_RESUME_FAN] && m_current_fan_speed != -1){
-                new_gcode += GCodeWriter::set_fan(m_config.gcode_flavor, m_current_fan_speed);
+                new_gcode.append(GCodeWriter::set_fan(m_config.gcode_flavor, m_current_fan_speed));
                 fan_speed_change_requests[CoolingLine::TYPE_FORCE_RESUME_FAN] = false;
             }
             else
-                new_gcode += GCodeWriter::set_fan(m_config.gcode_flavor, m_fan_speed);
+                new_gcode.append(GCodeWriter::set_fan(m_config.gcode_flavor, m_fan_speed));
             need_set_fan = false;
         }
         pos = line_end;
     }
     const char *gcode_end = gcode.c_str() + gcode.size();
     if (pos < gcode_end)
-        new_gcode.append(pos, gcode_end - pos);
+        append_source_lines(pos, gcode_end);
 
-    return new_gcode;
+    return new_gcode.finalize();
 }
 
 } // namespace Slic3r
@@ -2,8 +2,11 @@
 #define slic3r_CoolingBuffer_hpp_
 
 #include "../libslic3r.h"
+#include "GCodeMoves.hpp"
+#include <array>
 #include <map>
 #include <string>
+#include <vector>
 #include <cfloat>
 
 namespace Slic3r {
@@ -15,6 +18,8 @@ struct PerExtruderAdjustments;
 // A standalone G-code filter, to control cooling of the print.
 // The G-code is processed per layer. Once a layer is collected, fan start / stop commands are edited
 // and the print is modified to stretch over a minimum layer time.
+// The G-code snippets of a layer (the support layers preceding an object layer) are parsed as they arrive,
+// the slow down and the fan control are applied once the last snippet of the layer is received.
 //
 // The simple it sounds, the actual implementation is significantly more complex.
 // Namely, for a multi-extruder print, each material may require a different cooling logic.
@@ -24,24 +29,34 @@ struct PerExtruderAdjustments;
 class CoolingBuffer {
 public:
     CoolingBuffer(GCode &gcodegen);
+    ~CoolingBuffer();
     void        reset(const Vec3d &position);
     void        set_current_extruder(unsigned int extruder_id) { m_current_extruder = extruder_id; }
-    std::string process_layer(std::string &&gcode, size_t layer_id, bool flush);
+    // Keep running time totals while parsing and solve the slow down of the extruders in a closed form,
+    // instead of summing the lines and iterating the common feedrate at the end of each layer.
+    void        set_analytic_slowdown(bool analytic) { m_analytic_slowdown = analytic; }
+    // If moves is set, it holds the typed moves of gcode, which are not parsed again. It is replaced by the typed moves
+    // of the G-code returned.
+    std::string process_layer(std::string &&gcode, size_t layer_id, bool flush, GCodeMoves *moves = nullptr);
 
 private:
 	CoolingBuffer& operator=(const CoolingBuffer&) = delete;
-    std::vector<PerExtruderAdjustments> parse_layer_gcode(const std::string &gcode, std::vector<float> &current_pos) const;
+    // Parse the lines of m_gcode following m_parsed_end into m_per_extruder_adjustments.
+    // Unless flush is set, a trailing incomplete line is left for the next snippet.
+    void        parse_layer_gcode(bool flush);
     float       calculate_layer_slowdown(std::vector<PerExtruderAdjustments> &per_extruder_adjustments);
     // Apply slow down over G-code lines stored in per_extruder_adjustments, enable fan if needed.
-    // Returns the adjusted G-code.
-    std::string apply_layer_cooldown(const std::string &gcode, size_t layer_id, float layer_time, std::vector<PerExtruderAdjustments> &per_extruder_adjustments);
+    // Returns the adjusted G-code, edited in place of the source G-code, and the typed moves of m_moves, which made it to the adjusted G-code.
+    std::string apply_layer_cooldown(std::string &&gcode, size_t layer_id, float layer_time, std::vector<PerExtruderAdjustments> &per_extruder_adjustments, GCodeMoves &moves_out);
 
     // G-code snippet cached for the support layers preceding an object layer.
     std::string                 m_gcode;
+    // Typed moves of m_gcode.
+    GCodeMoves                  m_moves;
     // Internal data.
     // BBS: X,Y,Z,E,F,I,J
     std::vector<char>           m_axis;
-    std::vector<float>          m_current_pos;
+    std::array<float, 7>        m_current_pos;
     // Current known fan speed or -1 if not known yet.
     int                         m_fan_speed;
     int                         m_additional_fan_speed;
@@ -57,6 +72,22 @@ private:
     unsigned int                m_current_extruder;
     //BBS: current fan speed
     int                         m_current_fan_speed;
+
+    // Lines of m_gcode parsed so far, bucketed by an extruder.
+    std::vector<PerExtruderAdjustments> m_per_extruder_adjustments;
+    std::vector<size_t>         m_map_extruder_to_per_extruder_adjustment;
+    // State of the parser carried over to the next snippet of the layer.
+    // End of the parsed part of m_gcode, at a line boundary.
+    size_t                      m_parsed_end { 0 };
+    // Index of the first move of m_moves following m_parsed_end.
+    size_t                      m_parsed_move { 0 };
+    unsigned int                m_parser_extruder { 0 };
+    // Index of an existing CoolingLine of the current adjustment, which holds the feedrate setting command
+    // for a sequence of extrusion moves.
+    size_t                      m_active_speed_modifier { size_t(-1) };
+    // Orca: Whether we had our first extrusion in this layer.
+    bool                        m_layer_had_extrusion { false };
+    bool                        m_analytic_slowdown { false };
 };
 
 }
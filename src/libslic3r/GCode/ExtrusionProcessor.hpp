@@ -309,6 +309,19 @@ public:
         next_curled_extrusions[object] = AABBTreeLines::LinesDistancer<CurledLine>{layer->curled_lines};
     }
 
+    // Takes over the layers of the objects other was prepared for, e.g. by a copy of the G-code generator, which generated
+    // a layer ahead of the serial G-code generation.
+    void continue_from(ExtrusionQualityEstimator &&other)
+    {
+        for (auto &[object, boundaries] : other.next_layer_boundaries) {
+            prev_layer_boundaries[object]  = std::move(other.prev_layer_boundaries[object]);
+            next_layer_boundaries[object]  = std::move(boundaries);
+            prev_curled_extrusions[object] = std::move(other.prev_curled_extrusions[object]);
+            next_curled_extrusions[object] = std::move(other.next_curled_extrusions[object]);
+        }
+        current_object = other.current_object;
+    }
+
     std::vector<ProcessedPoint> estimate_extrusion_quality(const ExtrusionPath                &path,
                                                            const ConfigOptionPercents         &overlaps,
                                                            const ConfigOptionFloatsOrPercents &speeds,
@@ -19,7 +19,7 @@
 
 namespace Slic3r {
 
-const std::string& FanMover::process_gcode(const std::string& gcode, bool flush)
+const std::string& FanMover::process_gcode(const std::string& gcode, bool flush, const GCodeMoves *moves)
 {
     m_process_output = "";
 
@@ -27,9 +27,23 @@ const std::string& FanMover::process_gcode(const std::string& gcode, bool flush)
     m_buffer_time_size = 0;
     for (auto& data : m_buffer) m_buffer_time_size += data.time;
 
-    if(!gcode.empty())
-        m_parser.parse_buffer(gcode,
-            [this](GCodeReader& reader, const GCodeReader::GCodeLine& line) { /*m_process_output += line.raw() + "\n";*/ this->_process_gcode_line(reader, line); });
+    auto process_line = [this](GCodeReader& reader, const GCodeReader::GCodeLine& line) { /*m_process_output += line.raw() + "\n";*/ this->_process_gcode_line(reader, line); };
+    if (moves == nullptr || moves->empty()) {
+        if (!gcode.empty())
+            m_parser.parse_buffer(gcode, process_line);
+    } else {
+        const char *begin = gcode.c_str();
+        const char *end   = begin + gcode.size();
+        auto        it_move = moves->begin();
+        GCodeReader::GCodeLine gline;
+        for (const char *ptr = begin; *ptr != 0;) {
+            gline.reset();
+            if (it_move != moves->end() && it_move->line_start == size_t(ptr - begin))
+                ptr = m_parser.parse_move(*it_move ++, ptr, gline, process_line);
+            else
+                ptr = m_parser.parse_line(ptr, end, gline, process_line);
+        }
+    }
 
     if (flush) {
         while (!m_buffer.empty()) {
@@ -69,8 +69,9 @@ public:
         m_parser.apply_config(writer.config);
     }
 
-    // Adds the gcode contained in the given string to the analysis and returns it after removing the workcodes
-    const std::string& process_gcode(const std::string& gcode, bool flush);
+    // Adds the gcode contained in the given string to the analysis and returns it after removing the workcodes.
+    // The lines with a typed move in moves are not parsed again.
+    const std::string& process_gcode(const std::string& gcode, bool flush, const GCodeMoves *moves = nullptr);
 
 private:
     BufferData& put_in_buffer(BufferData&& data) {
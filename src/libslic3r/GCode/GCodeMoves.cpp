@@ -0,0 +1,48 @@
+#include "GCodeMoves.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Slic3r {
+
+void GCodeMoveRecorder::record(const GCodeMove &move, const char *line_begin, const char *line_end)
+{
+    GCodeMove &recorded = m_moves.emplace_back(move);
+    recorded.line_start = m_text.size();
+    m_text.append(line_begin, line_end);
+    recorded.line_end   = m_text.size();
+}
+
+void GCodeMoveRecorder::append(const GCodeMoveRecorder &rhs)
+{
+    m_moves.reserve(m_moves.size() + rhs.m_moves.size());
+    append_moves(m_moves, rhs.m_moves.begin(), rhs.m_moves.end(), 0, m_text.size());
+    m_text += rhs.m_text;
+}
+
+GCodeMoves GCodeMoveRecorder::bind(const std::string &gcode) const
+{
+    // How many recorded moves may be missing from gcode in a row, before a line of gcode is considered not recorded.
+    static constexpr const size_t max_moves_skipped = 16;
+
+    GCodeMoves out;
+    out.reserve(m_moves.size());
+    size_t idx_move = 0;
+    for (size_t line_start = 0; line_start < gcode.size() && idx_move < m_moves.size();) {
+        const char *newline  = static_cast<const char*>(memchr(gcode.data() + line_start, '\n', gcode.size() - line_start));
+        size_t      line_end = newline ? newline - gcode.data() + 1 : gcode.size();
+        std::string_view line(gcode.data() + line_start, line_end - line_start);
+        for (size_t i = idx_move; i < std::min(idx_move + max_moves_skipped + 1, m_moves.size()); ++ i)
+            if (this->text(m_moves[i]) == line) {
+                GCodeMove &move = out.emplace_back(m_moves[i]);
+                move.line_start = line_start;
+                move.line_end   = line_end;
+                idx_move = i + 1;
+                break;
+            }
+        line_start = line_end;
+    }
+    return out;
+}
+
+} // namespace Slic3r
@@ -0,0 +1,79 @@
+#ifndef slic3r_GCode_GCodeMoves_hpp_
+#define slic3r_GCode_GCodeMoves_hpp_
+
+#include "../libslic3r.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Slic3r {
+
+// Typed content of a G0 / G1 / G2 / G3 line formatted by GCodeWriter, so that the G-code filters
+// (CoolingBuffer, FanMover) do not need to parse the line again.
+struct GCodeMove
+{
+    enum Type : uint8_t {
+        G0,
+        G1,
+        G2,
+        G3,
+    };
+
+    bool  has(Axis axis) const { return (this->mask & (1 << int(axis))) != 0; }
+    float value(Axis axis) const { return this->axis[int(axis)]; }
+
+    Type     type { G1 };
+    // Axes present at the line, bits indexed by Axis, the same as GCodeReader::GCodeLine does.
+    uint32_t mask { 0 };
+    // Values of the axes, as a G-code parser reads them back from the text of the line.
+    float    axis[NUM_AXES];
+    // The line in the G-code, line_end past the trailing newline.
+    size_t   line_start { 0 };
+    size_t   line_end { 0 };
+};
+
+// Typed moves of the G-code of a layer, sorted by line_start. The G-code lines without a typed move,
+// such as the custom G-code or the G-code lines edited after being formatted, are parsed by the filters.
+using GCodeMoves = std::vector<GCodeMove>;
+
+// Moves recorded by GCodeWriter as they are formatted, together with their text,
+// to be bound to the G-code of a layer once the G-code is assembled by GCode::process_layer().
+class GCodeMoveRecorder
+{
+public:
+    void   clear() { m_moves.clear(); m_text.clear(); }
+    bool   empty() const { return m_moves.empty(); }
+    size_t size() const { return m_moves.size(); }
+
+    // Record a formatted line including the trailing newline.
+    void   record(const GCodeMove &move, const char *line_begin, const char *line_end);
+    // Append the moves recorded by another recorder.
+    void   append(const GCodeMoveRecorder &rhs);
+
+    // Find the recorded moves at the lines of gcode in the order they were recorded. Moves formatted, but dropped
+    // or edited before they reached gcode, are skipped. The other lines of gcode are left without a typed move.
+    GCodeMoves bind(const std::string &gcode) const;
+
+private:
+    std::string_view text(const GCodeMove &move) const
+        { return std::string_view(m_text.data() + move.line_start, move.line_end - move.line_start); }
+
+    // line_start, line_end index m_text.
+    std::vector<GCodeMove> m_moves;
+    std::string            m_text;
+};
+
+// Copy the typed moves of a G-code range starting at src_begin, which was copied to dst_begin.
+inline void append_moves(GCodeMoves &dst, GCodeMoves::const_iterator begin, GCodeMoves::const_iterator end, size_t src_begin, size_t dst_begin)
+{
+    for (auto it = begin; it != end; ++ it) {
+        GCodeMove &move = dst.emplace_back(*it);
+        move.line_start = move.line_start - src_begin + dst_begin;
+        move.line_end   = move.line_end   - src_begin + dst_begin;
+    }
+}
+
+} // namespace Slic3r
+
+#endif // slic3r_GCode_GCodeMoves_hpp_
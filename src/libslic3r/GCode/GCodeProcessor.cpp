@@ -17,6 +17,8 @@
 
 #include <fast_float/fast_float.h>
 
+#include <tbb/parallel_for.h>
+
 #include <float.h>
 #include <assert.h>
 #include <regex>
@@ -404,6 +406,38 @@ void GCodeProcessor::TimeProcessor::reset()
     machines[static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Normal)].enabled = true;
 }
 
+void GCodeProcessor::TimeProcessor::refresh_planners()
+{
+    this->calculate_time(Planner::refresh_threshold + 1, Planner::queue_size, 0.0f);
+}
+
+void GCodeProcessor::TimeProcessor::simulate_st_synchronize(float additional_time)
+{
+    this->calculate_time(0, 0, additional_time);
+}
+
+void GCodeProcessor::TimeProcessor::calculate_time(size_t min_blocks, size_t keep_last_n_blocks, float additional_time)
+{
+    std::array<TimeMachine*, static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count)> pending;
+    size_t num_pending = 0;
+    size_t max_blocks  = 0;
+    for (TimeMachine &machine : machines)
+        if (machine.enabled && machine.blocks.size() >= min_blocks) {
+            pending[num_pending ++] = &machine;
+            max_blocks = std::max(max_blocks, machine.blocks.size());
+        }
+
+    // The machines of the different time modes share no state, each of them processes its own blocks in the same order
+    // as if run one after the other, thus the estimates do not change. Short queues are not worth spawning a task.
+    if (num_pending > 1 && max_blocks >= Planner::queue_size)
+        tbb::parallel_for(size_t(0), num_pending, [&pending, keep_last_n_blocks, additional_time](size_t i) {
+            pending[i]->calculate_time(keep_last_n_blocks, additional_time);
+        });
+    else
+        for (size_t i = 0; i < num_pending; ++ i)
+            pending[i]->calculate_time(keep_last_n_blocks, additional_time);
+}
+
 void GCodeProcessor::UsedFilaments::reset()
 {
     color_change_cache = 0.0f;
@@ -557,6 +591,7 @@ void GCodeProcessorResult::reset() {
     lock();
 
     moves = std::vector<GCodeProcessorResult::MoveVertex>();
+    arc_interpolation_points = std::vector<Vec3f>();
     printable_area = Pointfs();
     //BBS: add bed exclude area
     bed_exclude_area = Pointfs();
@@ -584,6 +619,7 @@ void GCodeProcessorResult::reset() {
     lock();
 
     moves.clear();
+    arc_interpolation_points.clear();
     lines_ends.clear();
     printable_area = Pointfs();
     //BBS: add bed exclude area
@@ -1184,6 +1220,7 @@ void GCodeProcessor::reset()
     m_used_filaments.reset();
 
     m_result.reset();
+    m_in_place_post_process.reset();
     m_result.id = ++s_result_id;
 
     m_last_default_color_id = 0;
@@ -1300,6 +1337,8 @@ void GCodeProcessor::initialize(const std::string& filename)
 
 void GCodeProcessor::process_buffer(const std::string &buffer)
 {
+    if (m_in_place_post_process.enabled)
+        m_in_place_post_process.append(buffer);
     //FIXME maybe cache GCodeLine gline to be over multiple parse_buffer() invocations.
     m_parser.parse_buffer(buffer, [this](GCodeReader&, const GCodeReader::GCodeLine& line) { 
         this->process_gcode_line(line, false);
@@ -1317,10 +1356,10 @@ void GCodeProcessor::finalize(bool post_process)
     }
 
     // process the time blocks
+    m_time_processor.simulate_st_synchronize();
     for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count); ++i) {
         TimeMachine& machine = m_time_processor.machines[i];
         TimeMachine::CustomGCodeTime& gcode_time = machine.gcode_time;
-        machine.calculate_time();
         if (gcode_time.needed && gcode_time.cache != 0.0f)
             gcode_time.times.push_back({ CustomGCode::ColorChange, gcode_time.cache });
     }
@@ -1456,6 +1495,45 @@ std::vector<float> GCodeProcessor::get_layers_time(PrintEstimatedStatistics::ETi
         std::vector<float>();
 }
 
+std::vector<std::string> GCodeProcessor::layer_change_progress_lines() const
+{
+    std::vector<std::string> out;
+    if (m_disable_m73)
+        return out;
+
+    auto time_in_minutes = [](float time_in_seconds) { return int((time_in_seconds + 0.5f) / 60.0f); };
+    char line_M73[64];
+    for (const TimeMachine& machine : m_time_processor.machines) {
+        if (!machine.enabled || machine.time <= 0.0f)
+            continue;
+        // The time of the G-code preceding the first layer change is accounted to the first layer.
+        out.resize(std::max(out.size(), machine.layers_time.size()));
+        // The first line placeholder exports the progress at the start of the print.
+        std::pair<int, int> last_exported_main = { 0, time_in_minutes(machine.time) };
+        int                 last_exported_stop = time_in_minutes(machine.time);
+        float               elapsed_time       = 0.0f;
+        for (size_t layer_id = 0; layer_id < machine.layers_time.size(); elapsed_time += machine.layers_time[layer_id ++]) {
+            const std::pair<int, int> to_export_main = { int(100.0f * elapsed_time / machine.time), time_in_minutes(machine.time - elapsed_time) };
+            if (to_export_main != last_exported_main) {
+                sprintf(line_M73, machine.line_m73_main_mask.c_str(), std::to_string(to_export_main.first).c_str(), std::to_string(to_export_main.second).c_str());
+                out[layer_id] += line_M73;
+                last_exported_main = to_export_main;
+            }
+            auto it_stop = std::upper_bound(machine.stop_times.begin(), machine.stop_times.end(), elapsed_time,
+                [](float value, const TimeMachine::StopTime& t) { return value < t.elapsed_time; });
+            if (it_stop != machine.stop_times.end()) {
+                const int to_export_stop = time_in_minutes(it_stop->elapsed_time - elapsed_time);
+                if (to_export_stop != last_exported_stop) {
+                    sprintf(line_M73, machine.line_m73_stop_mask.c_str(), std::to_string(to_export_stop).c_str());
+                    out[layer_id] += line_M73;
+                    last_exported_stop = to_export_stop;
+                }
+            }
+        }
+    }
+    return out;
+}
+
 void GCodeProcessor::apply_config_simplify3d(const std::string& filename)
 {
     struct BedSize
@@ -1753,7 +1831,7 @@ void GCodeProcessor::process_gcode_line(const GCodeReader::GCodeLine& line, bool
         }
     }
     else {
-        const std::string &comment = line.raw();
+        const std::string_view comment = line.raw_view();
         if (comment.length() > 2 && comment.front() == ';')
             // Process tags embedded into comments. Tag comments always start at the start of a line
             // with a comment and continue with a tag without any whitespace separator.
@@ -2949,11 +3027,10 @@ void GCodeProcessor::process_G1(const GCodeReader::GCodeLine& line, const std::o
         prev = curr;
 
         blocks.push_back(block);
-
-        if (blocks.size() > TimeProcessor::Planner::refresh_threshold)
-            machine.calculate_time(TimeProcessor::Planner::queue_size);
     }
 
+    m_time_processor.refresh_planners();
+
     const Vec3f plate_offset = {(float) m_x_offset, (float) m_y_offset, 0.0f};
 
     if (m_seams_detector.is_active()) {
@@ -3384,11 +3461,10 @@ void  GCodeProcessor::process_G2_G3(const GCodeReader::GCodeLine& line)
         prev = curr;
 
         blocks.push_back(block);
-
-        if (blocks.size() > TimeProcessor::Planner::refresh_threshold)
-            machine.calculate_time(TimeProcessor::Planner::queue_size);
     }
 
+    m_time_processor.refresh_planners();
+
     //BBS: seam detector
     Vec3f plate_offset = {(float) m_x_offset, (float) m_y_offset, 0.0f};
 
@@ -4024,17 +4100,122 @@ static void update_lines_ends_and_out_file_pos(const std::string& out_string, st
         *out_file_pos += out_string.size();
 }
 
-void GCodeProcessor::run_post_process()
+// Returns true for the lines replaced by run_post_process() with the statistics: the placeholders, possibly padded with spaces,
+// and the filament statistics.
+static bool is_post_processed_statistics_line(std::string_view line)
 {
-    FilePtr in{ boost::nowide::fopen(m_result.filename.c_str(), "rb") };
-    if (in.f == nullptr)
-        throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nCannot open file for reading.\n"));
+    // Prefilter for parsing speed.
+    if (line.size() < 3 || line.front() != ';')
+        return false;
+    if (line[1] == ' ')
+        return boost::algorithm::starts_with(line, PrintStatistics::FilamentUsedMmMask) ||
+               boost::algorithm::starts_with(line, PrintStatistics::FilamentUsedGMask) ||
+               boost::algorithm::starts_with(line, PrintStatistics::TotalFilamentUsedGMask) ||
+               boost::algorithm::starts_with(line, PrintStatistics::FilamentUsedCm3Mask) ||
+               boost::algorithm::starts_with(line, PrintStatistics::FilamentCostMask) ||
+               boost::algorithm::starts_with(line, PrintStatistics::TotalFilamentCostMask);
+    // remove leading ';' and trailing '\n' and padding
+    line.remove_prefix(1);
+    while (! line.empty() && (line.back() == '\n' || line.back() == '\r' || line.back() == ' '))
+        line.remove_suffix(1);
+    return line == GCodeProcessor::reserved_tag(GCodeProcessor::ETags::First_Line_M73_Placeholder) ||
+           line == GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Last_Line_M73_Placeholder) ||
+           line == GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Estimated_Printing_Time_Placeholder) ||
+           line == GCodeProcessor::reserved_tag(GCodeProcessor::ETags::Total_Layer_Number_Placeholder);
+}
+
+void GCodeProcessor::InPlacePostProcess::append(const std::string& buffer)
+{
+    size_t line_begin = 0;
+    for (size_t line_end = buffer.find('\n'); line_end != std::string::npos; line_end = buffer.find('\n', line_begin)) {
+        std::string_view line(buffer.data() + line_begin, line_end + 1 - line_begin);
+        if (! partial_line.empty()) {
+            partial_line += line;
+            line = partial_line;
+        }
+        if (is_post_processed_statistics_line(line))
+            patched_lines.emplace_back(lines_ends.size());
+        lines_ends.emplace_back(file_size + line_end + 1);
+        partial_line.clear();
+        line_begin = line_end + 1;
+    }
+    partial_line.append(buffer, line_begin, std::string::npos);
+    file_size += buffer.size();
+}
 
+bool GCodeProcessor::patch_in_place(const std::function<bool(std::string&, std::string&)>& replace_line)
+{
+    const InPlacePostProcess& layout = m_in_place_post_process;
+    if (! layout.partial_line.empty())
+        return false;
+
+    boost::nowide::fstream file(m_result.filename, std::ios::in | std::ios::out | std::ios::binary);
+    if (! file.is_open() || ! file.seekg(0, std::ios::end) || size_t(file.tellg()) != layout.file_size)
+        return false;
+
+    // Produce all the replacements first, the file is only modified if all of them fit into the lines reserved for them.
+    std::vector<std::string> replacements(layout.patched_lines.size());
+    std::string              line;
+    for (size_t i = 0; i < layout.patched_lines.size(); ++ i) {
+        const size_t line_id    = layout.patched_lines[i];
+        const size_t line_begin = line_id == 0 ? 0 : layout.lines_ends[line_id - 1];
+        line.assign(layout.lines_ends[line_id] - line_begin, ' ');
+        if (! file.seekg(line_begin) || ! file.read(line.data(), line.size()) || ! is_post_processed_statistics_line(line))
+            return false;
+        std::string& replacement = replacements[i];
+        if (! replace_line(line, replacement))
+            replacement = line;
+        else if (replacement.empty())
+            replacement = "\n";
+        assert(replacement.back() == '\n');
+        if (replacement.size() > line.size())
+            return false;
+        // Pad the last line with spaces to the size of the line being replaced.
+        replacement.insert(replacement.size() - 1, line.size() - replacement.size(), ' ');
+    }
+
+    for (size_t i = 0; i < layout.patched_lines.size(); ++ i) {
+        const size_t line_id = layout.patched_lines[i];
+        if (! file.seekp(line_id == 0 ? 0 : layout.lines_ends[line_id - 1]) || ! file.write(replacements[i].data(), replacements[i].size()))
+            throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nIs the disk full?"));
+    }
+    file.close();
+    if (file.fail())
+        throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nIs the disk full?"));
+
+    // The replacements may span multiple lines, update the ends of the lines and the lines of the moves, which are 1 based.
+    m_result.lines_ends.clear();
+    m_result.lines_ends.reserve(layout.lines_ends.size() + layout.patched_lines.size());
+    std::vector<std::pair<size_t, size_t>> lines_map; // <first original line id after a patched line, lines added so far>
+    size_t next_line_id = 0;
+    size_t added_lines  = 0;
+    for (size_t i = 0; i < layout.patched_lines.size(); ++ i) {
+        const size_t line_id  = layout.patched_lines[i];
+        size_t       file_pos = line_id == 0 ? 0 : layout.lines_ends[line_id - 1];
+        m_result.lines_ends.insert(m_result.lines_ends.end(), layout.lines_ends.begin() + next_line_id, layout.lines_ends.begin() + line_id);
+        const size_t lines_count = m_result.lines_ends.size();
+        update_lines_ends_and_out_file_pos(replacements[i], m_result.lines_ends, &file_pos);
+        added_lines += m_result.lines_ends.size() - lines_count - 1;
+        next_line_id = line_id + 1;
+        lines_map.push_back({ next_line_id + 1, added_lines });
+    }
+    m_result.lines_ends.insert(m_result.lines_ends.end(), layout.lines_ends.begin() + next_line_id, layout.lines_ends.end());
+
+    if (added_lines > 0) {
+        for (GCodeProcessorResult::MoveVertex& move : m_result.moves) {
+            auto it = std::upper_bound(lines_map.begin(), lines_map.end(), move.gcode_id,
+                [](size_t gcode_id, const std::pair<size_t, size_t>& item) { return gcode_id < item.first; });
+            if (it != lines_map.begin())
+                move.gcode_id += std::prev(it)->second;
+        }
+    }
+    return true;
+}
+
+void GCodeProcessor::run_post_process()
+{
     // temporary file to contain modified gcode
     std::string out_path = m_result.filename + ".postprocess";
-    FilePtr out{ boost::nowide::fopen(out_path.c_str(), "wb") };
-    if (out.f == nullptr)
-        throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nCannot open file for writing.\n"));
 
     std::vector<double> filament_mm(m_result.extruders_count, 0.0);
     std::vector<double> filament_cm3(m_result.extruders_count, 0.0);
@@ -4401,13 +4582,15 @@ void GCodeProcessor::run_post_process()
     ExportLines export_lines(m_result.backtrace_enabled ? ExportLines::EWriteType::ByTime : ExportLines::EWriteType::BySize,
         m_time_processor.machines);
 
-    // replace placeholder lines with the proper final value
+    // replace placeholder lines with the proper final value passed to append_line
     // gcode_line is in/out parameter, to reduce expensive memory allocation
-    auto process_placeholders = [&](std::string& gcode_line) {
+    auto process_placeholders = [&](std::string& gcode_line, auto&& append_line) {
         bool processed = false;
 
-        // remove trailing '\n'
+        // remove trailing '\n' and the padding reserving room for patching the line in place
         auto line = std::string_view(gcode_line).substr(0, gcode_line.length() - 1);
+        while (!line.empty() && line.back() == ' ')
+            line.remove_suffix(1);
 
         if (line.length() > 1) {
             line = line.substr(1);
@@ -4417,7 +4600,7 @@ void GCodeProcessor::run_post_process()
                     const TimeMachine& machine = m_time_processor.machines[i];
                     if (machine.enabled) {
                         // export pair <percent, remaining time>
-                        export_lines.append_line(format_line_M73_main(machine.line_m73_main_mask.c_str(),
+                        append_line(format_line_M73_main(machine.line_m73_main_mask.c_str(),
                             (line == reserved_tag(ETags::First_Line_M73_Placeholder)) ? 0 : 100,
                             (line == reserved_tag(ETags::First_Line_M73_Placeholder)) ? time_in_minutes(machine.time) : 0));
                         processed = true;
@@ -4425,7 +4608,7 @@ void GCodeProcessor::run_post_process()
                         // export remaining time to next printer stop
                         if (line == reserved_tag(ETags::First_Line_M73_Placeholder) && !machine.stop_times.empty()) {
                             const int to_export_stop = time_in_minutes(machine.stop_times.front().elapsed_time);
-                            export_lines.append_line(format_line_M73_stop_int(machine.line_m73_stop_mask.c_str(), to_export_stop));
+                            append_line(format_line_M73_stop_int(machine.line_m73_stop_mask.c_str(), to_export_stop));
                             last_exported_stop[i] = to_export_stop;
                         }
                     }
@@ -4445,7 +4628,7 @@ void GCodeProcessor::run_post_process()
                             sprintf(buf, "; model printing time: %s; total estimated time: %s\n",
                                     get_time_dhms(machine.time - machine.prepare_time).c_str(), get_time_dhms(machine.time).c_str());
                         }
-                        export_lines.append_line(buf);
+                        append_line(buf);
                     }
                 }
                 for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count); ++i) {
@@ -4456,7 +4639,7 @@ void GCodeProcessor::run_post_process()
                         sprintf(buf, "; estimated first layer printing time (%s mode) = %s\n",
                                 (mode == PrintEstimatedStatistics::ETimeMode::Normal) ? "normal" : "silent",
                                 get_time_dhms(machine.prepare_time).c_str());
-                        export_lines.append_line(buf);
+                        append_line(buf);
                         processed = true;
                     }
                 }
@@ -4465,7 +4648,7 @@ void GCodeProcessor::run_post_process()
             else if (line == reserved_tag(ETags::Total_Layer_Number_Placeholder)) {
                 char buf[128];
                 sprintf(buf, "; total layer number: %u\n", m_layer_id);
-                export_lines.append_line(buf);
+                append_line(buf);
                 processed = true;
             }
         }
@@ -4667,6 +4850,30 @@ void GCodeProcessor::run_post_process()
         }
     };
 
+    if (m_in_place_post_process.enabled && !m_result.backtrace_enabled &&
+        // process_line_G1() exports no M73 lines
+        (m_in_place_post_process.progress_written ||
+         std::none_of(m_time_processor.machines.begin(), m_time_processor.machines.end(),
+            [this](const TimeMachine& machine) { return machine.enabled && (!m_disable_m73 || !machine.stop_times.empty()); })) &&
+        patch_in_place([&](std::string& gcode_line, std::string& replacement) {
+            if (process_placeholders(gcode_line, [&replacement](const std::string& line) { replacement += line; }))
+                return true;
+            if (process_used_filament(gcode_line)) {
+                replacement = gcode_line;
+                return true;
+            }
+            return false;
+        }))
+        return;
+
+    FilePtr in{ boost::nowide::fopen(m_result.filename.c_str(), "rb") };
+    if (in.f == nullptr)
+        throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nCannot open file for reading.\n"));
+
+    FilePtr out{ boost::nowide::fopen(out_path.c_str(), "wb") };
+    if (out.f == nullptr)
+        throw Slic3r::RuntimeError(std::string("GCode processor post process export failed.\nCannot open file for writing.\n"));
+
     m_result.lines_ends.clear();
     // m_result.lines_ends.emplace_back(std::vector<size_t>());
 
@@ -4711,7 +4918,7 @@ void GCodeProcessor::run_post_process()
                     ++line_id;
                     const unsigned int internal_g1_lines_counter = export_lines.update(gcode_line, line_id, g1_lines_counter);
                     // replace placeholder lines
-                    bool processed = process_placeholders(gcode_line);
+                    bool processed = process_placeholders(gcode_line, [&export_lines](const std::string& line) { export_lines.append_line(line); });
                     if (processed)
                         gcode_line.clear();
                     if (!processed)
@@ -4719,14 +4926,17 @@ void GCodeProcessor::run_post_process()
                     if (!processed && !is_temporary_decoration(gcode_line)) {
                         if (GCodeReader::GCodeLine::cmd_is(gcode_line, "G0") || GCodeReader::GCodeLine::cmd_is(gcode_line, "G1")) {
                             export_lines.append_line(gcode_line);
-                            // add lines M73 where needed
-                            process_line_G1(g1_lines_counter++);
+                            // add lines M73 where needed, unless written with the G-code
+                            if (!m_in_place_post_process.progress_written)
+                                process_line_G1(g1_lines_counter);
+                            ++g1_lines_counter;
                             gcode_line.clear();
                         }
                         else if (GCodeReader::GCodeLine::cmd_is(gcode_line, "G2") || GCodeReader::GCodeLine::cmd_is(gcode_line, "G3")) {
                             export_lines.append_line(gcode_line);
-                            // add lines M73 where needed
-                            process_line_G1(g1_lines_counter + internal_g1_lines_counter);
+                            // add lines M73 where needed, unless written with the G-code
+                            if (!m_in_place_post_process.progress_written)
+                                process_line_G1(g1_lines_counter + internal_g1_lines_counter);
                             g1_lines_counter += (1 + internal_g1_lines_counter);
                             gcode_line.clear();
                         }
@@ -4772,14 +4982,17 @@ void GCodeProcessor::store_move_vertex(EMoveType type, EMovePathType path_type)
         ((type == EMoveType::Seam) ? m_last_line_id : m_line_id);
 
     //BBS: apply plate's and extruder's offset to arc interpolation points
+    const uint32_t interpolation_points_begin = uint32_t(m_result.arc_interpolation_points.size());
+    uint32_t       interpolation_points_count = 0;
     if (path_type == EMovePathType::Arc_move_cw ||
         path_type == EMovePathType::Arc_move_ccw) {
         for (size_t i = 0; i < m_interpolation_points.size(); i++)
-            m_interpolation_points[i] =
+            m_result.arc_interpolation_points.emplace_back(
                 Vec3f(m_interpolation_points[i].x() + m_x_offset,
                       m_interpolation_points[i].y() + m_y_offset,
                       m_processing_start_custom_gcode ? m_first_layer_height : m_interpolation_points[i].z()) +
-                m_extruder_offsets[m_extruder_id];
+                m_extruder_offsets[m_extruder_id]);
+        interpolation_points_count = uint32_t(m_interpolation_points.size());
     }
 
     m_result.moves.push_back({
@@ -4803,7 +5016,8 @@ void GCodeProcessor::store_move_vertex(EMoveType type, EMovePathType path_type)
         //BBS: add arc move related data
         path_type,
         Vec3f(m_arc_center(0, 0) + m_x_offset, m_arc_center(1, 0) + m_y_offset, m_arc_center(2, 0)) + m_extruder_offsets[m_extruder_id],
-        m_interpolation_points,
+        interpolation_points_begin,
+        interpolation_points_count,
     });
 
     if (type == EMoveType::Seam) {
@@ -4958,6 +5172,9 @@ int GCodeProcessor::get_filament_vitrification_temperature(size_t extrude_id)
 
 void GCodeProcessor::process_custom_gcode_time(CustomGCode::Type code)
 {
+    //FIXME this simulates st_synchronize! is it correct?
+    // The estimated time may be longer than the real print time.
+    m_time_processor.simulate_st_synchronize();
     for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count); ++i) {
         TimeMachine& machine = m_time_processor.machines[i];
         if (!machine.enabled)
@@ -4965,9 +5182,6 @@ void GCodeProcessor::process_custom_gcode_time(CustomGCode::Type code)
 
         TimeMachine::CustomGCodeTime& gcode_time = machine.gcode_time;
         gcode_time.needed = true;
-        //FIXME this simulates st_synchronize! is it correct?
-        // The estimated time may be longer than the real print time.
-        machine.simulate_st_synchronize();
         if (gcode_time.cache != 0.0f) {
             gcode_time.times.push_back({ code, gcode_time.cache });
             gcode_time.cache = 0.0f;
@@ -4991,9 +5205,7 @@ void GCodeProcessor::process_filaments(CustomGCode::Type code)
 
 void GCodeProcessor::simulate_st_synchronize(float additional_time)
 {
-    for (size_t i = 0; i < static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count); ++i) {
-        m_time_processor.machines[i].simulate_st_synchronize(additional_time);
-    }
+    m_time_processor.simulate_st_synchronize(additional_time);
 }
 
 void GCodeProcessor::update_estimated_times_stats()
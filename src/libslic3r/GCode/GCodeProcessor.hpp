@@ -172,12 +172,15 @@ class Print;
             //BBS: arc move related data
             EMovePathType move_path_type{ EMovePathType::Noop_move };
             Vec3f arc_center_position{ Vec3f::Zero() };      // mm
-            std::vector<Vec3f> interpolation_points;     // interpolation points of arc for drawing
+            // Interpolation points of arc for drawing, stored as a range of GCodeProcessorResult::arc_interpolation_points
+            // so that millions of moves do not each own a small heap allocation.
+            uint32_t interpolation_points_begin{ 0 };
+            uint32_t interpolation_points_count{ 0 };
 
             float volumetric_rate() const { return feedrate * mm3_per_mm; }
             //BBS: new function to support arc move
             bool is_arc_move_with_interpolation_points() const {
-                return (move_path_type == EMovePathType::Arc_move_ccw || move_path_type == EMovePathType::Arc_move_cw) && interpolation_points.size();
+                return (move_path_type == EMovePathType::Arc_move_ccw || move_path_type == EMovePathType::Arc_move_cw) && interpolation_points_count > 0;
             }
             bool is_arc_move() const {
                 return move_path_type == EMovePathType::Arc_move_ccw || move_path_type == EMovePathType::Arc_move_cw;
@@ -191,9 +194,24 @@ class Print;
             std::vector<std::string> params;    // extra msg info
         };
 
+        // Read only view of the interpolation points of a single arc move.
+        struct InterpolationPoints
+        {
+            const Vec3f *first{ nullptr };
+            size_t       count{ 0 };
+
+            size_t       size() const { return count; }
+            bool         empty() const { return count == 0; }
+            const Vec3f& operator[](size_t idx) const { assert(idx < count); return first[idx]; }
+            const Vec3f* begin() const { return first; }
+            const Vec3f* end() const { return first + count; }
+        };
+
         std::string filename;
         unsigned int id;
         std::vector<MoveVertex> moves;
+        // Interpolation points of all arc moves, indexed by MoveVertex::interpolation_points_begin / interpolation_points_count.
+        std::vector<Vec3f> arc_interpolation_points;
         // Positions of ends of lines of the final G-code this->filename after TimeProcessor::post_process() finalizes the G-code.
         std::vector<size_t> lines_ends;
         Pointfs printable_area;
@@ -230,6 +248,10 @@ class Print;
 #endif // ENABLE_GCODE_VIEWER_STATISTICS
         void reset();
 
+        InterpolationPoints interpolation_points(const MoveVertex &move) const {
+            return { arc_interpolation_points.data() + move.interpolation_points_begin, move.interpolation_points_count };
+        }
+
         //BBS: add mutex for protection of gcode result
         mutable std::mutex result_mutex;
         GCodeProcessorResult& operator=(const GCodeProcessorResult &other)
@@ -237,6 +259,7 @@ class Print;
             filename = other.filename;
             id = other.id;
             moves = other.moves;
+            arc_interpolation_points = other.arc_interpolation_points;
             lines_ends = other.lines_ends;
             printable_area = other.printable_area;
             bed_exclude_area = other.bed_exclude_area;
@@ -500,6 +523,15 @@ class Print;
             std::array<TimeMachine, static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Count)> machines;
 
             void reset();
+
+            // Calculates the blocks of all the enabled machines once their queue exceeds Planner::refresh_threshold,
+            // keeping the last Planner::queue_size blocks for the look-ahead.
+            void refresh_planners();
+            // Simulates firmware st_synchronize() call on all the enabled machines.
+            void simulate_st_synchronize(float additional_time = 0.0f);
+
+        private:
+            void calculate_time(size_t min_blocks, size_t keep_last_n_blocks, float additional_time);
         };
 
         struct UsedFilaments  // filaments per ColorChange
@@ -734,6 +766,26 @@ class Print;
         int m_delta_temperature;
         int m_preheat_steps;
         bool m_disable_m73;
+
+        // Layout of the G-code passed to process_buffer(), recorded for run_post_process() to patch the statistics in place,
+        // see enable_in_place_post_process().
+        struct InPlacePostProcess
+        {
+            bool                enabled { false };
+            // The M73 lines were written with the G-code, see layer_change_progress_lines().
+            bool                progress_written { false };
+            // Offsets into the file of the ends of the lines processed so far.
+            std::vector<size_t> lines_ends;
+            // Indices into lines_ends of the placeholders and of the filament statistics.
+            std::vector<size_t> patched_lines;
+            // Unterminated line at the end of the last buffer.
+            std::string         partial_line;
+            size_t              file_size { 0 };
+
+            void reset() { lines_ends.clear(); patched_lines.clear(); partial_line.clear(); file_size = 0; }
+            void append(const std::string& buffer);
+        };
+        InPlacePostProcess m_in_place_post_process;
 #if ENABLE_GCODE_VIEWER_STATISTICS
         std::chrono::time_point<std::chrono::high_resolution_clock> m_start_time;
 #endif // ENABLE_GCODE_VIEWER_STATISTICS
@@ -781,6 +833,13 @@ class Print;
             return m_time_processor.machines[static_cast<size_t>(PrintEstimatedStatistics::ETimeMode::Stealth)].enabled;
         }
         void enable_machine_envelope_processing(bool enabled) { m_time_processor.machine_envelope_processing_enabled = enabled; }
+        // If enabled, finalize(true) overwrites the placeholders and the filament statistics of the G-code passed to process_buffer()
+        // in place, provided they were padded with spaces to fit the final values and no M73 or M104 lines have to be inserted.
+        // Otherwise the G-code is rewritten. If progress_written, the M73 lines were written with the G-code and none is inserted.
+        void enable_in_place_post_process(bool enabled, bool progress_written) {
+            m_in_place_post_process.enabled          = enabled;
+            m_in_place_post_process.progress_written = progress_written;
+        }
         void reset();
 
         const GCodeProcessorResult& get_result() const { return m_result; }
@@ -807,6 +866,10 @@ class Print;
         std::vector<std::pair<EMoveType, float>> get_moves_time(PrintEstimatedStatistics::ETimeMode mode) const;
         std::vector<std::pair<ExtrusionRole, float>> get_roles_time(PrintEstimatedStatistics::ETimeMode mode) const;
         std::vector<float> get_layers_time(PrintEstimatedStatistics::ETimeMode mode) const;
+        // M73 lines to be written before each of the layer change tags of the G-code processed, the progress at the start
+        // of the layer and the time remaining to the next printer stop. Called after finalize() to write the progress
+        // estimated by a pre-pass while generating the same G-code again.
+        std::vector<std::string> layer_change_progress_lines() const;
 
         //BBS: set offset for gcode writer
         void set_xy_offset(double x, double y) { m_x_offset = x; m_y_offset = y; }
@@ -954,6 +1017,10 @@ class Print;
         // 1) add remaining time lines M73 and update moves' gcode ids accordingly
         // 2) update used filament data
         void run_post_process();
+        // Overwrites the lines recorded by m_in_place_post_process with the lines produced by replace_line(line, replacement), keeping
+        // those it returns false for. Returns false without modifying the file if any of the replacements does not fit
+        // or if the file does not match the recorded layout.
+        bool patch_in_place(const std::function<bool(std::string&, std::string&)>& replace_line);
 
         //BBS: different path_type is only used for arc move
         void store_move_vertex(EMoveType type, EMovePathType path_type = EMovePathType::Noop_move);
@@ -179,6 +179,7 @@ LayerResult PressureEqualizer::process_layer(LayerResult &&input)
     if (!input.nop_layer_result) {
         this->process_layer(input.gcode);
         input.gcode.clear(); // GCode is already processed, so it isn't needed to store it.
+        input.moves.clear(); // The G-code is rewritten, its typed moves no longer apply.
         m_layer_results.emplace(new LayerResult(input));
     }
 
@@ -33,6 +33,14 @@
 
 namespace Slic3r {
 
+// Surface samples of a PrintObject and their visibility, see PrintObject::seam_visibility().
+struct SeamVisibility {
+  PrintObjectFingerprint key;
+  SeamPosition seam_position;
+  TriangleSetSamples mesh_samples;
+  std::vector<float> mesh_samples_visibility;
+};
+
 namespace SeamPlacerImpl {
 
 template<typename T> int sgn(T val) {
@@ -621,10 +629,10 @@ std::pair<size_t, size_t> find_previous_and_next_perimeter_point(const std::vect
   return {size_t(prev),size_t(next)};
 }
 
-// Computes all global model info - transforms object, performs raycasting
-void compute_global_occlusion(GlobalModelInfo &result, const PrintObject *po,
-                              std::function<void(void)> throw_if_canceled,
-                              SeamPosition seam_position = spAligned) {
+// Transforms object, samples its surface and performs raycasting to compute the visibility of the samples
+void raycast_global_visibility(GlobalModelInfo &result, const PrintObject *po,
+                               std::function<void(void)> throw_if_canceled,
+                               SeamPosition seam_position) {
   BOOST_LOG_TRIVIAL(debug)
       << "SeamPlacer: gather occlusion meshes: start";
   auto obj_transform = po->trafo_centered();
@@ -665,6 +673,45 @@ void compute_global_occlusion(GlobalModelInfo &result, const PrintObject *po,
 
   result.mesh_samples = sample_its_uniform_parallel(SeamPlacer::raycasting_visibility_samples_count,
                                                     triangle_set);
+
+  BOOST_LOG_TRIVIAL(debug)
+      << "SeamPlacer: Compute visiblity sample points: end";
+  throw_if_canceled();
+
+  BOOST_LOG_TRIVIAL(debug)
+      << "SeamPlacer: build AABB tree: start";
+  auto raycasting_tree = AABBTreeIndirect::build_aabb_tree_over_indexed_triangle_set(triangle_set.vertices,
+                                                                                     triangle_set.indices);
+
+  throw_if_canceled();
+  BOOST_LOG_TRIVIAL(debug)
+      << "SeamPlacer: build AABB tree: end";
+  result.mesh_samples_visibility = raycast_visibility(raycasting_tree, triangle_set, result.mesh_samples,
+                                                      negative_volumes_start_index, seam_position);
+  throw_if_canceled();
+#ifdef DEBUG_FILES
+  result.debug_export(triangle_set);
+#endif
+}
+
+// Computes all global model info - visibility of the surface samples, reusing the visibility cached on the PrintObject
+// if its meshes and transformations did not change, and the search structures over the samples
+void compute_global_occlusion(GlobalModelInfo &result, const PrintObject *po,
+                              std::function<void(void)> throw_if_canceled,
+                              SeamPosition seam_position = spAligned) {
+  const PrintObjectFingerprint key = po->seam_visibility_key();
+  const std::shared_ptr<const SeamVisibility> cached = po->seam_visibility();
+  if (cached && cached->key == key && cached->seam_position == seam_position) {
+    BOOST_LOG_TRIVIAL(debug)
+        << "SeamPlacer: reusing cached visibility of " << cached->mesh_samples.positions.size() << " samples";
+    result.mesh_samples = cached->mesh_samples;
+    result.mesh_samples_visibility = cached->mesh_samples_visibility;
+  } else {
+    raycast_global_visibility(result, po, throw_if_canceled, seam_position);
+    po->set_seam_visibility(std::make_shared<const SeamVisibility>(
+        SeamVisibility { key, seam_position, result.mesh_samples, result.mesh_samples_visibility }));
+  }
+
   result.mesh_samples_coordinate_functor = CoordinateFunctor(&result.mesh_samples.positions);
   result.mesh_samples_tree = KDTreeIndirect<3, float, CoordinateFunctor>(result.mesh_samples_coordinate_functor,
                                                                          result.mesh_samples.positions.size());
@@ -683,27 +730,8 @@ void compute_global_occlusion(GlobalModelInfo &result, const PrintObject *po,
   float search_radius = sqrt(search_area / PI);
   result.mesh_samples_radius = search_radius;
 
-  BOOST_LOG_TRIVIAL(debug)
-      << "SeamPlacer: Compute visiblity sample points: end";
-  throw_if_canceled();
-
   BOOST_LOG_TRIVIAL(debug)
       << "SeamPlacer: Mesh sample raidus: " << result.mesh_samples_radius;
-
-  BOOST_LOG_TRIVIAL(debug)
-      << "SeamPlacer: build AABB tree: start";
-  auto raycasting_tree = AABBTreeIndirect::build_aabb_tree_over_indexed_triangle_set(triangle_set.vertices,
-                                                                                     triangle_set.indices);
-
-  throw_if_canceled();
-  BOOST_LOG_TRIVIAL(debug)
-      << "SeamPlacer: build AABB tree: end";
-  result.mesh_samples_visibility = raycast_visibility(raycasting_tree, triangle_set, result.mesh_samples,
-                                                      negative_volumes_start_index, seam_position);
-  throw_if_canceled();
-#ifdef DEBUG_FILES
-  result.debug_export(triangle_set);
-#endif
 }
 
 void gather_enforcers_blockers(GlobalModelInfo &result, const PrintObject *po) {
@@ -19,6 +19,8 @@
 #include <algorithm>
 #include <cmath>
 
+#include <boost/log/trivial.hpp>
+
 #include <libslic3r.h>
 
 namespace Slic3r {
@@ -27,6 +29,14 @@ const static bool g_wipe_into_objects = false;
 
 namespace {
 
+int mixed_phase(const std::vector<int> *phases, size_t num_physical, unsigned int filament_id_1based)
+{
+    if (phases == nullptr || filament_id_1based <= num_physical)
+        return 0;
+    const size_t idx = size_t(filament_id_1based - num_physical - 1);
+    return idx < phases->size() ? (*phases)[idx] : 0;
+}
+
 unsigned int resolve_mixed_with_layer_heights(const MixedFilamentManager *mixed_mgr,
                                               size_t                      num_physical,
                                               unsigned int                filament_id_1based,
@@ -35,13 +45,16 @@ unsigned int resolve_mixed_with_layer_heights(const MixedFilamentManager *mixed_
                                               float                       layer_height,
                                               float                       layer_height_a,
                                               float                       layer_height_b,
-                                              float                       base_layer_height)
+                                              float                       base_layer_height,
+                                              const std::vector<int>     *phases)
 {
-    if (!(mixed_mgr && mixed_mgr->is_mixed(filament_id_1based, num_physical)))
+    const MixedFilament *mixed_row = mixed_mgr ? mixed_mgr->mixed_filament_from_id(filament_id_1based, num_physical) : nullptr;
+    if (mixed_row == nullptr)
         return filament_id_1based;
 
-    const MixedFilament *mixed_row = mixed_mgr->mixed_filament_from_id(filament_id_1based, num_physical);
-    const bool is_custom_mixed = mixed_row != nullptr && mixed_row->custom;
+    layer_index += mixed_phase(phases, num_physical, filament_id_1based);
+
+    const bool is_custom_mixed = mixed_row->custom;
 
     if (!is_custom_mixed && (layer_height_a > 0.f || layer_height_b > 0.f)) {
         const float safe_base = std::max<float>(0.01f, base_layer_height);
@@ -50,10 +63,8 @@ unsigned int resolve_mixed_with_layer_heights(const MixedFilamentManager *mixed_
         const int cycle   = ratio_a + ratio_b;
 
         if (cycle > 0) {
-            if (mixed_row != nullptr) {
-                const int pos = ((layer_index % cycle) + cycle) % cycle;
-                return pos < ratio_a ? mixed_row->component_a : mixed_row->component_b;
-            }
+            const int pos = ((layer_index % cycle) + cycle) % cycle;
+            return pos < ratio_a ? mixed_row->component_a : mixed_row->component_b;
         }
     }
 
@@ -195,7 +206,8 @@ unsigned int LayerTools::resolve_mixed_1based(unsigned int filament_id) const
                                             float(this->layer_height),
                                             mixed_layer_height_a,
                                             mixed_layer_height_b,
-                                            mixed_base_layer_height);
+                                            mixed_base_layer_height,
+                                            mixed_phases.get());
 }
 
 // Return a zero based extruder from the region, or extruder_override if overriden.
@@ -285,6 +297,14 @@ ToolOrdering::ToolOrdering(const PrintObject &object, unsigned int first_extrude
 
     // Collect extruders reuqired to print the layers.
     this->collect_extruders(object, std::vector<std::pair<double, unsigned int>>());
+    if (this->optimize_mixed_phases()) {
+        // Collect again with the mixed cadences shifted.
+        for (LayerTools &lt : m_layer_tools) {
+            lt.extruders.clear();
+            lt.filament_requests.clear();
+        }
+        this->collect_extruders(object, std::vector<std::pair<double, unsigned int>>());
+    }
 
     // BBS
     // Reorder the extruders to minimize tool switches.
@@ -378,6 +398,15 @@ ToolOrdering::ToolOrdering(const Print &print, unsigned int first_extruder, bool
     // Collect extruders reuqired to print the layers.
     for (auto object : print.objects())
         this->collect_extruders(*object, per_layer_extruder_switches);
+    if (this->optimize_mixed_phases()) {
+        // Collect again with the mixed cadences shifted.
+        for (LayerTools &lt : m_layer_tools) {
+            lt.extruders.clear();
+            lt.filament_requests.clear();
+        }
+        for (auto object : print.objects())
+            this->collect_extruders(*object, per_layer_extruder_switches);
+    }
 
     // Reorder the extruders to minimize tool switches.
     std::vector<unsigned int> first_layer_tool_order;
@@ -571,6 +600,7 @@ void ToolOrdering::collect_extruders(const PrintObject &object, const std::vecto
         layer_tools.mixed_layer_height_a     = m_mixed_layer_height_a;
         layer_tools.mixed_layer_height_b     = m_mixed_layer_height_b;
         layer_tools.mixed_base_layer_height  = m_mixed_base_layer_height;
+        layer_tools.mixed_phases             = m_mixed_phases;
     }
 
     // Collect the support extruders.
@@ -580,18 +610,18 @@ void ToolOrdering::collect_extruders(const PrintObject &object, const std::vecto
         ExtrusionRole role = support_layer->support_fills.role();
         bool         has_support        = role == erMixed || role == erSupportMaterial || role == erSupportTransition;
         bool         has_interface      = role == erMixed || role == erSupportMaterialInterface;
-        unsigned int extruder_support   = resolve_mixed(object.config().support_filament.value,
-                                                        layer_tools.layer_index,
-                                                        float(support_layer->print_z),
-                                                        float(support_layer->height));
-        unsigned int extruder_interface = resolve_mixed(object.config().support_interface_filament.value,
-                                                        layer_tools.layer_index,
-                                                        float(support_layer->print_z),
-                                                        float(support_layer->height));
         if (has_support)
-            layer_tools.extruders.push_back(extruder_support);
+            layer_tools.extruders.push_back(request_filament(layer_tools,
+                                                             object.config().support_filament.value,
+                                                             layer_tools.layer_index,
+                                                             float(support_layer->print_z),
+                                                             float(support_layer->height)));
         if (has_interface)
-            layer_tools.extruders.push_back(extruder_interface);
+            layer_tools.extruders.push_back(request_filament(layer_tools,
+                                                             object.config().support_interface_filament.value,
+                                                             layer_tools.layer_index,
+                                                             float(support_layer->print_z),
+                                                             float(support_layer->height)));
         if (has_support || has_interface) {
             layer_tools.has_support = true;
             layer_tools.wiping_extrusions().is_support_overriddable_and_mark(role, object);
@@ -638,7 +668,7 @@ void ToolOrdering::collect_extruders(const PrintObject &object, const std::vecto
 
                 if (something_nonoverriddable){
                     unsigned int wall_ext = (extruder_override == 0) ? region.config().wall_filament.value : extruder_override;
-                    wall_ext = resolve_mixed(wall_ext, layerCount, float(layer->print_z), float(layer->height));
+                    wall_ext = request_filament(layer_tools, wall_ext, layerCount, float(layer->print_z), float(layer->height));
                		layer_tools.extruders.emplace_back(wall_ext);
                     if (layerCount == 0) {
                         firstLayerExtruders.emplace_back(wall_ext);
@@ -669,20 +699,23 @@ void ToolOrdering::collect_extruders(const PrintObject &object, const std::vecto
             if (something_nonoverriddable || !m_print_config_ptr) {
             	if (extruder_override == 0) {
 	                if (has_solid_infill)
-	                    layer_tools.extruders.emplace_back(resolve_mixed(region.config().solid_infill_filament,
-                                                                         layerCount,
-                                                                         float(layer->print_z),
-                                                                         float(layer->height)));
+	                    layer_tools.extruders.emplace_back(request_filament(layer_tools,
+                                                                            region.config().solid_infill_filament,
+                                                                            layerCount,
+                                                                            float(layer->print_z),
+                                                                            float(layer->height)));
 	                if (has_infill)
-	                    layer_tools.extruders.emplace_back(resolve_mixed(region.config().sparse_infill_filament,
+	                    layer_tools.extruders.emplace_back(request_filament(layer_tools,
+                                                                            region.config().sparse_infill_filament,
+                                                                            layerCount,
+                                                                            float(layer->print_z),
+                                                                            float(layer->height)));
+            	} else if (has_solid_infill || has_infill)
+            		layer_tools.extruders.emplace_back(request_filament(layer_tools,
+                                                                         extruder_override,
                                                                          layerCount,
                                                                          float(layer->print_z),
                                                                          float(layer->height)));
-            	} else if (has_solid_infill || has_infill)
-            		layer_tools.extruders.emplace_back(resolve_mixed(extruder_override,
-                                                                      layerCount,
-                                                                      float(layer->print_z),
-                                                                      float(layer->height)));
             }
             if (has_solid_infill || has_infill)
                 layer_tools.has_object = true;
@@ -1548,7 +1581,159 @@ unsigned int ToolOrdering::resolve_mixed(unsigned int filament_id_1based,
                                             layer_height,
                                             m_mixed_layer_height_a,
                                             m_mixed_layer_height_b,
-                                            m_mixed_base_layer_height);
+                                            m_mixed_base_layer_height,
+                                            m_mixed_phases.get());
+}
+
+unsigned int ToolOrdering::request_filament(LayerTools  &layer_tools,
+                                            unsigned int filament_id_1based,
+                                            int          layer_index,
+                                            float        layer_print_z,
+                                            float        layer_height)
+{
+    layer_tools.filament_requests.push_back({ filament_id_1based, layer_index, layer_print_z, layer_height });
+    return resolve_mixed(filament_id_1based, layer_index, layer_print_z, layer_height);
+}
+
+bool ToolOrdering::optimize_mixed_phases()
+{
+    m_mixed_phase_stats = {};
+    m_mixed_phases.reset();
+    const MixedFilamentResolvePlan *plan = m_mixed_mgr ? m_mixed_mgr->resolve_plan(m_num_physical) : nullptr;
+    if (plan == nullptr || plan->rows.empty())
+        return false;
+
+    // Mixed rows cycling by the layer index. The height weighted rows cycle by print_z, they are left alone.
+    struct Row
+    {
+        unsigned int              filament_id;
+        int                       period = 0;
+        // Filament resolved for the layer index i at sequence[i].
+        std::vector<unsigned int> sequence;
+    };
+    constexpr int    max_period      = 64;
+    int              max_layer_index = 0;
+    std::vector<int> row_of_mixed(plan->rows.size(), -1);
+    std::vector<Row> rows;
+    for (const LayerTools &lt : m_layer_tools)
+        for (const LayerTools::FilamentRequest &request : lt.filament_requests) {
+            const MixedFilamentResolvePlan::Row *plan_row = plan->row(request.filament_id);
+            if (plan_row == nullptr || plan_row->height_weighted || request.layer_index < 0)
+                continue;
+            max_layer_index = std::max(max_layer_index, request.layer_index);
+            int &row_idx = row_of_mixed[request.filament_id - m_num_physical - 1];
+            if (row_idx == -1) {
+                row_idx = int(rows.size());
+                rows.push_back({ request.filament_id, 0, {} });
+            }
+        }
+    if (rows.empty())
+        return false;
+
+    for (Row &row : rows) {
+        row.sequence.resize(size_t(max_layer_index + 2 * max_period));
+        for (size_t i = 0; i < row.sequence.size(); ++ i)
+            row.sequence[i] = resolve_mixed(row.filament_id, int(i));
+        for (int period = 1; period <= max_period && row.period == 0; ++ period) {
+            bool periodic = true;
+            for (size_t i = 0; periodic && i < size_t(max_layer_index + max_period); ++ i)
+                periodic = row.sequence[i] == row.sequence[i + period];
+            if (periodic)
+                row.period = period;
+        }
+    }
+
+    // Filaments of the layers: the fixed ones and the mixed ones to shift as (row, layer index).
+    struct Layer
+    {
+        std::vector<unsigned int>        fixed;
+        std::vector<std::pair<int, int>> mixed;
+    };
+    std::vector<Layer> layers;
+    for (const LayerTools &lt : m_layer_tools) {
+        if (lt.filament_requests.empty())
+            continue;
+        Layer layer;
+        for (const LayerTools::FilamentRequest &request : lt.filament_requests) {
+            const int row_idx = plan->row(request.filament_id) != nullptr ? row_of_mixed[request.filament_id - m_num_physical - 1] : -1;
+            if (row_idx >= 0 && rows[row_idx].period > 1 && request.layer_index >= 0)
+                layer.mixed.emplace_back(row_idx, request.layer_index);
+            else
+                layer.fixed.emplace_back(resolve_mixed(request.filament_id, request.layer_index, request.print_z, request.height));
+        }
+        layers.emplace_back(std::move(layer));
+    }
+
+    // Tool changes if every layer starts with the last tool of the previous layer when it prints with it.
+    std::vector<unsigned int> previous, current;
+    auto tool_changes = [&](const std::vector<int> &phases) {
+        size_t changes = 0;
+        bool   first   = true;
+        previous.clear();
+        for (const Layer &layer : layers) {
+            current = layer.fixed;
+            for (const auto &[row_idx, layer_index] : layer.mixed)
+                current.emplace_back(rows[row_idx].sequence[size_t(layer_index + phases[row_idx])]);
+            sort_remove_duplicates(current);
+            if (current.empty())
+                continue;
+            bool continued = first;
+            for (auto it_prev = previous.begin(), it_cur = current.begin(); ! continued && it_prev != previous.end() && it_cur != current.end();) {
+                if (*it_prev == *it_cur)
+                    continued = true;
+                else if (*it_prev < *it_cur)
+                    ++ it_prev;
+                else
+                    ++ it_cur;
+            }
+            changes += current.size() - (continued ? 1 : 0);
+            first = false;
+            previous.swap(current);
+        }
+        return changes;
+    };
+
+    // Coordinate descent over the phases of the rows.
+    std::vector<int> phases(rows.size(), 0);
+    const size_t     changes_before = tool_changes(phases);
+    size_t           changes_best   = changes_before;
+    for (int round = 0; round < 4; ++ round) {
+        bool improved = false;
+        for (size_t row_idx = 0; row_idx < rows.size(); ++ row_idx) {
+            int best_phase = phases[row_idx];
+            for (int phase = 0; phase < rows[row_idx].period; ++ phase) {
+                if (phase == best_phase)
+                    continue;
+                phases[row_idx] = phase;
+                if (const size_t changes = tool_changes(phases); changes < changes_best) {
+                    changes_best = changes;
+                    best_phase   = phase;
+                    improved     = true;
+                }
+            }
+            phases[row_idx] = best_phase;
+        }
+        if (! improved)
+            break;
+    }
+
+    m_mixed_phase_stats.tool_changes_before = changes_before;
+    m_mixed_phase_stats.tool_changes_after  = changes_best;
+    if (changes_best < changes_before) {
+        auto mixed_phases = std::make_shared<std::vector<int>>(plan->rows.size(), 0);
+        for (size_t row_idx = 0; row_idx < rows.size(); ++ row_idx)
+            if (phases[row_idx] != 0) {
+                (*mixed_phases)[rows[row_idx].filament_id - m_num_physical - 1] = phases[row_idx];
+                ++ m_mixed_phase_stats.rows_shifted;
+            }
+        m_mixed_phases = std::move(mixed_phases);
+    }
+    BOOST_LOG_TRIVIAL(info) << "ToolOrdering mixed cadence phases"
+                            << ", layer_cycling_rows=" << rows.size()
+                            << ", rows_shifted=" << m_mixed_phase_stats.rows_shifted
+                            << ", tool_changes_before=" << changes_before
+                            << ", tool_changes_after=" << changes_best;
+    return m_mixed_phases != nullptr;
 }
 
 } // namespace Slic3r
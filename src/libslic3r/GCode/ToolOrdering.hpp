@@ -6,6 +6,7 @@
 #include "../libslic3r.h"
 #include "../MixedFilament.hpp"
 
+#include <memory>
 #include <utility>
 
 #include <boost/container/small_vector.hpp>
@@ -150,6 +151,18 @@ public:
     float                       mixed_layer_height_a    = 0.f;
     float                       mixed_layer_height_b    = 0.f;
     float                       mixed_base_layer_height = 0.2f;
+    // Cadence phase in layers of the enabled mixed rows (virtual ID - num_physical - 1), see ToolOrdering::optimize_mixed_phases().
+    std::shared_ptr<const std::vector<int>> mixed_phases;
+
+    // 1-based filament requested by this layer before resolving the mixed filaments.
+    struct FilamentRequest
+    {
+        unsigned int filament_id;
+        int          layer_index;
+        float        print_z;
+        float        height;
+    };
+    std::vector<FilamentRequest> filament_requests;
 
 private:
     // Resolve a 1-based filament ID through the mixed-filament manager for this layer.
@@ -202,6 +215,16 @@ public:
     std::vector<LayerTools>& layer_tools() { return m_layer_tools; }
     bool 				has_wipe_tower() const { return ! m_layer_tools.empty() && m_first_printing_extruder != (unsigned int)-1 && m_layer_tools.front().has_wipe_tower; }
 
+    struct MixedPhaseStats
+    {
+        // Mixed rows with their cadence shifted.
+        size_t rows_shifted        = 0;
+        // Estimated tool changes of the print before and after shifting the cadences.
+        size_t tool_changes_before = 0;
+        size_t tool_changes_after  = 0;
+    };
+    const MixedPhaseStats& mixed_phase_stats() const { return m_mixed_phase_stats; }
+
 private:
     void				initialize_layers(std::vector<coordf_t> &zs);
     void 				collect_extruders(const PrintObject &object, const std::vector<std::pair<double, unsigned int>> &per_layer_extruder_switches);
@@ -226,6 +249,16 @@ private:
                                int          layer_index,
                                float        layer_print_z = 0.f,
                                float        layer_height  = 0.f) const;
+    // resolve_mixed() recording the request into layer_tools.filament_requests.
+    unsigned int request_filament(LayerTools  &layer_tools,
+                                  unsigned int filament_id_1based,
+                                  int          layer_index,
+                                  float        layer_print_z,
+                                  float        layer_height);
+    // Shifts the cadences of the mixed rows cycling by the layer index, keeping their ratios, so that the rows sharing
+    // a filament print it on the same layers as far as possible. Returns true if the estimated number of tool changes
+    // dropped, then the extruders have to be collected again.
+    bool optimize_mixed_phases();
 
     std::vector<LayerTools>    m_layer_tools;
     // First printing extruder, including the multi-material priming sequence.
@@ -246,6 +279,8 @@ private:
     float                       m_mixed_layer_height_a    = 0.f;
     float                       m_mixed_layer_height_b    = 0.f;
     float                       m_mixed_base_layer_height = 0.2f;
+    std::shared_ptr<const std::vector<int>> m_mixed_phases;
+    MixedPhaseStats             m_mixed_phase_stats;
 };
 
 } // namespace SLic3r
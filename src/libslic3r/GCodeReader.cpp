@@ -89,10 +89,11 @@ const char* GCodeReader::parse_line_internal(const char *ptr, const char *end, G
     // Skip the rest of the line.
     for (; ! is_end_of_line(*c); ++ c);
 
-    // Copy the raw string including the comment, without the trailing newlines.
+    // Reference the raw string including the comment, without the trailing newlines. The line is only copied
+    // into GCodeLine::m_raw if the callback asks for GCodeLine::raw().
     if (c > ptr) {
-        PROFILE_BLOCK(copy_raw_string);
-        gline.m_raw.assign(ptr, c);
+        gline.m_raw_view  = std::string_view(ptr, c - ptr);
+        gline.m_raw_owned = false;
     }
 
     // Skip the trailing newlines.
@@ -102,7 +103,7 @@ const char* GCodeReader::parse_line_internal(const char *ptr, const char *end, G
 		++ c;
 
     if (m_verbose)
-        std::cout << gline.m_raw << std::endl;
+        std::cout << gline.m_raw_view << std::endl;
 
     return c;
 }
@@ -128,15 +129,18 @@ bool GCodeReader::parse_file_raw_internal(const std::string &filename, ParseLine
     FilePtr in{ boost::nowide::fopen(filename.c_str(), "rb") };
 
     // Read the input stream 64kB at a time, extract lines and process them.
-    std::vector<char> buffer(65536 * 10, 0);
+    // One more zero character is reserved after the data read, so that the last line of the file without a newline
+    // is terminated the same way as the other lines when handed out to the line parser without copying.
+    std::vector<char> buffer(65536 * 10 + 1, 0);
     // Line buffer.
     std::string gcode_line;
     size_t file_pos = 0;
     m_parsing = true;
     for (;;) {
-        size_t cnt_read = ::fread(buffer.data(), 1, buffer.size(), in.f);
+        size_t cnt_read = ::fread(buffer.data(), 1, buffer.size() - 1, in.f);
         if (::ferror(in.f))
             return false;
+        buffer[cnt_read] = 0;
         bool eof       = cnt_read == 0;
         auto it        = buffer.begin();
         auto it_bufend = buffer.begin() + cnt_read;
@@ -224,7 +228,7 @@ bool GCodeReader::parse_file_raw(const std::string &filename, raw_line_callback_
 
 bool GCodeReader::GCodeLine::has(char axis) const
 {
-    const char *c = m_raw.c_str();
+    const char *c = m_raw_view.data();
     // Skip the whitespaces.
     c = skip_whitespaces(c);
     // Skip the command.
@@ -247,7 +251,8 @@ bool GCodeReader::GCodeLine::has(char axis) const
 bool GCodeReader::GCodeLine::has_value(char axis, float &value) const
 {
     assert(is_decimal_separator_point());
-    const char *c = m_raw.c_str();
+    const char *c   = m_raw_view.data();
+    const char *end = c + m_raw_view.size();
     // Skip the whitespaces.
     c = skip_whitespaces(c);
     // Skip the command.
@@ -261,9 +266,9 @@ bool GCodeReader::GCodeLine::has_value(char axis, float &value) const
         // Check the name of the axis.
         if (*c == axis) {
             // Try to parse the numeric value.
-            char   *pend = nullptr;
-            double  v = strtod(++ c, &pend);
-            if (pend != nullptr && is_end_of_word(*pend)) {
+            double v;
+            auto [pend, ec] = fast_float::from_chars(++ c, end, v);
+            if (pend != c && is_end_of_word(*pend)) {
                 // The axis value has been parsed correctly.
                 value = float(v);
                 return true;
@@ -277,6 +282,7 @@ bool GCodeReader::GCodeLine::has_value(char axis, float &value) const
 
 void GCodeReader::GCodeLine::set(const Axis axis, const float new_value, const int decimal_digits)
 {
+    this->own_raw();
     std::ostringstream ss;
     ss << std::fixed << std::setprecision(decimal_digits) << new_value;
 
@@ -306,6 +312,7 @@ void GCodeReader::GCodeLine::set(const Axis axis, const float new_value, const i
         else
             m_raw = m_raw.replace(pos, 0, std::string(match) + ss.str());
     }
+    m_raw_view   = m_raw;
     m_axis[axis] = new_value;
     m_mask |= 1 << int(axis);
 }
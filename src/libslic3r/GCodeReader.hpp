@@ -8,6 +8,7 @@
 #include <string>
 #include <string_view>
 #include "PrintConfig.hpp"
+#include "GCode/GCodeMoves.hpp"
 
 namespace Slic3r {
 
@@ -16,17 +17,33 @@ public:
     class GCodeLine {
     public:
         GCodeLine() { reset(); }
-        void reset() { m_mask = 0; memset(m_axis, 0, sizeof(m_axis)); m_raw.clear(); }
+        // A copy always owns its raw string, the source line may point into a parser buffer which is going to be reused.
+        GCodeLine(const GCodeLine &rhs) { *this = rhs; }
+        GCodeLine& operator=(const GCodeLine &rhs) {
+            if (this != &rhs) {
+                memcpy(m_axis, rhs.m_axis, sizeof(m_axis));
+                m_mask = rhs.m_mask;
+                m_raw.assign(rhs.m_raw_view.data(), rhs.m_raw_view.size());
+                m_raw_view  = m_raw;
+                m_raw_owned = true;
+            }
+            return *this;
+        }
+        void reset() { m_mask = 0; memset(m_axis, 0, sizeof(m_axis)); this->clear(); }
 
-        const std::string&      raw() const { return m_raw; }
+        // The raw line is only copied into a std::string on first request, see raw_view().
+        const std::string&      raw() const { this->own_raw(); return m_raw; }
+        // Raw line without the trailing newlines. If the line was produced by GCodeReader::parse_file() or parse_buffer(),
+        // the view points into the reader's buffer and it is only valid during the callback.
+        std::string_view        raw_view() const { return m_raw_view; }
         const std::string_view  cmd() const { 
-            const char *cmd = GCodeReader::skip_whitespaces(m_raw.c_str());
+            const char *cmd = GCodeReader::skip_whitespaces(m_raw_view.data());
             return std::string_view(cmd, GCodeReader::skip_word(cmd) - cmd);
         }
         const std::string_view  comment() const
-            { size_t pos = m_raw.find(';'); return (pos == std::string::npos) ? std::string_view() : std::string_view(m_raw).substr(pos + 1); }
+            { size_t pos = m_raw_view.find(';'); return (pos == std::string_view::npos) ? std::string_view() : m_raw_view.substr(pos + 1); }
 
-        void  clear() { m_raw.clear(); }
+        void  clear() { m_raw.clear(); m_raw_view = m_raw; m_raw_owned = true; }
         bool  has(Axis axis) const { return (m_mask & (1 << int(axis))) != 0; }
         float value(Axis axis) const { return m_axis[axis]; }
         bool  has(char axis) const;
@@ -45,7 +62,7 @@ public:
             float y = this->has(Y) ? (this->y() - reader.y()) : 0;
             return sqrt(x*x + y*y);
         }
-        bool cmd_is(const char *cmd_test)          const { return cmd_is(m_raw, cmd_test); }
+        bool cmd_is(const char *cmd_test)          const { return cmd_is(m_raw_view.data(), cmd_test); }
         //BBS: modify to support G2 and G3
         bool extruding(const GCodeReader &reader)  const { return (this->cmd_is("G1") || this->cmd_is("G2") || this->cmd_is("G3")) && this->dist_E(reader) > 0; }
         bool retracting(const GCodeReader &reader) const { return (this->cmd_is("G1") || this->cmd_is("G2") || this->cmd_is("G3")) && this->dist_E(reader) < 0; }
@@ -73,8 +90,10 @@ public:
         float j() const { return m_axis[J]; }
         float p() const { return m_axis[P]; }
 
-        static bool cmd_is(const std::string &gcode_line, const char *cmd_test) {
-            const char *cmd = GCodeReader::skip_whitespaces(gcode_line.c_str());
+        static bool cmd_is(const std::string &gcode_line, const char *cmd_test) { return cmd_is(gcode_line.c_str(), cmd_test); }
+        // gcode_line has to be terminated by an end of line character or by zero.
+        static bool cmd_is(const char *gcode_line, const char *cmd_test) {
+            const char *cmd = GCodeReader::skip_whitespaces(gcode_line);
             size_t len = strlen(cmd_test); 
             return strncmp(cmd, cmd_test, len) == 0 && GCodeReader::is_end_of_word(cmd[len]);
         }
@@ -84,15 +103,25 @@ public:
         }
 
         static std::string extract_cmd(const std::string& gcode_line) {
-            GCodeLine temp;
-            temp.m_raw = gcode_line;
-            const std::string_view cmd = temp.cmd();
-            return { cmd.begin(), cmd.end() };
+            const char *cmd = GCodeReader::skip_whitespaces(gcode_line.c_str());
+            return { cmd, GCodeReader::skip_word(cmd) };
         }
     private:
-        std::string      m_raw;
-        float            m_axis[NUM_AXES];
-        uint32_t         m_mask;
+        void own_raw() const {
+            if (! m_raw_owned) {
+                m_raw.assign(m_raw_view.data(), m_raw_view.size());
+                m_raw_view  = m_raw;
+                m_raw_owned = true;
+            }
+        }
+
+        // Either points into m_raw or, while parsing a file or a buffer, into the parser's buffer.
+        // The character following the view is always an end of line character or zero.
+        mutable std::string_view m_raw_view;
+        mutable std::string      m_raw;
+        mutable bool             m_raw_owned { true };
+        float                    m_axis[NUM_AXES];
+        uint32_t                 m_mask;
         friend class GCodeReader;
     };
 
@@ -135,6 +164,30 @@ public:
     void parse_line(const std::string &line, Callback callback)
         { GCodeLine gline; this->parse_line(line.c_str(), line.c_str() + line.size(), gline, callback); }
 
+    // Same as parse_line(), but the axes are taken from the move typed by GCodeWriter instead of being parsed from the text.
+    // ptr points to the start of the line of the move.
+    template<typename Callback>
+    const char* parse_move(const GCodeMove &move, const char *ptr, GCodeLine &gline, Callback &callback)
+    {
+        gline.m_mask = move.mask;
+        memcpy(gline.m_axis, move.axis, sizeof(move.axis));
+        if (gline.has(E) && m_config.use_relative_e_distances)
+            m_position[E] = 0;
+        const char *c = ptr;
+        for (; ! is_end_of_line(*c); ++ c);
+        gline.m_raw_view  = std::string_view(ptr, c - ptr);
+        gline.m_raw_owned = false;
+        if (*c == '\r')
+            ++ c;
+        if (*c == '\n')
+            ++ c;
+        callback(*this, gline);
+        for (size_t i = 0; i < NUM_AXES; ++ i)
+            if (gline.has(Axis(i)))
+                m_position[i] = gline.value(Axis(i));
+        return c;
+    }
+
     // Returns false if reading the file failed.
     bool parse_file(const std::string &file, callback_t callback);
     // Collect positions of line ends in the binary G-code to be used by the G-code viewer when memory mapping and displaying section of G-code
@@ -4,6 +4,7 @@
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <assert.h>
 #include <GCode/GCodeProcessor.hpp>
 
@@ -94,9 +95,9 @@ std::string GCodeWriter::postamble() const
     return gcode.str();
 }
 
-std::string GCodeWriter::set_temperature(unsigned int temperature, GCodeFlavor flavor, bool wait, int tool, std::string comment){
+void GCodeWriter::set_temperature(std::string &out, unsigned int temperature, GCodeFlavor flavor, bool wait, int tool, std::string comment){
     if (wait && (flavor == gcfMakerWare || flavor == gcfSailfish))
-        return "";
+        return;
 
     std::string code;
     if (wait && flavor != gcfTeacup && flavor != gcfRepRapFirmware) {
@@ -113,7 +114,7 @@ std::string GCodeWriter::set_temperature(unsigned int temperature, GCodeFlavor f
             comment = "set nozzle temperature";
     }
 
-    std::ostringstream gcode;
+    GCodeAppender gcode(out);
     gcode << code << " ";
     if (flavor == gcfMach3 || flavor == gcfMachinekit) {
         gcode << "P";
@@ -132,29 +133,26 @@ std::string GCodeWriter::set_temperature(unsigned int temperature, GCodeFlavor f
 
     if ((flavor == gcfTeacup || flavor == gcfRepRapFirmware) && wait)
         gcode << "M116 ; wait for temperature to be reached\n";
-
-    return gcode.str();
 }
 
-std::string GCodeWriter::set_temperature(unsigned int temperature, bool wait, int tool) const
+void GCodeWriter::set_temperature(std::string &out, unsigned int temperature, bool wait, int tool) const
 {
     // set tool to -1 to make sure we won't emit T parameter for single extruder or SEMM
     if (!this->multiple_extruders || m_single_extruder_multi_material)
         tool = -1;
-    return set_temperature(temperature, this->config.gcode_flavor, wait, tool);
+    set_temperature(out, temperature, this->config.gcode_flavor, wait, tool);
 }
 
 // BBS
-std::string GCodeWriter::set_bed_temperature(int temperature, bool wait)
+void GCodeWriter::set_bed_temperature(std::string &out, int temperature, bool wait)
 {
     if (temperature == m_last_bed_temperature && (! wait || m_last_bed_temperature_reached))
-        return std::string();
+        return;
 
     m_last_bed_temperature = temperature;
     m_last_bed_temperature_reached = wait;
 
     std::string code, comment;
-    std::ostringstream gcode;
 
     if (wait) {
         code = "M190";
@@ -165,8 +163,7 @@ std::string GCodeWriter::set_bed_temperature(int temperature, bool wait)
         comment = "set bed temperature";
     }
 
-    gcode << code << " S" << temperature << " ; " << comment << "\n";
-    return gcode.str();
+    GCodeAppender(out) << code << " S" << temperature << " ; " << comment << "\n";
 }
 
 std::string GCodeWriter::set_chamber_temperature(int temperature, bool wait)
@@ -193,7 +190,7 @@ std::string GCodeWriter::set_chamber_temperature(int temperature, bool wait)
 }
 
 // copied from PrusaSlicer
-std::string GCodeWriter::set_acceleration_internal(Acceleration type, unsigned int acceleration)
+void GCodeWriter::set_acceleration_internal(std::string &out, Acceleration type, unsigned int acceleration)
 {
     // Clamp the acceleration to the allowed maximum.
     if (type == Acceleration::Print && m_max_acceleration > 0 && acceleration > m_max_acceleration)
@@ -206,11 +203,11 @@ std::string GCodeWriter::set_acceleration_internal(Acceleration type, unsigned i
 
     auto& last_value = separate_travel ? m_last_travel_acceleration : m_last_acceleration ;
     if (acceleration == 0 || acceleration == last_value)
-        return std::string();
+        return;
     
     last_value = acceleration;
     
-    std::ostringstream gcode;
+    GCodeAppender gcode(out);
     if (FLAVOR_IS(gcfRepetier))
         gcode << (separate_travel ? "M202 X" : "M201 X") << acceleration << " Y" << acceleration;
     else if (FLAVOR_IS(gcfRepRapFirmware) || FLAVOR_IS(gcfMarlinFirmware))
@@ -228,18 +225,16 @@ std::string GCodeWriter::set_acceleration_internal(Acceleration type, unsigned i
 
     if (GCodeWriter::full_gcode_comment) gcode << " ; adjust acceleration";
     gcode << "\n";
-    
-    return gcode.str();
 }
 
-std::string GCodeWriter::set_jerk_xy(double jerk)
+void GCodeWriter::set_jerk_xy(std::string &out, double jerk)
 {
     if (jerk < 0.01 || is_approx(jerk, m_last_jerk))
-        return std::string();
+        return;
     
     m_last_jerk = jerk;
 
-    std::ostringstream gcode;
+    GCodeAppender gcode(out);
     if (FLAVOR_IS(gcfKlipper)) {
         // Clamp the jerk to the allowed maximum.
         if (m_max_jerk_x > 0 && jerk > m_max_jerk_x)
@@ -260,17 +255,17 @@ std::string GCodeWriter::set_jerk_xy(double jerk)
         gcode << "M205 X" << jerk_x << " Y" << jerk_y;
     }
       
-    if (m_is_bbl_printers)
-        gcode << std::setprecision(2) << " Z" << m_max_jerk_z << " E" << m_max_jerk_e;
+    if (m_is_bbl_printers) {
+        gcode << " Z";
+        gcode.emit_general(m_max_jerk_z, 2) << " E";
+        gcode.emit_general(m_max_jerk_e, 2);
+    }
 
     if (GCodeWriter::full_gcode_comment) gcode << " ; adjust jerk";
     gcode << "\n";
-
-    return gcode.str();
-
 }
 
-std::string GCodeWriter::set_accel_and_jerk(unsigned int acceleration, double jerk)
+void GCodeWriter::set_accel_and_jerk(std::string &out, unsigned int acceleration, double jerk)
 {
     // Only Klipper supports setting acceleration and jerk at the same time. Throw an error if we try to do this on other flavours.
     if(FLAVOR_IS_NOT(gcfKlipper))
@@ -281,7 +276,9 @@ std::string GCodeWriter::set_accel_and_jerk(unsigned int acceleration, double je
         acceleration = m_max_acceleration;
     
     bool is_empty = true;
-    std::ostringstream gcode;
+    // Drop the command prefix again if neither the acceleration nor the jerk changes.
+    const size_t  out_size = out.size();
+    GCodeAppender gcode(out);
     gcode << "SET_VELOCITY_LIMIT";
     if (acceleration != 0 && acceleration != m_last_acceleration) {
         gcode << " ACCEL=" << acceleration;
@@ -303,53 +300,52 @@ std::string GCodeWriter::set_accel_and_jerk(unsigned int acceleration, double je
         is_empty = false;
     }
 
-    if(is_empty)
-        return std::string();
+    if(is_empty) {
+        out.resize(out_size);
+        return;
+    }
 
     if (GCodeWriter::full_gcode_comment)
         gcode << " ; adjust VELOCITY_LIMIT(accel/jerk)";
     gcode << "\n";
-
-    return gcode.str();
-
 }
 
-std::string GCodeWriter::set_junction_deviation(double junction_deviation){
-    std::ostringstream gcode;
+void GCodeWriter::set_junction_deviation(std::string &out, double junction_deviation){
+    GCodeAppender gcode(out);
     if (FLAVOR_IS(gcfMarlinFirmware) && junction_deviation > 0 && m_max_junction_deviation > 0) {
         // Clamp the junction deviation to the allowed maximum.
         gcode << "M205 J";
         if (junction_deviation <= m_max_junction_deviation) {
-            gcode << std::fixed << std::setprecision(3) << junction_deviation;
+            gcode.emit_fixed(junction_deviation, 3);
         } else {
-            gcode << std::fixed << std::setprecision(3) << m_max_junction_deviation;
+            gcode.emit_fixed(m_max_junction_deviation, 3);
         }
         if (GCodeWriter::full_gcode_comment) {
             gcode << " ; Junction Deviation";
         }
         gcode << "\n";
     }
-    return gcode.str();
 }
 
-std::string GCodeWriter::set_pressure_advance(double pa) const
+void GCodeWriter::set_pressure_advance(std::string &out, double pa) const
 {
-    std::ostringstream gcode;
     if (pa < 0)
-        return gcode.str();
+        return;
+    GCodeAppender gcode(out);
     if(m_is_bbl_printers){
         //SoftFever: set L1000 to use linear model
-        gcode << "M900 K" <<std::setprecision(4)<< pa << " L1000 M10 ; Override pressure advance value\n";
+        gcode << "M900 K";
+        gcode.emit_general(pa, 4) << " L1000 M10 ; Override pressure advance value\n";
     }
     else{
         if (FLAVOR_IS(gcfKlipper))
-            gcode << "SET_PRESSURE_ADVANCE ADVANCE=" << std::setprecision(4) << pa << "; Override pressure advance value\n";
+            gcode << "SET_PRESSURE_ADVANCE ADVANCE=";
         else if(FLAVOR_IS(gcfRepRapFirmware))
-            gcode << ("M572 D0 S") << std::setprecision(4) << pa << "; Override pressure advance value\n";
+            gcode << "M572 D0 S";
         else
-            gcode << "M900 K" <<std::setprecision(4)<< pa << "; Override pressure advance value\n";
+            gcode << "M900 K";
+        gcode.emit_general(pa, 4) << "; Override pressure advance value\n";
     }
-    return gcode.str();
 }
 
 std::string GCodeWriter::set_input_shaping(char axis, float damp, float freq) const
@@ -400,49 +396,42 @@ std::string GCodeWriter::set_input_shaping(char axis, float damp, float freq) co
 }
 
 
-std::string GCodeWriter::reset_e(bool force)
+void GCodeWriter::reset_e(std::string &out, bool force)
 {
     if (FLAVOR_IS(gcfMach3)
         || FLAVOR_IS(gcfMakerWare)
         || FLAVOR_IS(gcfSailfish))
-        return "";
+        return;
     
     if (m_extruder != nullptr) {
         if (is_zero(m_extruder->E()) && ! force)
-            return "";
+            return;
         m_extruder->reset_E();
     }
 
     if (! this->config.use_relative_e_distances) {
-        std::ostringstream gcode;
-        gcode << "G92 E0";
         //BBS
-        if (GCodeWriter::full_gcode_comment) gcode << " ; reset extrusion distance";
-        gcode << "\n";
-        return gcode.str();
-    } else {
-        return "";
+        out += GCodeWriter::full_gcode_comment ? "G92 E0 ; reset extrusion distance\n" : "G92 E0\n";
     }
 }
 
-std::string GCodeWriter::update_progress(unsigned int num, unsigned int tot, bool allow_100) const
+void GCodeWriter::update_progress(std::string &out, unsigned int num, unsigned int tot, bool allow_100) const
 {
     if (FLAVOR_IS_NOT(gcfMakerWare) && FLAVOR_IS_NOT(gcfSailfish))
-        return "";
+        return;
 
     if (config.disable_m73) {
-        return "";
+        return;
     }
     
     unsigned int percent = (unsigned int)floor(100.0 * num / tot + 0.5);
     if (!allow_100) percent = std::min(percent, (unsigned int)99);
     
-    std::ostringstream gcode;
+    GCodeAppender gcode(out);
     gcode << "M73 P" << percent;
     //BBS
     if (GCodeWriter::full_gcode_comment) gcode << " ; update progress";
     gcode << "\n";
-    return gcode.str();
 }
 
 std::string GCodeWriter::toolchange_prefix() const
@@ -452,42 +441,91 @@ std::string GCodeWriter::toolchange_prefix() const
            FLAVOR_IS(gcfSailfish)  ? "M108 T" : "T";
 }
 
-std::string GCodeWriter::toolchange(unsigned int extruder_id)
+void GCodeWriter::toolchange(std::string &out, unsigned int extruder_id)
 {
     // set the new extruder
 	auto it_extruder = Slic3r::lower_bound_by_predicate(m_extruders.begin(), m_extruders.end(), [extruder_id](const Extruder &e) { return e.id() < extruder_id; });
     assert(it_extruder != m_extruders.end() && it_extruder->id() == extruder_id);
     m_extruder = &*it_extruder;
 
-    // return the toolchange command
-    // if we are running a single-extruder setup, just set the extruder and return nothing
-    std::ostringstream gcode;
+    // append the toolchange command
+    // if we are running a single-extruder setup, just set the extruder and append nothing
     if (this->multiple_extruders || (this->config.filament_diameter.values.size() > 1 && !is_bbl_printers())) {
+        GCodeAppender gcode(out);
         gcode << this->toolchange_prefix() << extruder_id;
         //BBS
         if (GCodeWriter::full_gcode_comment)
             gcode << " ; change extruder";
         gcode << "\n";
-        gcode << this->reset_e(true);
+        this->reset_e(out, true);
     }
-    return gcode.str();
 }
 
-std::string GCodeWriter::set_speed(double F, const std::string &comment, const std::string &cooling_marker)
+void GCodeWriter::start_after(const std::vector<Extruder> &extruders, unsigned int extruder_id)
+{
+    assert(extruders.size() == m_extruders.size());
+    for (size_t i = 0; i < m_extruders.size(); ++ i) {
+        assert(extruders[i].id() == m_extruders[i].id());
+        m_extruders[i].reset();
+        m_extruders[i].set_retracted(extruders[i].retracted(), extruders[i].restart_extra());
+    }
+    auto it_extruder = Slic3r::lower_bound_by_predicate(m_extruders.begin(), m_extruders.end(), [extruder_id](const Extruder &e) { return e.id() < extruder_id; });
+    assert(it_extruder != m_extruders.end() && it_extruder->id() == extruder_id);
+    m_extruder = &*it_extruder;
+
+    m_last_acceleration        = 0;
+    m_last_travel_acceleration = 0;
+    m_last_jerk                = 0;
+    m_current_speed            = 0;
+    m_lifted                   = 0;
+    m_to_lift                  = 0;
+    m_to_lift_type             = LiftType::NormalLift;
+    m_is_current_pos_clear     = false;
+    m_gcode_label_objects_start.clear();
+    m_gcode_label_objects_end.clear();
+}
+
+void GCodeWriter::continue_from(const GCodeWriter &other)
+{
+    assert(other.m_extruders.size() == m_extruders.size());
+    for (size_t i = 0; i < m_extruders.size(); ++ i)
+        m_extruders[i].continue_from(other.m_extruders[i]);
+    m_extruder = &m_extruders[other.m_extruder - other.m_extruders.data()];
+
+    // Zero if the other writer did not emit them, then the values emitted by this writer are still valid.
+    if (other.m_last_acceleration != 0)
+        m_last_acceleration = other.m_last_acceleration;
+    if (other.m_last_travel_acceleration != 0)
+        m_last_travel_acceleration = other.m_last_travel_acceleration;
+    if (other.m_last_jerk != 0)
+        m_last_jerk = other.m_last_jerk;
+    if (other.m_current_speed != 0)
+        m_current_speed = other.m_current_speed;
+
+    m_lifted                    = other.m_lifted;
+    m_to_lift                   = other.m_to_lift;
+    m_to_lift_type              = other.m_to_lift_type;
+    m_pos                       = other.m_pos;
+    m_is_current_pos_clear      = other.m_is_current_pos_clear;
+    m_gcode_label_objects_start = other.m_gcode_label_objects_start;
+    m_gcode_label_objects_end   = other.m_gcode_label_objects_end;
+}
+
+void GCodeWriter::set_speed(std::string &out, double F, const std::string &comment, const std::string &cooling_marker)
 {
     assert(F > 0.);
     assert(F < 100000.);
     
     m_current_speed = F;
-    GCodeG1Formatter w;
+    GCodeG1Formatter w(this->move_recorder());
     w.emit_f(F);
     //BBS
     w.emit_comment(GCodeWriter::full_gcode_comment, comment);
     w.emit_string(cooling_marker);
-    return w.string();
+    w.append_to(out);
 }
 
-std::string GCodeWriter::travel_to_xy(const Vec2d &point, const std::string &comment)
+void GCodeWriter::travel_to_xy(std::string &out, const Vec2d &point, const std::string &comment)
 {
     m_pos(0) = point(0);
     m_pos(1) = point(1);
@@ -496,14 +534,14 @@ std::string GCodeWriter::travel_to_xy(const Vec2d &point, const std::string &com
     //BBS: take plate offset into consider
     Vec2d point_on_plate = { point(0) - m_x_offset, point(1) - m_y_offset };
     
-    GCodeG1Formatter w;
+    GCodeG1Formatter w(this->move_recorder());
     w.emit_xy(point_on_plate);
     auto speed = m_is_first_layer
         ? this->config.get_abs_value("initial_layer_travel_speed") : this->config.travel_speed.value;
     w.emit_f(speed * 60.0);
     //BBS
     w.emit_comment(GCodeWriter::full_gcode_comment, comment);
-    return w.string();
+    w.append_to(out);
 }
 
 std::string GCodeWriter::travel_to_xyz(const Vec3d &point, const std::string &comment, bool force_z)
@@ -560,7 +598,7 @@ std::string GCodeWriter::travel_to_xyz(const Vec3d &point, const std::string &co
                 //  /       to make the z list early to avoid to hit some warping place when travel is long.
                 Vec2d temp = delta_no_z.normalized() * delta(2) / tan(this->extruder()->travel_slope());
                 Vec3d slope_top_point = Vec3d(temp(0), temp(1), delta(2)) + source;
-                GCodeG1Formatter w0;
+                GCodeG1Formatter w0(this->move_recorder());
                 w0.emit_xyz(slope_top_point);
                 w0.emit_f(travel_speed * 60.0);
                 //BBS
@@ -574,7 +612,7 @@ std::string GCodeWriter::travel_to_xyz(const Vec3d &point, const std::string &co
 
         std::string xy_z_move;
         {
-            GCodeG1Formatter w0;
+            GCodeG1Formatter w0(this->move_recorder());
             if (this->is_current_position_clear()) {
                 w0.emit_xyz(target);
                 w0.emit_f(travel_speed * 60.0);
@@ -612,7 +650,7 @@ std::string GCodeWriter::travel_to_xyz(const Vec3d &point, const std::string &co
     //BBS: take plate offset into consider
     Vec3d point_on_plate = { dest_point(0) - m_x_offset, dest_point(1) - m_y_offset, dest_point(2) };
     std::string out_string;
-    GCodeG1Formatter w;
+    GCodeG1Formatter w(this->move_recorder());
     if (!this->is_current_position_clear())
     {
         //force to move xy first then z after filament change
@@ -621,7 +659,7 @@ std::string GCodeWriter::travel_to_xyz(const Vec3d &point, const std::string &co
         w.emit_comment(GCodeWriter::full_gcode_comment, comment);
         out_string = w.string() + _travel_to_z(point_on_plate.z(), comment);
     } else {
-        GCodeG1Formatter w;
+        GCodeG1Formatter w(this->move_recorder());
         w.emit_xyz(point_on_plate);
         w.emit_f(this->config.travel_speed.value * 60.0);
         w.emit_comment(GCodeWriter::full_gcode_comment, comment);
@@ -662,7 +700,7 @@ std::string GCodeWriter::_travel_to_z(double z, const std::string &comment)
                                  : this->config.travel_speed.value;
     }
     
-    GCodeG1Formatter w;
+    GCodeG1Formatter w(this->move_recorder());
     w.emit_z(z);
     w.emit_f(speed * 60.0);
     //BBS
@@ -681,7 +719,7 @@ std::string GCodeWriter::_spiral_travel_to_z(double z, const Vec2d &ij_offset, c
     }
     
     std::string output = "G17\n";
-    GCodeG2G3Formatter w(true);
+    GCodeG2G3Formatter w(true, this->move_recorder());
     w.emit_z(z);
     w.emit_ij(ij_offset);
     w.emit_string(" P1 ");
@@ -707,7 +745,7 @@ bool GCodeWriter::will_move_z(double z) const
     return true;
 }
 
-std::string GCodeWriter::extrude_to_xy(const Vec2d &point, double dE, const std::string &comment, bool force_no_extrusion)
+void GCodeWriter::extrude_to_xy(std::string &out, const Vec2d &point, double dE, const std::string &comment, bool force_no_extrusion)
 {
     m_pos(0) = point(0);
     m_pos(1) = point(1);
@@ -720,19 +758,19 @@ std::string GCodeWriter::extrude_to_xy(const Vec2d &point, double dE, const std:
     //BBS: take plate offset into consider
     Vec2d point_on_plate = { point(0) - m_x_offset, point(1) - m_y_offset };
 
-    GCodeG1Formatter w;
+    GCodeG1Formatter w(this->move_recorder());
     w.emit_xy(point_on_plate);
     if (!force_no_extrusion)
         w.emit_e(m_extruder->E());
     //BBS
     w.emit_comment(GCodeWriter::full_gcode_comment, comment);
-    return w.string();
+    w.append_to(out);
 }
 
 //BBS: generate G2 or G3 extrude which moves by arc
 //point is end point which means X and Y axis
 //center_offset is I and J axis
-std::string GCodeWriter::extrude_arc_to_xy(const Vec2d& point, const Vec2d& center_offset, double dE, const bool is_ccw, const std::string& comment, bool force_no_extrusion)
+void GCodeWriter::extrude_arc_to_xy(std::string &out, const Vec2d& point, const Vec2d& center_offset, double dE, const bool is_ccw, const std::string& comment, bool force_no_extrusion)
 {
     m_pos(0) = point(0);
     m_pos(1) = point(1);
@@ -741,17 +779,17 @@ std::string GCodeWriter::extrude_arc_to_xy(const Vec2d& point, const Vec2d& cent
 
     Vec2d point_on_plate = { point(0) - m_x_offset, point(1) - m_y_offset };
 
-    GCodeG2G3Formatter w(is_ccw);
+    GCodeG2G3Formatter w(is_ccw, this->move_recorder());
     w.emit_xy(point_on_plate);
     w.emit_ij(center_offset);
     if (!force_no_extrusion)
         w.emit_e(m_extruder->E());
     //BBS
     w.emit_comment(GCodeWriter::full_gcode_comment, comment);
-    return w.string();
+    w.append_to(out);
 }
 
-std::string GCodeWriter::extrude_to_xyz(const Vec3d &point, double dE, const std::string &comment, bool force_no_extrusion)
+void GCodeWriter::extrude_to_xyz(std::string &out, const Vec3d &point, double dE, const std::string &comment, bool force_no_extrusion)
 {
     m_pos = point;
     m_lifted = 0;
@@ -761,13 +799,13 @@ std::string GCodeWriter::extrude_to_xyz(const Vec3d &point, double dE, const std
     //BBS: take plate offset into consider
     Vec3d point_on_plate = { point(0) - m_x_offset, point(1) - m_y_offset, point(2) };
 
-    GCodeG1Formatter w;
+    GCodeG1Formatter w(this->move_recorder());
     w.emit_xyz(point_on_plate);
     if (!force_no_extrusion)
         w.emit_e(m_extruder->E());
     //BBS
     w.emit_comment(GCodeWriter::full_gcode_comment, comment);
-    return w.string();
+    w.append_to(out);
 }
 
 std::string GCodeWriter::retract(bool before_wipe, double retract_length)
@@ -807,7 +845,7 @@ std::string GCodeWriter::_retract(double length, double restart_extra, const std
         }
         else {
             // BBS
-            GCodeG1Formatter w;
+            GCodeG1Formatter w(this->move_recorder());
             w.emit_e(m_extruder->E());
             w.emit_f(m_extruder->retract_speed() * 60.);
             // BBS
@@ -837,7 +875,7 @@ std::string GCodeWriter::unretract()
         else {
             //BBS
             // use G1 instead of G0 because G0 will blend the restart with the previous travel move
-            GCodeG1Formatter w;
+            GCodeG1Formatter w(this->move_recorder());
             w.emit_e(m_extruder->E());
             w.emit_f(m_extruder->deretract_speed() * 60.);
             //BBS
@@ -887,9 +925,9 @@ std::string GCodeWriter::unlift()
     return gcode;
 }
 
-std::string GCodeWriter::set_fan(const GCodeFlavor gcode_flavor, unsigned int speed)
+void GCodeWriter::set_fan(std::string &out, const GCodeFlavor gcode_flavor, unsigned int speed)
 {
-    std::ostringstream gcode;
+    GCodeAppender gcode(out);
     if (speed == 0) {
         switch (gcode_flavor) {
         case gcfTeacup:
@@ -918,19 +956,19 @@ std::string GCodeWriter::set_fan(const GCodeFlavor gcode_flavor, unsigned int sp
             gcode << " ; enable fan";
         gcode << "\n";
     }
-    return gcode.str();
 }
 
-std::string GCodeWriter::set_fan(unsigned int speed) const
+void GCodeWriter::set_fan(std::string &out, unsigned int speed) const
 {
     //BBS
-    return GCodeWriter::set_fan(this->config.gcode_flavor, speed);
+    GCodeWriter::set_fan(out, this->config.gcode_flavor, speed);
 }
 
 //BBS: set additional fan speed for BBS machine only
 std::string GCodeWriter::set_additional_fan(unsigned int speed)
 {
-    std::ostringstream gcode;
+    std::string   out;
+    GCodeAppender gcode(out);
 
     gcode << "M106 " << "P2 " << "S" << (int)(255.0 * speed / 100.0);
     if (GCodeWriter::full_gcode_comment) {
@@ -940,17 +978,18 @@ std::string GCodeWriter::set_additional_fan(unsigned int speed)
             gcode << " ; enable additional fan ";
     }
     gcode << "\n";
-    return gcode.str();
+    return out;
 }
 
 std::string GCodeWriter::set_exhaust_fan( int speed,bool add_eol)
 {
-    std::ostringstream gcode;
+    std::string   out;
+    GCodeAppender gcode(out);
     gcode << "M106" << " P3" << " S" << (int)(speed / 100.0 * 255);
 
     if(add_eol)
         gcode << "\n";
-    return gcode.str();
+    return out;
 }
 
 void GCodeWriter::add_object_start_labels(std::string& gcode)
@@ -1023,6 +1062,23 @@ void GCodeFormatter::emit_axis(const char axis, const double v, size_t digits) {
         *(++this->ptr_err.ptr) = '0';
     this->ptr_err.ptr++;
 
+    // Capture the value as a parser reads it back from the text just emitted.
+    int axis_idx = -1;
+    switch (axis) {
+    case 'X': axis_idx = int(X); break;
+    case 'Y': axis_idx = int(Y); break;
+    case 'Z': axis_idx = int(Z); break;
+    case 'E': axis_idx = int(E); break;
+    case 'F': axis_idx = int(F); break;
+    case 'I': axis_idx = int(I); break;
+    case 'J': axis_idx = int(J); break;
+    default:  m_typed = false; break;
+    }
+    if (axis_idx >= 0) {
+        m_mask |= 1 << axis_idx;
+        m_axis[axis_idx] = float(double(v_int) / double(pow_10[digits]));
+    }
+
 #if 0 // #ifndef NDEBUG
     {
         // Verify that the optimized formatter produces the same result as the standard sprintf().
@@ -1039,4 +1095,49 @@ void GCodeFormatter::emit_axis(const char axis, const double v, size_t digits) {
 #endif // NDEBUG
 }
 
+void GCodeFormatter::record()
+{
+    // Only the "G0 " .. "G3 " lines with nothing but the axes and an optional comment are typed.
+    if (m_recorder == nullptr || ! m_typed || m_mask == 0 || ptr_err.ptr - buf < 4 ||
+        buf[0] != 'G' || buf[1] < '0' || buf[1] > '3' || buf[2] != ' ')
+        return;
+    GCodeMove move;
+    move.type = GCodeMove::Type(buf[1] - '0');
+    move.mask = m_mask;
+    for (int i = 0; i < int(NUM_AXES); ++ i)
+        move.axis[i] = (m_mask & (1 << i)) ? m_axis[i] : 0.f;
+    m_recorder->record(move, buf, ptr_err.ptr);
+}
+
+void GCodeAppender::emit_integer(int64_t v)
+{
+    char buf[24];
+#ifdef __APPLE__
+    // See GCodeFormatter::emit_axis().
+    char *end = buf;
+    boost::spirit::karma::generate(end, boost::spirit::karma::int_generator<int64_t>(), v);
+#else
+    char *end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+#endif
+    m_out.append(buf, end);
+}
+
+void GCodeAppender::emit_double(double v, std::chars_format format, int precision)
+{
+#ifdef __cpp_lib_to_chars
+    char buf[128];
+    if (auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), v, format, precision); ec == std::errc()) {
+        m_out.append(buf, end);
+        return;
+    }
+#endif
+    // Floating point std::to_chars is not supported by the standard library or the number does not fit.
+    std::ostringstream ss;
+    ss.imbue(std::locale::classic());
+    if (format == std::chars_format::fixed)
+        ss << std::fixed;
+    ss << std::setprecision(precision) << v;
+    m_out += ss.str();
+}
+
 } // namespace Slic3r
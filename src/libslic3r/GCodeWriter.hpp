@@ -3,11 +3,14 @@
 
 #include "libslic3r.h"
 #include <string>
+#include <string_view>
 #include <charconv>
+#include <type_traits>
 #include "Extruder.hpp"
 #include "Point.hpp"
 #include "PrintConfig.hpp"
 #include "GCode/CoolingBuffer.hpp"
+#include "GCode/GCodeMoves.hpp"
 
 namespace Slic3r {
 
@@ -43,41 +46,74 @@ public:
     }
     std::string preamble();
     std::string postamble() const;
-    static std::string set_temperature(unsigned int temperature, GCodeFlavor flavor, bool wait = false, int tool = -1, std::string comment = std::string());
-
-    std::string set_temperature(unsigned int temperature, bool wait = false, int tool = -1) const;
-    std::string set_bed_temperature(int temperature, bool wait = false);
+    static std::string set_temperature(unsigned int temperature, GCodeFlavor flavor, bool wait = false, int tool = -1, std::string comment = std::string())
+        { std::string out; set_temperature(out, temperature, flavor, wait, tool, std::move(comment)); return out; }
+    // The overloads taking std::string &out append the command to out, which may be reused by the caller
+    // to avoid allocating a string per command.
+    static void        set_temperature(std::string &out, unsigned int temperature, GCodeFlavor flavor, bool wait = false, int tool = -1, std::string comment = std::string());
+
+    std::string set_temperature(unsigned int temperature, bool wait = false, int tool = -1) const
+        { std::string out; this->set_temperature(out, temperature, wait, tool); return out; }
+    void        set_temperature(std::string &out, unsigned int temperature, bool wait = false, int tool = -1) const;
+    std::string set_bed_temperature(int temperature, bool wait = false)
+        { std::string out; this->set_bed_temperature(out, temperature, wait); return out; }
+    void        set_bed_temperature(std::string &out, int temperature, bool wait = false);
     std::string set_chamber_temperature(int temperature, bool wait = false);
-    std::string set_print_acceleration(unsigned int acceleration)   { return set_acceleration_internal(Acceleration::Print, acceleration); }
-    std::string set_travel_acceleration(unsigned int acceleration)  { return set_acceleration_internal(Acceleration::Travel, acceleration); }
-    std::string set_jerk_xy(double jerk);
+    std::string set_print_acceleration(unsigned int acceleration)   { std::string out; set_acceleration_internal(out, Acceleration::Print, acceleration); return out; }
+    void        set_print_acceleration(std::string &out, unsigned int acceleration)  { set_acceleration_internal(out, Acceleration::Print, acceleration); }
+    std::string set_travel_acceleration(unsigned int acceleration)  { std::string out; set_acceleration_internal(out, Acceleration::Travel, acceleration); return out; }
+    void        set_travel_acceleration(std::string &out, unsigned int acceleration) { set_acceleration_internal(out, Acceleration::Travel, acceleration); }
+    std::string set_jerk_xy(double jerk) { std::string out; this->set_jerk_xy(out, jerk); return out; }
+    void        set_jerk_xy(std::string &out, double jerk);
     // Orca: set acceleration and jerk in one command for Klipper
-    std::string set_accel_and_jerk(unsigned int acceleration, double jerk);
-    std::string set_junction_deviation(double junction_deviation); 
-    std::string set_pressure_advance(double pa) const;
+    std::string set_accel_and_jerk(unsigned int acceleration, double jerk)
+        { std::string out; this->set_accel_and_jerk(out, acceleration, jerk); return out; }
+    void        set_accel_and_jerk(std::string &out, unsigned int acceleration, double jerk);
+    std::string set_junction_deviation(double junction_deviation)
+        { std::string out; this->set_junction_deviation(out, junction_deviation); return out; }
+    void        set_junction_deviation(std::string &out, double junction_deviation);
+    std::string set_pressure_advance(double pa) const { std::string out; this->set_pressure_advance(out, pa); return out; }
+    void        set_pressure_advance(std::string &out, double pa) const;
     std::string set_input_shaping(char axis, float damp, float freq) const;
-    std::string reset_e(bool force = false);
-    std::string update_progress(unsigned int num, unsigned int tot, bool allow_100 = false) const;
+    std::string reset_e(bool force = false) { std::string out; this->reset_e(out, force); return out; }
+    void        reset_e(std::string &out, bool force = false);
+    std::string update_progress(unsigned int num, unsigned int tot, bool allow_100 = false) const
+        { std::string out; this->update_progress(out, num, tot, allow_100); return out; }
+    void        update_progress(std::string &out, unsigned int num, unsigned int tot, bool allow_100 = false) const;
     // return false if this extruder was already selected
     bool        need_toolchange(unsigned int extruder_id) const 
         { return m_extruder == nullptr || m_extruder->id() != extruder_id; }
     std::string set_extruder(unsigned int extruder_id)
         { return this->need_toolchange(extruder_id) ? this->toolchange(extruder_id) : ""; }
+    void        set_extruder(std::string &out, unsigned int extruder_id)
+        { if (this->need_toolchange(extruder_id)) this->toolchange(out, extruder_id); }
     // Prefix of the toolchange G-code line, to be used by the CoolingBuffer to separate sections of the G-code
     // printed with the same extruder.
     std::string toolchange_prefix() const;
-    std::string toolchange(unsigned int extruder_id);
-    std::string set_speed(double F, const std::string &comment = std::string(), const std::string &cooling_marker = std::string());
+    std::string toolchange(unsigned int extruder_id) { std::string out; this->toolchange(out, extruder_id); return out; }
+    void        toolchange(std::string &out, unsigned int extruder_id);
+    std::string set_speed(double F, const std::string &comment = std::string(), const std::string &cooling_marker = std::string())
+        { std::string out; this->set_speed(out, F, comment, cooling_marker); return out; }
+    void        set_speed(std::string &out, double F, const std::string &comment = std::string(), const std::string &cooling_marker = std::string());
     // SoftFever NOTE: the returned speed is mm/minute
     double      get_current_speed() const { return m_current_speed;}
-    std::string travel_to_xy(const Vec2d &point, const std::string &comment = std::string());
+    std::string travel_to_xy(const Vec2d &point, const std::string &comment = std::string())
+        { std::string out; this->travel_to_xy(out, point, comment); return out; }
+    // Appends the move to out, which may be reused by the caller to avoid allocating a string per move.
+    void        travel_to_xy(std::string &out, const Vec2d &point, const std::string &comment = std::string());
     std::string travel_to_xyz(const Vec3d &point, const std::string &comment = std::string(), bool force_z = false);
     std::string travel_to_z(double z, const std::string &comment = std::string(), bool force = false);
     bool        will_move_z(double z) const;
-    std::string extrude_to_xy(const Vec2d &point, double dE, const std::string &comment = std::string(), bool force_no_extrusion = false);
+    std::string extrude_to_xy(const Vec2d &point, double dE, const std::string &comment = std::string(), bool force_no_extrusion = false)
+        { std::string out; this->extrude_to_xy(out, point, dE, comment, force_no_extrusion); return out; }
+    void        extrude_to_xy(std::string &out, const Vec2d &point, double dE, const std::string &comment = std::string(), bool force_no_extrusion = false);
     //BBS: generate G2 or G3 extrude which moves by arc
-    std::string extrude_arc_to_xy(const Vec2d &point, const Vec2d &center_offset, double dE, const bool is_ccw, const std::string &comment = std::string(), bool force_no_extrusion = false);
-    std::string extrude_to_xyz(const Vec3d &point, double dE, const std::string &comment = std::string(), bool force_no_extrusion = false);
+    std::string extrude_arc_to_xy(const Vec2d &point, const Vec2d &center_offset, double dE, const bool is_ccw, const std::string &comment = std::string(), bool force_no_extrusion = false)
+        { std::string out; this->extrude_arc_to_xy(out, point, center_offset, dE, is_ccw, comment, force_no_extrusion); return out; }
+    void        extrude_arc_to_xy(std::string &out, const Vec2d &point, const Vec2d &center_offset, double dE, const bool is_ccw, const std::string &comment = std::string(), bool force_no_extrusion = false);
+    std::string extrude_to_xyz(const Vec3d &point, double dE, const std::string &comment = std::string(), bool force_no_extrusion = false)
+        { std::string out; this->extrude_to_xyz(out, point, dE, comment, force_no_extrusion); return out; }
+    void        extrude_to_xyz(std::string &out, const Vec3d &point, double dE, const std::string &comment = std::string(), bool force_no_extrusion = false);
     std::string retract(bool before_wipe = false, double retract_length = 0);
     std::string retract_for_toolchange(bool before_wipe = false, double retract_length = 0);
     std::string unretract();
@@ -87,15 +123,31 @@ public:
     Vec3d&       get_position() { return m_pos; }
     void        set_position(const Vec3d& in) { m_pos = in; }
     double      get_zhop() const { return m_lifted; }
+    // Z hop requested by lift() to be applied by the next travel.
+    double      get_zhop_to_lift() const { return m_to_lift; }
+    LiftType    get_zhop_to_lift_type() const { return m_to_lift_type; }
+    // Starts generating G-code to be appended to the G-code of another writer, which had the extruder_id selected and
+    // its extruders in the retraction state of extruders. The axes and the tachometers of the extruders are reset,
+    // the position becomes unknown and the cached acceleration, jerk and feedrate are dropped, thus they are emitted
+    // on their first use. See GCode::process_layers().
+    void        start_after(const std::vector<Extruder> &extruders, unsigned int extruder_id);
+    // Continues with the state of a writer started by start_after() from the state of this writer.
+    void        continue_from(const GCodeWriter &other);
+    // Record the moves formatted, so that GCode::process_layer() binds them to the G-code of the layer.
+    void                set_record_moves(bool record) { m_record_moves = record; }
+    GCodeMoveRecorder&  moves() { return m_moves; }
 
     //BBS: set offset for gcode writer
     void set_xy_offset(double x, double y) { m_x_offset = x; m_y_offset = y; }
     Vec2f get_xy_offset() { return Vec2f{m_x_offset, m_y_offset}; };
     // To be called by the CoolingBuffer from another thread.
-    static std::string set_fan(const GCodeFlavor gcode_flavor, unsigned int speed);
+    static std::string set_fan(const GCodeFlavor gcode_flavor, unsigned int speed)
+        { std::string out; set_fan(out, gcode_flavor, speed); return out; }
+    static void        set_fan(std::string &out, const GCodeFlavor gcode_flavor, unsigned int speed);
     // To be called by the main thread. It always emits the G-code, it does not remember the previous state.
     // Keeping the state is left to the CoolingBuffer, which runs asynchronously on another thread.
-    std::string set_fan(unsigned int speed) const;
+    std::string set_fan(unsigned int speed) const { std::string out; this->set_fan(out, speed); return out; }
+    void        set_fan(std::string &out, unsigned int speed) const;
     //BBS: set additional fan speed for BBS machine only
     static std::string set_additional_fan(unsigned int speed);
     static std::string set_exhaust_fan(int speed,bool add_eol);
@@ -169,6 +221,10 @@ public:
     bool            m_is_bbl_printers = false;
     double          m_current_speed;
     bool            m_is_first_layer = true;
+    bool            m_record_moves = false;
+    GCodeMoveRecorder m_moves;
+
+    GCodeMoveRecorder* move_recorder() { return m_record_moves ? &m_moves : nullptr; }
 
     enum class Acceleration {
         Travel,
@@ -178,13 +234,14 @@ public:
     std::string _travel_to_z(double z, const std::string &comment);
     std::string _spiral_travel_to_z(double z, const Vec2d &ij_offset, const std::string &comment);
     std::string _retract(double length, double restart_extra, const std::string &comment);
-    std::string set_acceleration_internal(Acceleration type, unsigned int acceleration);
+    void        set_acceleration_internal(std::string &out, Acceleration type, unsigned int acceleration);
 
 };
 
 class GCodeFormatter {
 public:
-    GCodeFormatter() {
+    // If recorder is set, the G0 / G1 / G2 / G3 lines formatted are recorded there as typed moves.
+    GCodeFormatter(GCodeMoveRecorder *recorder = nullptr) : m_recorder(recorder) {
         this->buf_end = buf + buflen;
         this->ptr_err.ptr = this->buf;
     }
@@ -247,32 +304,55 @@ public:
     }
 
     void emit_string(const std::string &s) {
-        strncpy(ptr_err.ptr, s.c_str(), s.size());
-        ptr_err.ptr += s.size();
+        // Anything but a comment may add words, which are not captured by the typed move.
+        if (! s.empty() && s.front() != ';')
+            m_typed = false;
+        this->append_chars(s);
     }
 
     void emit_comment(bool allow_comments, const std::string &comment) {
         if (allow_comments && ! comment.empty()) {
             *ptr_err.ptr ++ = ' '; *ptr_err.ptr ++ = ';'; *ptr_err.ptr ++ = ' ';
-            this->emit_string(comment);
+            this->append_chars(comment);
         }
     }
 
     std::string string() {
         *ptr_err.ptr ++ = '\n';
+        this->record();
         return std::string(this->buf, ptr_err.ptr - buf);
     }
 
+    // Appends the line to out instead of returning a new string.
+    void append_to(std::string &out) {
+        *ptr_err.ptr ++ = '\n';
+        this->record();
+        out.append(this->buf, ptr_err.ptr - buf);
+    }
+
 protected:
+    void append_chars(const std::string &s) {
+        strncpy(ptr_err.ptr, s.c_str(), s.size());
+        ptr_err.ptr += s.size();
+    }
+    // Record the line finished with a newline as a typed move.
+    void record();
+
     static constexpr const size_t   buflen = 256;
     char                            buf[buflen];
     char* buf_end;
     std::to_chars_result            ptr_err;
+
+    GCodeMoveRecorder              *m_recorder { nullptr };
+    // The axes emitted, as GCodeMove::mask and GCodeMove::axis.
+    uint32_t                        m_mask { 0 };
+    float                           m_axis[NUM_AXES];
+    bool                            m_typed { true };
 };
 
 class GCodeG1Formatter : public GCodeFormatter {
 public:
-    GCodeG1Formatter() {
+    GCodeG1Formatter(GCodeMoveRecorder *recorder = nullptr) : GCodeFormatter(recorder) {
         this->buf[0] = 'G';
         this->buf[1] = '1';
         this->buf_end = buf + buflen;
@@ -285,7 +365,7 @@ public:
 
 class GCodeG2G3Formatter : public GCodeFormatter {
 public:
-    GCodeG2G3Formatter(bool is_ccw) {
+    GCodeG2G3Formatter(bool is_ccw, GCodeMoveRecorder *recorder = nullptr) : GCodeFormatter(recorder) {
         this->buf[0] = 'G';
         this->buf[1] = is_ccw ? '3' : '2';
         this->buf_end = buf + buflen;
@@ -296,6 +376,35 @@ public:
     GCodeG2G3Formatter& operator=(const GCodeG2G3Formatter&) = delete;
 };
 
+// Appends G-code of arbitrary length to a string, replacing std::ostringstream. The numbers are formatted with std::to_chars
+// independently of the locale, the same way std::ostream formats them in the "C" locale.
+class GCodeAppender {
+public:
+    explicit GCodeAppender(std::string &out) : m_out(out) {}
+
+    GCodeAppender(const GCodeAppender&) = delete;
+    GCodeAppender& operator=(const GCodeAppender&) = delete;
+
+    GCodeAppender& operator<<(std::string_view s) { m_out += s; return *this; }
+    GCodeAppender& operator<<(const char *s) { m_out += s; return *this; }
+    GCodeAppender& operator<<(char c) { m_out += c; return *this; }
+    template<typename T, typename std::enable_if_t<std::is_integral_v<T> && ! std::is_same_v<T, char> && ! std::is_same_v<T, bool>, int> = 0>
+    GCodeAppender& operator<<(T v) { this->emit_integer(int64_t(v)); return *this; }
+    // std::ostream default: 6 significant digits.
+    GCodeAppender& operator<<(double v) { return this->emit_general(v, 6); }
+
+    // Same as std::setprecision(precision) << v.
+    GCodeAppender& emit_general(double v, int precision) { this->emit_double(v, std::chars_format::general, precision); return *this; }
+    // Same as std::fixed << std::setprecision(precision) << v.
+    GCodeAppender& emit_fixed(double v, int precision) { this->emit_double(v, std::chars_format::fixed, precision); return *this; }
+
+private:
+    void emit_integer(int64_t v);
+    void emit_double(double v, std::chars_format format, int precision);
+
+    std::string &m_out;
+};
+
 } /* namespace Slic3r */
 
 #endif /* slic3r_GCodeWriter_hpp_ */
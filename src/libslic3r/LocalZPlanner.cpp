@@ -0,0 +1,521 @@
+#include "LocalZPlanner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <boost/log/trivial.hpp>
+
+#include "ClipperUtils.hpp"
+#include "MixedFilament.hpp"
+
+namespace Slic3r {
+
+bool fit_pass_heights_to_interval(std::vector<double> &passes, double base_height, double lo, double hi)
+{
+    if (passes.empty() || base_height <= EPSILON)
+        return false;
+
+    double sum = std::accumulate(passes.begin(), passes.end(), 0.0);
+    double delta = base_height - sum;
+
+    auto within = [lo, hi](double h) { return h >= lo - EPSILON && h <= hi + EPSILON; };
+    if (std::abs(delta) > EPSILON) {
+        if (within(passes.back() + delta)) {
+            passes.back() += delta;
+            delta = 0.0;
+        } else if (delta > 0.0) {
+            for (size_t i = passes.size(); i > 0 && delta > EPSILON; --i) {
+                double &h = passes[i - 1];
+                const double room = hi - h;
+                if (room <= EPSILON)
+                    continue;
+                const double take = std::min(room, delta);
+                h += take;
+                delta -= take;
+            }
+        } else {
+            for (size_t i = passes.size(); i > 0 && delta < -EPSILON; --i) {
+                double &h = passes[i - 1];
+                const double room = h - lo;
+                if (room <= EPSILON)
+                    continue;
+                const double take = std::min(room, -delta);
+                h -= take;
+                delta += take;
+            }
+        }
+    }
+
+    if (std::abs(delta) > 1e-6)
+        return false;
+    return std::all_of(passes.begin(), passes.end(), within);
+}
+
+static std::vector<double> build_uniform_local_z_pass_heights(double base_height, double lo, double hi)
+{
+    std::vector<double> out;
+    if (base_height <= EPSILON)
+        return out;
+
+    size_t min_passes = size_t(std::max<double>(1.0, std::ceil((base_height - EPSILON) / hi)));
+    size_t max_passes = size_t(std::max<double>(1.0, std::floor((base_height + EPSILON) / lo)));
+    size_t pass_count = min_passes;
+
+    if (max_passes >= min_passes) {
+        const double target_step = 0.5 * (lo + hi);
+        const size_t target_passes =
+            size_t(std::max<double>(1.0, std::llround(base_height / std::max<double>(target_step, EPSILON))));
+        pass_count = std::clamp(target_passes, min_passes, max_passes);
+    }
+
+    if (pass_count == 1 && base_height >= 2.0 * lo - EPSILON && max_passes >= 2)
+        pass_count = 2;
+
+    if (pass_count <= 1) {
+        out.emplace_back(base_height);
+        return out;
+    }
+
+    const double uniform_height = base_height / double(pass_count);
+    out.assign(pass_count, uniform_height);
+
+    // Keep the accumulated numeric error at the very top of the interval.
+    double accumulated = 0.0;
+    for (size_t i = 0; i + 1 < out.size(); ++i)
+        accumulated += out[i];
+    out.back() = std::max<double>(EPSILON, base_height - accumulated);
+    return out;
+}
+
+static inline void compute_local_z_gradient_component_heights(int mix_b_percent, double lower_bound, double upper_bound,
+                                                              double &h_a, double &h_b)
+{
+    const int mix_b = std::clamp(mix_b_percent, 0, 100);
+    const double pct_b = double(mix_b) / 100.0;
+    const double pct_a = 1.0 - pct_b;
+    const double lo    = std::max<double>(0.01, lower_bound);
+    const double hi    = std::max<double>(lo, upper_bound);
+    h_a = lo + pct_a * (hi - lo);
+    h_b = lo + pct_b * (hi - lo);
+}
+
+std::vector<double> build_local_z_alternating_pass_heights(double base_height,
+                                                           double lower_bound,
+                                                           double upper_bound,
+                                                           double gradient_h_a,
+                                                           double gradient_h_b)
+{
+    if (base_height <= EPSILON)
+        return {};
+
+    const double lo = std::max<double>(0.01, lower_bound);
+    const double hi = std::max<double>(lo, upper_bound);
+    if (base_height < 2.0 * lo - EPSILON)
+        return { base_height };
+
+    const double cycle_h = std::max<double>(EPSILON, gradient_h_a + gradient_h_b);
+    const double ratio_a = std::clamp(gradient_h_a / cycle_h, 0.0, 1.0);
+    const double ratio_b = 1.0 - ratio_a;
+
+    size_t min_passes = size_t(std::max<double>(2.0, std::ceil((base_height - EPSILON) / hi)));
+    if ((min_passes % 2) != 0)
+        ++min_passes;
+
+    size_t max_passes = size_t(std::max<double>(2.0, std::floor((base_height + EPSILON) / lo)));
+    if ((max_passes % 2) != 0)
+        --max_passes;
+    if (max_passes < 2 || min_passes > max_passes)
+        return build_uniform_local_z_pass_heights(base_height, lo, hi);
+
+    for (size_t pass_count = min_passes; pass_count <= max_passes; pass_count += 2) {
+        const size_t pair_count = pass_count / 2;
+        const double pair_h     = base_height / double(pair_count);
+        const double h_a        = pair_h * ratio_a;
+        const double h_b        = pair_h * ratio_b;
+
+        std::vector<double> out;
+        out.reserve(pass_count);
+        for (size_t pair_idx = 0; pair_idx < pair_count; ++pair_idx) {
+            out.emplace_back(h_a);
+            out.emplace_back(h_b);
+        }
+        if (fit_pass_heights_to_interval(out, base_height, lo, hi))
+            return out;
+    }
+
+    return build_uniform_local_z_pass_heights(base_height, lo, hi);
+}
+
+std::vector<double> build_local_z_pass_heights(double base_height,
+                                               double lower_bound,
+                                               double upper_bound,
+                                               double preferred_a,
+                                               double preferred_b)
+{
+    if (base_height <= EPSILON)
+        return {};
+
+    const double lo = std::max<double>(0.01, lower_bound);
+    const double hi = std::max<double>(lo, upper_bound);
+
+    std::vector<double> cadence_unit;
+    if (preferred_a > EPSILON)
+        cadence_unit.push_back(std::clamp(preferred_a, lo, hi));
+    if (preferred_b > EPSILON)
+        cadence_unit.push_back(std::clamp(preferred_b, lo, hi));
+
+    if (!cadence_unit.empty()) {
+        std::vector<double> out;
+        out.reserve(size_t(std::ceil(base_height / lo)) + 2);
+
+        double z_used = 0.0;
+        size_t idx = 0;
+        size_t guard = 0;
+        while (z_used + cadence_unit[idx] < base_height - EPSILON && guard++ < 100000) {
+            out.push_back(cadence_unit[idx]);
+            z_used += cadence_unit[idx];
+            idx = (idx + 1) % cadence_unit.size();
+        }
+
+        const double remainder = base_height - z_used;
+        if (remainder > EPSILON)
+            out.push_back(remainder);
+
+        if (fit_pass_heights_to_interval(out, base_height, lo, hi))
+            return out;
+    }
+
+    return build_uniform_local_z_pass_heights(base_height, lo, hi);
+}
+
+static bool local_z_eligible_mixed_row(const MixedFilament &mf)
+{
+    // Local-Z flow-height modulation is intended for custom gradient rows.
+    // Keep auto-generated premix rows and manual pattern rows on nominal layers.
+    return mf.enabled &&
+           mf.custom &&
+           mf.manual_pattern.empty() &&
+           mf.distribution_mode != int(MixedFilament::SameLayerPointillisme);
+}
+
+LocalZPlan build_local_z_plan(const std::vector<LocalZPlanLayer>            &layers,
+                              const std::vector<std::vector<ExPolygons>>    &segmentation,
+                              const MixedFilamentManager                    &mixed_filaments,
+                              size_t                                         num_physical,
+                              const LocalZPlanParams                        &params,
+                              const std::function<void()>                   &throw_on_cancel)
+{
+    LocalZPlan out;
+    if (layers.empty() || segmentation.size() != layers.size() || num_physical == 0)
+        return out;
+
+    const double lo     = std::max(0.01, params.lower_bound);
+    const double hi     = std::max(lo, params.upper_bound);
+    const double pref_a = std::max(0., params.preferred_a);
+    const double pref_b = std::max(0., params.preferred_b);
+    const auto  &mixed_rows = mixed_filaments.mixed_filaments();
+
+    LocalZPlanStats &stats = out.stats;
+    out.intervals.reserve(layers.size());
+    // Preserve per-row local-Z phase across layers so pass orientation does not
+    // flip when a different mixed row dominates layer pass heights.
+    std::vector<uint8_t> row_next_component_a(mixed_rows.size(), uint8_t(1));
+    std::vector<uint8_t> row_phase_initialized(mixed_rows.size(), uint8_t(0));
+
+    int cadence_index = 0;
+    for (size_t layer_id = 0; layer_id < layers.size(); ++layer_id) {
+        if (throw_on_cancel)
+            throw_on_cancel();
+
+        const LocalZPlanLayer &layer = layers[layer_id];
+        LocalZInterval interval;
+        interval.layer_id           = layer_id;
+        interval.z_lo               = layer.print_z - layer.height;
+        interval.z_hi               = layer.print_z;
+        interval.base_height        = layer.height;
+        interval.sublayer_height    = layer.height;
+        interval.first_sublayer_idx = out.plans.size();
+
+        ExPolygons mixed_masks;
+        size_t     mixed_state_count = 0;
+        size_t     dominant_mixed_idx = size_t(-1);
+        double     dominant_mixed_area = -1.0;
+        double     dominant_gradient_h_a = 0.0;
+        double     dominant_gradient_h_b = 0.0;
+        bool       dominant_gradient_valid = false;
+        for (size_t channel_idx = 0; channel_idx < segmentation[layer_id].size(); ++channel_idx) {
+            const ExPolygons &state_masks = segmentation[layer_id][channel_idx];
+            if (state_masks.empty())
+                continue;
+            const unsigned int state_id = unsigned(channel_idx + 1);
+            if (!mixed_filaments.is_mixed(state_id, num_physical))
+                continue;
+
+            const int mixed_idx = mixed_filaments.mixed_index_from_filament_id(state_id, num_physical);
+            if (mixed_idx < 0 || size_t(mixed_idx) >= mixed_rows.size())
+                continue;
+            const MixedFilament &mf = mixed_rows[size_t(mixed_idx)];
+            if (!local_z_eligible_mixed_row(mf))
+                continue;
+
+            interval.has_mixed_paint = true;
+            ++mixed_state_count;
+            append(mixed_masks, state_masks);
+
+            const double mixed_area = std::abs(area(state_masks));
+            if (mixed_area > dominant_mixed_area) {
+                dominant_mixed_area = mixed_area;
+                dominant_mixed_idx  = size_t(mixed_idx);
+            }
+        }
+        if (dominant_mixed_idx < mixed_rows.size()) {
+            compute_local_z_gradient_component_heights(mixed_rows[dominant_mixed_idx].mix_b_percent, lo, hi,
+                                                       dominant_gradient_h_a, dominant_gradient_h_b);
+            dominant_gradient_valid = true;
+        }
+        stats.mixed_state_layers += mixed_state_count;
+        if (!mixed_masks.empty())
+            mixed_masks = union_ex(mixed_masks);
+        if (interval.has_mixed_paint)
+            ++stats.mixed_intervals;
+
+        ExPolygons base_masks = layer.slices;
+        if (interval.has_mixed_paint && !base_masks.empty() && !mixed_masks.empty()) {
+            base_masks = diff_ex(base_masks, mixed_masks);
+            if (!base_masks.empty()) {
+                const Polygons filtered = opening(to_polygons(base_masks), scaled<float>(5. * EPSILON), scaled<float>(5. * EPSILON));
+                base_masks = union_ex(filtered);
+            }
+        }
+
+        std::vector<double> pass_heights;
+        if (interval.has_mixed_paint) {
+            // Local-Z mode should emit an A/B/A/B pattern for mixed regions and
+            // derive relative heights from mixed-filament gradient bounds.
+            if (pref_a <= EPSILON && pref_b <= EPSILON) {
+                if (dominant_gradient_valid) {
+                    pass_heights = build_local_z_alternating_pass_heights(interval.base_height, lo, hi,
+                                                                          dominant_gradient_h_a, dominant_gradient_h_b);
+                    if (pass_heights.size() > 1)
+                        ++stats.alternating_height_intervals;
+                } else {
+                    pass_heights = build_local_z_pass_heights(interval.base_height, lo, hi, pref_a, pref_b);
+                }
+            } else {
+                pass_heights = build_local_z_pass_heights(interval.base_height, lo, hi, pref_a, pref_b);
+            }
+        }
+        else
+            pass_heights.emplace_back(interval.base_height);
+
+        // Keep auto local-Z 2-pass cadence order stable across layers even if the
+        // dominant mixed row changes. Per-row phase assignment still controls
+        // which filament gets pass-0 vs pass-1.
+        if (interval.has_mixed_paint &&
+            pref_a <= EPSILON &&
+            pref_b <= EPSILON &&
+            pass_heights.size() == 2 &&
+            pass_heights[0] > pass_heights[1]) {
+            std::swap(pass_heights[0], pass_heights[1]);
+        }
+
+        const bool split_interval = interval.has_mixed_paint && pass_heights.size() > 1;
+        if (split_interval) {
+            // Derive per-row start phase against the selected layer pass heights so
+            // complementary mixed rows can coexist on the same nominal layer.
+            std::vector<uint8_t> start_with_component_a = row_next_component_a;
+            std::vector<uint8_t> row_seen_in_interval(mixed_rows.size(), uint8_t(0));
+            if (pref_a <= EPSILON && pref_b <= EPSILON) {
+                for (size_t channel_idx = 0; channel_idx < segmentation[layer_id].size(); ++channel_idx) {
+                    const ExPolygons &state_masks = segmentation[layer_id][channel_idx];
+                    if (state_masks.empty())
+                        continue;
+
+                    const unsigned int state_id = unsigned(channel_idx + 1);
+                    if (!mixed_filaments.is_mixed(state_id, num_physical))
+                        continue;
+                    const int mixed_idx = mixed_filaments.mixed_index_from_filament_id(state_id, num_physical);
+                    if (mixed_idx < 0 || size_t(mixed_idx) >= mixed_rows.size())
+                        continue;
+                    const MixedFilament &mf = mixed_rows[size_t(mixed_idx)];
+                    if (!local_z_eligible_mixed_row(mf))
+                        continue;
+                    row_seen_in_interval[size_t(mixed_idx)] = uint8_t(1);
+                    if (row_phase_initialized[size_t(mixed_idx)] != 0)
+                        continue;
+
+                    double row_h_a = 0.0;
+                    double row_h_b = 0.0;
+                    compute_local_z_gradient_component_heights(mf.mix_b_percent, lo, hi, row_h_a, row_h_b);
+
+                    double err_ab = 0.0;
+                    double err_ba = 0.0;
+                    for (size_t pass_i = 0; pass_i < pass_heights.size(); ++pass_i) {
+                        const double expected_ab = (pass_i % 2) == 0 ? row_h_a : row_h_b;
+                        const double expected_ba = (pass_i % 2) == 0 ? row_h_b : row_h_a;
+                        err_ab += std::abs(pass_heights[pass_i] - expected_ab);
+                        err_ba += std::abs(pass_heights[pass_i] - expected_ba);
+                    }
+                    if (err_ba + 1e-6 < err_ab)
+                        start_with_component_a[size_t(mixed_idx)] = uint8_t(0);
+                }
+            }
+
+            ++stats.split_intervals;
+            double z_cursor = interval.z_lo;
+            size_t pass_idx = 0;
+            bool   interval_has_split_painted_masks = false;
+            interval.sublayer_height = *std::min_element(pass_heights.begin(), pass_heights.end());
+            for (const double pass_height_nominal : pass_heights) {
+                if (z_cursor >= interval.z_hi - EPSILON)
+                    break;
+                const double pass_height = std::min<double>(pass_height_nominal, interval.z_hi - z_cursor);
+                const double z_next      = std::min<double>(interval.z_hi, z_cursor + pass_height);
+
+                SubLayerPlan plan;
+                plan.layer_id       = layer_id;
+                plan.pass_index     = pass_idx;
+                plan.split_interval = true;
+                plan.z_lo           = z_cursor;
+                plan.z_hi           = z_next;
+                plan.print_z        = z_next;
+                plan.flow_height    = pass_height;
+                plan.painted_masks_by_extruder.assign(num_physical, ExPolygons());
+                ++stats.split_passes;
+                bool pass_has_painted_masks = false;
+
+                for (size_t channel_idx = 0; channel_idx < segmentation[layer_id].size(); ++channel_idx) {
+                    const ExPolygons &state_masks = segmentation[layer_id][channel_idx];
+                    if (state_masks.empty())
+                        continue;
+
+                    const unsigned int state_id = unsigned(channel_idx + 1);
+                    if (!mixed_filaments.is_mixed(state_id, num_physical))
+                        continue;
+                    const int mixed_idx = mixed_filaments.mixed_index_from_filament_id(state_id, num_physical);
+                    if (mixed_idx < 0 || size_t(mixed_idx) >= mixed_rows.size())
+                        continue;
+                    const MixedFilament &mf = mixed_rows[size_t(mixed_idx)];
+                    if (!local_z_eligible_mixed_row(mf))
+                        continue;
+                    row_seen_in_interval[size_t(mixed_idx)] = uint8_t(1);
+                    ++stats.forced_height_resolve_calls;
+                    unsigned int target_extruder = 0;
+                    if (mf.component_a > 0 && mf.component_a <= num_physical &&
+                        mf.component_b > 0 && mf.component_b <= num_physical) {
+                        const bool start_a = start_with_component_a[size_t(mixed_idx)] != 0;
+                        const bool even_pass = (pass_idx % 2) == 0;
+                        // Enforce strict per-pass alternation inside split local-Z intervals.
+                        target_extruder = even_pass
+                            ? (start_a ? mf.component_a : mf.component_b)
+                            : (start_a ? mf.component_b : mf.component_a);
+                        ++stats.strict_ab_assignments;
+                    }
+                    if (target_extruder == 0) {
+                        target_extruder = mixed_filaments.resolve(state_id, num_physical, cadence_index, float(plan.print_z), float(plan.flow_height), true);
+                    }
+                    if (target_extruder == 0 || target_extruder > num_physical) {
+                        ++stats.forced_height_resolve_invalid_target;
+                        continue;
+                    }
+                    append(plan.painted_masks_by_extruder[target_extruder - 1], state_masks);
+                    pass_has_painted_masks = true;
+                }
+                for (ExPolygons &masks : plan.painted_masks_by_extruder)
+                    if (masks.size() > 1)
+                        masks = union_ex(masks);
+                if (pass_has_painted_masks) {
+                    ++stats.split_passes_with_painted_masks;
+                    interval_has_split_painted_masks = true;
+                }
+
+                if (z_next >= interval.z_hi - EPSILON)
+                    plan.base_masks = base_masks;
+
+                out.plans.emplace_back(std::move(plan));
+                ++interval.sublayer_count;
+                ++stats.sublayers;
+                ++pass_idx;
+                ++cadence_index;
+                z_cursor = z_next;
+            }
+
+            if (pass_idx > 0) {
+                const bool toggle_after_interval = (pass_idx % 2) != 0;
+                for (size_t mixed_idx = 0; mixed_idx < mixed_rows.size(); ++mixed_idx) {
+                    if (row_seen_in_interval[mixed_idx] == 0)
+                        continue;
+                    const bool start_a = start_with_component_a[mixed_idx] != 0;
+                    const bool next_a  = toggle_after_interval ? !start_a : start_a;
+                    row_next_component_a[mixed_idx] = next_a ? uint8_t(1) : uint8_t(0);
+                    row_phase_initialized[mixed_idx] = uint8_t(1);
+                }
+            }
+            if (!interval_has_split_painted_masks)
+                ++stats.split_intervals_without_painted_masks;
+        } else {
+            if (interval.has_mixed_paint)
+                ++stats.non_split_mixed_intervals;
+            SubLayerPlan plan;
+            plan.layer_id       = layer_id;
+            plan.pass_index     = 0;
+            plan.split_interval = false;
+            plan.z_lo           = interval.z_lo;
+            plan.z_hi           = interval.z_hi;
+            plan.print_z        = interval.z_hi;
+            plan.flow_height    = interval.base_height;
+            plan.base_masks     = base_masks;
+            plan.painted_masks_by_extruder.assign(num_physical, ExPolygons());
+
+            for (size_t channel_idx = 0; channel_idx < segmentation[layer_id].size(); ++channel_idx) {
+                const ExPolygons &state_masks = segmentation[layer_id][channel_idx];
+                if (state_masks.empty())
+                    continue;
+
+                const unsigned int state_id = unsigned(channel_idx + 1);
+                if (!mixed_filaments.is_mixed(state_id, num_physical))
+                    continue;
+                const MixedFilament *mixed_row = mixed_filaments.mixed_filament_from_id(state_id, num_physical);
+                if (mixed_row == nullptr || !local_z_eligible_mixed_row(*mixed_row))
+                    continue;
+                ++stats.forced_height_resolve_calls;
+                const unsigned int target_extruder =
+                    mixed_filaments.resolve(state_id, num_physical, cadence_index, float(plan.print_z), float(plan.flow_height), true);
+                if (target_extruder == 0 || target_extruder > num_physical) {
+                    ++stats.forced_height_resolve_invalid_target;
+                    continue;
+                }
+                append(plan.painted_masks_by_extruder[target_extruder - 1], state_masks);
+            }
+            for (ExPolygons &masks : plan.painted_masks_by_extruder)
+                if (masks.size() > 1)
+                    masks = union_ex(masks);
+
+            out.plans.emplace_back(std::move(plan));
+            interval.sublayer_count = 1;
+            ++stats.sublayers;
+            ++cadence_index;
+        }
+
+        if (interval.has_mixed_paint) {
+            BOOST_LOG_TRIVIAL(debug) << "Local-Z interval"
+                                     << " layer_id=" << layer_id
+                                     << " base_height=" << interval.base_height
+                                     << " split=" << split_interval
+                                     << " mixed_states=" << mixed_state_count
+                                     << " pass_count=" << pass_heights.size()
+                                     << " pass_min_height="
+                                     << (pass_heights.empty() ? 0.0 : *std::min_element(pass_heights.begin(), pass_heights.end()))
+                                     << " pass_max_height="
+                                     << (pass_heights.empty() ? 0.0 : *std::max_element(pass_heights.begin(), pass_heights.end()))
+                                     << " mixed_mask_count=" << mixed_masks.size()
+                                     << " base_mask_count=" << base_masks.size();
+        }
+
+        out.intervals.emplace_back(std::move(interval));
+    }
+    return out;
+}
+
+} // namespace Slic3r
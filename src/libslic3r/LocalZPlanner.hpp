@@ -0,0 +1,102 @@
+#ifndef slic3r_LocalZPlanner_hpp_
+#define slic3r_LocalZPlanner_hpp_
+
+#include <functional>
+#include <vector>
+
+#include "ExPolygon.hpp"
+
+namespace Slic3r {
+
+class MixedFilamentManager;
+
+// Phase A local-Z dithering planner cache.
+struct LocalZInterval
+{
+    size_t layer_id { 0 };
+    double z_lo { 0.0 };
+    double z_hi { 0.0 };
+    double base_height { 0.0 };
+    double sublayer_height { 0.0 };
+    bool   has_mixed_paint { false };
+    size_t first_sublayer_idx { 0 };
+    size_t sublayer_count { 0 };
+};
+
+struct SubLayerPlan
+{
+    size_t layer_id { 0 };
+    size_t pass_index { 0 };
+    bool   split_interval { false };
+    double z_lo { 0.0 };
+    double z_hi { 0.0 };
+    double print_z { 0.0 };
+    double flow_height { 0.0 };
+    std::vector<ExPolygons> painted_masks_by_extruder;
+    ExPolygons              base_masks;
+};
+
+// One object layer as seen by the Local-Z planner.
+struct LocalZPlanLayer
+{
+    double     print_z { 0.0 };
+    double     height { 0.0 };
+    // Union of the slices of all the regions of the layer.
+    ExPolygons slices;
+};
+
+struct LocalZPlanParams
+{
+    // Bounds of the sub-layer heights, see mixed_filament_height_lower_bound / mixed_filament_height_upper_bound.
+    double lower_bound { 0.04 };
+    double upper_bound { 0.16 };
+    // Preferred heights of the A and B sub-layers, zero to derive them from the gradient of the dominant mixed row.
+    double preferred_a { 0.0 };
+    double preferred_b { 0.0 };
+};
+
+struct LocalZPlanStats
+{
+    size_t mixed_intervals { 0 };
+    size_t split_intervals { 0 };
+    size_t non_split_mixed_intervals { 0 };
+    size_t split_intervals_without_painted_masks { 0 };
+    size_t sublayers { 0 };
+    size_t split_passes { 0 };
+    size_t split_passes_with_painted_masks { 0 };
+    size_t alternating_height_intervals { 0 };
+    size_t strict_ab_assignments { 0 };
+    size_t mixed_state_layers { 0 };
+    size_t forced_height_resolve_calls { 0 };
+    size_t forced_height_resolve_invalid_target { 0 };
+};
+
+struct LocalZPlan
+{
+    std::vector<LocalZInterval> intervals;
+    std::vector<SubLayerPlan>   plans;
+    LocalZPlanStats             stats;
+};
+
+// Splits the layers painted by Local-Z eligible mixed rows into sub-layers alternating the components of the rows.
+// segmentation[layer][channel] holds the masks painted by the 1-based filament state channel + 1, as produced
+// by multi_material_segmentation_by_painting(). layers and segmentation have to be of the same size.
+// Every layer produces one LocalZInterval and at least one SubLayerPlan.
+LocalZPlan build_local_z_plan(const std::vector<LocalZPlanLayer>            &layers,
+                              const std::vector<std::vector<ExPolygons>>    &segmentation,
+                              const MixedFilamentManager                    &mixed_filaments,
+                              size_t                                         num_physical,
+                              const LocalZPlanParams                        &params,
+                              const std::function<void()>                   &throw_on_cancel = {});
+
+// Heights of the sub-layers splitting a layer of base_height, cycling preferred_a / preferred_b if set,
+// falling back to uniform sub-layers within [lower_bound, upper_bound] otherwise.
+std::vector<double> build_local_z_pass_heights(double base_height, double lower_bound, double upper_bound, double preferred_a, double preferred_b);
+// Heights of an even number of sub-layers splitting a layer of base_height in pairs of gradient_h_a : gradient_h_b.
+std::vector<double> build_local_z_alternating_pass_heights(double base_height, double lower_bound, double upper_bound, double gradient_h_a, double gradient_h_b);
+// Adjusts the top passes so that they sum up to base_height. Returns false if not possible within [lo, hi].
+bool                fit_pass_heights_to_interval(std::vector<double> &passes, double base_height, double lo, double hi);
+
+} // namespace Slic3r
+
+#endif // slic3r_LocalZPlanner_hpp_
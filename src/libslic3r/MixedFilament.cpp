@@ -651,12 +651,29 @@ static std::vector<unsigned int> build_weighted_gradient_sequence(const std::vec
     return sequence;
 }
 
+// Physical filament IDs of the steps of a manual pattern, '1' => component_a, '2' => component_b, '3'..'9' => direct IDs.
+static std::vector<unsigned int> decode_manual_pattern(const MixedFilament &mf, size_t num_physical)
+{
+    std::vector<unsigned int> steps;
+    steps.reserve(mf.manual_pattern.size());
+    for (const char token : mf.manual_pattern) {
+        unsigned int id = mf.component_a;
+        if (token == '2')
+            id = mf.component_b;
+        else if (token >= '3' && token <= '9' && unsigned(token - '0') <= num_physical)
+            id = unsigned(token - '0');
+        steps.emplace_back(id);
+    }
+    return steps;
+}
+
 // ---------------------------------------------------------------------------
 // MixedFilamentManager
 // ---------------------------------------------------------------------------
 
 void MixedFilamentManager::auto_generate(const std::vector<std::string> &filament_colours)
 {
+    m_resolve_plan.reset();
     // Keep a copy of the old list so we can preserve user-modified ratios and
     // enabled flags and custom rows.
     std::vector<MixedFilament> old = std::move(m_mixed);
@@ -709,6 +726,7 @@ void MixedFilamentManager::auto_generate(const std::vector<std::string> &filamen
 
 void MixedFilamentManager::remove_physical_filament(unsigned int deleted_filament_id)
 {
+    m_resolve_plan.reset();
     if (deleted_filament_id == 0 || m_mixed.empty())
         return;
 
@@ -733,6 +751,7 @@ void MixedFilamentManager::add_custom_filament(unsigned int component_a,
                                                int          mix_b_percent,
                                                const std::vector<std::string> &filament_colours)
 {
+    m_resolve_plan.reset();
     const size_t n = filament_colours.size();
     if (n < 2)
         return;
@@ -760,8 +779,53 @@ void MixedFilamentManager::add_custom_filament(unsigned int component_a,
     refresh_display_colors(filament_colours);
 }
 
+bool MixedFilamentManager::add_custom_sequence(const std::vector<unsigned int> &component_ids,
+                                               const std::vector<int>          &layers,
+                                               const std::vector<std::string>  &filament_colours)
+{
+    const size_t n = filament_colours.size();
+    if (component_ids.size() < 2 || component_ids.size() != layers.size())
+        return false;
+
+    std::vector<std::pair<unsigned int, int>> components;
+    for (size_t i = 0; i < component_ids.size(); ++i)
+        components.emplace_back(component_ids[i], layers[i]);
+    std::sort(components.begin(), components.end());
+    for (size_t i = 0; i < components.size(); ++i) {
+        const auto [id, count] = components[i];
+        // Past component_a and component_b, the pattern tokens are the filament IDs themselves.
+        if (id == 0 || id > n || count <= 0 || (i > 0 && id == components[i - 1].first) || (i >= 2 && id > 9))
+            return false;
+    }
+
+    std::vector<unsigned int> ids;
+    std::vector<int>          counts;
+    for (const auto &[id, count] : components) {
+        ids.emplace_back(id);
+        counts.emplace_back(count);
+    }
+    const std::vector<unsigned int> sequence = build_weighted_gradient_sequence(ids, counts);
+    if (sequence.empty())
+        return false;
+
+    m_resolve_plan.reset();
+    MixedFilament mf;
+    mf.component_a = ids[0];
+    mf.component_b = ids[1];
+    for (const unsigned int id : sequence)
+        mf.manual_pattern += id == mf.component_a ? '1' : id == mf.component_b ? '2' : char('0' + id);
+    mf.mix_b_percent = mix_percent_from_normalized_pattern(mf.manual_pattern);
+    mf.distribution_mode = int(MixedFilament::LayerCycle);
+    mf.enabled = true;
+    mf.custom = true;
+    m_mixed.push_back(std::move(mf));
+    refresh_display_colors(filament_colours);
+    return true;
+}
+
 void MixedFilamentManager::clear_custom_entries()
 {
+    m_resolve_plan.reset();
     m_mixed.erase(std::remove_if(m_mixed.begin(), m_mixed.end(), [](const MixedFilament &mf) { return mf.custom; }), m_mixed.end());
 }
 
@@ -789,6 +853,7 @@ void MixedFilamentManager::apply_gradient_settings(int   gradient_mode,
                                                    int   cycle_layers,
                                                    bool  advanced_dithering)
 {
+    m_resolve_plan.reset();
     m_gradient_mode      = (gradient_mode != 0) ? 1 : 0;
     m_height_lower_bound = std::max(0.01f, lower_bound);
     m_height_upper_bound = std::max(m_height_lower_bound, upper_bound);
@@ -833,6 +898,7 @@ std::string MixedFilamentManager::serialize_custom_entries() const
 
 void MixedFilamentManager::load_custom_entries(const std::string &serialized, const std::vector<std::string> &filament_colours)
 {
+    m_resolve_plan.reset();
     const size_t n = filament_colours.size();
     if (serialized.empty() || n < 2) {
         BOOST_LOG_TRIVIAL(debug) << "MixedFilamentManager::load_custom_entries skipped"
@@ -932,6 +998,9 @@ unsigned int MixedFilamentManager::resolve(unsigned int filament_id,
                                            float        layer_height,
                                            bool         force_height_weighted) const
 {
+    if (const MixedFilamentResolvePlan *plan = resolve_plan(num_physical))
+        return plan->resolve(filament_id, layer_index, layer_print_z, layer_height, force_height_weighted);
+
     const int mixed_idx = mixed_index_from_filament_id(filament_id, num_physical);
     if (mixed_idx < 0)
         return filament_id;
@@ -997,10 +1066,93 @@ unsigned int MixedFilamentManager::resolve(unsigned int filament_id,
     return (pos < mf.ratio_a) ? mf.component_a : mf.component_b;
 }
 
+void MixedFilamentManager::build_resolve_plan(size_t num_physical)
+{
+    auto plan = std::make_shared<MixedFilamentResolvePlan>();
+    plan->num_physical = num_physical;
+    plan->rows.reserve(m_mixed.size());
+
+    for (size_t i = 0; i < m_mixed.size(); ++i) {
+        const MixedFilament &mf = m_mixed[i];
+        if (!mf.enabled)
+            continue;
+
+        MixedFilamentResolvePlan::Row row;
+        row.mixed_index     = int(i);
+        row.component_a     = mf.component_a;
+        row.component_b     = mf.component_b;
+        row.ratio_a         = mf.ratio_a;
+        row.ratio_b         = mf.ratio_b;
+        row.height_weighted = m_gradient_mode == 1 && mf.custom;
+        row.advanced_dither = m_gradient_mode == 0 && m_advanced_dithering && mf.custom;
+        compute_gradient_heights(mf, m_height_lower_bound, m_height_upper_bound, row.height_a, row.height_b);
+
+        // Same precedence as the parsing path in resolve(): manual pattern
+        // first, then the weighted multi-component gradient sequence.
+        std::vector<unsigned int> steps;
+        if (!mf.manual_pattern.empty()) {
+            steps = decode_manual_pattern(mf, num_physical);
+        } else if (mf.distribution_mode != int(MixedFilament::Simple)) {
+            const std::vector<unsigned int> gradient_ids = decode_gradient_component_ids(mf.gradient_component_ids, num_physical);
+            if (gradient_ids.size() >= 3) {
+                const std::vector<int> gradient_weights =
+                    decode_gradient_component_weights(mf.gradient_component_weights, gradient_ids.size());
+                steps = build_weighted_gradient_sequence(
+                    gradient_ids, gradient_weights.empty() ? std::vector<int>(gradient_ids.size(), 1) : gradient_weights);
+            }
+        }
+        row.sequence_begin = uint32_t(plan->sequence.size());
+        row.sequence_size  = uint32_t(steps.size());
+        plan->sequence.insert(plan->sequence.end(), steps.begin(), steps.end());
+        plan->rows.emplace_back(row);
+    }
+
+    m_resolve_plan = std::move(plan);
+}
+
+unsigned int MixedFilamentResolvePlan::resolve(unsigned int filament_id,
+                                               int          layer_index,
+                                               float        layer_print_z,
+                                               float        layer_height,
+                                               bool         force_height_weighted) const
+{
+    const Row *r = this->row(filament_id);
+    if (r == nullptr)
+        return filament_id;
+
+    if (r->sequence_size > 0)
+        return sequence[r->sequence_begin + uint32_t(safe_mod(layer_index, int(r->sequence_size)))];
+
+    if (force_height_weighted || r->height_weighted) {
+        const float cycle_h = std::max(0.01f, r->height_a + r->height_b);
+        const float z_anchor = (layer_height > 1e-6f)
+            ? std::max(0.f, layer_print_z - 0.5f * layer_height)
+            : std::max(0.f, layer_print_z);
+        float phase = std::fmod(z_anchor, cycle_h);
+        if (phase < 0.f)
+            phase += cycle_h;
+        return (phase < r->height_a) ? r->component_a : r->component_b;
+    }
+
+    const int cycle = r->ratio_a + r->ratio_b;
+    if (cycle <= 0)
+        return r->component_a;
+
+    if (r->advanced_dither)
+        return use_component_b_advanced_dither(layer_index, r->ratio_a, r->ratio_b) ? r->component_b : r->component_a;
+
+    const int pos = safe_mod(layer_index, cycle);
+    return (pos < r->ratio_a) ? r->component_a : r->component_b;
+}
+
 int MixedFilamentManager::mixed_index_from_filament_id(unsigned int filament_id, size_t num_physical) const
 {
     if (filament_id <= num_physical)
         return -1;
+    if (const MixedFilamentResolvePlan *plan = resolve_plan(num_physical)) {
+        const MixedFilamentResolvePlan::Row *row = plan->row(filament_id);
+        return row != nullptr ? row->mixed_index : -1;
+    }
 
     const size_t enabled_virtual_idx = size_t(filament_id - num_physical - 1);
     size_t enabled_seen = 0;
@@ -1029,44 +1181,23 @@ std::string MixedFilamentManager::blend_color_multi(
     if (color_percents.size() == 1)
         return color_percents.front().first;
 
-    struct WeightedColor {
-        RGB color;
-        int pct;
-    };
-    std::vector<WeightedColor> colors;
-    colors.reserve(color_percents.size());
-
-    int total_pct = 0;
+    std::vector<unsigned char> colors;
+    std::vector<float>         weights;
+    colors.reserve(color_percents.size() * 3);
+    weights.reserve(color_percents.size());
     for (const auto &[hex, pct] : color_percents) {
         if (pct <= 0)
             continue;
-        colors.push_back({parse_hex_color(hex), pct});
-        total_pct += pct;
+        const RGB rgb = parse_hex_color(hex);
+        colors.insert(colors.end(), { static_cast<unsigned char>(rgb.r), static_cast<unsigned char>(rgb.g), static_cast<unsigned char>(rgb.b) });
+        weights.emplace_back(static_cast<float>(pct));
     }
-    if (colors.empty() || total_pct <= 0)
+    if (weights.empty())
         return "#000000";
 
-    unsigned char r = static_cast<unsigned char>(colors.front().color.r);
-    unsigned char g = static_cast<unsigned char>(colors.front().color.g);
-    unsigned char b = static_cast<unsigned char>(colors.front().color.b);
-    int accumulated_pct = colors.front().pct;
-
-    for (size_t i = 1; i < colors.size(); ++i) {
-        const auto &next = colors[i];
-        const int new_total = accumulated_pct + next.pct;
-        if (new_total <= 0)
-            continue;
-        const float t = static_cast<float>(next.pct) / static_cast<float>(new_total);
-        filament_mixer_lerp(
-            r, g, b,
-            static_cast<unsigned char>(next.color.r),
-            static_cast<unsigned char>(next.color.g),
-            static_cast<unsigned char>(next.color.b),
-            t, &r, &g, &b);
-        accumulated_pct = new_total;
-    }
-
-    return rgb_to_hex({int(r), int(g), int(b)});
+    unsigned char rgb[3];
+    filament_mixer_blend_batch(colors.data(), weights.size(), weights.data(), 1, rgb);
+    return rgb_to_hex({int(rgb[0]), int(rgb[1]), int(rgb[2])});
 }
 
 std::string MixedFilamentManager::blend_color(const std::string &color_a,
@@ -1098,6 +1229,19 @@ std::string MixedFilamentManager::blend_color(const std::string &color_a,
 void MixedFilamentManager::refresh_display_colors(const std::vector<std::string> &filament_colours)
 {
     for (MixedFilament &mf : m_mixed) {
+        if (mf.manual_pattern.find_first_of("3456789") != std::string::npos) {
+            // The pattern prints filaments past component_a and component_b, blend all of them by their share of the steps.
+            std::vector<int> counts(filament_colours.size() + 1, 0);
+            for (const unsigned int id : decode_manual_pattern(mf, filament_colours.size()))
+                if (id >= 1 && id <= filament_colours.size())
+                    ++counts[id];
+            std::vector<std::pair<std::string, int>> color_percents;
+            for (size_t id = 1; id < counts.size(); ++id)
+                if (counts[id] > 0)
+                    color_percents.emplace_back(filament_colours[id - 1], counts[id]);
+            mf.display_color = color_percents.empty() ? "#26A69A" : blend_color_multi(color_percents);
+            continue;
+        }
         const std::vector<unsigned int> gradient_ids = decode_gradient_component_ids(mf.gradient_component_ids, filament_colours.size());
         if (mf.distribution_mode != int(MixedFilament::Simple) && gradient_ids.size() >= 3) {
             const std::vector<int> gradient_weights =
@@ -1143,6 +1287,8 @@ void MixedFilamentManager::refresh_display_colors(const std::vector<std::string>
 
 size_t MixedFilamentManager::enabled_count() const
 {
+    if (m_resolve_plan)
+        return m_resolve_plan->rows.size();
     size_t count = 0;
     for (const auto &mf : m_mixed)
         if (mf.enabled)
@@ -5,6 +5,7 @@
 #include <vector>
 #include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <utility>
 
 namespace Slic3r {
@@ -83,6 +84,56 @@ struct MixedFilament
     bool operator!=(const MixedFilament &rhs) const { return !(*this == rhs); }
 };
 
+// ---------------------------------------------------------------------------
+// MixedFilamentResolvePlan
+//
+// Immutable lookup table compiled from a MixedFilamentManager for a fixed
+// number of physical filaments. Manual patterns and weighted gradient
+// sequences are pre-decoded to physical IDs and gradient heights are
+// precomputed, so resolve() is O(1) and does not allocate. The plan is never
+// modified after construction and may be shared read-only between threads.
+// ---------------------------------------------------------------------------
+struct MixedFilamentResolvePlan
+{
+    struct Row
+    {
+        // Index of the source row in MixedFilamentManager::mixed_filaments().
+        int          mixed_index     = -1;
+        unsigned int component_a     = 1;
+        unsigned int component_b     = 2;
+        int          ratio_a         = 1;
+        int          ratio_b         = 1;
+        // Height-weighted cadence, see compute_gradient_heights().
+        float        height_a        = 0.f;
+        float        height_b        = 0.f;
+        // Slice of `sequence` holding the decoded manual pattern or the
+        // weighted gradient sequence. Empty when the row uses a cadence.
+        uint32_t     sequence_begin  = 0;
+        uint32_t     sequence_size   = 0;
+        bool         height_weighted = false;
+        bool         advanced_dither = false;
+    };
+
+    size_t                    num_physical = 0;
+    // Indexed by (virtual filament ID - num_physical - 1), enabled rows only.
+    std::vector<Row>          rows;
+    std::vector<unsigned int> sequence;
+
+    const Row *row(unsigned int filament_id) const
+    {
+        if (filament_id <= num_physical)
+            return nullptr;
+        const size_t idx = size_t(filament_id - num_physical - 1);
+        return idx < rows.size() ? &rows[idx] : nullptr;
+    }
+
+    unsigned int resolve(unsigned int filament_id,
+                         int          layer_index,
+                         float        layer_print_z,
+                         float        layer_height,
+                         bool         force_height_weighted) const;
+};
+
 // ---------------------------------------------------------------------------
 // MixedFilamentManager
 //
@@ -113,6 +164,13 @@ public:
     // Add a custom mixed filament.
     void add_custom_filament(unsigned int component_a, unsigned int component_b, int mix_b_percent, const std::vector<std::string> &filament_colours);
 
+    // Add a custom mixed filament printing component_ids[i] (1-based) on layers[i] layers of every cycle, the layers
+    // of the components interleaved evenly. The cadence is stored as a manual pattern, thus past the two lowest IDs
+    // only physical filaments 3..9 fit. Returns false if the components are invalid or do not fit.
+    bool add_custom_sequence(const std::vector<unsigned int> &component_ids,
+                             const std::vector<int>          &layers,
+                             const std::vector<std::string>  &filament_colours);
+
     // Remove all custom rows, keep auto-generated ones.
     void clear_custom_entries();
 
@@ -132,6 +190,20 @@ public:
     // Accepts separators and A/B aliases. Returns empty string if invalid.
     static std::string normalize_manual_pattern(const std::string &pattern);
 
+    // ---- Resolution plan ------------------------------------------------
+
+    // Compile the current rows into an immutable MixedFilamentResolvePlan.
+    // Called once the mixed rows are final (Print::apply), after which
+    // resolve() and the ID lookups are answered from the plan. Any mutation
+    // of the rows drops the plan and falls back to the parsing path.
+    void build_resolve_plan(size_t num_physical);
+
+    // Compiled plan for `num_physical`, or nullptr if none is available.
+    const MixedFilamentResolvePlan *resolve_plan(size_t num_physical) const
+    {
+        return (m_resolve_plan && m_resolve_plan->num_physical == num_physical) ? m_resolve_plan.get() : nullptr;
+    }
+
     // ---- Queries --------------------------------------------------------
 
     // True when `filament_id` (1-based) refers to a mixed filament.
@@ -169,7 +241,7 @@ public:
     // ---- Accessors ------------------------------------------------------
 
     const std::vector<MixedFilament> &mixed_filaments() const { return m_mixed; }
-    std::vector<MixedFilament>       &mixed_filaments()       { return m_mixed; }
+    std::vector<MixedFilament>       &mixed_filaments()       { m_resolve_plan.reset(); return m_mixed; }
 
     size_t enabled_count() const;
 
@@ -194,6 +266,8 @@ private:
     float                      m_height_upper_bound  = 0.16f;
     int                        m_cycle_layers        = 4;
     bool                       m_advanced_dithering  = false;
+
+    std::shared_ptr<const MixedFilamentResolvePlan> m_resolve_plan;
 };
 
 } // namespace Slic3r
@@ -0,0 +1,274 @@
+#include "MixedFilamentPalette.hpp"
+#include "filament_mixer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+
+#include <boost/log/trivial.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace Slic3r {
+
+using RGB8 = std::array<unsigned char, 3>;
+using Lab  = std::array<double, 3>;
+
+static_assert(sizeof(RGB8) == 3, "RGB8 arrays are passed to filament_mixer_blend_batch() as interleaved RGB");
+
+// Parse "#RRGGBB". Returns black on failure.
+static RGB8 parse_hex_color(const std::string &hex)
+{
+    RGB8 c {};
+    if (hex.size() >= 7 && hex[0] == '#') {
+        try {
+            for (size_t i = 0; i < 3; ++i)
+                c[i] = (unsigned char)std::clamp(std::stoi(hex.substr(1 + 2 * i, 2), nullptr, 16), 0, 255);
+        } catch (...) {
+            c = {};
+        }
+    }
+    return c;
+}
+
+static std::string rgb_to_hex(const RGB8 &c)
+{
+    char buf[8];
+    std::snprintf(buf, sizeof(buf), "#%02X%02X%02X", c[0], c[1], c[2]);
+    return std::string(buf);
+}
+
+// sRGB to CIELAB, D65 white point.
+static Lab rgb_to_lab(const RGB8 &c)
+{
+    double rgb[3];
+    for (size_t i = 0; i < 3; ++i) {
+        const double v = double(c[i]) / 255.;
+        rgb[i] = v > 0.04045 ? std::pow((v + 0.055) / 1.055, 2.4) : v / 12.92;
+    }
+    const double xyz[3] = {
+        (0.4124564 * rgb[0] + 0.3575761 * rgb[1] + 0.1804375 * rgb[2]) / 0.95047,
+        (0.2126729 * rgb[0] + 0.7151522 * rgb[1] + 0.0721750 * rgb[2]),
+        (0.0193339 * rgb[0] + 0.1191920 * rgb[1] + 0.9503041 * rgb[2]) / 1.08883
+    };
+    double f[3];
+    for (size_t i = 0; i < 3; ++i)
+        f[i] = xyz[i] > 216. / 24389. ? std::cbrt(xyz[i]) : (24389. / 27. * xyz[i] + 16.) / 116.;
+    return { 116. * f[1] - 16., 500. * (f[0] - f[1]), 200. * (f[1] - f[2]) };
+}
+
+// CIEDE2000 following Sharma, Wu, Dalal: "The CIEDE2000 color-difference formula", 2005.
+static double delta_e_2000(const Lab &lab1, const Lab &lab2)
+{
+    constexpr double pi      = 3.14159265358979323846;
+    auto             deg     = [](double rad) { return rad * 180. / pi; };
+    auto             rad     = [](double deg) { return deg * pi / 180.; };
+    // C^7 / (C^7 + 25^7)
+    auto             chroma7 = [](double c) { return std::pow(c, 7.) / (std::pow(c, 7.) + 6103515625.); };
+
+    const double c1    = std::hypot(lab1[1], lab1[2]);
+    const double c2    = std::hypot(lab2[1], lab2[2]);
+    const double g     = 0.5 * (1. - std::sqrt(chroma7(0.5 * (c1 + c2))));
+    const double a1    = (1. + g) * lab1[1];
+    const double a2    = (1. + g) * lab2[1];
+    const double c1p   = std::hypot(a1, lab1[2]);
+    const double c2p   = std::hypot(a2, lab2[2]);
+    auto         hue   = [&deg](double b, double a) {
+        if (a == 0. && b == 0.)
+            return 0.;
+        const double h = deg(std::atan2(b, a));
+        return h < 0. ? h + 360. : h;
+    };
+    const double h1p   = hue(lab1[2], a1);
+    const double h2p   = hue(lab2[2], a2);
+
+    const double dlp   = lab2[0] - lab1[0];
+    const double dcp   = c2p - c1p;
+    double       dhp   = 0.;
+    if (c1p * c2p != 0.) {
+        dhp = h2p - h1p;
+        if (dhp > 180.)
+            dhp -= 360.;
+        else if (dhp < -180.)
+            dhp += 360.;
+    }
+    const double dHp   = 2. * std::sqrt(c1p * c2p) * std::sin(rad(0.5 * dhp));
+
+    const double lp    = 0.5 * (lab1[0] + lab2[0]);
+    const double cp    = 0.5 * (c1p + c2p);
+    double       hp    = h1p + h2p;
+    if (c1p * c2p != 0.) {
+        if (std::abs(h1p - h2p) <= 180.)
+            hp *= 0.5;
+        else
+            hp = hp < 360. ? 0.5 * (hp + 360.) : 0.5 * (hp - 360.);
+    }
+    const double t     = 1. - 0.17 * std::cos(rad(hp - 30.)) + 0.24 * std::cos(rad(2. * hp)) + 0.32 * std::cos(rad(3. * hp + 6.)) -
+                         0.20 * std::cos(rad(4. * hp - 63.));
+    const double dtheta = 30. * std::exp(-std::pow((hp - 275.) / 25., 2.));
+    const double rc    = 2. * std::sqrt(chroma7(cp));
+    const double sl    = 1. + 0.015 * (lp - 50.) * (lp - 50.) / std::sqrt(20. + (lp - 50.) * (lp - 50.));
+    const double sc    = 1. + 0.045 * cp;
+    const double sh    = 1. + 0.015 * cp * t;
+    const double rt    = -std::sin(rad(2. * dtheta)) * rc;
+
+    const double l = dlp / sl;
+    const double c = dcp / sc;
+    const double h = dHp / sh;
+    return std::sqrt(l * l + c * c + h * h + rt * c * h);
+}
+
+double color_delta_e(const std::string &color_a, const std::string &color_b)
+{
+    return delta_e_2000(rgb_to_lab(parse_hex_color(color_a)), rgb_to_lab(parse_hex_color(color_b)));
+}
+
+int MixedFilamentRecipe::cycle_layers() const
+{
+    return std::accumulate(layers.begin(), layers.end(), 0);
+}
+
+// Calls fn(layers) for all the splits of cycle layers into layers.size() positive counts without a common divisor,
+// the other splits repeat the recipe of a shorter cycle.
+template<typename Fn>
+static void for_each_reduced_split(int cycle, std::vector<int> &layers, size_t idx, Fn &&fn)
+{
+    if (idx + 1 == layers.size()) {
+        layers[idx] = cycle;
+        int g = 0;
+        for (const int l : layers)
+            g = std::gcd(g, l);
+        if (g == 1)
+            fn(layers);
+        return;
+    }
+    for (int l = 1; l <= cycle - int(layers.size() - idx - 1); ++l) {
+        layers[idx] = l;
+        for_each_reduced_split(cycle - l, layers, idx + 1, fn);
+    }
+}
+
+// Calls fn(ids) for all the ascending sets of num_components of the filaments 1..num_filaments.
+template<typename Fn>
+static void for_each_component_set(size_t num_filaments, size_t num_components, std::vector<unsigned int> &ids, size_t idx, Fn &&fn)
+{
+    if (idx == num_components) {
+        fn(ids);
+        return;
+    }
+    for (unsigned int id = idx == 0 ? 1 : ids[idx - 1] + 1; id <= num_filaments; ++id) {
+        ids[idx] = id;
+        for_each_component_set(num_filaments, num_components, ids, idx + 1, fn);
+    }
+}
+
+std::vector<MixedFilamentRecipe> optimize_mixed_filament_palette(const std::vector<std::string>   &targets,
+                                                                 const std::vector<std::string>   &filament_colours,
+                                                                 const MixedFilamentPaletteParams &params)
+{
+    std::vector<MixedFilamentRecipe> out(targets.size());
+    const size_t num_filaments = filament_colours.size();
+    if (targets.empty() || num_filaments == 0)
+        return out;
+
+    std::vector<RGB8> physical;
+    physical.reserve(num_filaments);
+    for (const std::string &colour : filament_colours)
+        physical.emplace_back(parse_hex_color(colour));
+
+    // Candidate recipes grouped by their component set, each set blended by a single batch.
+    struct ComponentSet
+    {
+        std::vector<unsigned int> ids;
+        // Layer counts of the recipes, ids.size() per recipe.
+        std::vector<int>          layers;
+        size_t                    first_recipe { 0 };
+    };
+    std::vector<ComponentSet> sets;
+    size_t                    num_recipes = 0;
+    const int                 max_cycle   = std::max(1, params.max_cycle_layers);
+    for (size_t num_components = 1; num_components <= std::min(std::max<size_t>(1, params.max_components), num_filaments); ++num_components) {
+        std::vector<unsigned int> ids(num_components);
+        // Past the second component, manual patterns name the filaments by a single digit.
+        const size_t max_filament = num_components >= 3 ? std::min<size_t>(num_filaments, 9) : num_filaments;
+        for_each_component_set(max_filament, num_components, ids, 0, [&](const std::vector<unsigned int> &set_ids) {
+            ComponentSet set { set_ids, {}, num_recipes };
+            std::vector<int> layers(set_ids.size());
+            for (int cycle = int(set_ids.size()); cycle <= max_cycle; ++cycle)
+                for_each_reduced_split(cycle, layers, 0, [&set](const std::vector<int> &split) {
+                    set.layers.insert(set.layers.end(), split.begin(), split.end());
+                });
+            if (set.layers.empty())
+                return;
+            num_recipes += set.layers.size() / set_ids.size();
+            sets.emplace_back(std::move(set));
+        });
+    }
+
+    std::vector<RGB8> recipe_colors(num_recipes);
+    std::vector<Lab>  recipe_labs(num_recipes);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, sets.size()), [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t set_idx = range.begin(); set_idx < range.end(); ++set_idx) {
+            const ComponentSet        &set = sets[set_idx];
+            std::vector<unsigned char> colors;
+            for (const unsigned int id : set.ids)
+                colors.insert(colors.end(), physical[id - 1].begin(), physical[id - 1].end());
+            const std::vector<float> weights(set.layers.begin(), set.layers.end());
+            const size_t             count = set.layers.size() / set.ids.size();
+            filament_mixer_blend_batch(colors.data(), set.ids.size(), weights.data(), count, recipe_colors[set.first_recipe].data());
+            for (size_t i = set.first_recipe; i < set.first_recipe + count; ++i)
+                recipe_labs[i] = rgb_to_lab(recipe_colors[i]);
+        }
+    });
+
+    // Search order: fewer components first, then shorter cycles.
+    std::vector<std::pair<size_t, size_t>> order; // (set, recipe)
+    order.reserve(num_recipes);
+    for (size_t set_idx = 0; set_idx < sets.size(); ++set_idx)
+        for (size_t i = 0; i < sets[set_idx].layers.size() / sets[set_idx].ids.size(); ++i)
+            order.emplace_back(set_idx, sets[set_idx].first_recipe + i);
+    auto cycle_of = [&sets](const std::pair<size_t, size_t> &candidate) {
+        const ComponentSet &set = sets[candidate.first];
+        const size_t        i   = candidate.second - set.first_recipe;
+        return std::accumulate(set.layers.begin() + i * set.ids.size(), set.layers.begin() + (i + 1) * set.ids.size(), 0);
+    };
+    std::stable_sort(order.begin(), order.end(), [&](const auto &lhs, const auto &rhs) {
+        const size_t lhs_components = sets[lhs.first].ids.size();
+        const size_t rhs_components = sets[rhs.first].ids.size();
+        return lhs_components < rhs_components || (lhs_components == rhs_components && cycle_of(lhs) < cycle_of(rhs));
+    });
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, targets.size()), [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t target_idx = range.begin(); target_idx < range.end(); ++target_idx) {
+            const Lab target = rgb_to_lab(parse_hex_color(targets[target_idx]));
+            double    best_delta_e = std::numeric_limits<double>::max();
+            size_t    best         = 0;
+            for (size_t i = 0; i < order.size(); ++i) {
+                const double delta_e = delta_e_2000(target, recipe_labs[order[i].second]);
+                if (delta_e < best_delta_e - 1e-9) {
+                    best_delta_e = delta_e;
+                    best         = i;
+                }
+            }
+            const ComponentSet  &set    = sets[order[best].first];
+            const size_t         i      = order[best].second - set.first_recipe;
+            MixedFilamentRecipe &recipe = out[target_idx];
+            recipe.component_ids = set.ids;
+            recipe.layers.assign(set.layers.begin() + i * set.ids.size(), set.layers.begin() + (i + 1) * set.ids.size());
+            recipe.color   = rgb_to_hex(recipe_colors[order[best].second]);
+            recipe.delta_e = best_delta_e;
+        }
+    });
+
+    BOOST_LOG_TRIVIAL(debug) << "optimize_mixed_filament_palette"
+                             << ", targets=" << targets.size()
+                             << ", filaments=" << num_filaments
+                             << ", component_sets=" << sets.size()
+                             << ", recipes=" << num_recipes;
+    return out;
+}
+
+} // namespace Slic3r
@@ -0,0 +1,43 @@
+#ifndef slic3r_MixedFilamentPalette_hpp_
+#define slic3r_MixedFilamentPalette_hpp_
+
+#include <string>
+#include <vector>
+
+namespace Slic3r {
+
+// Mixed filament recipe: every cycle prints component_ids[i] on layers[i] layers.
+struct MixedFilamentRecipe
+{
+    // 1-based physical filament IDs, ascending. A single component is the physical filament itself.
+    std::vector<unsigned int> component_ids;
+    std::vector<int>          layers;
+    // Colour "#RRGGBB" predicted by the FilamentMixer model and its CIEDE2000 difference from the target.
+    std::string               color;
+    double                    delta_e { 0. };
+
+    int cycle_layers() const;
+};
+
+struct MixedFilamentPaletteParams
+{
+    // Most physical filaments combined by a recipe.
+    size_t max_components { 3 };
+    // Longest cycle of a recipe, see mixed_filament_cycle_layers.
+    int    max_cycle_layers { 4 };
+};
+
+// Searches the recipes mixing filament_colours for the ones closest to the target colours "#RRGGBB", one recipe per target.
+// All the sets of up to max_components filaments with all the layer counts reduced to cycles of up to max_cycle_layers are
+// blended once, in parallel, and matched against all the targets. Ties go to fewer components and shorter cycles.
+// Recipes of three or more components use filaments 1..9 only to fit MixedFilamentManager::add_custom_sequence().
+std::vector<MixedFilamentRecipe> optimize_mixed_filament_palette(const std::vector<std::string>   &targets,
+                                                                 const std::vector<std::string>   &filament_colours,
+                                                                 const MixedFilamentPaletteParams &params = {});
+
+// CIEDE2000 difference of two "#RRGGBB" colours.
+double color_delta_e(const std::string &color_a, const std::string &color_b);
+
+} // namespace Slic3r
+
+#endif /* slic3r_MixedFilamentPalette_hpp_ */
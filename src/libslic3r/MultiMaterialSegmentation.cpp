@@ -3,6 +3,7 @@
 #include "EdgeGrid.hpp"
 #include "Layer.hpp"
 #include "Print.hpp"
+#include "Profiling.hpp"
 #include "Geometry/VoronoiVisualUtils.hpp"
 #include "Geometry/VoronoiUtils.hpp"
 #include "MutablePolygon.hpp"
@@ -14,8 +15,7 @@
 
 #include <boost/log/trivial.hpp>
 #include <tbb/parallel_for.h>
-#include <mutex>
-#include <boost/thread/lock_guard.hpp>
+#include <tbb/enumerable_thread_specific.h>
 
 //#define MM_SEGMENTATION_DEBUG_GRAPH
 //#define MM_SEGMENTATION_DEBUG_REGIONS
@@ -520,11 +520,21 @@ struct PaintedLine
     int    color;
 };
 
+using PaintedLinesSet = std::unordered_set<std::pair<size_t, size_t>, boost::hash<std::pair<size_t, size_t>>>;
+
+// Painted lines projected by a single thread, per layer, to be merged once all the painted facets are projected.
+struct PaintedLinesBuffer
+{
+    std::vector<std::vector<PaintedLine>> layers;
+    // Reused by the PaintedLineVisitors of the thread.
+    PaintedLinesSet                       painted_lines_set;
+};
+
 struct PaintedLineVisitor
 {
-    PaintedLineVisitor(const EdgeGrid::Grid &grid, std::vector<PaintedLine> &painted_lines, std::mutex &painted_lines_mutex, size_t reserve) : grid(grid), painted_lines(painted_lines), painted_lines_mutex(painted_lines_mutex)
+    PaintedLineVisitor(const EdgeGrid::Grid &grid, std::vector<PaintedLine> &painted_lines, PaintedLinesSet &painted_lines_set) : grid(grid), painted_lines(painted_lines), painted_lines_set(painted_lines_set)
     {
-        painted_lines_set.reserve(reserve);
+        painted_lines_set.clear();
     }
 
     void reset() { painted_lines_set.clear(); }
@@ -564,10 +574,7 @@ struct PaintedLineVisitor
                             line_to_test_projected.reverse();
 
                         painted_lines_set.insert(*it_contour_and_segment);
-                        {
-                            boost::lock_guard<std::mutex> lock(painted_lines_mutex);
-                            painted_lines.push_back({it_contour_and_segment->first, it_contour_and_segment->second, line_to_test_projected, this->color});
-                        }
+                        painted_lines.push_back({it_contour_and_segment->first, it_contour_and_segment->second, line_to_test_projected, this->color});
                     }
                 }
             }
@@ -576,16 +583,15 @@ struct PaintedLineVisitor
         return true;
     }
 
-    const EdgeGrid::Grid                                                                 &grid;
-    std::vector<PaintedLine>                                                             &painted_lines;
-    std::mutex                                                                           &painted_lines_mutex;
-    Line                                                                                  line_to_test;
-    std::unordered_set<std::pair<size_t, size_t>, boost::hash<std::pair<size_t, size_t>>> painted_lines_set;
-    int                                                                                   color             = -1;
+    const EdgeGrid::Grid       &grid;
+    std::vector<PaintedLine>   &painted_lines;
+    PaintedLinesSet            &painted_lines_set;
+    Line                        line_to_test;
+    int                         color             = -1;
 
-    static inline const double                                                            cos_threshold2    = Slic3r::sqr(cos(M_PI * 30. / 180.));
-    static inline const double                                                            append_threshold  = 50 * SCALED_EPSILON;
-    static inline const double                                                            append_threshold2 = Slic3r::sqr(append_threshold);
+    static inline const double  cos_threshold2    = Slic3r::sqr(cos(M_PI * 30. / 180.));
+    static inline const double  append_threshold  = 50 * SCALED_EPSILON;
+    static inline const double  append_threshold2 = Slic3r::sqr(append_threshold);
 };
 
 BoundingBox get_extents(const std::vector<ColoredLines> &colored_polygons) {
@@ -1966,7 +1972,6 @@ std::vector<std::vector<ExPolygons>> segmentation_by_painting(const PrintObject
     std::vector<std::vector<ExPolygons>>  segmented_regions(num_layers);
     segmented_regions.assign(num_layers, std::vector<ExPolygons>(num_facets_states));
     std::vector<std::vector<PaintedLine>> painted_lines(num_layers);
-    std::array<std::mutex, 64>            painted_lines_mutex;
     std::vector<EdgeGrid::Grid>           edge_grids(num_layers);
     const ConstLayerPtrsAdaptor           layers = print_object.layers();
     std::vector<ExPolygons>               input_expolygons(num_layers);
@@ -2029,9 +2034,11 @@ std::vector<std::vector<ExPolygons>> segmentation_by_painting(const PrintObject
     }
 
     BOOST_LOG_TRIVIAL(debug) << "Print object segmentation - Projection of painted triangles - Begin";
+    // Each thread collects the painted lines into its own buffer, the buffers are merged per layer once all the facets are projected.
+    tbb::enumerable_thread_specific<PaintedLinesBuffer> painted_lines_buffers;
     for (const ModelVolume *mv : print_object.model_object()->volumes) {
         const ModelVolumeFacetsInfo facets_info = extract_facets_info(*mv);
-        tbb::parallel_for(tbb::blocked_range<size_t>(1, num_facets_states), [&mv, &print_object, &facets_info, &layers, &edge_grids, &painted_lines, &painted_lines_mutex, &input_expolygons, &throw_on_cancel_callback](const tbb::blocked_range<size_t> &range) {
+        tbb::parallel_for(tbb::blocked_range<size_t>(1, num_facets_states), [&mv, &print_object, &facets_info, &layers, &edge_grids, &painted_lines_buffers, &input_expolygons, &throw_on_cancel_callback](const tbb::blocked_range<size_t> &range) {
             for (size_t extruder_idx = range.begin(); extruder_idx < range.end(); ++extruder_idx) {
                 throw_on_cancel_callback();
                 const indexed_triangle_set custom_facets = facets_info.facets_annotation.get_facets(*mv, EnforcerBlockerType(extruder_idx));
@@ -2039,7 +2046,10 @@ std::vector<std::vector<ExPolygons>> segmentation_by_painting(const PrintObject
                     continue;
 
                 const Transform3f tr = print_object.trafo().cast<float>() * mv->get_matrix().cast<float>();
-                tbb::parallel_for(tbb::blocked_range<size_t>(0, custom_facets.indices.size()), [&tr, &custom_facets, &print_object, &layers, &edge_grids, &input_expolygons, &painted_lines, &painted_lines_mutex, &extruder_idx](const tbb::blocked_range<size_t> &range) {
+                tbb::parallel_for(tbb::blocked_range<size_t>(0, custom_facets.indices.size()), [&tr, &custom_facets, &print_object, &layers, &edge_grids, &input_expolygons, &painted_lines_buffers, &extruder_idx](const tbb::blocked_range<size_t> &range) {
+                    PaintedLinesBuffer &buffer = painted_lines_buffers.local();
+                    if (buffer.layers.empty())
+                        buffer.layers.resize(layers.size());
                     for (size_t facet_idx = range.begin(); facet_idx < range.end(); ++facet_idx) {
                         float min_z = std::numeric_limits<float>::max();
                         float max_z = std::numeric_limits<float>::lowest();
@@ -2107,10 +2117,7 @@ std::vector<std::vector<ExPolygons>> segmentation_by_painting(const PrintObject
                                     continue;
                             }
 
-                            size_t mutex_idx = layer_idx & 0x3F;
-                            assert(mutex_idx < painted_lines_mutex.size());
-
-                            PaintedLineVisitor visitor(edge_grids[layer_idx], painted_lines[layer_idx], painted_lines_mutex[mutex_idx], 16);
+                            PaintedLineVisitor visitor(edge_grids[layer_idx], buffer.layers[layer_idx], buffer.painted_lines_set);
                             visitor.line_to_test = line_to_test;
                             visitor.color        = int(extruder_idx);
                             edge_grids[layer_idx].visit_cells_intersecting_line(line_to_test.a, line_to_test.b, visitor);
@@ -2120,6 +2127,16 @@ std::vector<std::vector<ExPolygons>> segmentation_by_painting(const PrintObject
             }
         }); // end of parallel_for
     }
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, num_layers), [&painted_lines, &painted_lines_buffers](const tbb::blocked_range<size_t> &range) {
+        for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++layer_idx) {
+            size_t num_painted_lines = 0;
+            for (const PaintedLinesBuffer &buffer : painted_lines_buffers)
+                num_painted_lines += buffer.layers[layer_idx].size();
+            painted_lines[layer_idx].reserve(num_painted_lines);
+            for (PaintedLinesBuffer &buffer : painted_lines_buffers)
+                Slic3r::append(painted_lines[layer_idx], std::move(buffer.layers[layer_idx]));
+        }
+    }); // end of parallel_for
     BOOST_LOG_TRIVIAL(debug) << "Print object segmentation - projection of painted triangles - end";
     BOOST_LOG_TRIVIAL(debug) << "Print object segmentation - painted layers count: "
                              << std::count_if(painted_lines.begin(), painted_lines.end(), [](const std::vector<PaintedLine> &pl) { return !pl.empty(); });
@@ -2196,6 +2213,7 @@ std::vector<std::vector<ExPolygons>> segmentation_by_painting(const PrintObject
 
 // Returns multi-material segmentation based on painting in multi-material segmentation gizmo
 std::vector<std::vector<ExPolygons>> multi_material_segmentation_by_painting(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback) {
+    Profiling::Scope profiling_scope("MM segmentation by painting", "MixedFilament", print_object.model_object()->name);
     const size_t num_physical_filaments = print_object.print()->config().filament_colour.size();
     const size_t num_total_filaments    = print_object.print()->mixed_filament_manager().total_filaments(num_physical_filaments);
     const size_t num_facets_states      = num_total_filaments + 1;
@@ -2253,4 +2271,603 @@ std::vector<std::vector<ExPolygons>> fuzzy_skin_segmentation_by_painting(const P
     return segmentation_by_painting(print_object, extract_facets_info, num_facets_states, max_external_perimeter_width, 0.f, false, IncludeTopAndBottomLayers::No, throw_on_cancel_callback);
 }
 
+std::vector<ExPolygons> split_masks_into_stripes(const ExPolygons                &masks,
+                                                 const std::vector<unsigned int> &slot_extruders,
+                                                 size_t                           phase,
+                                                 size_t                           num_extruders,
+                                                 unsigned int                     fallback_extruder,
+                                                 coord_t                          stripe_pitch,
+                                                 bool                             vertical)
+{
+    std::vector<ExPolygons> out_by_extruder(num_extruders);
+    if (masks.empty() || slot_extruders.empty() || stripe_pitch <= 0 || fallback_extruder == 0 || fallback_extruder > num_extruders)
+        return out_by_extruder;
+
+    const BoundingBox bbox = get_extents(masks);
+    if (!bbox.defined)
+        return out_by_extruder;
+
+    // Stripes are laid across axis, each of them spans the whole bounding box along the other axis.
+    const int     axis     = vertical ? 0 : 1;
+    const coord_t span_min = bbox.min(1 - axis);
+    const coord_t span_max = bbox.max(1 - axis);
+    std::vector<Polygons> stripes_by_extruder(num_extruders);
+    auto emit_stripes = [&](unsigned int extruder_id, coord_t from, coord_t to) {
+        Point pmin, pmax;
+        pmin(axis)     = from;
+        pmax(axis)     = to;
+        pmin(1 - axis) = span_min;
+        pmax(1 - axis) = span_max;
+        stripes_by_extruder[extruder_id - 1].emplace_back(BoundingBox(pmin, pmax).polygon());
+    };
+
+    coord_t grid_offset = bbox.min(axis) % stripe_pitch;
+    if (grid_offset < 0)
+        grid_offset += stripe_pitch;
+    unsigned int run_extruder = 0;
+    coord_t      run_begin    = bbox.min(axis);
+    size_t       stripe_idx   = 0;
+    for (coord_t stripe_begin = bbox.min(axis) - grid_offset; stripe_begin < bbox.max(axis); stripe_begin += stripe_pitch, ++stripe_idx) {
+        unsigned int extruder_id = slot_extruders[(stripe_idx + phase) % slot_extruders.size()];
+        if (extruder_id == 0 || extruder_id > num_extruders)
+            extruder_id = fallback_extruder;
+        if (extruder_id != run_extruder) {
+            const coord_t clamped_begin = std::max(stripe_begin, bbox.min(axis));
+            if (run_extruder != 0)
+                emit_stripes(run_extruder, run_begin, clamped_begin);
+            run_extruder = extruder_id;
+            run_begin    = clamped_begin;
+        }
+    }
+    if (run_extruder != 0)
+        emit_stripes(run_extruder, run_begin, bbox.max(axis));
+
+    // The stripes of all the extruders tile the bounding box, thus nothing of the masks is left to be assigned afterwards.
+    bool any_clipped = false;
+    for (size_t extruder_idx = 0; extruder_idx < num_extruders; ++extruder_idx)
+        if (!stripes_by_extruder[extruder_idx].empty()) {
+            out_by_extruder[extruder_idx] = intersection_ex(masks, stripes_by_extruder[extruder_idx], ApplySafetyOffset::Yes);
+            any_clipped |= !out_by_extruder[extruder_idx].empty();
+        }
+    if (!any_clipped)
+        out_by_extruder[fallback_extruder - 1] = masks;
+
+    return out_by_extruder;
+}
+
+unsigned int DitherTile::extruder(int64_t x, int64_t y) const
+{
+    const int64_t n  = int64_t(size);
+    int64_t       tx = x % n;
+    int64_t       ty = y % n;
+    if (tx < 0)
+        tx += n;
+    if (ty < 0)
+        ty += n;
+    return cells[size_t(ty) * size + size_t(tx)];
+}
+
+// Thresholds of the 16x16 ordered dither matrix, row by row.
+static std::vector<float> bayer_thresholds()
+{
+    constexpr size_t size = 16;
+    constexpr size_t bits = 4;
+    std::vector<float> out(size * size);
+    for (size_t y = 0; y < size; ++y)
+        for (size_t x = 0; x < size; ++x) {
+            // Interleave the bits of x ^ y and y from the least significant one down.
+            size_t rank = 0;
+            for (size_t bit = 0; bit < bits; ++bit) {
+                rank |= (((x ^ y) >> bit) & 1) << (2 * (bits - 1 - bit) + 1);
+                rank |= ((y >> bit) & 1) << (2 * (bits - 1 - bit));
+            }
+            out[y * size + x] = (float(rank) + 0.5f) / float(size * size);
+        }
+    return out;
+}
+
+// Thresholds of a 32x32 blue noise matrix, row by row, generated by the void-and-cluster method of Ulichney.
+// Deterministic, thus the same tiles are produced on every platform.
+static std::vector<float> blue_noise_thresholds()
+{
+    constexpr size_t size  = 32;
+    constexpr size_t count = size * size;
+    constexpr double sigma = 1.9;
+
+    // Gaussian energy of the toroidal offset (dx, dy).
+    std::vector<double> kernel(count);
+    for (size_t dy = 0; dy < size; ++dy)
+        for (size_t dx = 0; dx < size; ++dx) {
+            const double x = double(std::min(dx, size - dx));
+            const double y = double(std::min(dy, size - dy));
+            kernel[dy * size + dx] = std::exp(-(x * x + y * y) / (2. * sigma * sigma));
+        }
+    auto splat = [&kernel](std::vector<double> &energy, size_t idx, double sign) {
+        const size_t px = idx % size, py = idx / size;
+        for (size_t y = 0; y < size; ++y)
+            for (size_t x = 0; x < size; ++x)
+                energy[y * size + x] += sign * kernel[((y + size - py) % size) * size + (x + size - px) % size];
+    };
+    // Tightest cluster: the set point of the highest energy. Largest void: the unset point of the lowest energy.
+    auto tightest_cluster = [](const std::vector<uint8_t> &pattern, const std::vector<double> &energy) {
+        size_t best = 0;
+        for (size_t i = 0, found = 0; i < count; ++i)
+            if (pattern[i] && (!found++ || energy[i] > energy[best]))
+                best = i;
+        return best;
+    };
+    auto largest_void = [](const std::vector<uint8_t> &pattern, const std::vector<double> &energy) {
+        size_t best = 0;
+        for (size_t i = 0, found = 0; i < count; ++i)
+            if (!pattern[i] && (!found++ || energy[i] < energy[best]))
+                best = i;
+        return best;
+    };
+
+    // Initial pattern of a tenth of the points, scattered by a fixed linear congruential sequence, then relaxed
+    // by moving the points of the tightest clusters into the largest voids.
+    std::vector<uint8_t> pattern(count, 0);
+    std::vector<double>  energy(count, 0.);
+    uint32_t             seed = 12345;
+    for (size_t num_set = 0; num_set < count / 10;) {
+        seed = seed * 1664525u + 1013904223u;
+        const size_t idx = (seed >> 8) % count;
+        if (!pattern[idx]) {
+            pattern[idx] = 1;
+            splat(energy, idx, 1.);
+            ++num_set;
+        }
+    }
+    for (size_t iter = 0; iter < count; ++iter) {
+        const size_t cluster = tightest_cluster(pattern, energy);
+        pattern[cluster]     = 0;
+        splat(energy, cluster, -1.);
+        const size_t hole = largest_void(pattern, energy);
+        pattern[hole]     = 1;
+        splat(energy, hole, 1.);
+        if (hole == cluster)
+            break;
+    }
+
+    std::vector<size_t> rank(count, 0);
+    const size_t        num_initial = count / 10;
+    {
+        // Rank the initial points from the most clustered one down.
+        std::vector<uint8_t> p = pattern;
+        std::vector<double>  e = energy;
+        for (size_t r = num_initial; r > 0; --r) {
+            const size_t cluster = tightest_cluster(p, e);
+            p[cluster]           = 0;
+            splat(e, cluster, -1.);
+            rank[cluster] = r - 1;
+        }
+    }
+    // Rank the remaining points by filling the largest voids.
+    for (size_t r = num_initial; r < count; ++r) {
+        const size_t hole = largest_void(pattern, energy);
+        pattern[hole]     = 1;
+        splat(energy, hole, 1.);
+        rank[hole] = r;
+    }
+
+    std::vector<float> out(count);
+    for (size_t i = 0; i < count; ++i)
+        out[i] = (float(rank[i]) + 0.5f) / float(count);
+    return out;
+}
+
+DitherTile build_dither_tile(const std::vector<unsigned int> &slot_extruders, size_t phase, bool blue_noise)
+{
+    DitherTile tile;
+    if (slot_extruders.empty())
+        return tile;
+
+    static const std::vector<float> s_bayer      = bayer_thresholds();
+    static const std::vector<float> s_blue_noise = blue_noise_thresholds();
+    const std::vector<float>       &thresholds   = blue_noise ? s_blue_noise : s_bayer;
+
+    const size_t num_slots = slot_extruders.size();
+    tile.size              = blue_noise ? 32 : 16;
+    tile.cells.reserve(thresholds.size());
+    for (const float threshold : thresholds) {
+        const size_t slot = std::min(size_t(threshold * float(num_slots)), num_slots - 1);
+        tile.cells.emplace_back(slot_extruders[(slot + phase) % num_slots]);
+    }
+    return tile;
+}
+
+// Grid of square cells of cell_size covering a bounding box, the cell (0, 0) of the plane anchored at the origin.
+struct DitherGrid
+{
+    coord_t cell_size;
+    int64_t x_begin;
+    int64_t y_begin;
+    size_t  columns;
+    size_t  rows;
+
+    int64_t cell_floor(coord_t c) const { return int64_t(c >= 0 ? c / cell_size : -((-c + cell_size - 1) / cell_size)); }
+    bool    on_grid(coord_t c) const { return c % cell_size == 0; }
+    // Index of the cell containing p, or -1 if p is out of the grid.
+    int64_t cell_idx(const Point &p) const
+    {
+        const int64_t col = this->cell_floor(p.x()) - x_begin;
+        const int64_t row = this->cell_floor(p.y()) - y_begin;
+        return col < 0 || row < 0 || col >= int64_t(columns) || row >= int64_t(rows) ? -1 : row * int64_t(columns) + col;
+    }
+    // Index of the cell containing the middle of the segment (a, b), or -1 if it is out of the grid.
+    int64_t cell_idx_of_middle(const Point &a, const Point &b) const
+    {
+        auto floor_div = [](int64_t n, int64_t d) { return n >= 0 ? n / d : -((-n + d - 1) / d); };
+        const int64_t col = floor_div(int64_t(a.x()) + int64_t(b.x()), 2 * int64_t(cell_size)) - x_begin;
+        const int64_t row = floor_div(int64_t(a.y()) + int64_t(b.y()), 2 * int64_t(cell_size)) - y_begin;
+        return col < 0 || row < 0 || col >= int64_t(columns) || row >= int64_t(rows) ? -1 : row * int64_t(columns) + col;
+    }
+    Point cell_min(size_t cell_idx) const
+    {
+        return { coord_t((x_begin + int64_t(cell_idx % columns)) * cell_size), coord_t((y_begin + int64_t(cell_idx / columns)) * cell_size) };
+    }
+    // Position of p on the boundary of the cell counter-clockwise from its minimum corner, -1 if p is not on the boundary.
+    int64_t boundary_param(size_t cell_idx, const Point &p) const
+    {
+        const Point pmin = this->cell_min(cell_idx);
+        const Point pmax = pmin + Point(cell_size, cell_size);
+        if (p.y() == pmin.y())
+            return p.x() - pmin.x();
+        if (p.x() == pmax.x())
+            return int64_t(cell_size) + p.y() - pmin.y();
+        if (p.y() == pmax.y())
+            return 2 * int64_t(cell_size) + pmax.x() - p.x();
+        if (p.x() == pmin.x())
+            return 3 * int64_t(cell_size) + pmax.y() - p.y();
+        return -1;
+    }
+};
+
+// Piece of a mask boundary inside a single cell, from the crossing where it enters the cell to the crossing where it leaves it.
+struct DitherCellChain
+{
+    size_t  cell_idx;
+    int64_t entry_param;
+    int64_t exit_param;
+    // Range of the points of the chain in the shared point buffer, both crossings included.
+    size_t  begin;
+    size_t  end;
+};
+
+// Cuts the rings of masks at the grid lines into chains per cell. The cells where the rings touch the grid lines at their vertices,
+// run along them, pass through the grid corners or lie inside a single cell are marked in degenerate, their chains are not emitted.
+static void dither_cell_chains(const ExPolygons &masks, const DitherGrid &grid, std::vector<DitherCellChain> &chains, Points &chain_points,
+                               std::vector<uint8_t> &degenerate)
+{
+    // Marks the cells around a point lying on the grid lines.
+    auto mark_around = [&grid, &degenerate](const Point &p) {
+        for (const Point &probe : { Point(p.x() - 1, p.y() - 1), Point(p.x() + 1, p.y() - 1), Point(p.x() - 1, p.y() + 1), Point(p.x() + 1, p.y() + 1) })
+            if (int64_t cell_idx = grid.cell_idx(probe); cell_idx >= 0)
+                degenerate[size_t(cell_idx)] = true;
+    };
+    struct Crossing
+    {
+        double t;
+        Point  point;
+    };
+    std::vector<Crossing> edge_crossings;
+    // Ring points interleaved with the crossings, the crossings flagged.
+    std::vector<std::pair<Point, bool>> ring;
+    auto visit_ring = [&](const Polygon &polygon) {
+        const Points &pts = polygon.points;
+        ring.clear();
+        for (size_t i = 0; i < pts.size(); ++i) {
+            const Point &a = pts[i];
+            const Point &b = pts[i + 1 < pts.size() ? i + 1 : 0];
+            ring.emplace_back(a, false);
+            if (grid.on_grid(a.x()) || grid.on_grid(a.y()))
+                mark_around(a);
+            if ((a.x() == b.x() && grid.on_grid(a.x())) || (a.y() == b.y() && grid.on_grid(a.y()))) {
+                // Edge running along a grid line, mark the cells on both of its sides.
+                const int64_t num_steps = std::max(std::abs(b.x() - a.x()), std::abs(b.y() - a.y())) / grid.cell_size + 1;
+                for (int64_t k = 0; k <= num_steps; ++k)
+                    mark_around(Point(a.x() + (b.x() - a.x()) * k / num_steps, a.y() + (b.y() - a.y()) * k / num_steps));
+                continue;
+            }
+            edge_crossings.clear();
+            for (int axis = 0; axis < 2; ++axis) {
+                const coord_t lo = std::min(a(axis), b(axis));
+                const coord_t hi = std::max(a(axis), b(axis));
+                for (int64_t line = grid.cell_floor(lo) + 1; line <= grid.cell_floor(hi - 1); ++line) {
+                    const coord_t c = coord_t(line * grid.cell_size);
+                    const double  t = double(c - a(axis)) / double(b(axis) - a(axis));
+                    Point         p;
+                    p(axis)     = c;
+                    p(1 - axis) = coord_t(std::llround(double(a(1 - axis)) + t * double(b(1 - axis) - a(1 - axis))));
+                    edge_crossings.push_back({ t, p });
+                }
+            }
+            std::sort(edge_crossings.begin(), edge_crossings.end(), [](const Crossing &l, const Crossing &r) { return l.t < r.t; });
+            for (const Crossing &crossing : edge_crossings) {
+                // Crossings through a grid corner, the rounded ones included, are degenerate.
+                if (grid.on_grid(crossing.point.x()) && grid.on_grid(crossing.point.y()))
+                    mark_around(crossing.point);
+                ring.emplace_back(crossing.point, true);
+            }
+        }
+        const auto it_first = std::find_if(ring.begin(), ring.end(), [](const std::pair<Point, bool> &p) { return p.second; });
+        if (it_first == ring.end()) {
+            // The ring does not cross the grid lines, it is an island or a hole inside a single cell.
+            if (!pts.empty())
+                if (int64_t cell_idx = grid.cell_idx(pts.front()); cell_idx >= 0)
+                    degenerate[size_t(cell_idx)] = true;
+            return;
+        }
+        const size_t first = size_t(it_first - ring.begin());
+        for (size_t i = 0; i < ring.size();) {
+            // Chain from the crossing at first + i to the next crossing.
+            DitherCellChain chain;
+            chain.begin = chain_points.size();
+            chain_points.emplace_back(ring[(first + i) % ring.size()].first);
+            size_t j = i + 1;
+            for (; !ring[(first + j) % ring.size()].second; ++j)
+                chain_points.emplace_back(ring[(first + j) % ring.size()].first);
+            chain_points.emplace_back(ring[(first + j) % ring.size()].first);
+            chain.end = chain_points.size();
+            // The cell of the chain is the one of the middle of its first segment, which lies inside the cell.
+            const Point  &p0       = chain_points[chain.begin];
+            const Point  &p1       = chain_points[chain.begin + 1];
+            const int64_t cell_idx = grid.cell_idx_of_middle(p0, p1);
+            if (cell_idx >= 0) {
+                chain.cell_idx    = size_t(cell_idx);
+                chain.entry_param = grid.boundary_param(chain.cell_idx, p0);
+                chain.exit_param  = grid.boundary_param(chain.cell_idx, chain_points[chain.end - 1]);
+                if (chain.entry_param < 0 || chain.exit_param < 0)
+                    degenerate[chain.cell_idx] = true;
+                else
+                    chains.emplace_back(chain);
+            }
+            i = j;
+        }
+    };
+    for (const ExPolygon &expoly : masks) {
+        visit_ring(expoly.contour);
+        for (const Polygon &hole : expoly.holes)
+            visit_ring(hole);
+    }
+}
+
+// Closes the chains of a cell into polygons along the cell boundary, the Weiler-Atherton clipping of the masks by a square.
+// Returns false if the entries and exits of the chains do not alternate along the cell boundary.
+static bool close_dither_cell_chains(const DitherGrid &grid, size_t cell_idx, const DitherCellChain *chains, size_t num_chains,
+                                     const Points &chain_points, ExPolygons &out)
+{
+    // Entries and exits along the boundary: an exit is always followed by an entry, counter-clockwise.
+    std::vector<std::pair<int64_t, int>> params;
+    params.reserve(2 * num_chains);
+    for (size_t i = 0; i < num_chains; ++i) {
+        params.emplace_back(chains[i].entry_param, int(i) + 1);
+        params.emplace_back(chains[i].exit_param, -int(i) - 1);
+    }
+    std::sort(params.begin(), params.end());
+    std::vector<int> next_chain(num_chains);
+    for (size_t i = 0; i < params.size(); ++i) {
+        const std::pair<int64_t, int> &next = params[(i + 1) % params.size()];
+        if (i + 1 < params.size() && params[i].first == next.first)
+            return false;
+        if (params[i].second < 0) {
+            if (next.second < 0)
+                return false;
+            next_chain[-params[i].second - 1] = next.second - 1;
+        }
+    }
+
+    const coord_t cell_size = grid.cell_size;
+    const Point   pmin      = grid.cell_min(cell_idx);
+    const Point   corners[4] = { pmin + Point(cell_size, 0), pmin + Point(cell_size, cell_size), pmin + Point(0, cell_size), pmin };
+    std::vector<bool> visited(num_chains, false);
+    for (size_t start = 0; start < num_chains; ++start) {
+        if (visited[start])
+            continue;
+        Polygon contour;
+        for (size_t i = start; !visited[i]; i = size_t(next_chain[i])) {
+            visited[i] = true;
+            const DitherCellChain &chain = chains[i];
+            contour.points.insert(contour.points.end(), chain_points.begin() + chain.begin, chain_points.begin() + chain.end);
+            // Corners passed counter-clockwise from the exit to the next entry.
+            const int64_t entry = chains[next_chain[i]].entry_param;
+            const int64_t end   = entry > chain.exit_param ? entry : entry + 4 * cell_size;
+            for (int64_t corner = chain.exit_param / cell_size + 1; corner * cell_size < end; ++corner)
+                contour.points.emplace_back(corners[(corner - 1) % 4]);
+        }
+        out.emplace_back(std::move(contour));
+    }
+    return true;
+}
+
+std::vector<ExPolygons> split_masks_into_dither_cells(const ExPolygons &masks,
+                                                      const DitherTile &tile,
+                                                      size_t            num_extruders,
+                                                      unsigned int      fallback_extruder,
+                                                      coord_t           cell_size)
+{
+    std::vector<ExPolygons> out_by_extruder(num_extruders);
+    if (masks.empty() || tile.empty() || cell_size <= 0 || fallback_extruder == 0 || fallback_extruder > num_extruders)
+        return out_by_extruder;
+
+    const BoundingBox bbox = get_extents(masks);
+    if (!bbox.defined)
+        return out_by_extruder;
+
+    DitherGrid grid { cell_size, 0, 0, 0, 0 };
+    grid.x_begin = grid.cell_floor(bbox.min.x());
+    grid.y_begin = grid.cell_floor(bbox.min.y());
+    grid.columns = size_t(grid.cell_floor(bbox.max.x()) + 1 - grid.x_begin);
+    grid.rows    = size_t(grid.cell_floor(bbox.max.y()) + 1 - grid.y_begin);
+    const size_t columns = grid.columns;
+    const size_t rows    = grid.rows;
+
+    // Classify the cells: the cells crossed by the boundary of the masks are clipped, the other ones are either completely
+    // inside or completely outside of the masks, which is decided by the crossings of the masks with the row through the cell centers.
+    enum CellClass : uint8_t { Outside, Inside, Boundary, Degenerate };
+    std::vector<DitherCellChain> chains;
+    Points                       chain_points;
+    std::vector<uint8_t>         degenerate(rows * columns, false);
+    dither_cell_chains(masks, grid, chains, chain_points, degenerate);
+    std::vector<uint8_t> cell_class(rows * columns, Outside);
+    for (const DitherCellChain &chain : chains)
+        cell_class[chain.cell_idx] = Boundary;
+    for (size_t cell_idx = 0; cell_idx < cell_class.size(); ++cell_idx)
+        if (degenerate[cell_idx])
+            cell_class[cell_idx] = Degenerate;
+
+    std::vector<std::vector<double>> row_crossings(rows);
+    auto visit_polygon = [&](const Polygon &polygon) {
+        for (size_t i = 0; i < polygon.points.size(); ++i) {
+            const Point  &a      = polygon.points[i];
+            const Point  &b      = polygon.points[i + 1 < polygon.points.size() ? i + 1 : 0];
+            const Point  &lo     = a.y() <= b.y() ? a : b;
+            const Point  &hi     = a.y() <= b.y() ? b : a;
+            // Crossings with the lines through the cell centers, the edge taken half-open in y.
+            const int64_t row_lo = std::max<int64_t>(grid.cell_floor(lo.y()) - grid.y_begin, 0);
+            const int64_t row_hi = std::min<int64_t>(grid.cell_floor(hi.y()) - grid.y_begin, int64_t(rows) - 1);
+            for (int64_t row = row_lo; row <= row_hi; ++row) {
+                const double y_center = (double(row + grid.y_begin) + 0.5) * double(cell_size);
+                if (double(lo.y()) <= y_center && y_center < double(hi.y()))
+                    row_crossings[size_t(row)].emplace_back(double(lo.x()) + (y_center - double(lo.y())) * double(hi.x() - lo.x()) / double(hi.y() - lo.y()));
+            }
+        }
+    };
+    for (const ExPolygon &expoly : masks) {
+        visit_polygon(expoly.contour);
+        for (const Polygon &hole : expoly.holes)
+            visit_polygon(hole);
+    }
+    for (size_t row = 0; row < rows; ++row) {
+        std::vector<double> &crossings = row_crossings[row];
+        std::sort(crossings.begin(), crossings.end());
+        // The masks do not overlap, thus the even-odd rule applies.
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            const int64_t col_lo = std::max<int64_t>(int64_t(std::ceil((crossings[i] - 0.5 * double(cell_size)) / double(cell_size))) - grid.x_begin, 0);
+            const int64_t col_hi = std::min<int64_t>(int64_t(std::floor((crossings[i + 1] - 0.5 * double(cell_size)) / double(cell_size))) - grid.x_begin, int64_t(columns) - 1);
+            for (int64_t col = col_lo; col <= col_hi; ++col)
+                if (uint8_t &c = cell_class[row * columns + size_t(col)]; c == Outside)
+                    c = Inside;
+        }
+    }
+
+    auto cell_extruder = [&](size_t cell_idx) {
+        unsigned int extruder_id = tile.extruder(grid.x_begin + int64_t(cell_idx % columns), grid.y_begin + int64_t(cell_idx / columns));
+        return extruder_id == 0 || extruder_id > num_extruders ? fallback_extruder : extruder_id;
+    };
+
+    // Most of the pieces are single cells, reserve for a piece per inside cell in the proportion of the extruder in the tile
+    // and for a few pieces per clipped cell, so that the pieces are not copied when the vectors grow.
+    {
+        size_t num_inside = 0, num_clipped = 0;
+        for (const uint8_t c : cell_class) {
+            num_inside += c == Inside;
+            num_clipped += c == Boundary || c == Degenerate;
+        }
+        std::vector<size_t> tile_cells(num_extruders, 0);
+        for (unsigned int extruder_id : tile.cells)
+            ++tile_cells[(extruder_id == 0 || extruder_id > num_extruders ? fallback_extruder : extruder_id) - 1];
+        for (size_t extruder_idx = 0; extruder_idx < num_extruders; ++extruder_idx)
+            out_by_extruder[extruder_idx].reserve((num_inside + 2 * num_clipped) * tile_cells[extruder_idx] / tile.cells.size() + 8);
+    }
+
+    // The cells crossed by the boundary are clipped by closing the chains of the boundary inside them.
+    std::sort(chains.begin(), chains.end(), [](const DitherCellChain &l, const DitherCellChain &r) { return l.cell_idx < r.cell_idx; });
+    for (auto it = chains.begin(); it != chains.end();) {
+        auto it_end = std::find_if(it, chains.end(), [cell_idx = it->cell_idx](const DitherCellChain &c) { return c.cell_idx != cell_idx; });
+        if (cell_class[it->cell_idx] == Boundary) {
+            ExPolygons &out = out_by_extruder[cell_extruder(it->cell_idx) - 1];
+            const size_t num_out = out.size();
+            if (!close_dither_cell_chains(grid, it->cell_idx, &*it, size_t(it_end - it), chain_points, out)) {
+                out.erase(out.begin() + num_out, out.end());
+                cell_class[it->cell_idx] = Degenerate;
+            }
+        }
+        it = it_end;
+    }
+
+    // Runs of cells of the same extruder and class along a row, [x_begin, x_end) in cells, open since row y_begin.
+    struct Run
+    {
+        int64_t      x_begin;
+        int64_t      x_end;
+        unsigned int extruder_id;
+        uint8_t      cell_class;
+        int64_t      y_begin;
+
+        bool continues(const Run &rhs) const { return x_begin == rhs.x_begin && x_end == rhs.x_end && extruder_id == rhs.extruder_id && cell_class == rhs.cell_class; }
+    };
+    std::vector<Polygons> degenerate_cells_by_extruder(num_extruders);
+    auto emit = [&](const Run &run, int64_t y_end) {
+        const coord_t x0 = coord_t(run.x_begin * cell_size);
+        const coord_t y0 = coord_t(run.y_begin * cell_size);
+        const coord_t x1 = coord_t(run.x_end * cell_size);
+        const coord_t y1 = coord_t(y_end * cell_size);
+        if (run.cell_class == Inside) {
+            Points &pts = out_by_extruder[run.extruder_id - 1].emplace_back().contour.points;
+            pts.reserve(4);
+            pts.emplace_back(x0, y0);
+            pts.emplace_back(x1, y0);
+            pts.emplace_back(x1, y1);
+            pts.emplace_back(x0, y1);
+        } else
+            degenerate_cells_by_extruder[run.extruder_id - 1].emplace_back(BoundingBox(Point(x0, y0), Point(x1, y1)).polygon());
+    };
+
+    const int64_t    tile_size = int64_t(tile.size);
+    const int64_t    tile_x0   = ((grid.x_begin % tile_size) + tile_size) % tile_size;
+    std::vector<Run> open_runs;
+    std::vector<Run> row_runs;
+    for (size_t row = 0; row < rows; ++row) {
+        const int64_t       y        = grid.y_begin + int64_t(row);
+        const unsigned int *tile_row = tile.cells.data() + size_t(((y % tile_size) + tile_size) % tile_size) * tile.size;
+        const uint8_t      *classes  = cell_class.data() + row * columns;
+        row_runs.clear();
+        for (size_t col = 0, tx = size_t(tile_x0); col < columns; ++col, tx = tx + 1 == tile.size ? 0 : tx + 1) {
+            const uint8_t c = classes[col];
+            if (c == Outside || c == Boundary)
+                continue;
+            const int64_t x           = grid.x_begin + int64_t(col);
+            unsigned int  extruder_id = tile_row[tx];
+            if (extruder_id == 0 || extruder_id > num_extruders)
+                extruder_id = fallback_extruder;
+            if (!row_runs.empty() && row_runs.back().x_end == x && row_runs.back().extruder_id == extruder_id && row_runs.back().cell_class == c)
+                row_runs.back().x_end = x + 1;
+            else
+                row_runs.push_back({ x, x + 1, extruder_id, c, y });
+        }
+        // Extend the open runs continuing in this row, close the others. Both lists are sorted by x.
+        auto it_open = open_runs.begin();
+        for (Run &run : row_runs) {
+            for (; it_open != open_runs.end() && it_open->x_begin < run.x_begin; ++it_open)
+                emit(*it_open, y);
+            if (it_open != open_runs.end() && it_open->x_begin == run.x_begin) {
+                if (it_open->continues(run))
+                    run.y_begin = it_open->y_begin;
+                else
+                    emit(*it_open, y);
+                ++it_open;
+            }
+        }
+        for (; it_open != open_runs.end(); ++it_open)
+            emit(*it_open, y);
+        open_runs.swap(row_runs);
+    }
+    for (const Run &run : open_runs)
+        emit(run, grid.y_begin + int64_t(rows));
+
+    bool any_assigned = false;
+    for (size_t extruder_idx = 0; extruder_idx < num_extruders; ++extruder_idx) {
+        ExPolygons &out = out_by_extruder[extruder_idx];
+        // Only the degenerate cells are left to a boolean operation, a single one per extruder.
+        if (!degenerate_cells_by_extruder[extruder_idx].empty())
+            append(out, intersection_ex(masks, degenerate_cells_by_extruder[extruder_idx]));
+        any_assigned |= !out.empty();
+    }
+    if (!any_assigned)
+        out_by_extruder[fallback_extruder - 1] = masks;
+
+    return out_by_extruder;
+}
+
 } // namespace Slic3r
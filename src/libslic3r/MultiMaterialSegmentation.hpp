@@ -1,6 +1,7 @@
 #ifndef slic3r_MultiMaterialSegmentation_hpp_
 #define slic3r_MultiMaterialSegmentation_hpp_
 
+#include <cstdint>
 #include <utility>
 #include <vector>
 
@@ -52,6 +53,49 @@ std::vector<std::vector<ExPolygons>> multi_material_segmentation_by_painting(con
 // Returns fuzzy skin segmentation based on painting in fuzzy skin segmentation gizmo
 std::vector<std::vector<ExPolygons>> fuzzy_skin_segmentation_by_painting(const PrintObject &print_object, const std::function<void()> &throw_on_cancel_callback);
 
+// Splits masks into stripes of stripe_pitch width running along the Y axis if vertical, along the X axis otherwise. The stripes lie
+// on a grid anchored at the origin, the i-th stripe crossing the bounding box of the masks is assigned the 1-based extruder
+// slot_extruders[(i + phase) % slot_extruders.size()], slots out of the range of num_extruders fall back to fallback_extruder.
+// Returns the masks per 0-based extruder. Neighbor stripes of the same extruder are merged in a single sweep over the grid,
+// thus each extruder is clipped from the masks by a single boolean operation.
+std::vector<ExPolygons> split_masks_into_stripes(const ExPolygons                &masks,
+                                                 const std::vector<unsigned int> &slot_extruders,
+                                                 size_t                           phase,
+                                                 size_t                           num_extruders,
+                                                 unsigned int                     fallback_extruder,
+                                                 coord_t                          stripe_pitch,
+                                                 bool                             vertical);
+
+// Assignment of the cells of a square tile to 1-based extruders. The tile repeats over the plane, its cell (0, 0) anchored
+// at the origin, so that the masks of all layers sharing a tile are dithered consistently.
+struct DitherTile
+{
+    size_t                    size { 0 };
+    // Extruder of the cell (x, y) at cells[y * size + x].
+    std::vector<unsigned int> cells;
+
+    bool         empty() const { return cells.empty(); }
+    // Extruder of the cell (x, y) of the plane.
+    unsigned int extruder(int64_t x, int64_t y) const;
+};
+
+// Dithers slot_extruders over the cells of an ordered (Bayer) or of a blue noise threshold matrix: a cell of threshold t in [0, 1)
+// gets slot_extruders[(floor(t * slot_extruders.size()) + phase) % slot_extruders.size()], thus each slot gets its share
+// of the cells evenly spread over the tile and the phase rotates the slots over the cells.
+DitherTile build_dither_tile(const std::vector<unsigned int> &slot_extruders, size_t phase, bool blue_noise);
+
+// Splits masks into square cells of cell_size assigned to extruders by tile, extruders out of the range of num_extruders fall back
+// to fallback_extruder. Returns the masks per 0-based extruder. The masks are expected not to overlap. Only the cells crossed by the
+// boundary of the masks are clipped, by closing the pieces of the boundary inside each of them along the cell sides, the cells inside
+// the masks are emitted as they are. Cells touched by the boundary at their sides or corners are left to a boolean operation.
+// The cells of each row are merged into runs of the same extruder and equal runs of consecutive rows into rectangles. The pieces
+// of an extruder may touch each other, the caller is expected to union them if needed.
+std::vector<ExPolygons> split_masks_into_dither_cells(const ExPolygons &masks,
+                                                      const DitherTile &tile,
+                                                      size_t            num_extruders,
+                                                      unsigned int      fallback_extruder,
+                                                      coord_t           cell_size);
+
 } // namespace Slic3r
 
 namespace boost::polygon {
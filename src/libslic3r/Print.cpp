@@ -49,6 +49,36 @@ namespace Slic3r {
 template class PrintState<PrintStep, psCount>;
 template class PrintState<PrintObjectStep, posCount>;
 
+const char* print_step_name(PrintStep step)
+{
+    switch (step) {
+    case psWipeTower:     return "WipeTower";
+    case psSkirtBrim:     return "SkirtBrim";
+    case psGCodeExport:   return "GCodeExport";
+    case psConflictCheck: return "ConflictCheck";
+    default:              return nullptr;
+    }
+}
+
+const char* print_step_name(PrintObjectStep step)
+{
+    switch (step) {
+    case posSlice:                    return "Slice";
+    case posPerimeters:               return "Perimeters";
+    case posEstimateCurledExtrusions: return "EstimateCurledExtrusions";
+    case posPrepareInfill:            return "PrepareInfill";
+    case posInfill:                   return "Infill";
+    case posIroning:                  return "Ironing";
+    case posSupportMaterial:          return "SupportMaterial";
+    case posSimplifyPath:             return "SimplifyPath";
+    case posSimplifySupportPath:      return "SimplifySupportPath";
+    case posDetectOverhangsForLift:   return "DetectOverhangsForLift";
+    case posSimplifyWall:             return "SimplifyWall";
+    case posSimplifyInfill:           return "SimplifyInfill";
+    default:                          return nullptr;
+    }
+}
+
 PrintRegion::PrintRegion(const PrintRegionConfig &config) : PrintRegion(config, config.hash()) {}
 PrintRegion::PrintRegion(PrintRegionConfig &&config) : PrintRegion(std::move(config), config.hash()) {}
 
@@ -68,13 +98,10 @@ void Print::clear()
     m_model.clear_objects();
 }
 
-// Called by Print::apply().
-// This method only accepts PrintConfig option keys.
-bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* new_config */, const std::vector<t_config_option_key> &opt_keys)
+// Collects the Print and PrintObject steps invalidated by a change of a single PrintConfig option.
+// Returns true if the option is not handled here, then all the steps have to be invalidated.
+static bool print_config_option_invalidated_steps(const t_config_option_key &opt_key, std::vector<PrintStep> &steps, std::vector<PrintObjectStep> &osteps)
 {
-    if (opt_keys.empty())
-        return false;
-
     // Cache the plenty of parameters, which influence the G-code generator only,
     // or they are only notes not influencing the generated G-code.
     static std::unordered_set<std::string> steps_gcode = {
@@ -190,6 +217,7 @@ bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* n
         "accel_to_decel_factor",
         "wipe_on_loops",
         "gcode_comments",
+        "gcode_in_place_statistics",
         "gcode_label_objects", 
         "exclude_object",
         "support_material_interface_fan_speed",
@@ -212,160 +240,175 @@ bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* n
 
     static std::unordered_set<std::string> steps_ignore;
 
+    if (steps_gcode.find(opt_key) != steps_gcode.end()) {
+        // These options only affect G-code export or they are just notes without influence on the generated G-code,
+        // so there is nothing to invalidate.
+        steps.emplace_back(psGCodeExport);
+    } else if (steps_ignore.find(opt_key) != steps_ignore.end()) {
+        // These steps have no influence on the G-code whatsoever. Just ignore them.
+    } else if (
+           opt_key == "skirt_type"
+        || opt_key == "skirt_loops"
+        || opt_key == "skirt_speed"
+        || opt_key == "skirt_height"
+        || opt_key == "min_skirt_length"
+        || opt_key == "single_loop_draft_shield"
+        || opt_key == "draft_shield"
+        || opt_key == "skirt_distance"
+        || opt_key == "skirt_start_angle"
+        || opt_key == "ooze_prevention"
+        || opt_key == "wipe_tower_x"
+        || opt_key == "wipe_tower_y"
+        || opt_key == "wipe_tower_rotation_angle") {
+        steps.emplace_back(psSkirtBrim);
+    } else if (
+           opt_key == "initial_layer_print_height"
+        || opt_key == "nozzle_diameter"
+        || opt_key == "filament_shrink"
+        || opt_key == "filament_shrinkage_compensation_z"
+        || opt_key == "resolution"
+        || opt_key == "precise_z_height"
+        || opt_key == "dithering_z_step_size"
+        || opt_key == "dithering_local_z_mode"
+        || opt_key == "dithering_step_painted_zones_only"
+        || opt_key == "mixed_filament_gradient_mode"
+        || opt_key == "mixed_filament_height_lower_bound"
+        || opt_key == "mixed_filament_height_upper_bound"
+        || opt_key == "mixed_filament_cycle_layers"
+        || opt_key == "mixed_filament_advanced_dithering"
+        || opt_key == "mixed_filament_pointillism_pattern"
+        || opt_key == "mixed_filament_surface_indentation"
+        || opt_key == "mixed_filament_definitions"
+        // Spiral Vase forces different kind of slicing than the normal model:
+        // In Spiral Vase mode, holes are closed and only the largest area contour is kept at each layer.
+        // Therefore toggling the Spiral Vase on / off requires complete reslicing.
+        || opt_key == "spiral_mode") {
+        osteps.emplace_back(posSlice);
+    } else if (
+           opt_key == "print_sequence"
+        || opt_key == "filament_type"
+        || opt_key == "chamber_temperature"
+        || opt_key == "nozzle_temperature_initial_layer"
+        || opt_key == "filament_minimal_purge_on_wipe_tower"
+        || opt_key == "filament_max_volumetric_speed"
+        || opt_key == "filament_loading_speed"
+        || opt_key == "filament_loading_speed_start"
+        || opt_key == "filament_unloading_speed"
+        || opt_key == "filament_unloading_speed_start"
+        || opt_key == "filament_toolchange_delay"
+        || opt_key == "filament_cooling_moves"
+        || opt_key == "filament_stamping_loading_speed"
+        || opt_key == "filament_stamping_distance"
+        || opt_key == "filament_cooling_initial_speed"
+        || opt_key == "filament_cooling_final_speed"
+        || opt_key == "filament_ramming_parameters"
+        || opt_key == "filament_multitool_ramming"
+        || opt_key == "filament_multitool_ramming_volume"
+        || opt_key == "filament_multitool_ramming_flow"
+        || opt_key == "filament_max_volumetric_speed"
+        || opt_key == "gcode_flavor"
+        || opt_key == "single_extruder_multi_material"
+        || opt_key == "nozzle_temperature"
+        // BBS
+        || opt_key == "supertack_plate_temp"
+        || opt_key == "cool_plate_temp"
+        || opt_key == "textured_cool_plate_temp"
+        || opt_key == "eng_plate_temp"
+        || opt_key == "hot_plate_temp"
+        || opt_key == "textured_plate_temp"
+        || opt_key == "enable_prime_tower"
+        || opt_key == "prime_tower_width"
+        || opt_key == "prime_tower_brim_width"
+        || opt_key == "first_layer_print_sequence"
+        || opt_key == "other_layers_print_sequence"
+        || opt_key == "other_layers_print_sequence_nums" 
+        || opt_key == "wipe_tower_bridging"
+        || opt_key == "wipe_tower_extra_flow"
+        || opt_key == "wipe_tower_no_sparse_layers"
+        || opt_key == "flush_volumes_matrix"
+        || opt_key == "prime_volume"
+        || opt_key == "prime_tower_brim_chamfer"
+        || opt_key == "prime_tower_brim_chamfer_max_width"
+        || opt_key == "flush_into_infill"
+        || opt_key == "flush_into_support"
+        || opt_key == "initial_layer_infill_speed"
+        || opt_key == "travel_speed"
+        || opt_key == "travel_speed_z"
+        || opt_key == "initial_layer_speed"
+        || opt_key == "initial_layer_travel_speed"
+        || opt_key == "slow_down_layers"
+        || opt_key == "idle_temperature"
+        || opt_key == "wipe_tower_cone_angle"
+        || opt_key == "wipe_tower_extra_spacing"
+        || opt_key == "wipe_tower_max_purge_speed"
+        || opt_key == "wipe_tower_wall_type"
+        || opt_key == "wipe_tower_extra_rib_length"
+        || opt_key == "wipe_tower_rib_width"
+        || opt_key == "wipe_tower_fillet_wall"
+        || opt_key == "wipe_tower_filament"
+        || opt_key == "wiping_volumes_extruders"
+        || opt_key == "enable_filament_ramming"
+        || opt_key == "purge_in_prime_tower"
+        || opt_key == "z_offset"
+        || opt_key == "support_multi_bed_types"
+        ) {
+        steps.emplace_back(psWipeTower);
+        steps.emplace_back(psSkirtBrim);
+    } else if (opt_key == "filament_soluble"
+            || opt_key == "filament_is_support"
+            || opt_key == "independent_support_layer_height") {
+        steps.emplace_back(psWipeTower);
+        // Soluble support interface / non-soluble base interface produces non-soluble interface layers below soluble interface layers.
+        // Thus switching between soluble / non-soluble interface layer material may require recalculation of supports.
+        //FIXME Killing supports on any change of "filament_soluble" is rough. We should check for each object whether that is necessary.
+        osteps.emplace_back(posSupportMaterial);
+        osteps.emplace_back(posSimplifySupportPath);
+    } else if (
+           opt_key == "initial_layer_line_width"
+        || opt_key == "min_layer_height"
+        || opt_key == "max_layer_height"
+        //|| opt_key == "resolution"
+        //BBS: when enable arc fitting, we must re-generate perimeter
+        || opt_key == "enable_arc_fitting"
+        || opt_key == "print_order"
+        || opt_key == "wall_sequence") {
+        osteps.emplace_back(posPerimeters);
+        osteps.emplace_back(posEstimateCurledExtrusions);
+        osteps.emplace_back(posInfill);
+        osteps.emplace_back(posSupportMaterial);
+			osteps.emplace_back(posSimplifyPath);
+        osteps.emplace_back(posSimplifyInfill);
+        osteps.emplace_back(posSimplifySupportPath);
+        steps.emplace_back(psSkirtBrim);
+    }
+    else if (opt_key == "z_hop_types") {
+        osteps.emplace_back(posDetectOverhangsForLift);
+    } else {
+        // for legacy, if we can't handle this option let's invalidate all steps
+        return true;
+    }
+    return false;
+}
+
+// Called by Print::apply().
+// This method only accepts PrintConfig option keys.
+bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* new_config */, const std::vector<t_config_option_key> &opt_keys)
+{
+    if (opt_keys.empty())
+        return false;
+
     std::vector<PrintStep> steps;
     std::vector<PrintObjectStep> osteps;
     bool invalidated = false;
+    bool replan_mixed_segmentation = false;
 
-    for (const t_config_option_key &opt_key : opt_keys) {
-        if (steps_gcode.find(opt_key) != steps_gcode.end()) {
-            // These options only affect G-code export or they are just notes without influence on the generated G-code,
-            // so there is nothing to invalidate.
-            steps.emplace_back(psGCodeExport);
-        } else if (steps_ignore.find(opt_key) != steps_ignore.end()) {
-            // These steps have no influence on the G-code whatsoever. Just ignore them.
-        } else if (
-               opt_key == "skirt_type"
-            || opt_key == "skirt_loops"
-            || opt_key == "skirt_speed"
-            || opt_key == "skirt_height"
-            || opt_key == "min_skirt_length"
-            || opt_key == "single_loop_draft_shield"
-            || opt_key == "draft_shield"
-            || opt_key == "skirt_distance"
-            || opt_key == "skirt_start_angle"
-            || opt_key == "ooze_prevention"
-            || opt_key == "wipe_tower_x"
-            || opt_key == "wipe_tower_y"
-            || opt_key == "wipe_tower_rotation_angle") {
-            steps.emplace_back(psSkirtBrim);
-        } else if (
-               opt_key == "initial_layer_print_height"
-            || opt_key == "nozzle_diameter"
-            || opt_key == "filament_shrink"
-            || opt_key == "filament_shrinkage_compensation_z"
-            || opt_key == "resolution"
-            || opt_key == "precise_z_height"
-            || opt_key == "dithering_z_step_size"
-            || opt_key == "dithering_local_z_mode"
-            || opt_key == "dithering_step_painted_zones_only"
-            || opt_key == "mixed_filament_gradient_mode"
-            || opt_key == "mixed_filament_height_lower_bound"
-            || opt_key == "mixed_filament_height_upper_bound"
-            || opt_key == "mixed_filament_cycle_layers"
-            || opt_key == "mixed_filament_advanced_dithering"
-            || opt_key == "mixed_filament_surface_indentation"
-            || opt_key == "mixed_filament_definitions"
-            // Spiral Vase forces different kind of slicing than the normal model:
-            // In Spiral Vase mode, holes are closed and only the largest area contour is kept at each layer.
-            // Therefore toggling the Spiral Vase on / off requires complete reslicing.
-            || opt_key == "spiral_mode") {
-            osteps.emplace_back(posSlice);
-        } else if (
-               opt_key == "print_sequence"
-            || opt_key == "filament_type"
-            || opt_key == "chamber_temperature"
-            || opt_key == "nozzle_temperature_initial_layer"
-            || opt_key == "filament_minimal_purge_on_wipe_tower"
-            || opt_key == "filament_max_volumetric_speed"
-            || opt_key == "filament_loading_speed"
-            || opt_key == "filament_loading_speed_start"
-            || opt_key == "filament_unloading_speed"
-            || opt_key == "filament_unloading_speed_start"
-            || opt_key == "filament_toolchange_delay"
-            || opt_key == "filament_cooling_moves"
-            || opt_key == "filament_stamping_loading_speed"
-            || opt_key == "filament_stamping_distance"
-            || opt_key == "filament_cooling_initial_speed"
-            || opt_key == "filament_cooling_final_speed"
-            || opt_key == "filament_ramming_parameters"
-            || opt_key == "filament_multitool_ramming"
-            || opt_key == "filament_multitool_ramming_volume"
-            || opt_key == "filament_multitool_ramming_flow"
-            || opt_key == "filament_max_volumetric_speed"
-            || opt_key == "gcode_flavor"
-            || opt_key == "single_extruder_multi_material"
-            || opt_key == "nozzle_temperature"
-            // BBS
-            || opt_key == "supertack_plate_temp"
-            || opt_key == "cool_plate_temp"
-            || opt_key == "textured_cool_plate_temp"
-            || opt_key == "eng_plate_temp"
-            || opt_key == "hot_plate_temp"
-            || opt_key == "textured_plate_temp"
-            || opt_key == "enable_prime_tower"
-            || opt_key == "prime_tower_width"
-            || opt_key == "prime_tower_brim_width"
-            || opt_key == "first_layer_print_sequence"
-            || opt_key == "other_layers_print_sequence"
-            || opt_key == "other_layers_print_sequence_nums" 
-            || opt_key == "wipe_tower_bridging"
-            || opt_key == "wipe_tower_extra_flow"
-            || opt_key == "wipe_tower_no_sparse_layers"
-            || opt_key == "flush_volumes_matrix"
-            || opt_key == "prime_volume"
-            || opt_key == "prime_tower_brim_chamfer"
-            || opt_key == "prime_tower_brim_chamfer_max_width"
-            || opt_key == "flush_into_infill"
-            || opt_key == "flush_into_support"
-            || opt_key == "initial_layer_infill_speed"
-            || opt_key == "travel_speed"
-            || opt_key == "travel_speed_z"
-            || opt_key == "initial_layer_speed"
-            || opt_key == "initial_layer_travel_speed"
-            || opt_key == "slow_down_layers"
-            || opt_key == "idle_temperature"
-            || opt_key == "wipe_tower_cone_angle"
-            || opt_key == "wipe_tower_extra_spacing"
-            || opt_key == "wipe_tower_max_purge_speed"
-            || opt_key == "wipe_tower_wall_type"
-            || opt_key == "wipe_tower_extra_rib_length"
-            || opt_key == "wipe_tower_rib_width"
-            || opt_key == "wipe_tower_fillet_wall"
-            || opt_key == "wipe_tower_filament"
-            || opt_key == "wiping_volumes_extruders"
-            || opt_key == "enable_filament_ramming"
-            || opt_key == "purge_in_prime_tower"
-            || opt_key == "z_offset"
-            || opt_key == "support_multi_bed_types"
-            ) {
-            steps.emplace_back(psWipeTower);
-            steps.emplace_back(psSkirtBrim);
-        } else if (opt_key == "filament_soluble"
-                || opt_key == "filament_is_support"
-                || opt_key == "independent_support_layer_height") {
-            steps.emplace_back(psWipeTower);
-            // Soluble support interface / non-soluble base interface produces non-soluble interface layers below soluble interface layers.
-            // Thus switching between soluble / non-soluble interface layer material may require recalculation of supports.
-            //FIXME Killing supports on any change of "filament_soluble" is rough. We should check for each object whether that is necessary.
-            osteps.emplace_back(posSupportMaterial);
-            osteps.emplace_back(posSimplifySupportPath);
-        } else if (
-               opt_key == "initial_layer_line_width"
-            || opt_key == "min_layer_height"
-            || opt_key == "max_layer_height"
-            //|| opt_key == "resolution"
-            //BBS: when enable arc fitting, we must re-generate perimeter
-            || opt_key == "enable_arc_fitting"
-            || opt_key == "print_order"
-            || opt_key == "wall_sequence") {
-            osteps.emplace_back(posPerimeters);
-            osteps.emplace_back(posEstimateCurledExtrusions);
-            osteps.emplace_back(posInfill);
-            osteps.emplace_back(posSupportMaterial);
-			osteps.emplace_back(posSimplifyPath);
-            osteps.emplace_back(posSimplifyInfill);
-            osteps.emplace_back(posSimplifySupportPath);
-            steps.emplace_back(psSkirtBrim);
-        }
-        else if (opt_key == "z_hop_types") {
-            osteps.emplace_back(posDetectOverhangsForLift);
-        } else {
-            // for legacy, if we can't handle this option let's invalidate all steps
+    // Continue with the other opt_keys after invalidating all steps to possibly invalidate any object specific steps.
+    for (const t_config_option_key &opt_key : opt_keys)
+        if (PrintObject::is_mixed_segmentation_option(opt_key))
+            replan_mixed_segmentation = true;
+        else if (print_config_option_invalidated_steps(opt_key, steps, osteps))
             //FIXME invalidate all steps of all objects as well?
             invalidated |= this->invalidate_all_steps();
-            // Continue with the other opt_keys to possibly invalidate any object specific steps.
-        }
-    }
 
     sort_remove_duplicates(steps);
     for (PrintStep step : steps)
@@ -374,6 +417,9 @@ bool Print::invalidate_state_by_config_options(const ConfigOptionResolver & /* n
     for (PrintObjectStep ostep : osteps)
         for (PrintObject *object : m_objects)
             invalidated |= object->invalidate_step(ostep);
+    if (replan_mixed_segmentation)
+        for (PrintObject *object : m_objects)
+            invalidated |= object->invalidate_mixed_segmentation();
 
     return invalidated;
 }
@@ -1928,19 +1974,27 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
     int object_count = m_objects.size();
     std::set<PrintObject*> need_slicing_objects;
     std::set<PrintObject*> re_slicing_objects;
+    // Objects to be sliced bucketed by their content fingerprint, only objects of the same bucket may be the same.
+    std::unordered_map<PrintObjectFingerprint, std::vector<PrintObject*>, PrintObjectFingerprint::Hash> slicing_objects_by_fingerprint;
+    auto add_slicing_object = [&need_slicing_objects, &slicing_objects_by_fingerprint](PrintObject *obj) {
+        need_slicing_objects.insert(obj);
+        slicing_objects_by_fingerprint[obj->content_fingerprint()].emplace_back(obj);
+    };
+    auto find_same_slicing_object = [&slicing_objects_by_fingerprint, &is_print_object_the_same](const PrintObject *obj) -> PrintObject* {
+        if (auto it = slicing_objects_by_fingerprint.find(obj->content_fingerprint()); it != slicing_objects_by_fingerprint.end())
+            for (PrintObject *slicing_obj : it->second)
+                if (is_print_object_the_same(obj, slicing_obj))
+                    return slicing_obj;
+        return nullptr;
+    };
     if (!use_cache) {
         for (int index = 0; index < object_count; index++)
         {
             PrintObject *obj =  m_objects[index];
-            for (PrintObject *slicing_obj : need_slicing_objects)
-            {
-                if (is_print_object_the_same(obj, slicing_obj)) {
-                    obj->set_shared_object(slicing_obj);
-                    break;
-                }
-            }
-            if (!obj->get_shared_object())
-                need_slicing_objects.insert(obj);
+            if (PrintObject *slicing_obj = find_same_slicing_object(obj); slicing_obj)
+                obj->set_shared_object(slicing_obj);
+            else
+                add_slicing_object(obj);
         }
     }
     else {
@@ -1948,26 +2002,22 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
         {
             PrintObject *obj =  m_objects[index];
             if (obj->layer_count() > 0)
-                need_slicing_objects.insert(obj);
+                add_slicing_object(obj);
         }
         for (int index = 0; index < object_count; index++)
         {
             PrintObject *obj =  m_objects[index];
             bool found_shared = false;
             if (need_slicing_objects.find(obj) == need_slicing_objects.end()) {
-                for (PrintObject *slicing_obj : need_slicing_objects)
-                {
-                    if (is_print_object_the_same(obj, slicing_obj)) {
-                        obj->set_shared_object(slicing_obj);
-                        found_shared = true;
-                        break;
-                    }
+                if (PrintObject *slicing_obj = find_same_slicing_object(obj); slicing_obj) {
+                    obj->set_shared_object(slicing_obj);
+                    found_shared = true;
                 }
                 if (!found_shared) {
                     BOOST_LOG_TRIVIAL(warning) << boost::format("Also can not find the shared object, identify_id %1%, maybe shared object is skipped")%obj->model_object()->instances[0]->loaded_id;
                     //throw Slic3r::SlicingError("Cannot find the cached data.");
                     //don't report errot, set use_cache to false, and reslice these objects
-                    need_slicing_objects.insert(obj);
+                    add_slicing_object(obj);
                     re_slicing_objects.insert(obj);
                     //use_cache = false;
                 }
@@ -1978,71 +2028,45 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
     BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": total object counts %1% in current print, need to slice %2%")%m_objects.size()%need_slicing_objects.size();
     BOOST_LOG_TRIVIAL(info) << "Starting the slicing process." << log_memory_info();
     if (!use_cache) {
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->make_perimeters();
-            }
-            else {
-                if (obj->set_started(posSlice))
-                    obj->set_done(posSlice);
-                if (obj->set_started(posPerimeters))
-                    obj->set_done(posPerimeters);
-            }
-        }
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->estimate_curled_extrusions();
-            }
-            else {
-                if (obj->set_started(posEstimateCurledExtrusions))
-                    obj->set_done(posEstimateCurledExtrusions);
-            }
-        }
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->infill();
-            }
-            else {
-                if (obj->set_started(posPrepareInfill))
-                    obj->set_done(posPrepareInfill);
-                if (obj->set_started(posInfill))
-                    obj->set_done(posInfill);
-            }
-        }
-        for (PrintObject *obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->ironing();
-            }
-            else {
-                if (obj->set_started(posIroning))
-                    obj->set_done(posIroning);
-            }
-        }
-
-        tbb::parallel_for(tbb::blocked_range<int>(0, int(m_objects.size())),
-            [this, need_slicing_objects](const tbb::blocked_range<int>& range) {
+        // Each object runs its chain of steps on its own, the objects do not depend on each other. Running the chains
+        // concurrently lets the steps of small objects overlap instead of waiting for all the objects after each step.
+        // Cancellation is still reported by the steps throwing from inside the parallel loop.
+        // Objects sliced from scratch are looked up in the persistent slice cache first and stored there once sliced.
+        const bool use_slice_cache = ! m_slice_cache_dir.empty();
+        tbb::parallel_for(tbb::blocked_range<int>(0, int(m_objects.size()), 1),
+            [this, &need_slicing_objects, use_slice_cache](const tbb::blocked_range<int>& range) {
                 for (int i = range.begin(); i < range.end(); i++) {
                     PrintObject* obj = m_objects[i];
                     if (need_slicing_objects.count(obj) != 0) {
+                        const bool slice_from_scratch = use_slice_cache && ! obj->is_step_done(posSlice);
+                        if (slice_from_scratch && this->load_from_slice_cache(obj)) {
+                            for (PrintObjectStep step : { posSlice, posPerimeters, posPrepareInfill, posInfill, posIroning, posSupportMaterial,
+                                                          posDetectOverhangsForLift })
+                                if (obj->set_started(step))
+                                    obj->set_done(step);
+                            // The curled lines are not cached.
+                            obj->estimate_curled_extrusions();
+                            continue;
+                        }
+                        obj->make_perimeters();
+                        obj->estimate_curled_extrusions();
+                        obj->infill();
+                        obj->ironing();
                         obj->generate_support_material();
+                        obj->detect_overhangs_for_lift();
+                        if (slice_from_scratch)
+                            this->store_to_slice_cache(obj);
                     }
                     else {
-                        if (obj->set_started(posSupportMaterial))
-                            obj->set_done(posSupportMaterial);
+                        // Layers are copied from the shared object once all the chains finished.
+                        for (PrintObjectStep step : { posSlice, posPerimeters, posEstimateCurledExtrusions, posPrepareInfill, posInfill,
+                                                      posIroning, posSupportMaterial, posDetectOverhangsForLift })
+                            if (obj->set_started(step))
+                                obj->set_done(step);
                     }
                 }
             }
         );
-
-        for (PrintObject* obj : m_objects) {
-            if (need_slicing_objects.count(obj) != 0) {
-                obj->detect_overhangs_for_lift();
-            }
-            else {
-                if (obj->set_started(posDetectOverhangsForLift))
-                    obj->set_done(posDetectOverhangsForLift);
-            }
-        }
     }
     else {
         for (PrintObject *obj : m_objects) {
@@ -2196,6 +2220,9 @@ void Print::process(long long *time_cost_with_cache, bool use_cache)
                 obj->set_done(posSimplifySupportPath);
         }
     }
+    // The extrusions are final now, clip the perimeters of the Local-Z sub-passes ahead of the G-code export.
+    for (PrintObject *obj : m_objects)
+        obj->build_local_z_extrusions();
 
     // BBS
     bool has_adaptive_layer_height = false;
@@ -3864,54 +3891,331 @@ static void from_json(const json& j, groupedVolumeSlices& firstlayer_group)
     }
 }
 
-int Print::export_cached_data(const std::string& directory, bool with_space)
+static void convert_layer_to_json(json& layer_json, const Layer* layer)
 {
-    int ret = 0;
-    boost::filesystem::path directory_path(directory);
+    json slice_polygons_json = json::array(), slice_bboxs_json = json::array(), overhang_polygons_json = json::array(), layer_regions_json = json::array();
+    layer_json[JSON_LAYER_PRINT_Z] = layer->print_z;
+    layer_json[JSON_LAYER_HEIGHT] = layer->height;
+    layer_json[JSON_LAYER_SLICE_Z] = layer->slice_z;
+    layer_json[JSON_LAYER_ID] = layer->id();
+    //layer_json["slicing_errors"] = layer->slicing_errors;
+
+    //sliced_polygons
+    for (const ExPolygon& slice_polygon : layer->lslices) {
+        json slice_polygon_json = slice_polygon;
+        slice_polygons_json.push_back(std::move(slice_polygon_json));
+    }
+    layer_json[JSON_LAYER_SLICED_POLYGONS] = std::move(slice_polygons_json);
+
+    //sliced_bbox
+    for (const BoundingBox& slice_bbox : layer->lslices_bboxes) {
+        json bbox_json = json::array();
+
+        bbox_json = slice_bbox;
+        slice_bboxs_json.push_back(std::move(bbox_json));
+    }
+    layer_json[JSON_LAYER_SLLICED_BBOXES] = std::move(slice_bboxs_json);
+
+    //overhang_polygons
+    for (const ExPolygon& overhang_polygon : layer->loverhangs) {
+        json overhang_polygon_json = overhang_polygon;
+        overhang_polygons_json.push_back(std::move(overhang_polygon_json));
+    }
+    layer_json[JSON_LAYER_OVERHANG_POLYGONS] = std::move(overhang_polygons_json);
+
+    //overhang_box
+    layer_json[JSON_LAYER_OVERHANG_BBOX] = layer->loverhangs_bbox;
+
+    for (const LayerRegion *layer_region : layer->regions()) {
+        json region_json = *layer_region;
+
+        layer_regions_json.push_back(std::move(region_json));
+    }
+    layer_json[JSON_LAYER_REGIONS] = std::move(layer_regions_json);
+
+    return;
+}
+
+// Serializes the layers, the support layers and the first layer groups of a sliced object.
+static json print_object_to_json(const PrintObject *obj)
+{
+    json root_json, layers_json = json::array(), support_layers_json = json::array(), first_layer_groups = json::array();
+
+    //export the layers
+    std::vector<json> layers_json_vector(obj->layer_count());
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, obj->layer_count()),
+        [&layers_json_vector, obj](const tbb::blocked_range<size_t>& layer_range) {
+            for (size_t layer_index = layer_range.begin(); layer_index < layer_range.end(); ++ layer_index) {
+                const Layer *layer = obj->get_layer(layer_index);
+                json layer_json;
+                convert_layer_to_json(layer_json, layer);
+                layers_json_vector[layer_index] = std::move(layer_json);
+            }
+        }
+    );
+    for (int l_index = 0; l_index < layers_json_vector.size(); l_index++) {
+        layers_json.push_back(std::move(layers_json_vector[l_index]));
+    }
+    layers_json_vector.clear();
+    /*for (const Layer *layer : obj->layers()) {
+        // for each layer
+        json layer_json;
+
+        convert_layer_to_json(layer_json, layer);
+
+        layers_json.push_back(std::move(layer_json));
+    }*/
+
+    root_json[JSON_LAYERS] = std::move(layers_json);
+
+    //export the support layers
+    std::vector<json> support_layers_json_vector(obj->support_layer_count());
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, obj->support_layer_count()),
+        [&support_layers_json_vector, obj](const tbb::blocked_range<size_t>& support_layer_range) {
+            for (size_t s_layer_index = support_layer_range.begin(); s_layer_index < support_layer_range.end(); ++ s_layer_index) {
+                const SupportLayer *support_layer = obj->support_layers()[s_layer_index];
+                json support_layer_json, support_islands_json = json::array(), support_fills_json, supportfills_entities_json = json::array();
+
+                convert_layer_to_json(support_layer_json, support_layer);
 
-    auto convert_layer_to_json = [](json& layer_json, const Layer* layer) {
-        json slice_polygons_json = json::array(), slice_bboxs_json = json::array(), overhang_polygons_json = json::array(), layer_regions_json = json::array();
-        layer_json[JSON_LAYER_PRINT_Z] = layer->print_z;
-        layer_json[JSON_LAYER_HEIGHT] = layer->height;
-        layer_json[JSON_LAYER_SLICE_Z] = layer->slice_z;
-        layer_json[JSON_LAYER_ID] = layer->id();
-        //layer_json["slicing_errors"] = layer->slicing_errors;
-
-        //sliced_polygons
-        for (const ExPolygon& slice_polygon : layer->lslices) {
-            json slice_polygon_json = slice_polygon;
-            slice_polygons_json.push_back(std::move(slice_polygon_json));
+                support_layer_json[JSON_SUPPORT_LAYER_INTERFACE_ID] = support_layer->interface_id();
+                support_layer_json[JSON_SUPPORT_LAYER_TYPE] = support_layer->support_type;
+
+                //support_islands
+                for (const ExPolygon& support_island : support_layer->support_islands) {
+                    json support_island_json = support_island;
+                    support_islands_json.push_back(std::move(support_island_json));
+                }
+                support_layer_json[JSON_SUPPORT_LAYER_ISLANDS] = std::move(support_islands_json);
+
+                //support_fills
+                support_fills_json[JSON_EXTRUSION_NO_SORT] = support_layer->support_fills.no_sort;
+                support_fills_json[JSON_EXTRUSION_ENTITY_TYPE] = JSON_EXTRUSION_TYPE_COLLECTION;
+                for (const ExtrusionEntity* extrusion_entity : support_layer->support_fills.entities) {
+                    json supportfill_entity_json, supportfill_entity_paths_json = json::array();
+                    bool ret = convert_extrusion_to_json(supportfill_entity_json, supportfill_entity_paths_json, extrusion_entity);
+                    if (!ret)
+                        continue;
+
+                    supportfills_entities_json.push_back(std::move(supportfill_entity_json));
+                }
+                support_fills_json[JSON_EXTRUSION_ENTITIES] = std::move(supportfills_entities_json);
+                support_layer_json[JSON_SUPPORT_LAYER_FILLS] = std::move(support_fills_json);
+
+                support_layers_json_vector[s_layer_index] = std::move(support_layer_json);
+            }
         }
-        layer_json[JSON_LAYER_SLICED_POLYGONS] = std::move(slice_polygons_json);
+    );
+    for (int s_index = 0; s_index < support_layers_json_vector.size(); s_index++) {
+        support_layers_json.push_back(std::move(support_layers_json_vector[s_index]));
+    }
+    support_layers_json_vector.clear();
 
-        //sliced_bbox
-        for (const BoundingBox& slice_bbox : layer->lslices_bboxes) {
-            json bbox_json = json::array();
+    /*for (const SupportLayer *support_layer : obj->support_layers()) {
+        json support_layer_json, support_islands_json = json::array(), support_fills_json, supportfills_entities_json = json::array();
 
-            bbox_json = slice_bbox;
-            slice_bboxs_json.push_back(std::move(bbox_json));
+        convert_layer_to_json(support_layer_json, support_layer);
+
+        support_layer_json[JSON_SUPPORT_LAYER_INTERFACE_ID] = support_layer->interface_id();
+
+        //support_islands
+        for (const ExPolygon& support_island : support_layer->support_islands.expolygons) {
+            json support_island_json = support_island;
+            support_islands_json.push_back(std::move(support_island_json));
         }
-        layer_json[JSON_LAYER_SLLICED_BBOXES] = std::move(slice_bboxs_json);
+        support_layer_json[JSON_SUPPORT_LAYER_ISLANDS] = std::move(support_islands_json);
+
+        //support_fills
+        support_fills_json[JSON_EXTRUSION_NO_SORT] = support_layer->support_fills.no_sort;
+        support_fills_json[JSON_EXTRUSION_ENTITY_TYPE] = JSON_EXTRUSION_TYPE_COLLECTION;
+        for (const ExtrusionEntity* extrusion_entity : support_layer->support_fills.entities) {
+            json supportfill_entity_json, supportfill_entity_paths_json = json::array();
+            bool ret = convert_extrusion_to_json(supportfill_entity_json, supportfill_entity_paths_json, extrusion_entity);
+            if (!ret)
+                continue;
 
-        //overhang_polygons
-        for (const ExPolygon& overhang_polygon : layer->loverhangs) {
-            json overhang_polygon_json = overhang_polygon;
-            overhang_polygons_json.push_back(std::move(overhang_polygon_json));
+            supportfills_entities_json.push_back(std::move(supportfill_entity_json));
         }
-        layer_json[JSON_LAYER_OVERHANG_POLYGONS] = std::move(overhang_polygons_json);
+        support_fills_json[JSON_EXTRUSION_ENTITIES] = std::move(supportfills_entities_json);
+        support_layer_json[JSON_SUPPORT_LAYER_FILLS] = std::move(support_fills_json);
 
-        //overhang_box
-        layer_json[JSON_LAYER_OVERHANG_BBOX] = layer->loverhangs_bbox;
+        support_layers_json.push_back(std::move(support_layer_json));
+    } // for each layer*/
+    root_json[JSON_SUPPORT_LAYERS] = std::move(support_layers_json);
 
-        for (const LayerRegion *layer_region : layer->regions()) {
-            json region_json = *layer_region;
+    const std::vector<groupedVolumeSlices> &first_layer_obj_groups =  obj->firstLayerObjGroups();
+    for (size_t s_group_index = 0; s_group_index < first_layer_obj_groups.size(); ++ s_group_index) {
+        groupedVolumeSlices group = first_layer_obj_groups[s_group_index];
 
-            layer_regions_json.push_back(std::move(region_json));
+        //convert the id
+        for (ObjectID& obj_id : group.volume_ids)
+        {
+            const ModelVolume* currentModelVolumePtr = nullptr;
+            //BBS: support shared object logic
+            const PrintObject* shared_object = obj->get_shared_object();
+            if (!shared_object)
+                shared_object = obj;
+            const ModelVolumePtrs& volumes_ptr = shared_object->model_object()->volumes;
+            size_t volume_count = volumes_ptr.size();
+            for (size_t index = 0; index < volume_count; index ++) {
+                currentModelVolumePtr = volumes_ptr[index];
+                if (currentModelVolumePtr->id() == obj_id) {
+                    obj_id.id = index;
+                    break;
+                }
+            }
         }
-        layer_json[JSON_LAYER_REGIONS] = std::move(layer_regions_json);
 
-        return;
-    };
+        json first_layer_group_json;
+
+        first_layer_group_json = group;
+        first_layer_groups.push_back(std::move(first_layer_group_json));
+    }
+    root_json[JSON_FIRSTLAYER_GROUPS] = std::move(first_layer_groups);
+
+    return root_json;
+}
+
+static const PrintRegion* find_region(const PrintObject* object, size_t config_hash)
+{
+    int regions_count = object->num_printing_regions();
+    for (int index = 0; index < regions_count; index++ )
+    {
+        const PrintRegion&  print_region = object->printing_region(index);
+        if (print_region.config_hash() == config_hash ) {
+            return &print_region;
+        }
+    }
+    return NULL;
+}
+
+// Rebuilds the layers of a cleared PrintObject from the json written by print_object_to_json(), returns 0 on success.
+static int print_object_from_json(PrintObject *obj, json &root_json, const std::string &file_name)
+{
+    std::string name = root_json.at(JSON_OBJECT_NAME);
+    int identify_id = root_json.at(JSON_IDENTIFY_ID);
+    int layer_count = 0, support_layer_count = 0, firstlayer_group_count = 0;
+
+    layer_count = root_json[JSON_LAYERS].size();
+    support_layer_count = root_json[JSON_SUPPORT_LAYERS].size();
+    firstlayer_group_count = root_json[JSON_FIRSTLAYER_GROUPS].size();
+
+    BOOST_LOG_TRIVIAL(info) << __FUNCTION__<<boost::format(":will load %1%, identify_id %2%, layer_count %3%, support_layer_count %4%, firstlayer_group_count %5%")
+        %name %identify_id %layer_count %support_layer_count %firstlayer_group_count;
+
+    Layer* previous_layer = NULL;
+    //create layer and layer regions
+    for (int index = 0; index < layer_count; index++)
+    {
+        json& layer_json = root_json[JSON_LAYERS][index];
+        Layer* new_layer = obj->add_layer(layer_json[JSON_LAYER_ID], layer_json[JSON_LAYER_HEIGHT], layer_json[JSON_LAYER_PRINT_Z], layer_json[JSON_LAYER_SLICE_Z]);
+        if (!new_layer) {
+            BOOST_LOG_TRIVIAL(error) <<__FUNCTION__<< boost::format(":create_layer failed, out of memory");
+            return CLI_OUT_OF_MEMORY;
+        }
+        if (previous_layer) {
+            previous_layer->upper_layer = new_layer;
+            new_layer->lower_layer = previous_layer;
+        }
+        previous_layer = new_layer;
+
+        //layer regions
+        int layer_regions_count = layer_json[JSON_LAYER_REGIONS].size();
+        for (int region_index = 0; region_index < layer_regions_count; region_index++)
+        {
+            json& region_json = layer_json[JSON_LAYER_REGIONS][region_index];
+            size_t config_hash = region_json[JSON_LAYER_REGION_CONFIG_HASH];
+            const PrintRegion *print_region = find_region(obj, config_hash);
+
+            if (!print_region){
+                BOOST_LOG_TRIVIAL(error) <<__FUNCTION__<< boost::format(":can not find print region of object %1%, layer %2%, print_z %3%, layer_region %4%")
+                    %name % index %new_layer->print_z %region_index;
+                //delete new_layer;
+                return CLI_IMPORT_CACHE_DATA_CAN_NOT_USE;
+            }
+
+            new_layer->add_region(print_region);
+        }
+
+    }
+
+    //load the layer data parallel
+    BOOST_LOG_TRIVIAL(info) << __FUNCTION__<<boost::format(": load the layers in parallel");
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, obj->layer_count()),
+        [&root_json, &obj](const tbb::blocked_range<size_t>& layer_range) {
+            for (size_t layer_index = layer_range.begin(); layer_index < layer_range.end(); ++ layer_index) {
+                const json& layer_json = root_json[JSON_LAYERS][layer_index];
+                Layer* layer = obj->get_layer(layer_index);
+                extract_layer(layer_json, *layer);
+            }
+        }
+    );
+
+    //support layers
+    Layer* previous_support_layer = NULL;
+    //create support_layers
+    for (int index = 0; index < support_layer_count; index++)
+    {
+        json& layer_json = root_json[JSON_SUPPORT_LAYERS][index];
+        SupportLayer* new_support_layer = obj->add_support_layer(layer_json[JSON_LAYER_ID], layer_json[JSON_SUPPORT_LAYER_INTERFACE_ID], layer_json[JSON_LAYER_HEIGHT], layer_json[JSON_LAYER_PRINT_Z]);
+        if (!new_support_layer) {
+            BOOST_LOG_TRIVIAL(error) <<__FUNCTION__<< boost::format(":add_support_layer failed, out of memory");
+            return CLI_OUT_OF_MEMORY;
+        }
+        if (previous_support_layer) {
+            previous_support_layer->upper_layer = new_support_layer;
+            new_support_layer->lower_layer = previous_support_layer;
+        }
+        previous_support_layer = new_support_layer;
+    }
+
+    BOOST_LOG_TRIVIAL(info) << __FUNCTION__<< boost::format(": finished load layers, start to load support_layers.");
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, obj->support_layer_count()),
+        [&root_json, &obj](const tbb::blocked_range<size_t>& support_layer_range) {
+            for (size_t layer_index = support_layer_range.begin(); layer_index < support_layer_range.end(); ++ layer_index) {
+                const json& layer_json = root_json[JSON_SUPPORT_LAYERS][layer_index];
+                SupportLayer* support_layer = obj->get_support_layer(layer_index);
+                extract_support_layer(layer_json, *support_layer);
+            }
+        }
+    );
+
+    //load first group volumes
+    std::vector<groupedVolumeSlices>& firstlayer_objgroups = obj->firstLayerObjGroupsMod();
+    for (int index = 0; index < firstlayer_group_count; index++)
+    {
+        json& firstlayer_group_json = root_json[JSON_FIRSTLAYER_GROUPS][index];
+        groupedVolumeSlices firstlayer_group = firstlayer_group_json;
+        //convert the id
+        for (ObjectID& obj_id : firstlayer_group.volume_ids)
+        {
+            ModelVolume* currentModelVolumePtr = nullptr;
+            ModelVolumePtrs& volumes_ptr = obj->model_object()->volumes;
+            size_t volume_count = volumes_ptr.size();
+            if (obj_id.id < volume_count) {
+                currentModelVolumePtr = volumes_ptr[obj_id.id];
+                obj_id = currentModelVolumePtr->id();
+            }
+            else {
+                BOOST_LOG_TRIVIAL(error) << __FUNCTION__<< boost::format(": can not find volume_id %1% from object file %2% in firstlayer groups, volume_count %3%!")
+                    %obj_id.id %file_name %volume_count;
+                return CLI_IMPORT_CACHE_LOAD_FAILED;
+            }
+        }
+        firstlayer_objgroups.push_back(std::move(firstlayer_group));
+    }
+
+    return 0;
+}
+
+int Print::export_cached_data(const std::string& directory, bool with_space)
+{
+    int ret = 0;
+    boost::filesystem::path directory_path(directory);
 
     //firstly clear this directory
     if (fs::exists(directory_path)) {
@@ -3947,145 +4251,10 @@ int Print::export_cached_data(const std::string& directory, bool with_space)
         BOOST_LOG_TRIVIAL(info) << boost::format("begin to dump object %1%, identify_id %2% to %3%")%model_obj->name %identify_id %file_name;
 
         try {
-            json root_json, layers_json = json::array(), support_layers_json = json::array(), first_layer_groups = json::array();
-
+            json root_json = print_object_to_json(obj);
             root_json[JSON_OBJECT_NAME] = model_obj->name;
             root_json[JSON_IDENTIFY_ID] = identify_id;
 
-            //export the layers
-            std::vector<json> layers_json_vector(obj->layer_count());
-            tbb::parallel_for(
-                tbb::blocked_range<size_t>(0, obj->layer_count()),
-                [&layers_json_vector, obj, convert_layer_to_json](const tbb::blocked_range<size_t>& layer_range) {
-                    for (size_t layer_index = layer_range.begin(); layer_index < layer_range.end(); ++ layer_index) {
-                        const Layer *layer = obj->get_layer(layer_index);
-                        json layer_json;
-                        convert_layer_to_json(layer_json, layer);
-                        layers_json_vector[layer_index] = std::move(layer_json);
-                    }
-                }
-            );
-            for (int l_index = 0; l_index < layers_json_vector.size(); l_index++) {
-                layers_json.push_back(std::move(layers_json_vector[l_index]));
-            }
-            layers_json_vector.clear();
-            /*for (const Layer *layer : obj->layers()) {
-                // for each layer
-                json layer_json;
-
-                convert_layer_to_json(layer_json, layer);
-
-                layers_json.push_back(std::move(layer_json));
-            }*/
-
-            root_json[JSON_LAYERS] = std::move(layers_json);
-
-            //export the support layers
-            std::vector<json> support_layers_json_vector(obj->support_layer_count());
-            tbb::parallel_for(
-                tbb::blocked_range<size_t>(0, obj->support_layer_count()),
-                [&support_layers_json_vector, obj, convert_layer_to_json](const tbb::blocked_range<size_t>& support_layer_range) {
-                    for (size_t s_layer_index = support_layer_range.begin(); s_layer_index < support_layer_range.end(); ++ s_layer_index) {
-                        const SupportLayer *support_layer = obj->get_support_layer(s_layer_index);
-                        json support_layer_json, support_islands_json = json::array(), support_fills_json, supportfills_entities_json = json::array();
-
-                        convert_layer_to_json(support_layer_json, support_layer);
-
-                        support_layer_json[JSON_SUPPORT_LAYER_INTERFACE_ID] = support_layer->interface_id();
-                        support_layer_json[JSON_SUPPORT_LAYER_TYPE] = support_layer->support_type;
-
-                        //support_islands
-                        for (const ExPolygon& support_island : support_layer->support_islands) {
-                            json support_island_json = support_island;
-                            support_islands_json.push_back(std::move(support_island_json));
-                        }
-                        support_layer_json[JSON_SUPPORT_LAYER_ISLANDS] = std::move(support_islands_json);
-
-                        //support_fills
-                        support_fills_json[JSON_EXTRUSION_NO_SORT] = support_layer->support_fills.no_sort;
-                        support_fills_json[JSON_EXTRUSION_ENTITY_TYPE] = JSON_EXTRUSION_TYPE_COLLECTION;
-                        for (const ExtrusionEntity* extrusion_entity : support_layer->support_fills.entities) {
-                            json supportfill_entity_json, supportfill_entity_paths_json = json::array();
-                            bool ret = convert_extrusion_to_json(supportfill_entity_json, supportfill_entity_paths_json, extrusion_entity);
-                            if (!ret)
-                                continue;
-
-                            supportfills_entities_json.push_back(std::move(supportfill_entity_json));
-                        }
-                        support_fills_json[JSON_EXTRUSION_ENTITIES] = std::move(supportfills_entities_json);
-                        support_layer_json[JSON_SUPPORT_LAYER_FILLS] = std::move(support_fills_json);
-
-                        support_layers_json_vector[s_layer_index] = std::move(support_layer_json);
-                    }
-                }
-            );
-            for (int s_index = 0; s_index < support_layers_json_vector.size(); s_index++) {
-                support_layers_json.push_back(std::move(support_layers_json_vector[s_index]));
-            }
-            support_layers_json_vector.clear();
-
-            /*for (const SupportLayer *support_layer : obj->support_layers()) {
-                json support_layer_json, support_islands_json = json::array(), support_fills_json, supportfills_entities_json = json::array();
-
-                convert_layer_to_json(support_layer_json, support_layer);
-
-                support_layer_json[JSON_SUPPORT_LAYER_INTERFACE_ID] = support_layer->interface_id();
-
-                //support_islands
-                for (const ExPolygon& support_island : support_layer->support_islands.expolygons) {
-                    json support_island_json = support_island;
-                    support_islands_json.push_back(std::move(support_island_json));
-                }
-                support_layer_json[JSON_SUPPORT_LAYER_ISLANDS] = std::move(support_islands_json);
-
-                //support_fills
-                support_fills_json[JSON_EXTRUSION_NO_SORT] = support_layer->support_fills.no_sort;
-                support_fills_json[JSON_EXTRUSION_ENTITY_TYPE] = JSON_EXTRUSION_TYPE_COLLECTION;
-                for (const ExtrusionEntity* extrusion_entity : support_layer->support_fills.entities) {
-                    json supportfill_entity_json, supportfill_entity_paths_json = json::array();
-                    bool ret = convert_extrusion_to_json(supportfill_entity_json, supportfill_entity_paths_json, extrusion_entity);
-                    if (!ret)
-                        continue;
-
-                    supportfills_entities_json.push_back(std::move(supportfill_entity_json));
-                }
-                support_fills_json[JSON_EXTRUSION_ENTITIES] = std::move(supportfills_entities_json);
-                support_layer_json[JSON_SUPPORT_LAYER_FILLS] = std::move(support_fills_json);
-
-                support_layers_json.push_back(std::move(support_layer_json));
-            } // for each layer*/
-            root_json[JSON_SUPPORT_LAYERS] = std::move(support_layers_json);
-
-            const std::vector<groupedVolumeSlices> &first_layer_obj_groups =  obj->firstLayerObjGroups();
-            for (size_t s_group_index = 0; s_group_index < first_layer_obj_groups.size(); ++ s_group_index) {
-                groupedVolumeSlices group = first_layer_obj_groups[s_group_index];
-
-                //convert the id
-                for (ObjectID& obj_id : group.volume_ids)
-                {
-                    const ModelVolume* currentModelVolumePtr = nullptr;
-                    //BBS: support shared object logic
-                    const PrintObject* shared_object = obj->get_shared_object();
-                    if (!shared_object)
-                        shared_object = obj;
-                    const ModelVolumePtrs& volumes_ptr = shared_object->model_object()->volumes;
-                    size_t volume_count = volumes_ptr.size();
-                    for (size_t index = 0; index < volume_count; index ++) {
-                        currentModelVolumePtr = volumes_ptr[index];
-                        if (currentModelVolumePtr->id() == obj_id) {
-                            obj_id.id = index;
-                            break;
-                        }
-                    }
-                }
-
-                json first_layer_group_json;
-
-                first_layer_group_json = group;
-                first_layer_groups.push_back(std::move(first_layer_group_json));
-            }
-            root_json[JSON_FIRSTLAYER_GROUPS] = std::move(first_layer_groups);
-
             filename_vector.push_back(file_name);
             json_vector.push_back(std::move(root_json));
             /*boost::nowide::ofstream c;
@@ -4142,18 +4311,6 @@ int Print::load_cached_data(const std::string& directory)
         return CLI_IMPORT_CACHE_NOT_FOUND;
     }
 
-    auto find_region = [this](PrintObject* object, size_t config_hash) -> const PrintRegion* {
-        int regions_count = object->num_printing_regions();
-        for (int index = 0; index < regions_count; index++ )
-        {
-            const PrintRegion&  print_region = object->printing_region(index);
-            if (print_region.config_hash() == config_hash ) {
-                return &print_region;
-            }
-        }
-        return NULL;
-    };
-
     int count = 0;
     std::vector<std::pair<std::string, PrintObject*>> object_filenames;
     for (PrintObject *obj : m_objects) {
@@ -4211,123 +4368,9 @@ int Print::load_cached_data(const std::string& directory)
         PrintObject *obj = object_filenames[obj_index].second;
 
         try {
-            //boost::nowide::ifstream ifs(file_name);
-            //ifs >> root_json;
-
-            std::string name = root_json.at(JSON_OBJECT_NAME);
-            int identify_id = root_json.at(JSON_IDENTIFY_ID);
-            int layer_count = 0, support_layer_count = 0, firstlayer_group_count = 0;
-
-            layer_count = root_json[JSON_LAYERS].size();
-            support_layer_count = root_json[JSON_SUPPORT_LAYERS].size();
-            firstlayer_group_count = root_json[JSON_FIRSTLAYER_GROUPS].size();
-
-            BOOST_LOG_TRIVIAL(info) << __FUNCTION__<<boost::format(":will load %1%, identify_id %2%, layer_count %3%, support_layer_count %4%, firstlayer_group_count %5%")
-                %name %identify_id %layer_count %support_layer_count %firstlayer_group_count;
-
-            Layer* previous_layer = NULL;
-            //create layer and layer regions
-            for (int index = 0; index < layer_count; index++)
-            {
-                json& layer_json = root_json[JSON_LAYERS][index];
-                Layer* new_layer = obj->add_layer(layer_json[JSON_LAYER_ID], layer_json[JSON_LAYER_HEIGHT], layer_json[JSON_LAYER_PRINT_Z], layer_json[JSON_LAYER_SLICE_Z]);
-                if (!new_layer) {
-                    BOOST_LOG_TRIVIAL(error) <<__FUNCTION__<< boost::format(":create_layer failed, out of memory");
-                    return CLI_OUT_OF_MEMORY;
-                }
-                if (previous_layer) {
-                    previous_layer->upper_layer = new_layer;
-                    new_layer->lower_layer = previous_layer;
-                }
-                previous_layer = new_layer;
-
-                //layer regions
-                int layer_regions_count = layer_json[JSON_LAYER_REGIONS].size();
-                for (int region_index = 0; region_index < layer_regions_count; region_index++)
-                {
-                    json& region_json = layer_json[JSON_LAYER_REGIONS][region_index];
-                    size_t config_hash = region_json[JSON_LAYER_REGION_CONFIG_HASH];
-                    const PrintRegion *print_region = find_region(obj, config_hash);
-
-                    if (!print_region){
-                        BOOST_LOG_TRIVIAL(error) <<__FUNCTION__<< boost::format(":can not find print region of object %1%, layer %2%, print_z %3%, layer_region %4%")
-                            %name % index %new_layer->print_z %region_index;
-                        //delete new_layer;
-                        return CLI_IMPORT_CACHE_DATA_CAN_NOT_USE;
-                    }
-
-                    new_layer->add_region(print_region);
-                }
-
-            }
-
-            //load the layer data parallel
-            BOOST_LOG_TRIVIAL(info) << __FUNCTION__<<boost::format(": load the layers in parallel");
-            tbb::parallel_for(
-                tbb::blocked_range<size_t>(0, obj->layer_count()),
-                [&root_json, &obj](const tbb::blocked_range<size_t>& layer_range) {
-                    for (size_t layer_index = layer_range.begin(); layer_index < layer_range.end(); ++ layer_index) {
-                        const json& layer_json = root_json[JSON_LAYERS][layer_index];
-                        Layer* layer = obj->get_layer(layer_index);
-                        extract_layer(layer_json, *layer);
-                    }
-                }
-            );
-
-            //support layers
-            Layer* previous_support_layer = NULL;
-            //create support_layers
-            for (int index = 0; index < support_layer_count; index++)
-            {
-                json& layer_json = root_json[JSON_SUPPORT_LAYERS][index];
-                SupportLayer* new_support_layer = obj->add_support_layer(layer_json[JSON_LAYER_ID], layer_json[JSON_SUPPORT_LAYER_INTERFACE_ID], layer_json[JSON_LAYER_HEIGHT], layer_json[JSON_LAYER_PRINT_Z]);
-                if (!new_support_layer) {
-                    BOOST_LOG_TRIVIAL(error) <<__FUNCTION__<< boost::format(":add_support_layer failed, out of memory");
-                    return CLI_OUT_OF_MEMORY;
-                }
-                if (previous_support_layer) {
-                    previous_support_layer->upper_layer = new_support_layer;
-                    new_support_layer->lower_layer = previous_support_layer;
-                }
-                previous_support_layer = new_support_layer;
-            }
-
-            BOOST_LOG_TRIVIAL(info) << __FUNCTION__<< boost::format(": finished load layers, start to load support_layers.");
-            tbb::parallel_for(
-                tbb::blocked_range<size_t>(0, obj->support_layer_count()),
-                [&root_json, &obj](const tbb::blocked_range<size_t>& support_layer_range) {
-                    for (size_t layer_index = support_layer_range.begin(); layer_index < support_layer_range.end(); ++ layer_index) {
-                        const json& layer_json = root_json[JSON_SUPPORT_LAYERS][layer_index];
-                        SupportLayer* support_layer = obj->get_support_layer(layer_index);
-                        extract_support_layer(layer_json, *support_layer);
-                    }
-                }
-            );
-
-            //load first group volumes
-            std::vector<groupedVolumeSlices>& firstlayer_objgroups = obj->firstLayerObjGroupsMod();
-            for (int index = 0; index < firstlayer_group_count; index++)
-            {
-                json& firstlayer_group_json = root_json[JSON_FIRSTLAYER_GROUPS][index];
-                groupedVolumeSlices firstlayer_group = firstlayer_group_json;
-                //convert the id
-                for (ObjectID& obj_id : firstlayer_group.volume_ids)
-                {
-                    ModelVolume* currentModelVolumePtr = nullptr;
-                    ModelVolumePtrs& volumes_ptr = obj->model_object()->volumes;
-                    size_t volume_count = volumes_ptr.size();
-                    if (obj_id.id < volume_count) {
-                        currentModelVolumePtr = volumes_ptr[obj_id.id];
-                        obj_id = currentModelVolumePtr->id();
-                    }
-                    else {
-                        BOOST_LOG_TRIVIAL(error) << __FUNCTION__<< boost::format(": can not find volume_id %1% from object file %2% in firstlayer groups, volume_count %3%!")
-                            %obj_id.id %object_filenames[obj_index].first %volume_count;
-                        return CLI_IMPORT_CACHE_LOAD_FAILED;
-                    }
-                }
-                firstlayer_objgroups.push_back(std::move(firstlayer_group));
-            }
+            int obj_ret = print_object_from_json(obj, root_json, object_filenames[obj_index].first);
+            if (obj_ret)
+                return obj_ret;
 
             count ++;
             BOOST_LOG_TRIVIAL(info) << __FUNCTION__<< boost::format(": load object %1% from %2% successfully.")%count%object_filenames[obj_index].first;
@@ -4348,6 +4391,85 @@ int Print::load_cached_data(const std::string& directory)
     return ret;
 }
 
+t_config_option_keys Print::slice_cache_config_keys() const
+{
+    t_config_option_keys keys;
+    std::vector<PrintStep> steps;
+    std::vector<PrintObjectStep> osteps;
+    for (const t_config_option_key &opt_key : m_config.keys()) {
+        osteps.clear();
+        if (print_config_option_invalidated_steps(opt_key, steps, osteps) || ! osteps.empty())
+            keys.emplace_back(opt_key);
+    }
+    return keys;
+}
+
+static std::string slice_cache_file_name(const std::string &directory, const PrintObjectFingerprint &key)
+{
+    return directory + "/" + (boost::format("%016x%016x.json") % key.hi % key.lo).str();
+}
+
+bool Print::load_from_slice_cache(PrintObject *object) const
+{
+    const std::string file_name = slice_cache_file_name(m_slice_cache_dir, object->slice_cache_key());
+    if (! fs::exists(file_name))
+        return false;
+
+    object->clear_layers();
+    object->clear_support_layers();
+    object->firstLayerObjGroupsMod().clear();
+    try {
+        json root_json;
+        boost::nowide::ifstream ifs(file_name);
+        ifs >> root_json;
+        if (print_object_from_json(object, root_json, file_name) == 0) {
+            // The cached regions hold the classified slices, the same as after PrintObject::prepare_infill().
+            object->m_typed_slices = true;
+            BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": object %1% loaded from slice cache %2%") % object->model_object()->name % file_name;
+            return true;
+        }
+    }
+    catch (std::exception &err) {
+        BOOST_LOG_TRIVIAL(warning) << __FUNCTION__ << ": load from " << file_name << " got a generic exception, reason = " << err.what();
+    }
+    // Drop a partially loaded entry, the object will be sliced from scratch.
+    object->clear_layers();
+    object->clear_support_layers();
+    object->firstLayerObjGroupsMod().clear();
+    return false;
+}
+
+void Print::store_to_slice_cache(const PrintObject *object) const
+{
+    // The Local-Z sub-layer plan is not part of the cached data, such objects are always sliced.
+    if (! object->local_z_intervals().empty())
+        return;
+
+    const std::string file_name = slice_cache_file_name(m_slice_cache_dir, object->slice_cache_key());
+    if (fs::exists(file_name))
+        return;
+
+    try {
+        fs::create_directories(m_slice_cache_dir);
+        const ModelInstance *model_instance = object->instances()[0].model_instance;
+        json root_json = print_object_to_json(object);
+        root_json[JSON_OBJECT_NAME] = object->model_object()->name;
+        root_json[JSON_IDENTIFY_ID] = (model_instance->loaded_id > 0) ? model_instance->loaded_id : model_instance->id().id;
+
+        // Written to a temporary file and renamed, so that the slicers sharing the cache directory never read a partial entry.
+        const std::string tmp_name = file_name + "." + fs::unique_path("%%%%-%%%%-%%%%").string();
+        boost::nowide::ofstream c;
+        c.open(tmp_name, std::ios::out | std::ios::trunc);
+        c << root_json.dump(0) << std::endl;
+        c.close();
+        fs::rename(tmp_name, file_name);
+        BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(": object %1% stored to slice cache %2%") % object->model_object()->name % file_name;
+    }
+    catch (std::exception &err) {
+        BOOST_LOG_TRIVIAL(warning) << __FUNCTION__ << ": save to " << file_name << " got a generic exception, reason = " << err.what();
+    }
+}
+
 BoundingBoxf3 PrintInstance::get_bounding_box() {
     return print_object->model_object()->instance_bounding_box(*model_instance, false);
 }
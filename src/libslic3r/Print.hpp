@@ -8,6 +8,7 @@
 #include "BoundingBox.hpp"
 #include "ExtrusionEntityCollection.hpp"
 #include "Flow.hpp"
+#include "LocalZPlanner.hpp"
 #include "Point.hpp"
 #include "Slicing.hpp"
 #include "TriangleMeshSlicer.hpp"
@@ -35,6 +36,7 @@ class ModelObject;
 class Print;
 class PrintObject;
 class SupportLayer;
+struct SeamVisibility;
 // BBS
 class TreeSupportData;
 class TreeSupport;
@@ -54,30 +56,33 @@ struct groupedVolumeSlices
     ExPolygons              slices;
 };
 
-// Phase A local-Z dithering planner cache.
-struct LocalZInterval
+// Local-Z perimeter sub-passes of one object layer, built from its SubLayerPlans by PrintObject::build_local_z_extrusions()
+// once the extrusions are final. The G-code export only groups the prebuilt collections.
+struct LocalZLayerExtrusions
 {
-    size_t layer_id { 0 };
-    double z_lo { 0.0 };
-    double z_hi { 0.0 };
-    double base_height { 0.0 };
-    double sublayer_height { 0.0 };
-    bool   has_mixed_paint { false };
-    size_t first_sublayer_idx { 0 };
-    size_t sublayer_count { 0 };
-};
+    struct Pass
+    {
+        const SubLayerPlan     *plan { nullptr };
+        // Painted masks of the pass grown to overlap the base perimeters, indexed by extruder.
+        std::vector<ExPolygons> compensated_masks_by_extruder;
+    };
+    // A perimeter collection of a region clipped into the sub-passes and into the remaining base part.
+    struct ClippedPerimeters
+    {
+        // [pass][extruder], nullptr where nothing is left after clipping.
+        std::vector<std::vector<std::unique_ptr<ExtrusionEntityCollection>>> by_pass;
+        // nullptr if the whole collection is printed by the sub-passes.
+        std::unique_ptr<ExtrusionEntityCollection>                           base;
+    };
 
-struct SubLayerPlan
-{
-    size_t layer_id { 0 };
-    size_t pass_index { 0 };
-    bool   split_interval { false };
-    double z_lo { 0.0 };
-    double z_hi { 0.0 };
-    double print_z { 0.0 };
-    double flow_height { 0.0 };
-    std::vector<ExPolygons> painted_masks_by_extruder;
-    ExPolygons              base_masks;
+    ExPolygons                                  raw_mixed_masks_union;
+    ExPolygons                                  mixed_masks_union;
+    ExPolygons                                  mixed_masks_union_for_base_exclude;
+    std::vector<Pass>                           passes;
+    // [region][index of the collection in LayerRegion::perimeters]
+    std::vector<std::vector<ClippedPerimeters>> perimeters;
+
+    bool empty() const { return passes.empty(); }
 };
 
 enum SupportNecessaryType {
@@ -125,6 +130,10 @@ enum PrintObjectStep {
     posCount,
 };
 
+// Names of the steps as reported to Profiling.
+const char* print_step_name(PrintStep step);
+const char* print_step_name(PrintObjectStep step);
+
 // A PrintRegion object represents a group of volumes to print
 // sharing the same config (including the same assigned extruder(s))
 class PrintRegion
@@ -336,6 +345,20 @@ private:
     size_t                                      m_ref_cnt{ 0 };
 };
 
+// 128 bit fingerprint of the content a PrintObject is sliced from: mesh identity, transformation,
+// per volume configs and paint data and the object config. See PrintObject::content_fingerprint().
+struct PrintObjectFingerprint
+{
+    uint64_t lo { 0 };
+    uint64_t hi { 0 };
+
+    bool operator==(const PrintObjectFingerprint &rhs) const { return lo == rhs.lo && hi == rhs.hi; }
+    bool operator!=(const PrintObjectFingerprint &rhs) const { return ! (*this == rhs); }
+    bool operator< (const PrintObjectFingerprint &rhs) const { return hi < rhs.hi || (hi == rhs.hi && lo < rhs.lo); }
+
+    struct Hash { size_t operator()(const PrintObjectFingerprint &fp) const { return size_t(fp.lo ^ fp.hi); } };
+};
+
 class PrintObject : public PrintObjectBaseWithState<Print, PrintObjectStep, posCount>
 {
 private: // Prevents erroneous use by other classes.
@@ -429,11 +452,24 @@ public:
     const std::vector<SubLayerPlan>&   local_z_sublayer_plan() const { return m_local_z_sublayer_plan; }
     void                                set_local_z_plan(std::vector<LocalZInterval> intervals, std::vector<SubLayerPlan> sublayers)
     {
+        m_local_z_layer_extrusions.clear();
         m_local_z_intervals = std::move(intervals);
         m_local_z_sublayer_plan = std::move(sublayers);
     }
+    // Sub-passes of a layer, nullptr if the layer is not split or build_local_z_extrusions() did not run yet.
+    const LocalZLayerExtrusions*        local_z_layer_extrusions(size_t layer_id) const
+    {
+        return layer_id < m_local_z_layer_extrusions.size() && ! m_local_z_layer_extrusions[layer_id].empty() ?
+            &m_local_z_layer_extrusions[layer_id] : nullptr;
+    }
+    // Clip the perimeters into the Local-Z sub-passes, in parallel over the layers. To be called after the last step
+    // modifying the extrusions, does nothing if already built or if there is no Local-Z plan.
+    void                                build_local_z_extrusions();
+    void                                clear_local_z_extrusions() { m_local_z_layer_extrusions.clear(); }
     void                                clear_local_z_plan()
     {
+        // The sub-passes reference the plans.
+        m_local_z_layer_extrusions.clear();
         m_local_z_intervals.clear();
         m_local_z_sublayer_plan.clear();
     }
@@ -494,6 +530,17 @@ public:
     void         get_certain_layers(float start, float end, std::vector<LayerPtrs> &out, std::vector<BoundingBox> &boundingbox_objects);
     Points       get_instances_shift_without_plate_offset();
     PrintObject* get_shared_object() const { return m_shared_object; }
+    // Fingerprint of everything Print::process() compares to share the slices of identical objects, updated by Print::apply().
+    // Objects with the same content always have the same fingerprint, thus it may key caches of sliced data.
+    const PrintObjectFingerprint& content_fingerprint() const { return m_content_fingerprint; }
+    // Key of the persistent slice cache, see Print::set_slice_cache_dir(). It hashes the meshes, thus it is computed on demand.
+    PrintObjectFingerprint slice_cache_key() const;
+    // Key of the seam visibility cache: the meshes and the transformations of the model parts and negative volumes.
+    PrintObjectFingerprint seam_visibility_key() const;
+    // Visibility of the object surface computed by SeamPlacer. It is kept over invalidation of the PrintObject steps, thus
+    // it survives re-slicing after config changes, and it is reused as long as its key matches seam_visibility_key().
+    std::shared_ptr<const SeamVisibility> seam_visibility() const { return m_seam_visibility; }
+    void         set_seam_visibility(std::shared_ptr<const SeamVisibility> visibility) const { m_seam_visibility = std::move(visibility); }
     void         set_shared_object(PrintObject *object);
     void         clear_shared_object();
     void         copy_layers_from_shared_object();
@@ -523,12 +570,18 @@ public:
     bool                    invalidate_step(PrintObjectStep step);
     // Invalidates all PrintObject and Print steps.
     bool                    invalidate_all_steps();
+    // Invalidates posSlice like invalidate_step(), but keeps the retained input of the multi-material segmentation,
+    // so that slice() re-runs just the mixed filament passes and the region assignment.
+    bool                    invalidate_mixed_segmentation();
+    // Options of the mixed filaments, which do not require the meshes to be sliced again, see invalidate_mixed_segmentation().
+    static bool             is_mixed_segmentation_option(const t_config_option_key &opt_key);
     // Invalidate steps based on a set of parameters changed.
     // It may be called for both the PrintObjectConfig and PrintRegionConfig.
     bool                    invalidate_state_by_config_options(
         const ConfigOptionResolver &old_config, const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys);
     // If ! m_slicing_params.valid, recalculate.
     void                    update_slicing_parameters();
+    void                    update_content_fingerprint();
 
     static PrintObjectConfig object_config_from_model_object(const PrintObjectConfig &default_object_config, const ModelObject &object, size_t num_extruders);
 
@@ -587,6 +640,8 @@ private:
     SupportLayerPtrs                        m_support_layers;
     std::vector<LocalZInterval>             m_local_z_intervals;
     std::vector<SubLayerPlan>               m_local_z_sublayer_plan;
+    // Indexed by layer id, empty until build_local_z_extrusions().
+    std::vector<LocalZLayerExtrusions>      m_local_z_layer_extrusions;
     // BBS
     std::shared_ptr<TreeSupportData>        m_tree_support_preview_cache;
 
@@ -600,10 +655,31 @@ private:
     std::vector < VolumeSlices >            firstLayerObjSliceByVolume;
     std::vector<groupedVolumeSlices>        firstLayerObjSliceByGroups;
 
+    // Input of the multi-material segmentation of a painted object retained by slice_volumes(): the slices of the regions
+    // before the segmentation and the raw painted segmentation. If only the mixed filament options changed, slice() restores
+    // the regions from it instead of slicing the meshes and segmenting the painting again.
+    // It holds a second copy of the region slices and of the painted segmentation, roughly doubling the slice memory of
+    // the object, so it is only retained while the print has mixed filaments and is released with the posSlice step.
+    struct MixedSegmentationInput
+    {
+        // Layer height profile the layers were generated from, the input is only valid for the same layers.
+        std::vector<coordf_t>                   layer_height_profile;
+        size_t                                  num_regions { 0 };
+        size_t                                  num_total_filaments { 0 };
+        // [layer][region]
+        std::vector<std::vector<Surfaces>>      region_slices;
+        std::vector<VolumeSlices>               first_layer_slices_by_volume;
+        std::vector<std::vector<ExPolygons>>    painted_segmentation;
+    };
+    std::unique_ptr<MixedSegmentationInput> m_mixed_segmentation_input;
+    bool                                    m_keep_mixed_segmentation_input { false };
+
     // BBS: per object skirt
     ExtrusionEntityCollection               m_skirt;
 
     PrintObject*                            m_shared_object{ nullptr };
+    PrintObjectFingerprint                  m_content_fingerprint;
+    mutable std::shared_ptr<const SeamVisibility> m_seam_visibility;
 
     
     // SoftFever
@@ -907,6 +983,19 @@ public:
     //return 0 means successful
     int                 export_cached_data(const std::string& dir_path, bool with_space=false);
     int                 load_cached_data(const std::string& directory);
+    // Directory of the persistent slice cache, empty to disable it. If set, process() loads the layers of an object to be sliced
+    // from the entry matching its PrintObject::slice_cache_key() instead of running the geometry steps, and stores an entry
+    // for each object it sliced.
+    void                set_slice_cache_dir(const std::string &dir) { m_slice_cache_dir = dir; }
+    const std::string&  slice_cache_dir() const { return m_slice_cache_dir; }
+    // Generate the G-code of the layers ahead in parallel and stitch it to the G-code generated serially, if the state of the G-code
+    // generator at the start of a layer was predicted. The G-code differs from the serially generated one by the travel moves entering
+    // the layers. See GCode::process_layers().
+    void                set_parallel_gcode_layers(bool enable) { m_parallel_gcode_layers = enable; }
+    bool                parallel_gcode_layers() const { return m_parallel_gcode_layers; }
+    // Solve the cooling slow down of a layer in a closed form over running time totals. See CoolingBuffer::set_analytic_slowdown().
+    void                set_analytic_cooling_slowdown(bool enable) { m_analytic_cooling_slowdown = enable; }
+    bool                analytic_cooling_slowdown() const { return m_analytic_cooling_slowdown; }
 
     // methods for handling state
     bool                is_step_done(PrintStep step) const { return Inherited::is_step_done(step); }
@@ -1063,6 +1152,10 @@ private:
     static StringObjectException check_multi_filament_valid(const Print &print);
 
     bool                invalidate_state_by_config_options(const ConfigOptionResolver &new_config, const std::vector<t_config_option_key> &opt_keys);
+    // PrintConfig options invalidating any PrintObject step, their values are part of PrintObject::slice_cache_key().
+    t_config_option_keys slice_cache_config_keys() const;
+    bool                load_from_slice_cache(PrintObject *object) const;
+    void                store_to_slice_cache(const PrintObject *object) const;
 
     void                _make_skirt();
     void                _make_wipe_tower();
@@ -1113,6 +1206,10 @@ private:
     //SoftFever: calibration
     Calib_Params m_calib_params;
 
+    std::string m_slice_cache_dir;
+    bool        m_parallel_gcode_layers { false };
+    bool        m_analytic_cooling_slowdown { false };
+
     // To allow GCode to set the Print's GCodeExport step status.
     friend class GCode;
     // Allow PrintObject to access m_mutex and m_cancel_callback.
@@ -1177,6 +1177,7 @@ Print::ApplyStatus Print::apply(const Model &model, DynamicPrintConfig new_full_
     new_full_config.option("mixed_filament_advanced_dithering", true);
     new_full_config.option("mixed_filament_pointillism_pixel_size", true);
     new_full_config.option("mixed_filament_pointillism_line_gap", true);
+    new_full_config.option("mixed_filament_pointillism_pattern", true);
     new_full_config.option("mixed_filament_surface_indentation", true);
     new_full_config.option("mixed_filament_definitions", true);
     m_config.option("dithering_z_step_size", true);
@@ -1189,6 +1190,7 @@ Print::ApplyStatus Print::apply(const Model &model, DynamicPrintConfig new_full_
     m_config.option("mixed_filament_advanced_dithering", true);
     m_config.option("mixed_filament_pointillism_pixel_size", true);
     m_config.option("mixed_filament_pointillism_line_gap", true);
+    m_config.option("mixed_filament_pointillism_pattern", true);
     m_config.option("mixed_filament_surface_indentation", true);
     m_config.option("mixed_filament_definitions", true);
     m_default_object_config.option("dithering_z_step_size", true);
@@ -1201,6 +1203,7 @@ Print::ApplyStatus Print::apply(const Model &model, DynamicPrintConfig new_full_
     m_default_object_config.option("mixed_filament_advanced_dithering", true);
     m_default_object_config.option("mixed_filament_pointillism_pixel_size", true);
     m_default_object_config.option("mixed_filament_pointillism_line_gap", true);
+    m_default_object_config.option("mixed_filament_pointillism_pattern", true);
     m_default_object_config.option("mixed_filament_surface_indentation", true);
     m_default_object_config.option("mixed_filament_definitions", true);
     // BBS
@@ -1377,6 +1380,9 @@ Print::ApplyStatus Print::apply(const Model &model, DynamicPrintConfig new_full_
                             << ", mixed_total=" << m_mixed_filament_mgr.mixed_filaments().size()
                             << ", mixed_enabled=" << m_mixed_filament_mgr.enabled_count()
                             << ", mixed_custom=" << mixed_custom_count;
+    // Freeze the mixed rows into a lookup plan shared by the slicing and
+    // tool ordering workers.
+    m_mixed_filament_mgr.build_resolve_plan(num_extruders);
     // Total filaments = physical extruders + enabled mixed (virtual) filaments.
     // Used for extruder ID clamping so that virtual IDs are accepted.
     size_t num_total_filaments = m_mixed_filament_mgr.total_filaments(num_extruders);
@@ -1935,8 +1941,11 @@ Print::ApplyStatus Print::apply(const Model &model, DynamicPrintConfig new_full_
 #endif /* _DEBUG */
 
 	//BBS: add timestamp logic
-	if (apply_status != APPLY_STATUS_UNCHANGED)
+	if (apply_status != APPLY_STATUS_UNCHANGED) {
 		m_modified_count++;
+		for (PrintObject *object : m_objects)
+			object->update_content_fingerprint();
+	}
 	BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << boost::format(" %1%: finished,  this %2%, m_modified_count %3%, apply_status %4%, m_support_used %5%")%__LINE__ %this %m_modified_count %apply_status %m_support_used;
 	return static_cast<ApplyStatus>(apply_status);
 }
@@ -2,6 +2,7 @@
 #define slic3r_PrintBase_hpp_
 
 #include "libslic3r.h"
+#include <array>
 #include <set>
 #include <vector>
 #include <string>
@@ -13,6 +14,7 @@
 #include "Model.hpp"
 #include "PlaceholderParser.hpp"
 #include "PrintConfig.hpp"
+#include "Profiling.hpp"
 
 namespace Slic3r {
 
@@ -576,6 +578,29 @@ private:
     friend PrintTryCancel;
 };
 
+// Name of a step reported to Profiling. Overloaded next to the step enums, steps without a name are reported by their index.
+template<typename StepType> inline const char* print_step_name(StepType) { return nullptr; }
+
+// Report a step finished to Profiling as a scope started at begin_us.
+template<typename StepType> inline void profile_step(StepType step, const char *category, int64_t begin_us, std::string_view object = {})
+{
+    if (begin_us < 0 || ! Profiling::enabled())
+        return;
+    if (const char *name = print_step_name(step))
+        Profiling::complete(name, category, begin_us, object);
+    else
+        Profiling::complete(std::string(category) + " step " + std::to_string(int(step)), category, begin_us, object);
+    Profiling::sample_memory();
+}
+
+// Start times of COUNT steps, none of them started.
+template<const size_t COUNT> inline std::array<int64_t, COUNT> unset_step_begin_us()
+{
+    std::array<int64_t, COUNT> out;
+    out.fill(-1);
+    return out;
+}
+
 template<typename PrintStepEnum, const size_t COUNT>
 class PrintBaseWithState : public PrintBase
 {
@@ -594,9 +619,15 @@ public:
             this->status_update_warnings(static_cast<int>(active_step.first), warning_level, message, nullptr, message_id);
     }
 protected:
-    bool            set_started(PrintStepEnum step) { return m_state.set_started(step, this->state_mutex(), [this](){ this->throw_if_canceled(); }); }
+    bool            set_started(PrintStepEnum step) {
+        bool started = m_state.set_started(step, this->state_mutex(), [this](){ this->throw_if_canceled(); });
+        m_step_begin_us[step] = started && Profiling::enabled() ? Profiling::now_us() : -1;
+        return started;
+    }
 	PrintStateBase::TimeStamp set_done(PrintStepEnum step) {
 		std::pair<PrintStateBase::TimeStamp, bool> status = m_state.set_done(step, this->state_mutex(), [this](){ this->throw_if_canceled(); });
+        profile_step(step, "Print", m_step_begin_us[step]);
+        m_step_begin_us[step] = -1;
         if (status.second)
             this->status_update_warnings(static_cast<int>(step), PrintStateBase::WarningLevel::NON_CRITICAL, std::string());
         return status.first;
@@ -617,6 +648,8 @@ protected:
 
 private:
     PrintState<PrintStepEnum, COUNT> m_state;
+    // Start of the active steps for Profiling, -1 if the step is not active or the profiler was disabled when it started.
+    std::array<int64_t, COUNT>       m_step_begin_us = unset_step_begin_us<COUNT>();
 };
 
 template<typename PrintType, typename PrintObjectStepEnum, const size_t COUNT>
@@ -634,10 +667,15 @@ public:
 protected:
 	PrintObjectBaseWithState(PrintType *print, ModelObject *model_object) : PrintObjectBase(model_object), m_print(print) {}
 
-    bool            set_started(PrintObjectStepEnum step)
-        { return m_state.set_started(step, PrintObjectBase::state_mutex(m_print), [this](){ this->throw_if_canceled(); }); }
+    bool            set_started(PrintObjectStepEnum step) {
+        bool started = m_state.set_started(step, PrintObjectBase::state_mutex(m_print), [this](){ this->throw_if_canceled(); });
+        m_step_begin_us[step] = started && Profiling::enabled() ? Profiling::now_us() : -1;
+        return started;
+    }
 	PrintStateBase::TimeStamp set_done(PrintObjectStepEnum step) {
 		std::pair<PrintStateBase::TimeStamp, bool> status = m_state.set_done(step, PrintObjectBase::state_mutex(m_print), [this](){ this->throw_if_canceled(); });
+        profile_step(step, "PrintObject", m_step_begin_us[step], m_model_object ? std::string_view(m_model_object->name) : std::string_view());
+        m_step_begin_us[step] = -1;
         if (status.second)
             this->status_update_warnings(m_print, static_cast<int>(step), PrintStateBase::WarningLevel::NON_CRITICAL, std::string());
         return status.first;
@@ -677,6 +715,8 @@ protected:
 
 private:
     PrintState<PrintObjectStepEnum, COUNT>   m_state;
+    // Start of the active steps for Profiling, -1 if the step is not active or the profiler was disabled when it started.
+    std::array<int64_t, COUNT>               m_step_begin_us = unset_step_begin_us<COUNT>();
 };
 
 } // namespace Slic3r
@@ -210,6 +210,13 @@ static t_config_enum_values s_keys_map_WallDirection{
 };
 CONFIG_OPTION_ENUM_DEFINE_STATIC_MAPS(WallDirection)
 
+static t_config_enum_values s_keys_map_PointillismPattern{
+    { "stripes",    int(PointillismPattern::Stripes) },
+    { "bayer",      int(PointillismPattern::Bayer) },
+    { "blue_noise", int(PointillismPattern::BlueNoise) },
+};
+CONFIG_OPTION_ENUM_DEFINE_STATIC_MAPS(PointillismPattern)
+
 //BBS
 static t_config_enum_values s_keys_map_PrintSequence {
     { "by layer",     int(PrintSequence::ByLayer) },
@@ -3187,6 +3194,16 @@ void PrintConfigDef::init_fff_params()
                    "slow down.");
     def->mode = comAdvanced;
     def->set_default_value(new ConfigOptionBool(0));
+
+    def = this->add("gcode_in_place_statistics", coBool);
+    def->label = L("Write G-code once");
+    def->tooltip = L("Reserve room for the estimated printing time, the layer count and the filament usage in the exported G-code "
+                     "and fill them in place instead of writing the whole file a second time, which is slow on network drives. "
+                     "If M73 progress output is enabled, the G-code is generated twice, first without writing it to estimate "
+                     "the printing time, and the progress is written at each layer change instead of at each percent. "
+                     "The file is still rewritten if there are preheat lines to insert.");
+    def->mode = comAdvanced;
+    def->set_default_value(new ConfigOptionBool(false));
     
     //BBS
     def = this->add("infill_combination", coBool);
@@ -4216,6 +4233,24 @@ void PrintConfigDef::init_fff_params()
     def->mode = comAdvanced;
     def->set_default_value(new ConfigOptionFloat(0.0));
 
+    def = this->add("mixed_filament_pointillism_pattern", coEnum);
+    def->label = L("Pointillisme pattern");
+    def->category = L("Others");
+    def->tooltip = L("How same-layer pointillisme splits a mixed filament region between its components. "
+                     "Stripes alternate the components in parallel bands. Ordered and blue noise scatter them over a grid of "
+                     "square cells in the proportions of the mixed filament, ordered in a regular Bayer pattern, blue noise "
+                     "without visible structure.\n\n"
+                     "Warning: Same-layer pointillisme is extremely experimental and may produce unusable results.");
+    def->enum_keys_map = &ConfigOptionEnum<PointillismPattern>::get_enum_values();
+    def->enum_values.push_back("stripes");
+    def->enum_values.push_back("bayer");
+    def->enum_values.push_back("blue_noise");
+    def->enum_labels.push_back(L("Stripes"));
+    def->enum_labels.push_back(L("Ordered"));
+    def->enum_labels.push_back(L("Blue noise"));
+    def->mode = comAdvanced;
+    def->set_default_value(new ConfigOptionEnum<PointillismPattern>(PointillismPattern::Stripes));
+
     def = this->add("mixed_filament_surface_indentation", coFloat);
     def->label = L("Selective Expansion contraction");
     def->category = L("Others");
@@ -8220,6 +8255,36 @@ CLIMiscConfigDef::CLIMiscConfigDef()
     def->cli_params = "dir";
     def->set_default_value(new ConfigOptionString());
 
+    def = this->add("slice_cache_dir", coString);
+    def->label = L("Slice cache directory");
+    def->tooltip = L("Reuse the sliced layers of objects stored in this directory by previous runs and store the newly sliced ones there. "
+                     "Changes of settings not affecting the slicing of the objects, such as filament temperatures, do not require slicing again.");
+    def->cli_params = "dir";
+    def->set_default_value(new ConfigOptionString());
+
+    def = this->add("parallel_gcode_layers", coBool);
+    def->label = L("Generate G-code layers in parallel");
+    def->tooltip = L("Generate the G-code of the layers ahead on multiple threads and join it to the G-code of the previous layer, "
+                     "if the state of the printer at the start of the layer, such as the active extruder and its retraction, was "
+                     "predicted correctly. Otherwise the layer is generated again after the previous one. The first travel move of "
+                     "a layer generated ahead does not continue from the position the previous layer ended at, thus the G-code "
+                     "differs from the one generated without this option.");
+    def->set_default_value(new ConfigOptionBool(false));
+
+    def = this->add("analytic_cooling_slowdown", coBool);
+    def->label = L("Analytic cooling slow down");
+    def->tooltip = L("Solve the slow down of the layers printed faster than their minimum layer time in a closed form over "
+                     "the layer time summed while the G-code is being generated, instead of iterating the slowed down feedrate. "
+                     "The feedrates may differ from the iterative solution in the last digit.");
+    def->set_default_value(new ConfigOptionBool(false));
+
+    def = this->add("profile_trace", coString);
+    def->label = L("Profiling trace");
+    def->tooltip = L("Write the timings of the slicing steps, of the G-code export and of the mixed filament passes together with "
+                     "memory samples into this file, in the Chrome trace event format (chrome://tracing or ui.perfetto.dev).");
+    def->cli_params = "trace.json";
+    def->set_default_value(new ConfigOptionString());
+
     def = this->add("debug", coInt);
     def->label = L("Debug level");
     def->tooltip = L("Sets debug logging level. 0:fatal, 1:error, 2:warning, 3:info, 4:debug, 5:trace\n");
@@ -880,6 +880,7 @@ bool PrintObject::invalidate_state_by_config_options(
 
     std::vector<PrintObjectStep> steps;
     bool invalidated = false;
+    bool replan_mixed_segmentation = false;
     for (const t_config_option_key &opt_key : opt_keys) {
         if (   opt_key == "brim_width"
             || opt_key == "brim_object_gap"
@@ -945,11 +946,12 @@ bool PrintObject::invalidate_state_by_config_options(
             if (this->is_mm_painted() && (opt_key == "filter_out_gap_fill" && (opt_key == "gap_infill_speed" && is_gap_fill_changed_state_due_to_speed())))
                 steps.emplace_back(posSlice);
             steps.emplace_back(posPerimeters);
+        } else if (is_mixed_segmentation_option(opt_key)) {
+            // Mixed filament controls affect layer cadence and virtual tool distribution, they are applied to the retained
+            // multi-material segmentation if the layers did not change, see slice().
+            replan_mixed_segmentation = true;
         } else if (
                opt_key == "layer_height"
-            || opt_key == "dithering_z_step_size"
-            || opt_key == "dithering_local_z_mode"
-            || opt_key == "dithering_step_painted_zones_only"
             || opt_key == "mmu_segmented_region_max_width"
             || opt_key == "mmu_segmented_region_interlocking_depth"
             || opt_key == "raft_layers"
@@ -966,18 +968,6 @@ bool PrintObject::invalidate_state_by_config_options(
             || opt_key == "interlocking_depth"
             || opt_key == "interlocking_boundary_avoidance"
             || opt_key == "interlocking_beam_width") {
-            steps.emplace_back(posSlice);
-        } else if (
-               opt_key == "mixed_filament_gradient_mode"
-            || opt_key == "mixed_filament_height_lower_bound"
-            || opt_key == "mixed_filament_height_upper_bound"
-            || opt_key == "mixed_filament_cycle_layers"
-            || opt_key == "mixed_filament_advanced_dithering"
-            || opt_key == "mixed_filament_surface_indentation"
-            || opt_key == "mixed_filament_definitions") {
-            // Mixed filament gradient controls affect layer cadence and virtual
-            // tool distribution, so force a re-slice prompt like other
-            // layer-structure settings.
             steps.emplace_back(posSlice);
 		} else if (
                opt_key == "elefant_foot_compensation"
@@ -1233,12 +1223,33 @@ bool PrintObject::invalidate_state_by_config_options(
     sort_remove_duplicates(steps);
     for (PrintObjectStep step : steps)
         invalidated |= this->invalidate_step(step);
+    // After the other steps, posSlice invalidated by them drops the retained segmentation input as well.
+    if (replan_mixed_segmentation)
+        invalidated |= this->invalidate_mixed_segmentation();
     return invalidated;
 }
 
+bool PrintObject::is_mixed_segmentation_option(const t_config_option_key &opt_key)
+{
+    return opt_key == "mixed_filament_gradient_mode"
+        || opt_key == "mixed_filament_height_lower_bound"
+        || opt_key == "mixed_filament_height_upper_bound"
+        || opt_key == "mixed_filament_cycle_layers"
+        || opt_key == "mixed_filament_advanced_dithering"
+        || opt_key == "mixed_filament_pointillism_pattern"
+        || opt_key == "mixed_filament_surface_indentation"
+        || opt_key == "mixed_filament_definitions"
+        || opt_key == "dithering_z_step_size"
+        || opt_key == "dithering_local_z_mode"
+        || opt_key == "dithering_step_painted_zones_only";
+}
+
 bool PrintObject::invalidate_step(PrintObjectStep step)
 {
 	bool invalidated = Inherited::invalidate_step(step);
+    // The Local-Z sub-passes are clipped from the final perimeters, see build_local_z_extrusions().
+    if (step != posSupportMaterial && step != posSimplifySupportPath)
+        this->clear_local_z_extrusions();
 
     // propagate to dependent steps
     if (step == posPerimeters) {
@@ -1254,6 +1265,8 @@ bool PrintObject::invalidate_step(PrintObjectStep step)
         invalidated |= m_print->invalidate_steps({ psSkirtBrim });
         m_slicing_params.valid = false;
         this->clear_local_z_plan();
+        if (! m_keep_mixed_segmentation_input)
+            m_mixed_segmentation_input.reset();
     } else if (step == posSupportMaterial) {
         invalidated |= this->invalidate_steps({ posSimplifySupportPath });
         invalidated |= m_print->invalidate_steps({ psSkirtBrim });
@@ -1276,9 +1289,18 @@ bool PrintObject::invalidate_all_steps()
 	// Then reset some of the depending values.
 	m_slicing_params.valid = false;
     this->clear_local_z_plan();
+    m_mixed_segmentation_input.reset();
 	return result;
 }
 
+bool PrintObject::invalidate_mixed_segmentation()
+{
+    m_keep_mixed_segmentation_input = true;
+    bool invalidated = this->invalidate_step(posSlice);
+    m_keep_mixed_segmentation_input = false;
+    return invalidated;
+}
+
 // This function analyzes slices of a region (SurfaceCollection slices).
 // Each region slice (instance of Surface) is analyzed, whether it is supported or whether it is the top surface.
 // Initially all slices are of type stInternal.
@@ -3288,6 +3310,162 @@ void PrintObject::update_slicing_parameters()
       }
 }
 
+namespace {
+// Accumulates two independently mixed 64 bit lanes into a PrintObjectFingerprint.
+class PrintObjectFingerprintBuilder
+{
+public:
+    void add_bits(uint64_t value) {
+        m_lo = mix(m_lo ^ value);
+        m_hi = mix(m_hi + (value ^ 0xc2b2ae3d27d4eb4fULL) * 0x9e3779b97f4a7c15ULL);
+    }
+    void add_double(double value) {
+        // Adding zero turns -0. into 0., the two compare equal.
+        value += 0.;
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        this->add_bits(bits);
+    }
+    void add_matrix(const Transform3d &trafo) {
+        for (int i = 0; i < 16; ++ i)
+            this->add_double(trafo.data()[i]);
+    }
+    void add_config(const ConfigBase &config) {
+        // DynamicConfig keeps its options sorted by key, StaticConfig lists them in the order of their definition.
+        const t_config_option_keys keys = config.keys();
+        this->add_bits(keys.size());
+        for (const t_config_option_key &key : keys) {
+            this->add_bits(std::hash<std::string>{}(key));
+            this->add_bits(config.option(key)->hash());
+        }
+    }
+    void add_facets(const FacetsAnnotation &facets) {
+        const TriangleSelector::TriangleSplittingData &data = facets.get_data();
+        this->add_bits(data.triangles_to_split.size());
+        for (const TriangleSelector::TriangleBitStreamMapping &mapping : data.triangles_to_split)
+            this->add_bits((uint64_t(uint32_t(mapping.triangle_idx)) << 32) | uint32_t(mapping.bitstream_start_idx));
+        this->add_bits(data.bitstream.size());
+        this->add_bits(std::hash<std::vector<bool>>{}(data.bitstream));
+        this->add_bits(std::hash<std::vector<bool>>{}(data.used_states));
+    }
+    void add_layer_height_profile(const LayerHeightProfile &profile) {
+        const std::vector<coordf_t> data = profile.get();
+        this->add_bits(data.size());
+        for (coordf_t value : data)
+            this->add_double(value);
+    }
+    void add_layer_config_ranges(const t_layer_config_ranges &ranges) {
+        this->add_bits(ranges.size());
+        for (const auto &[range, config] : ranges) {
+            this->add_double(range.first);
+            this->add_double(range.second);
+            this->add_config(config.get());
+        }
+    }
+    void add_mesh(const indexed_triangle_set &its) {
+        this->add_bits(its.vertices.size());
+        for (const stl_vertex &v : its.vertices) {
+            uint32_t bits[3];
+            memcpy(bits, v.data(), sizeof(bits));
+            this->add_bits((uint64_t(bits[0]) << 32) | bits[1]);
+            this->add_bits(bits[2]);
+        }
+        this->add_bits(its.indices.size());
+        for (const stl_triangle_vertex_indices &f : its.indices) {
+            this->add_bits((uint64_t(uint32_t(f(0))) << 32) | uint32_t(f(1)));
+            this->add_bits(uint32_t(f(2)));
+        }
+    }
+    PrintObjectFingerprint fingerprint() const { return { m_lo, m_hi }; }
+
+private:
+    // splitmix64 finalizer
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t m_lo { 0x243f6a8885a308d3ULL };
+    uint64_t m_hi { 0x13198a2e03707344ULL };
+};
+} // namespace
+
+// Covers everything Print::process() compares before sharing the slices of two objects, except that the volume transformations
+// are compared approximately there and thus left out of the fingerprint. The meshes are identified by their address, thus
+// the fingerprint is only valid within a session.
+void PrintObject::update_content_fingerprint()
+{
+    PrintObjectFingerprintBuilder builder;
+    builder.add_matrix(m_trafo);
+    const ModelObject &model_object = *this->model_object();
+    builder.add_bits(model_object.volumes.size());
+    for (const ModelVolume *volume : model_object.volumes) {
+        builder.add_bits(uint64_t(volume->type()));
+        builder.add_bits(uint64_t(reinterpret_cast<uintptr_t>(volume->mesh_ptr().get())));
+        builder.add_config(volume->config.get());
+        builder.add_facets(volume->supported_facets);
+        builder.add_facets(volume->seam_facets);
+        builder.add_facets(volume->mmu_segmentation_facets);
+        builder.add_facets(volume->fuzzy_skin_facets);
+    }
+    builder.add_config(model_object.config.get());
+    m_content_fingerprint = builder.fingerprint();
+}
+
+// Key of the persistent slice cache, see Print::set_slice_cache_dir(). In contrast to content_fingerprint() the meshes are hashed
+// by their content and the volume transformations exactly, and the layer height profile, the layer height ranges and the resolved
+// object and region configs are covered together with the print config options invalidating any PrintObject step. The key thus stays valid across sessions of the same build.
+PrintObjectFingerprint PrintObject::slice_cache_key() const
+{
+    PrintObjectFingerprintBuilder builder;
+    builder.add_bits(std::hash<std::string>{}(SLIC3R_VERSION));
+    builder.add_matrix(m_trafo);
+    const ModelObject &model_object = *this->model_object();
+    builder.add_bits(model_object.volumes.size());
+    for (const ModelVolume *volume : model_object.volumes) {
+        builder.add_bits(uint64_t(volume->type()));
+        builder.add_mesh(volume->mesh().its);
+        builder.add_matrix(volume->get_matrix());
+        builder.add_config(volume->config.get());
+        builder.add_facets(volume->supported_facets);
+        builder.add_facets(volume->seam_facets);
+        builder.add_facets(volume->mmu_segmentation_facets);
+        builder.add_facets(volume->fuzzy_skin_facets);
+    }
+    builder.add_config(model_object.config.get());
+    // The variable layer height and the height ranges shape the layers even if the region configs stay the same.
+    builder.add_layer_height_profile(model_object.layer_height_profile);
+    builder.add_layer_config_ranges(model_object.layer_config_ranges);
+    builder.add_config(m_config);
+    builder.add_bits(this->num_printing_regions());
+    for (size_t region_id = 0; region_id < this->num_printing_regions(); ++ region_id)
+        builder.add_bits(this->printing_region(region_id).config_hash());
+    const PrintConfig &print_config = this->print()->config();
+    for (const t_config_option_key &key : this->print()->slice_cache_config_keys()) {
+        builder.add_bits(std::hash<std::string>{}(key));
+        builder.add_bits(print_config.option(key)->hash());
+    }
+    return builder.fingerprint();
+}
+
+// Covers the input of SeamPlacer's visibility raycasting only. The meshes are hashed by their content, as a mesh released
+// by the Model may be replaced by another one allocated at the same address.
+PrintObjectFingerprint PrintObject::seam_visibility_key() const
+{
+    PrintObjectFingerprintBuilder builder;
+    builder.add_matrix(this->trafo_centered());
+    for (const ModelVolume *volume : this->model_object()->volumes)
+        if (volume->type() == ModelVolumeType::MODEL_PART || volume->type() == ModelVolumeType::NEGATIVE_VOLUME) {
+            builder.add_bits(uint64_t(volume->type()));
+            builder.add_mesh(volume->mesh().its);
+            builder.add_matrix(volume->get_matrix());
+        }
+    return builder.fingerprint();
+}
+
 // Orca: XYZ shrinkage compensation has introduced the const Vec3d &object_shrinkage_compensation parameter to the function below
 SlicingParameters PrintObject::slicing_parameters(const DynamicPrintConfig &full_config, const ModelObject &model_object, float object_max_z, const Vec3d &object_shrinkage_compensation)
 {
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <fstream>
@@ -14,8 +15,10 @@
 #include "ElephantFootCompensation.hpp"
 #include "I18N.hpp"
 #include "Layer.hpp"
+#include "LocalZPlanner.hpp"
 #include "MultiMaterialSegmentation.hpp"
 #include "Print.hpp"
+#include "Profiling.hpp"
 #include "SVG.hpp"
 //BBS
 #include "ShortestPath.hpp"
@@ -804,11 +807,16 @@ void PrintObject::slice()
     std::vector<coordf_t> layer_height_profile;
     this->update_layer_height_profile(*this->model_object(), m_slicing_params, layer_height_profile, this);
     m_print->throw_if_canceled();
+    // The retained input of the multi-material segmentation is only valid for the same layers.
+    if (m_mixed_segmentation_input && m_mixed_segmentation_input->layer_height_profile != layer_height_profile)
+        m_mixed_segmentation_input.reset();
     m_typed_slices = false;
     this->clear_layers();
     m_layers = new_layers(this, generate_object_layers(m_slicing_params, layer_height_profile, m_config.precise_z_height.value));
     this->slice_volumes();
     m_print->throw_if_canceled();
+    if (m_mixed_segmentation_input)
+        m_mixed_segmentation_input->layer_height_profile = std::move(layer_height_profile);
     int firstLayerReplacedBy = 0;
 
 #if 0
@@ -873,6 +881,7 @@ static coordf_t float_from_full_config(const DynamicPrintConfig &full_cfg, const
 
 static bool apply_mixed_surface_indentation(PrintObject &print_object, std::vector<std::vector<ExPolygons>> &segmentation)
 {
+    Profiling::Scope profiling_scope("Mixed surface indentation", "MixedFilament", print_object.model_object()->name);
     const Print *print = print_object.print();
     if (print == nullptr || segmentation.empty())
         return false;
@@ -974,184 +983,6 @@ static bool apply_mixed_surface_indentation(PrintObject &print_object, std::vect
     return true;
 }
 
-static bool fit_pass_heights_to_interval(std::vector<double> &passes, double base_height, double lo, double hi)
-{
-    if (passes.empty() || base_height <= EPSILON)
-        return false;
-
-    double sum = std::accumulate(passes.begin(), passes.end(), 0.0);
-    double delta = base_height - sum;
-
-    auto within = [lo, hi](double h) { return h >= lo - EPSILON && h <= hi + EPSILON; };
-    if (std::abs(delta) > EPSILON) {
-        if (within(passes.back() + delta)) {
-            passes.back() += delta;
-            delta = 0.0;
-        } else if (delta > 0.0) {
-            for (size_t i = passes.size(); i > 0 && delta > EPSILON; --i) {
-                double &h = passes[i - 1];
-                const double room = hi - h;
-                if (room <= EPSILON)
-                    continue;
-                const double take = std::min(room, delta);
-                h += take;
-                delta -= take;
-            }
-        } else {
-            for (size_t i = passes.size(); i > 0 && delta < -EPSILON; --i) {
-                double &h = passes[i - 1];
-                const double room = h - lo;
-                if (room <= EPSILON)
-                    continue;
-                const double take = std::min(room, -delta);
-                h -= take;
-                delta += take;
-            }
-        }
-    }
-
-    if (std::abs(delta) > 1e-6)
-        return false;
-    return std::all_of(passes.begin(), passes.end(), within);
-}
-
-static std::vector<double> build_uniform_local_z_pass_heights(double base_height, double lo, double hi)
-{
-    std::vector<double> out;
-    if (base_height <= EPSILON)
-        return out;
-
-    size_t min_passes = size_t(std::max<double>(1.0, std::ceil((base_height - EPSILON) / hi)));
-    size_t max_passes = size_t(std::max<double>(1.0, std::floor((base_height + EPSILON) / lo)));
-    size_t pass_count = min_passes;
-
-    if (max_passes >= min_passes) {
-        const double target_step = 0.5 * (lo + hi);
-        const size_t target_passes =
-            size_t(std::max<double>(1.0, std::llround(base_height / std::max<double>(target_step, EPSILON))));
-        pass_count = std::clamp(target_passes, min_passes, max_passes);
-    }
-
-    if (pass_count == 1 && base_height >= 2.0 * lo - EPSILON && max_passes >= 2)
-        pass_count = 2;
-
-    if (pass_count <= 1) {
-        out.emplace_back(base_height);
-        return out;
-    }
-
-    const double uniform_height = base_height / double(pass_count);
-    out.assign(pass_count, uniform_height);
-
-    // Keep the accumulated numeric error at the very top of the interval.
-    double accumulated = 0.0;
-    for (size_t i = 0; i + 1 < out.size(); ++i)
-        accumulated += out[i];
-    out.back() = std::max<double>(EPSILON, base_height - accumulated);
-    return out;
-}
-
-static inline void compute_local_z_gradient_component_heights(int mix_b_percent, double lower_bound, double upper_bound,
-                                                              double &h_a, double &h_b)
-{
-    const int mix_b = std::clamp(mix_b_percent, 0, 100);
-    const double pct_b = double(mix_b) / 100.0;
-    const double pct_a = 1.0 - pct_b;
-    const double lo    = std::max<double>(0.01, lower_bound);
-    const double hi    = std::max<double>(lo, upper_bound);
-    h_a = lo + pct_a * (hi - lo);
-    h_b = lo + pct_b * (hi - lo);
-}
-
-static std::vector<double> build_local_z_alternating_pass_heights(double base_height,
-                                                                   double lower_bound,
-                                                                   double upper_bound,
-                                                                   double gradient_h_a,
-                                                                   double gradient_h_b)
-{
-    if (base_height <= EPSILON)
-        return {};
-
-    const double lo = std::max<double>(0.01, lower_bound);
-    const double hi = std::max<double>(lo, upper_bound);
-    if (base_height < 2.0 * lo - EPSILON)
-        return { base_height };
-
-    const double cycle_h = std::max<double>(EPSILON, gradient_h_a + gradient_h_b);
-    const double ratio_a = std::clamp(gradient_h_a / cycle_h, 0.0, 1.0);
-    const double ratio_b = 1.0 - ratio_a;
-
-    size_t min_passes = size_t(std::max<double>(2.0, std::ceil((base_height - EPSILON) / hi)));
-    if ((min_passes % 2) != 0)
-        ++min_passes;
-
-    size_t max_passes = size_t(std::max<double>(2.0, std::floor((base_height + EPSILON) / lo)));
-    if ((max_passes % 2) != 0)
-        --max_passes;
-    if (max_passes < 2 || min_passes > max_passes)
-        return build_uniform_local_z_pass_heights(base_height, lo, hi);
-
-    for (size_t pass_count = min_passes; pass_count <= max_passes; pass_count += 2) {
-        const size_t pair_count = pass_count / 2;
-        const double pair_h     = base_height / double(pair_count);
-        const double h_a        = pair_h * ratio_a;
-        const double h_b        = pair_h * ratio_b;
-
-        std::vector<double> out;
-        out.reserve(pass_count);
-        for (size_t pair_idx = 0; pair_idx < pair_count; ++pair_idx) {
-            out.emplace_back(h_a);
-            out.emplace_back(h_b);
-        }
-        if (fit_pass_heights_to_interval(out, base_height, lo, hi))
-            return out;
-    }
-
-    return build_uniform_local_z_pass_heights(base_height, lo, hi);
-}
-
-static std::vector<double> build_local_z_pass_heights(double base_height,
-                                                      double lower_bound,
-                                                      double upper_bound,
-                                                      double preferred_a,
-                                                      double preferred_b)
-{
-    if (base_height <= EPSILON)
-        return {};
-
-    const double lo = std::max<double>(0.01, lower_bound);
-    const double hi = std::max<double>(lo, upper_bound);
-
-    std::vector<double> cadence_unit;
-    if (preferred_a > EPSILON)
-        cadence_unit.push_back(std::clamp(preferred_a, lo, hi));
-    if (preferred_b > EPSILON)
-        cadence_unit.push_back(std::clamp(preferred_b, lo, hi));
-
-    if (!cadence_unit.empty()) {
-        std::vector<double> out;
-        out.reserve(size_t(std::ceil(base_height / lo)) + 2);
-
-        double z_used = 0.0;
-        size_t idx = 0;
-        size_t guard = 0;
-        while (z_used + cadence_unit[idx] < base_height - EPSILON && guard++ < 100000) {
-            out.push_back(cadence_unit[idx]);
-            z_used += cadence_unit[idx];
-            idx = (idx + 1) % cadence_unit.size();
-        }
-
-        const double remainder = base_height - z_used;
-        if (remainder > EPSILON)
-            out.push_back(remainder);
-
-        if (fit_pass_heights_to_interval(out, base_height, lo, hi))
-            return out;
-    }
-
-    return build_uniform_local_z_pass_heights(base_height, lo, hi);
-}
-
 static std::vector<unsigned int> decode_manual_pattern_sequence(const MixedFilament &mf, size_t num_physical)
 {
     std::vector<unsigned int> sequence;
@@ -1358,16 +1189,6 @@ static std::vector<unsigned int> pointillism_sequence_for_row(const MixedFilamen
     return sequence;
 }
 
-static bool local_z_eligible_mixed_row(const MixedFilament &mf)
-{
-    // Local-Z flow-height modulation is intended for custom gradient rows.
-    // Keep auto-generated premix rows and manual pattern rows on nominal layers.
-    return mf.enabled &&
-           mf.custom &&
-           mf.manual_pattern.empty() &&
-           mf.distribution_mode != int(MixedFilament::SameLayerPointillisme);
-}
-
 static size_t unique_extruder_count(const std::vector<unsigned int> &sequence, size_t num_physical)
 {
     if (sequence.empty() || num_physical == 0)
@@ -1386,6 +1207,15 @@ static size_t unique_extruder_count(const std::vector<unsigned int> &sequence, s
     return unique_count;
 }
 
+// First extruder of the sequence in the range of the physical filaments, zero if none.
+static unsigned int first_valid_extruder(const std::vector<unsigned int> &sequence, size_t num_physical)
+{
+    for (const unsigned int extruder_id : sequence)
+        if (extruder_id >= 1 && extruder_id <= num_physical)
+            return extruder_id;
+    return 0;
+}
+
 static bool split_masks_pointillism_stripes(const ExPolygons               &source_masks,
                                             const std::vector<unsigned int> &sequence,
                                             size_t                           num_physical,
@@ -1401,19 +1231,9 @@ static bool split_masks_pointillism_stripes(const ExPolygons               &sour
     if (!bbox.defined || bbox.min.x() >= bbox.max.x() || bbox.min.y() >= bbox.max.y())
         return false;
 
-    out_by_extruder.assign(num_physical, ExPolygons());
-
     const size_t slot_count = sequence.size();
     const size_t phase      = slot_count > 0 ? (layer_id % slot_count) : 0;
 
-    auto align_down_to_grid = [stripe_pitch](coord_t value) {
-        coord_t rem = value % stripe_pitch;
-        if (rem < 0)
-            rem += stripe_pitch;
-        return value - rem;
-    };
-
-    std::vector<Polygons> stripe_polygons_by_slot(slot_count);
     const bool vertical_base = (bbox.max.x() - bbox.min.x()) >= (bbox.max.y() - bbox.min.y());
     // Alternate stripe orientation every layer so different faces of the model
     // receive mixed-color variation instead of long single-direction bands.
@@ -1422,79 +1242,11 @@ static bool split_masks_pointillism_stripes(const ExPolygons               &sour
     if (flip_orientation)
         vertical = !vertical;
 
-    if (vertical) {
-        const coord_t y0 = bbox.min.y();
-        const coord_t y1 = bbox.max.y();
-        const coord_t x_start_aligned = align_down_to_grid(bbox.min.x());
-        size_t stripe_idx = 0;
-        for (coord_t x = x_start_aligned; x < bbox.max.x(); x += stripe_pitch, ++stripe_idx) {
-            const coord_t x0 = std::max(x, bbox.min.x());
-            const coord_t x1 = std::min<coord_t>(x + stripe_pitch, bbox.max.x());
-            if (x1 <= x0)
-                continue;
-
-            const size_t slot = (stripe_idx + phase) % slot_count;
-            stripe_polygons_by_slot[slot].emplace_back(BoundingBox(Point(x0, y0), Point(x1, y1)).polygon());
-        }
-    } else {
-        const coord_t x0 = bbox.min.x();
-        const coord_t x1 = bbox.max.x();
-        const coord_t y_start_aligned = align_down_to_grid(bbox.min.y());
-        size_t stripe_idx = 0;
-        for (coord_t y = y_start_aligned; y < bbox.max.y(); y += stripe_pitch, ++stripe_idx) {
-            const coord_t y0 = std::max(y, bbox.min.y());
-            const coord_t y1 = std::min<coord_t>(y + stripe_pitch, bbox.max.y());
-            if (y1 <= y0)
-                continue;
-
-            const size_t slot = (stripe_idx + phase) % slot_count;
-            stripe_polygons_by_slot[slot].emplace_back(BoundingBox(Point(x0, y0), Point(x1, y1)).polygon());
-        }
-    }
-
-    unsigned int fallback_extruder = 0;
-    for (const unsigned int extruder_id : sequence) {
-        if (extruder_id >= 1 && extruder_id <= num_physical) {
-            fallback_extruder = extruder_id;
-            break;
-        }
-    }
+    const unsigned int fallback_extruder = first_valid_extruder(sequence, num_physical);
     if (fallback_extruder == 0)
         return false;
 
-    for (size_t slot = 0; slot < slot_count; ++slot) {
-        const unsigned int extruder_id = sequence[slot];
-        if (extruder_id == 0 || extruder_id > num_physical || stripe_polygons_by_slot[slot].empty())
-            continue;
-
-        ExPolygons clipped = intersection_ex(source_masks, stripe_polygons_by_slot[slot], ApplySafetyOffset::Yes);
-        if (!clipped.empty())
-            append(out_by_extruder[extruder_id - 1], std::move(clipped));
-    }
-
-    ExPolygons assigned_union;
-    for (ExPolygons &masks : out_by_extruder) {
-        if (masks.size() > 1)
-            masks = union_ex(masks);
-        append(assigned_union, masks);
-    }
-
-    if (assigned_union.empty()) {
-        append(out_by_extruder[fallback_extruder - 1], source_masks);
-        return true;
-    }
-
-    if (assigned_union.size() > 1)
-        assigned_union = union_ex(assigned_union);
-
-    ExPolygons remainder = diff_ex(source_masks, assigned_union, ApplySafetyOffset::Yes);
-    if (!remainder.empty()) {
-        append(out_by_extruder[fallback_extruder - 1], std::move(remainder));
-        ExPolygons &fallback_masks = out_by_extruder[fallback_extruder - 1];
-        if (fallback_masks.size() > 1)
-            fallback_masks = union_ex(fallback_masks);
-    }
-
+    out_by_extruder = split_masks_into_stripes(source_masks, sequence, phase, num_physical, fallback_extruder, stripe_pitch, vertical);
     return true;
 }
 
@@ -1510,6 +1262,7 @@ static size_t non_empty_mask_count(const std::vector<ExPolygons> &masks_by_extru
 template<typename ThrowOnCancel>
 static bool apply_pointillism_mixed_segmentation(PrintObject &print_object, std::vector<std::vector<ExPolygons>> &segmentation, ThrowOnCancel throw_on_cancel)
 {
+    Profiling::Scope profiling_scope("Pointillism segmentation", "MixedFilament", print_object.model_object()->name);
     const Print *print = print_object.print();
     if (print == nullptr || segmentation.empty())
         return false;
@@ -1589,100 +1342,146 @@ static bool apply_pointillism_mixed_segmentation(PrintObject &print_object, std:
             ++same_layer_rows;
     }
 
-    size_t transformed_layers = 0;
-    size_t transformed_states = 0;
-    size_t transformed_masks  = 0;
-    size_t skipped_states     = 0;
-    size_t retried_states     = 0;
-    size_t weak_split_states  = 0;
-    size_t pair_override_states = 0;
-    size_t global_override_states = 0;
-
-    for (size_t layer_id = 0; layer_id < segmentation.size(); ++layer_id) {
-        throw_on_cancel();
-        if (segmentation[layer_id].size() != num_channels) {
-            ++skipped_states;
-            continue;
+    // Dither tiles of the active rows, one per phase, shared by all the layers of that phase.
+    const PointillismPattern pattern = print_cfg.mixed_filament_pointillism_pattern.value;
+    std::vector<std::vector<DitherTile>> dither_tiles(mixed_rows.size());
+    if (pattern != PointillismPattern::Stripes)
+        for (size_t mixed_idx : same_layer_row_indices) {
+            const std::vector<unsigned int> &sequence = same_layer_sequences[mixed_idx];
+            dither_tiles[mixed_idx].reserve(sequence.size());
+            for (size_t phase = 0; phase < sequence.size(); ++phase)
+                dither_tiles[mixed_idx].emplace_back(build_dither_tile(sequence, phase, pattern == PointillismPattern::BlueNoise));
         }
 
-        bool layer_transformed = false;
-        std::vector<bool> touched_physical(num_physical, false);
-
-        for (size_t channel_idx = num_physical; channel_idx < num_channels; ++channel_idx) {
-            ExPolygons &state_masks = segmentation[layer_id][channel_idx];
-            if (state_masks.empty())
-                continue;
+    struct LayerStats
+    {
+        size_t transformed_layers { 0 };
+        size_t transformed_states { 0 };
+        size_t transformed_masks { 0 };
+        size_t skipped_states { 0 };
+        size_t retried_states { 0 };
+        size_t weak_split_states { 0 };
+        size_t pair_override_states { 0 };
+        size_t global_override_states { 0 };
+    };
+    std::vector<LayerStats> layer_stats(segmentation.size());
 
-            const unsigned int state_id = unsigned(channel_idx + 1);
-            const int mixed_idx = mixed_mgr.mixed_index_from_filament_id(state_id, num_physical);
-            if (mixed_idx < 0 || size_t(mixed_idx) >= mixed_rows.size()) {
-                ++skipped_states;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, segmentation.size()), [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t layer_id = range.begin(); layer_id < range.end(); ++layer_id) {
+            throw_on_cancel();
+            LayerStats &stats = layer_stats[layer_id];
+            if (segmentation[layer_id].size() != num_channels) {
+                ++stats.skipped_states;
                 continue;
             }
 
-            const MixedFilament &mf = mixed_rows[size_t(mixed_idx)];
-            const std::vector<unsigned int> *sequence_ptr = find_sequence_override(size_t(mixed_idx));
-            if (sequence_ptr == nullptr || sequence_ptr->empty() || unique_extruder_count(*sequence_ptr, num_physical) < 2) {
-                ++skipped_states;
-                continue;
-            }
-            if (!same_layer_row_active[size_t(mixed_idx)]) {
-                bool pair_match = false;
-                for (size_t idx : same_layer_row_indices) {
-                    const MixedFilament &candidate = mixed_rows[idx];
-                    if ((candidate.component_a == mf.component_a && candidate.component_b == mf.component_b) ||
-                        (candidate.component_a == mf.component_b && candidate.component_b == mf.component_a)) {
-                        pair_match = true;
-                        break;
-                    }
+            bool layer_transformed = false;
+            std::vector<bool> touched_physical(num_physical, false);
+
+            for (size_t channel_idx = num_physical; channel_idx < num_channels; ++channel_idx) {
+                ExPolygons &state_masks = segmentation[layer_id][channel_idx];
+                if (state_masks.empty())
+                    continue;
+
+                const unsigned int state_id = unsigned(channel_idx + 1);
+                const int mixed_idx = mixed_mgr.mixed_index_from_filament_id(state_id, num_physical);
+                if (mixed_idx < 0 || size_t(mixed_idx) >= mixed_rows.size()) {
+                    ++stats.skipped_states;
+                    continue;
                 }
-                if (pair_match)
-                    ++pair_override_states;
-                else if (same_layer_row_indices.size() == 1)
-                    ++global_override_states;
-            }
 
-            std::vector<ExPolygons> split_by_extruder;
-            if (!split_masks_pointillism_stripes(state_masks, *sequence_ptr, num_physical, layer_id, stripe_pitch, false, split_by_extruder)) {
-                ++skipped_states;
-                continue;
-            }
-            size_t split_unique = non_empty_mask_count(split_by_extruder);
-            if (split_unique < 2) {
-                std::vector<ExPolygons> retry_split;
-                if (split_masks_pointillism_stripes(state_masks, *sequence_ptr, num_physical, layer_id, stripe_pitch, true, retry_split)) {
-                    const size_t retry_unique = non_empty_mask_count(retry_split);
-                    if (retry_unique > split_unique) {
-                        split_by_extruder = std::move(retry_split);
-                        split_unique = retry_unique;
+                const MixedFilament &mf = mixed_rows[size_t(mixed_idx)];
+                const std::vector<unsigned int> *sequence_ptr = find_sequence_override(size_t(mixed_idx));
+                if (sequence_ptr == nullptr || sequence_ptr->empty() || unique_extruder_count(*sequence_ptr, num_physical) < 2) {
+                    ++stats.skipped_states;
+                    continue;
+                }
+                if (!same_layer_row_active[size_t(mixed_idx)]) {
+                    bool pair_match = false;
+                    for (size_t idx : same_layer_row_indices) {
+                        const MixedFilament &candidate = mixed_rows[idx];
+                        if ((candidate.component_a == mf.component_a && candidate.component_b == mf.component_b) ||
+                            (candidate.component_a == mf.component_b && candidate.component_b == mf.component_a)) {
+                            pair_match = true;
+                            break;
+                        }
                     }
-                    ++retried_states;
+                    if (pair_match)
+                        ++stats.pair_override_states;
+                    else if (same_layer_row_indices.size() == 1)
+                        ++stats.global_override_states;
                 }
-            }
-            if (split_unique < 2)
-                ++weak_split_states;
 
-            for (size_t extruder_idx = 0; extruder_idx < num_physical; ++extruder_idx) {
-                if (split_by_extruder[extruder_idx].empty())
+                std::vector<ExPolygons> split_by_extruder;
+                const std::vector<DitherTile> &tiles = dither_tiles[size_t(sequence_ptr - same_layer_sequences.data())];
+                bool split = false;
+                if (tiles.empty())
+                    split = split_masks_pointillism_stripes(state_masks, *sequence_ptr, num_physical, layer_id, stripe_pitch, false, split_by_extruder);
+                else if (unsigned int fallback_extruder = first_valid_extruder(*sequence_ptr, num_physical); fallback_extruder != 0) {
+                    split_by_extruder = split_masks_into_dither_cells(state_masks, tiles[layer_id % tiles.size()], num_physical, fallback_extruder, stripe_pitch);
+                    split = true;
+                }
+                if (!split) {
+                    ++stats.skipped_states;
                     continue;
-                append(segmentation[layer_id][extruder_idx], std::move(split_by_extruder[extruder_idx]));
-                touched_physical[extruder_idx] = true;
-            }
+                }
+                size_t split_unique = non_empty_mask_count(split_by_extruder);
+                if (split_unique < 2) {
+                    // Masks thinner than a stripe or a cell, try the stripes across.
+                    std::vector<ExPolygons> retry_split;
+                    if (split_masks_pointillism_stripes(state_masks, *sequence_ptr, num_physical, layer_id, stripe_pitch, tiles.empty(), retry_split)) {
+                        const size_t retry_unique = non_empty_mask_count(retry_split);
+                        if (retry_unique > split_unique) {
+                            split_by_extruder = std::move(retry_split);
+                            split_unique = retry_unique;
+                        }
+                        ++stats.retried_states;
+                    }
+                }
+                if (split_unique < 2)
+                    ++stats.weak_split_states;
 
-            transformed_masks += state_masks.size();
-            state_masks.clear();
-            layer_transformed = true;
-            ++transformed_states;
-        }
+                for (size_t extruder_idx = 0; extruder_idx < num_physical; ++extruder_idx) {
+                    if (split_by_extruder[extruder_idx].empty())
+                        continue;
+                    append(segmentation[layer_id][extruder_idx], std::move(split_by_extruder[extruder_idx]));
+                    touched_physical[extruder_idx] = true;
+                }
 
-        if (layer_transformed) {
-            ++transformed_layers;
-            for (size_t extruder_idx = 0; extruder_idx < num_physical; ++extruder_idx) {
-                if (!touched_physical[extruder_idx] || segmentation[layer_id][extruder_idx].size() <= 1)
-                    continue;
-                segmentation[layer_id][extruder_idx] = union_ex(segmentation[layer_id][extruder_idx]);
+                stats.transformed_masks += state_masks.size();
+                state_masks.clear();
+                layer_transformed = true;
+                ++stats.transformed_states;
+            }
+
+            if (layer_transformed) {
+                ++stats.transformed_layers;
+                for (size_t extruder_idx = 0; extruder_idx < num_physical; ++extruder_idx) {
+                    if (!touched_physical[extruder_idx] || segmentation[layer_id][extruder_idx].size() <= 1)
+                        continue;
+                    segmentation[layer_id][extruder_idx] = union_ex(segmentation[layer_id][extruder_idx]);
+                }
             }
         }
+    });
+
+    size_t transformed_layers = 0;
+    size_t transformed_states = 0;
+    size_t transformed_masks  = 0;
+    size_t skipped_states     = 0;
+    size_t retried_states     = 0;
+    size_t weak_split_states  = 0;
+    size_t pair_override_states = 0;
+    size_t global_override_states = 0;
+    for (const LayerStats &stats : layer_stats) {
+        transformed_layers     += stats.transformed_layers;
+        transformed_states     += stats.transformed_states;
+        transformed_masks      += stats.transformed_masks;
+        skipped_states         += stats.skipped_states;
+        retried_states         += stats.retried_states;
+        weak_split_states      += stats.weak_split_states;
+        pair_override_states   += stats.pair_override_states;
+        global_override_states += stats.global_override_states;
     }
 
     if (transformed_states > 0) {
@@ -1697,6 +1496,7 @@ static bool apply_pointillism_mixed_segmentation(PrintObject &print_object, std:
                                    << " pair_override_states=" << pair_override_states
                                    << " global_override_states=" << global_override_states
                                    << " stripe_pitch_mm=" << stripe_pitch_mm
+                                   << " pattern=" << int(pattern)
                                    << " skipped_states=" << skipped_states;
         return true;
     }
@@ -1810,6 +1610,7 @@ static void export_local_z_plan_debug(const PrintObject &print_object, coordf_t
 template<typename ThrowOnCancel>
 static void build_local_z_plan(PrintObject &print_object, const std::vector<std::vector<ExPolygons>> &segmentation, ThrowOnCancel throw_on_cancel)
 {
+    Profiling::Scope profiling_scope("Local-Z plan", "MixedFilament", print_object.model_object()->name);
     print_object.clear_local_z_plan();
 
     const Print *print = print_object.print();
@@ -1877,353 +1678,298 @@ static void build_local_z_plan(PrintObject &print_object, const std::vector<std:
                              << " preferred_b=" << preferred_b
                              << " physical_filaments=" << num_physical;
 
-    std::vector<LocalZInterval> intervals;
-    std::vector<SubLayerPlan>   plans;
-    intervals.reserve(print_object.layer_count());
-    size_t mixed_intervals              = 0;
-    size_t split_intervals              = 0;
-    size_t non_split_mixed_intervals    = 0;
-    size_t total_generated_sublayer_cnt = 0;
-    size_t total_mixed_state_layers     = 0;
-    size_t forced_height_resolve_calls  = 0;
-    size_t forced_height_resolve_invalid_target   = 0;
-    size_t split_passes_total                     = 0;
-    size_t split_passes_with_painted_masks        = 0;
-    size_t split_intervals_without_painted_masks  = 0;
-    size_t strict_ab_assignments                  = 0;
-    size_t alternating_height_intervals           = 0;
-    // Preserve per-row local-Z phase across layers so pass orientation does not
-    // flip when a different mixed row dominates layer pass heights.
-    std::vector<uint8_t> row_next_component_a(mixed_rows.size(), uint8_t(1));
-    std::vector<uint8_t> row_phase_initialized(mixed_rows.size(), uint8_t(0));
-
-    int cadence_index = 0;
-    for (size_t layer_id = 0; layer_id < print_object.layer_count(); ++layer_id) {
-        throw_on_cancel();
-
+    std::vector<LocalZPlanLayer> layers(print_object.layer_count());
+    for (size_t layer_id = 0; layer_id < layers.size(); ++layer_id) {
         const Layer &layer = *print_object.get_layer(int(layer_id));
-        LocalZInterval interval;
-        interval.layer_id           = layer_id;
-        interval.z_lo               = layer.print_z - layer.height;
-        interval.z_hi               = layer.print_z;
-        interval.base_height        = layer.height;
-        interval.sublayer_height    = layer.height;
-        interval.first_sublayer_idx = plans.size();
-
-        ExPolygons mixed_masks;
-        size_t     mixed_state_count = 0;
-        size_t     dominant_mixed_idx = size_t(-1);
-        double     dominant_mixed_area = -1.0;
-        double     dominant_gradient_h_a = 0.0;
-        double     dominant_gradient_h_b = 0.0;
-        bool       dominant_gradient_valid = false;
-        for (size_t channel_idx = 0; channel_idx < segmentation[layer_id].size(); ++channel_idx) {
-            const ExPolygons &state_masks = segmentation[layer_id][channel_idx];
-            if (state_masks.empty())
-                continue;
-            const unsigned int state_id = unsigned(channel_idx + 1);
-            if (!mixed_mgr.is_mixed(state_id, num_physical))
-                continue;
+        layers[layer_id].print_z = layer.print_z;
+        layers[layer_id].height  = layer.height;
+        layers[layer_id].slices  = collect_layer_region_slices(layer);
+    }
+    LocalZPlanParams params;
+    params.lower_bound = mixed_lower;
+    params.upper_bound = mixed_upper;
+    params.preferred_a = preferred_a;
+    params.preferred_b = preferred_b;
+    LocalZPlan             plan  = build_local_z_plan(layers, segmentation, mixed_mgr, num_physical, params, throw_on_cancel);
+    const LocalZPlanStats &stats = plan.stats;
+    std::vector<LocalZInterval> &intervals = plan.intervals;
+    std::vector<SubLayerPlan>   &plans     = plan.plans;
 
-            const int mixed_idx = mixed_mgr.mixed_index_from_filament_id(state_id, num_physical);
-            if (mixed_idx < 0 || size_t(mixed_idx) >= mixed_rows.size())
-                continue;
-            const MixedFilament &mf = mixed_rows[size_t(mixed_idx)];
-            if (!local_z_eligible_mixed_row(mf))
-                continue;
+    if (!intervals.empty() && !plans.empty()) {
+        print_object.set_local_z_plan(std::move(intervals), std::move(plans));
+        export_local_z_plan_debug(print_object, mixed_lower, mixed_upper);
+        BOOST_LOG_TRIVIAL(warning) << "Local-Z plan built"
+                                   << " object=" << object_name
+                                   << " mixed_intervals=" << stats.mixed_intervals
+                                   << " split_intervals=" << stats.split_intervals
+                                   << " non_split_mixed_intervals=" << stats.non_split_mixed_intervals
+                                   << " split_intervals_without_painted_masks=" << stats.split_intervals_without_painted_masks
+                                   << " sublayer_passes=" << stats.sublayers
+                                   << " split_passes_total=" << stats.split_passes
+                                   << " split_passes_with_painted_masks=" << stats.split_passes_with_painted_masks
+                                   << " alternating_height_intervals=" << stats.alternating_height_intervals
+                                   << " strict_ab_assignments=" << stats.strict_ab_assignments
+                                   << " mixed_state_layers=" << stats.mixed_state_layers
+                                   << " forced_height_resolve_calls=" << stats.forced_height_resolve_calls
+                                   << " forced_height_resolve_invalid_target=" << stats.forced_height_resolve_invalid_target
+                                   << " mixed_lower=" << mixed_lower
+                                   << " mixed_upper=" << mixed_upper
+                                   << " preferred_a=" << preferred_a
+                                   << " preferred_b=" << preferred_b;
+    } else {
+        BOOST_LOG_TRIVIAL(warning) << "Local-Z plan empty after build"
+                                   << " object=" << object_name
+                                   << " intervals=" << intervals.size()
+                                   << " plans=" << plans.size()
+                                   << " mixed_intervals=" << stats.mixed_intervals;
+    }
+}
 
-            interval.has_mixed_paint = true;
-            ++mixed_state_count;
-            append(mixed_masks, state_masks);
+// Local-Z perimeter sub-passes: the perimeters of the layers split by the Local-Z plan are clipped into the painted masks
+// of the sub-passes and into the remaining base part once, after the extrusions are final, so that the G-code export
+// only groups the prebuilt collections.
 
-            const double mixed_area = std::abs(area(state_masks));
-            if (mixed_area > dominant_mixed_area) {
-                dominant_mixed_area = mixed_area;
-                dominant_mixed_idx  = size_t(mixed_idx);
-            }
-        }
-        if (dominant_mixed_idx < mixed_rows.size()) {
-            compute_local_z_gradient_component_heights(mixed_rows[dominant_mixed_idx].mix_b_percent, mixed_lower, mixed_upper,
-                                                       dominant_gradient_h_a, dominant_gradient_h_b);
-            dominant_gradient_valid = true;
-        }
-        total_mixed_state_layers += mixed_state_count;
-        if (!mixed_masks.empty())
-            mixed_masks = union_ex(mixed_masks);
-        if (interval.has_mixed_paint)
-            ++mixed_intervals;
-
-        const ExPolygons layer_masks = collect_layer_region_slices(layer);
-        ExPolygons       base_masks  = layer_masks;
-        if (interval.has_mixed_paint && !base_masks.empty() && !mixed_masks.empty()) {
-            base_masks = diff_ex(base_masks, mixed_masks);
-            if (!base_masks.empty()) {
-                const Polygons filtered = opening(to_polygons(base_masks), scaled<float>(5. * EPSILON), scaled<float>(5. * EPSILON));
-                base_masks = union_ex(filtered);
-            }
-        }
+// Compensate perimeter clipping at mixed-mask boundaries to avoid cracks from exact centerline clipping.
+static constexpr double LOCAL_Z_PERIMETER_MASK_EXPAND_MM = 0.10;
+// Keep base exclusion smaller than mixed-pass inclusion to guarantee a slight overlap
+// instead of a moat at the boundary.
+static constexpr double LOCAL_Z_BASE_MASK_EXPAND_MM      = 0.04;
 
-        std::vector<double> pass_heights;
-        if (interval.has_mixed_paint) {
-            // Local-Z mode should emit an A/B/A/B pattern for mixed regions and
-            // derive relative heights from mixed-filament gradient bounds.
-            if (preferred_a <= EPSILON && preferred_b <= EPSILON) {
-                if (dominant_gradient_valid) {
-                    pass_heights = build_local_z_alternating_pass_heights(interval.base_height, mixed_lower, mixed_upper,
-                                                                          dominant_gradient_h_a, dominant_gradient_h_b);
-                    if (pass_heights.size() > 1)
-                        ++alternating_height_intervals;
-                } else {
-                    pass_heights = build_local_z_pass_heights(interval.base_height, mixed_lower, mixed_upper, preferred_a, preferred_b);
-                }
-            } else {
-                pass_heights = build_local_z_pass_heights(interval.base_height, mixed_lower, mixed_upper, preferred_a, preferred_b);
-            }
-        }
-        else
-            pass_heights.emplace_back(interval.base_height);
-
-        // Keep auto local-Z 2-pass cadence order stable across layers even if the
-        // dominant mixed row changes. Per-row phase assignment still controls
-        // which filament gets pass-0 vs pass-1.
-        if (interval.has_mixed_paint &&
-            preferred_a <= EPSILON &&
-            preferred_b <= EPSILON &&
-            pass_heights.size() == 2 &&
-            pass_heights[0] > pass_heights[1]) {
-            std::swap(pass_heights[0], pass_heights[1]);
-        }
+// Calls path_fn for every ExtrusionPath of an extrusion entity, descending into collections, multi-paths and loops.
+template<typename PathFn>
+static void for_each_local_z_path(const ExtrusionEntity &entity, PathFn &&path_fn)
+{
+    if (const auto *collection = dynamic_cast<const ExtrusionEntityCollection*>(&entity)) {
+        for (const ExtrusionEntity *child : collection->entities)
+            for_each_local_z_path(*child, path_fn);
+    } else if (const auto *path = dynamic_cast<const ExtrusionPath*>(&entity)) {
+        path_fn(*path);
+    } else if (const auto *multipath = dynamic_cast<const ExtrusionMultiPath*>(&entity)) {
+        for (const ExtrusionPath &p : multipath->paths)
+            path_fn(p);
+    } else if (const auto *loop = dynamic_cast<const ExtrusionLoop*>(&entity)) {
+        for (const ExtrusionPath &p : loop->paths)
+            path_fn(p);
+    }
+}
 
-        const bool split_interval = interval.has_mixed_paint && pass_heights.size() > 1;
-        if (split_interval) {
-            // Derive per-row start phase against the selected layer pass heights so
-            // complementary mixed rows can coexist on the same nominal layer.
-            std::vector<uint8_t> start_with_component_a = row_next_component_a;
-            std::vector<uint8_t> row_seen_in_interval(mixed_rows.size(), uint8_t(0));
-            if (preferred_a <= EPSILON && preferred_b <= EPSILON) {
-                for (size_t channel_idx = 0; channel_idx < segmentation[layer_id].size(); ++channel_idx) {
-                    const ExPolygons &state_masks = segmentation[layer_id][channel_idx];
-                    if (state_masks.empty())
-                        continue;
+static inline void apply_local_z_flow_height_override(ExtrusionPath &path, const double flow_height_override)
+{
+    if (flow_height_override <= EPSILON)
+        return;
+    if (path.height > EPSILON) {
+        const double ratio = flow_height_override / path.height;
+        path.mm3_per_mm *= ratio;
+    }
+    path.height = float(flow_height_override);
+}
 
-                    const unsigned int state_id = unsigned(channel_idx + 1);
-                    if (!mixed_mgr.is_mixed(state_id, num_physical))
-                        continue;
-                    const int mixed_idx = mixed_mgr.mixed_index_from_filament_id(state_id, num_physical);
-                    if (mixed_idx < 0 || size_t(mixed_idx) >= mixed_rows.size())
-                        continue;
-                    const MixedFilament &mf = mixed_rows[size_t(mixed_idx)];
-                    if (!local_z_eligible_mixed_row(mf))
-                        continue;
-                    row_seen_in_interval[size_t(mixed_idx)] = uint8_t(1);
-                    if (row_phase_initialized[size_t(mixed_idx)] != 0)
-                        continue;
+static inline void append_clipped_path(const ExtrusionPath        &src_path,
+                                       const ExPolygons           *include_masks,
+                                       const ExPolygons           *exclude_masks,
+                                       const double                flow_height_override,
+                                       ExtrusionEntityCollection  &dst)
+{
+    Polylines segments{src_path.polyline};
+    if (include_masks != nullptr && !include_masks->empty())
+        segments = intersection_pl(std::move(segments), *include_masks);
+    if (exclude_masks != nullptr && !exclude_masks->empty())
+        segments = diff_pl(std::move(segments), *exclude_masks);
+
+    for (Polyline &segment : segments) {
+        if (!segment.is_valid())
+            continue;
+        ExtrusionPath clipped(segment, src_path);
+        apply_local_z_flow_height_override(clipped, flow_height_override);
+        dst.append(std::move(clipped));
+    }
+}
 
-                    double row_h_a = 0.0;
-                    double row_h_b = 0.0;
-                    compute_local_z_gradient_component_heights(mf.mix_b_percent, mixed_lower, mixed_upper, row_h_a, row_h_b);
-
-                    double err_ab = 0.0;
-                    double err_ba = 0.0;
-                    for (size_t pass_i = 0; pass_i < pass_heights.size(); ++pass_i) {
-                        const double expected_ab = (pass_i % 2) == 0 ? row_h_a : row_h_b;
-                        const double expected_ba = (pass_i % 2) == 0 ? row_h_b : row_h_a;
-                        err_ab += std::abs(pass_heights[pass_i] - expected_ab);
-                        err_ba += std::abs(pass_heights[pass_i] - expected_ba);
-                    }
-                    if (err_ba + 1e-6 < err_ab)
-                        start_with_component_a[size_t(mixed_idx)] = uint8_t(0);
-                }
-            }
+static std::unique_ptr<ExtrusionEntityCollection> clip_extrusion_collection_for_local_z(const ExtrusionEntityCollection &source,
+                                                                                        const ExPolygons               *include_masks,
+                                                                                        const ExPolygons               *exclude_masks,
+                                                                                        const double                    flow_height_override)
+{
+    if (source.entities.empty())
+        return nullptr;
 
-            ++split_intervals;
-            double z_cursor = interval.z_lo;
-            size_t pass_idx = 0;
-            bool   interval_has_split_painted_masks = false;
-            interval.sublayer_height = *std::min_element(pass_heights.begin(), pass_heights.end());
-            for (const double pass_height_nominal : pass_heights) {
-                if (z_cursor >= interval.z_hi - EPSILON)
-                    break;
-                const double pass_height = std::min<double>(pass_height_nominal, interval.z_hi - z_cursor);
-                const double z_next      = std::min<double>(interval.z_hi, z_cursor + pass_height);
-
-                SubLayerPlan plan;
-                plan.layer_id       = layer_id;
-                plan.pass_index     = pass_idx;
-                plan.split_interval = true;
-                plan.z_lo           = z_cursor;
-                plan.z_hi           = z_next;
-                plan.print_z        = z_next;
-                plan.flow_height    = pass_height;
-                plan.painted_masks_by_extruder.assign(num_physical, ExPolygons());
-                ++split_passes_total;
-                bool pass_has_painted_masks = false;
-
-                for (size_t channel_idx = 0; channel_idx < segmentation[layer_id].size(); ++channel_idx) {
-                    const ExPolygons &state_masks = segmentation[layer_id][channel_idx];
-                    if (state_masks.empty())
-                        continue;
+    if ((include_masks == nullptr || include_masks->empty()) &&
+        (exclude_masks == nullptr || exclude_masks->empty()) &&
+        flow_height_override <= EPSILON)
+        return std::make_unique<ExtrusionEntityCollection>(source);
+
+    auto out = std::make_unique<ExtrusionEntityCollection>();
+    out->no_sort = source.no_sort;
+    for_each_local_z_path(source, [&](const ExtrusionPath &path) {
+        append_clipped_path(path, include_masks, exclude_masks, flow_height_override, *out);
+    });
+    if (out->entities.empty())
+        return nullptr;
+    return out;
+}
 
-                    const unsigned int state_id = unsigned(channel_idx + 1);
-                    if (!mixed_mgr.is_mixed(state_id, num_physical))
-                        continue;
-                    const int mixed_idx = mixed_mgr.mixed_index_from_filament_id(state_id, num_physical);
-                    if (mixed_idx < 0 || size_t(mixed_idx) >= mixed_rows.size())
-                        continue;
-                    const MixedFilament &mf = mixed_rows[size_t(mixed_idx)];
-                    if (!local_z_eligible_mixed_row(mf))
-                        continue;
-                    row_seen_in_interval[size_t(mixed_idx)] = uint8_t(1);
-                    ++forced_height_resolve_calls;
-                    unsigned int target_extruder = 0;
-                    if (mf.component_a > 0 && mf.component_a <= num_physical &&
-                        mf.component_b > 0 && mf.component_b <= num_physical) {
-                        const bool start_a = start_with_component_a[size_t(mixed_idx)] != 0;
-                        const bool even_pass = (pass_idx % 2) == 0;
-                        // Enforce strict per-pass alternation inside split local-Z intervals.
-                        target_extruder = even_pass
-                            ? (start_a ? mf.component_a : mf.component_b)
-                            : (start_a ? mf.component_b : mf.component_a);
-                        ++strict_ab_assignments;
-                    }
-                    if (target_extruder == 0) {
-                        target_extruder = mixed_mgr.resolve(state_id, num_physical, cadence_index, float(plan.print_z), float(plan.flow_height), true);
-                    }
-                    if (target_extruder == 0 || target_extruder > num_physical) {
-                        ++forced_height_resolve_invalid_target;
-                        continue;
-                    }
-                    append(plan.painted_masks_by_extruder[target_extruder - 1], state_masks);
-                    pass_has_painted_masks = true;
-                }
-                for (ExPolygons &masks : plan.painted_masks_by_extruder)
-                    if (masks.size() > 1)
-                        masks = union_ex(masks);
-                if (pass_has_painted_masks) {
-                    ++split_passes_with_painted_masks;
-                    interval_has_split_painted_masks = true;
-                }
+static inline ExPolygons local_z_compensate_masks(const ExPolygons &src_masks, const float delta_scaled, const bool fallback_to_source)
+{
+    if (src_masks.empty() || std::abs(delta_scaled) <= EPSILON)
+        return src_masks;
 
-                if (z_next >= interval.z_hi - EPSILON)
-                    plan.base_masks = base_masks;
+    ExPolygons compensated = offset_ex(src_masks, delta_scaled);
+    if (!compensated.empty() && compensated.size() > 1)
+        compensated = union_ex(compensated);
 
-                plans.emplace_back(std::move(plan));
-                ++interval.sublayer_count;
-                ++total_generated_sublayer_cnt;
-                ++pass_idx;
-                ++cadence_index;
-                z_cursor = z_next;
-            }
+    if (compensated.empty() && fallback_to_source)
+        return src_masks;
+    return compensated;
+}
+
+// Builds the sub-passes of a single layer from its plans [first_idx, end_idx) and clips the perimeters of its regions.
+// Leaves out empty if no sub-pass has any painted mask. Rejected layers are logged until rejected_context_logs reaches 50.
+static void build_local_z_layer_extrusions(const Layer                     &layer,
+                                           const std::vector<SubLayerPlan> &plans,
+                                           const size_t                     first_idx,
+                                           const size_t                     end_idx,
+                                           std::atomic<size_t>             &rejected_context_logs,
+                                           LocalZLayerExtrusions           &out)
+{
+    const float perimeter_mask_expand = float(scale_(LOCAL_Z_PERIMETER_MASK_EXPAND_MM));
+    const float base_mask_expand      = float(scale_(LOCAL_Z_BASE_MASK_EXPAND_MM));
+
+    ExPolygons raw_mixed_masks_union;
+    for (size_t plan_idx = first_idx; plan_idx < end_idx; ++plan_idx) {
+        const SubLayerPlan &plan = plans[plan_idx];
+        if (!plan.split_interval)
+            continue;
+        LocalZLayerExtrusions::Pass pass;
+        pass.plan = &plan;
+        pass.compensated_masks_by_extruder.assign(plan.painted_masks_by_extruder.size(), ExPolygons());
+        bool pass_has_compensated_masks = false;
+        for (size_t extruder_id = 0; extruder_id < plan.painted_masks_by_extruder.size(); ++extruder_id) {
+            const ExPolygons &raw_masks = plan.painted_masks_by_extruder[extruder_id];
+            if (raw_masks.empty())
+                continue;
+            append(raw_mixed_masks_union, raw_masks);
+            ExPolygons compensated = local_z_compensate_masks(raw_masks, perimeter_mask_expand, true);
+            pass_has_compensated_masks |= !compensated.empty();
+            pass.compensated_masks_by_extruder[extruder_id] = std::move(compensated);
+        }
+        if (pass_has_compensated_masks) {
+            for (const ExPolygons &masks : pass.compensated_masks_by_extruder)
+                append(out.mixed_masks_union, masks);
+            out.passes.emplace_back(std::move(pass));
+        }
+    }
+    if (raw_mixed_masks_union.size() > 1)
+        raw_mixed_masks_union = union_ex(raw_mixed_masks_union);
+    out.raw_mixed_masks_union = raw_mixed_masks_union;
+    if (out.mixed_masks_union.size() > 1) {
+        ExPolygons merged_masks = union_ex(out.mixed_masks_union);
+        if (!merged_masks.empty())
+            out.mixed_masks_union = std::move(merged_masks);
+        else if (!raw_mixed_masks_union.empty())
+            out.mixed_masks_union = raw_mixed_masks_union;
+    }
+    if (out.mixed_masks_union.empty() && !raw_mixed_masks_union.empty())
+        out.mixed_masks_union = raw_mixed_masks_union;
+    if (out.passes.empty() || out.mixed_masks_union.empty()) {
+        if (rejected_context_logs.fetch_add(1, std::memory_order_relaxed) < 50)
+            BOOST_LOG_TRIVIAL(warning) << "Local-Z context rejected"
+                                       << " print_z=" << layer.print_z
+                                       << " layer_id=" << layer.id()
+                                       << " first_idx=" << first_idx
+                                       << " end_idx=" << end_idx
+                                       << " pass_count=" << out.passes.size()
+                                       << " raw_mask_count=" << raw_mixed_masks_union.size();
+        out = LocalZLayerExtrusions();
+        return;
+    }
+    const ExPolygons &base_exclude_source = !out.raw_mixed_masks_union.empty() ? out.raw_mixed_masks_union : out.mixed_masks_union;
+    out.mixed_masks_union_for_base_exclude = local_z_compensate_masks(base_exclude_source, base_mask_expand, true);
 
-            if (pass_idx > 0) {
-                const bool toggle_after_interval = (pass_idx % 2) != 0;
-                for (size_t mixed_idx = 0; mixed_idx < mixed_rows.size(); ++mixed_idx) {
-                    if (row_seen_in_interval[mixed_idx] == 0)
+    const ExPolygons &base_exclude_masks = out.mixed_masks_union_for_base_exclude.empty() ? out.mixed_masks_union : out.mixed_masks_union_for_base_exclude;
+    size_t            base_clip_leak_warnings = 0;
+    out.perimeters.clear();
+    out.perimeters.resize(layer.regions().size());
+    for (size_t region_id = 0; region_id < layer.regions().size(); ++region_id) {
+        const LayerRegion *layerm = layer.regions()[region_id];
+        if (layerm == nullptr)
+            continue;
+        std::vector<LocalZLayerExtrusions::ClippedPerimeters> &clipped_region = out.perimeters[region_id];
+        clipped_region.resize(layerm->perimeters.entities.size());
+        for (size_t entity_idx = 0; entity_idx < layerm->perimeters.entities.size(); ++entity_idx) {
+            assert(dynamic_cast<const ExtrusionEntityCollection*>(layerm->perimeters.entities[entity_idx]) != nullptr);
+            const auto *extrusions = static_cast<const ExtrusionEntityCollection*>(layerm->perimeters.entities[entity_idx]);
+            if (extrusions->entities.empty())
+                continue;
+            LocalZLayerExtrusions::ClippedPerimeters &clipped = clipped_region[entity_idx];
+            clipped.by_pass.resize(out.passes.size());
+            for (size_t pass_idx = 0; pass_idx < out.passes.size(); ++pass_idx) {
+                const LocalZLayerExtrusions::Pass &pass = out.passes[pass_idx];
+                clipped.by_pass[pass_idx].resize(pass.compensated_masks_by_extruder.size());
+                for (size_t extruder_id = 0; extruder_id < pass.compensated_masks_by_extruder.size(); ++extruder_id) {
+                    const ExPolygons &pass_masks = pass.compensated_masks_by_extruder[extruder_id];
+                    if (pass_masks.empty())
                         continue;
-                    const bool start_a = start_with_component_a[mixed_idx] != 0;
-                    const bool next_a  = toggle_after_interval ? !start_a : start_a;
-                    row_next_component_a[mixed_idx] = next_a ? uint8_t(1) : uint8_t(0);
-                    row_phase_initialized[mixed_idx] = uint8_t(1);
+                    clipped.by_pass[pass_idx][extruder_id] = clip_extrusion_collection_for_local_z(*extrusions, &pass_masks, nullptr, pass.plan->flow_height);
                 }
             }
-            if (!interval_has_split_painted_masks)
-                ++split_intervals_without_painted_masks;
-        } else {
-            if (interval.has_mixed_paint)
-                ++non_split_mixed_intervals;
-            SubLayerPlan plan;
-            plan.layer_id       = layer_id;
-            plan.pass_index     = 0;
-            plan.split_interval = false;
-            plan.z_lo           = interval.z_lo;
-            plan.z_hi           = interval.z_hi;
-            plan.print_z        = interval.z_hi;
-            plan.flow_height    = interval.base_height;
-            plan.base_masks     = base_masks;
-            plan.painted_masks_by_extruder.assign(num_physical, ExPolygons());
-
-            for (size_t channel_idx = 0; channel_idx < segmentation[layer_id].size(); ++channel_idx) {
-                const ExPolygons &state_masks = segmentation[layer_id][channel_idx];
-                if (state_masks.empty())
-                    continue;
-
-                const unsigned int state_id = unsigned(channel_idx + 1);
-                if (!mixed_mgr.is_mixed(state_id, num_physical))
-                    continue;
-                const MixedFilament *mixed_row = mixed_mgr.mixed_filament_from_id(state_id, num_physical);
-                if (mixed_row == nullptr || !local_z_eligible_mixed_row(*mixed_row))
-                    continue;
-                ++forced_height_resolve_calls;
-                const unsigned int target_extruder =
-                    mixed_mgr.resolve(state_id, num_physical, cadence_index, float(plan.print_z), float(plan.flow_height), true);
-                if (target_extruder == 0 || target_extruder > num_physical) {
-                    ++forced_height_resolve_invalid_target;
-                    continue;
+            clipped.base = clip_extrusion_collection_for_local_z(*extrusions, nullptr, &base_exclude_masks, 0.);
+            if (clipped.base && base_clip_leak_warnings < 3) {
+                const ExPolygons &mixed_leak_ref = !out.raw_mixed_masks_union.empty() ? out.raw_mixed_masks_union : out.mixed_masks_union;
+                Polylines         clipped_base_lines;
+                for_each_local_z_path(*clipped.base, [&clipped_base_lines](const ExtrusionPath &path) { clipped_base_lines.emplace_back(path.polyline); });
+                Polylines leaked_segments = intersection_pl(std::move(clipped_base_lines), mixed_leak_ref);
+                if (!leaked_segments.empty()) {
+                    ++base_clip_leak_warnings;
+                    BOOST_LOG_TRIVIAL(warning) << "Local-Z base clip leak"
+                                               << " print_z=" << layer.print_z
+                                               << " layer_id=" << layer.id()
+                                               << " leaked_segment_count=" << leaked_segments.size()
+                                               << " warn_index=" << base_clip_leak_warnings;
                 }
-                append(plan.painted_masks_by_extruder[target_extruder - 1], state_masks);
             }
-            for (ExPolygons &masks : plan.painted_masks_by_extruder)
-                if (masks.size() > 1)
-                    masks = union_ex(masks);
-
-            plans.emplace_back(std::move(plan));
-            interval.sublayer_count = 1;
-            ++total_generated_sublayer_cnt;
-            ++cadence_index;
         }
-
-        if (interval.has_mixed_paint) {
-            BOOST_LOG_TRIVIAL(debug) << "Local-Z interval"
-                                     << " object=" << object_name
-                                     << " layer_id=" << layer_id
-                                     << " base_height=" << interval.base_height
-                                     << " split=" << split_interval
-                                     << " mixed_states=" << mixed_state_count
-                                     << " pass_count=" << pass_heights.size()
-                                     << " pass_min_height="
-                                     << (pass_heights.empty() ? 0.0 : *std::min_element(pass_heights.begin(), pass_heights.end()))
-                                     << " pass_max_height="
-                                     << (pass_heights.empty() ? 0.0 : *std::max_element(pass_heights.begin(), pass_heights.end()))
-                                     << " mixed_mask_count=" << mixed_masks.size()
-                                     << " base_mask_count=" << base_masks.size();
-        }
-
-        intervals.emplace_back(std::move(interval));
     }
+    BOOST_LOG_TRIVIAL(debug) << "Local-Z context"
+                             << " print_z=" << layer.print_z
+                             << " layer_id=" << layer.id()
+                             << " split_pass_count=" << out.passes.size()
+                             << " mixed_mask_count=" << out.mixed_masks_union.size()
+                             << " base_exclude_mask_count=" << out.mixed_masks_union_for_base_exclude.size()
+                             << " perimeter_mask_expand_mm=" << LOCAL_Z_PERIMETER_MASK_EXPAND_MM
+                             << " base_mask_expand_mm=" << LOCAL_Z_BASE_MASK_EXPAND_MM;
+}
 
-    if (!intervals.empty() && !plans.empty()) {
-        print_object.set_local_z_plan(std::move(intervals), std::move(plans));
-        export_local_z_plan_debug(print_object, mixed_lower, mixed_upper);
-        BOOST_LOG_TRIVIAL(warning) << "Local-Z plan built"
-                                   << " object=" << object_name
-                                   << " mixed_intervals=" << mixed_intervals
-                                   << " split_intervals=" << split_intervals
-                                   << " non_split_mixed_intervals=" << non_split_mixed_intervals
-                                   << " split_intervals_without_painted_masks=" << split_intervals_without_painted_masks
-                                   << " sublayer_passes=" << total_generated_sublayer_cnt
-                                   << " split_passes_total=" << split_passes_total
-                                   << " split_passes_with_painted_masks=" << split_passes_with_painted_masks
-                                   << " alternating_height_intervals=" << alternating_height_intervals
-                                   << " strict_ab_assignments=" << strict_ab_assignments
-                                   << " mixed_state_layers=" << total_mixed_state_layers
-                                   << " forced_height_resolve_calls=" << forced_height_resolve_calls
-                                   << " forced_height_resolve_invalid_target=" << forced_height_resolve_invalid_target
-                                   << " mixed_lower=" << mixed_lower
-                                   << " mixed_upper=" << mixed_upper
-                                   << " preferred_a=" << preferred_a
-                                   << " preferred_b=" << preferred_b;
-    } else {
-        BOOST_LOG_TRIVIAL(warning) << "Local-Z plan empty after build"
-                                   << " object=" << object_name
-                                   << " intervals=" << intervals.size()
-                                   << " plans=" << plans.size()
-                                   << " mixed_intervals=" << mixed_intervals;
-    }
+void PrintObject::build_local_z_extrusions()
+{
+    if (m_local_z_intervals.empty() || m_local_z_sublayer_plan.empty() || !m_local_z_layer_extrusions.empty())
+        return;
+
+    Profiling::Scope profiling_scope("Local-Z extrusions", "MixedFilament", this->model_object()->name);
+    BOOST_LOG_TRIVIAL(debug) << "Building Local-Z perimeter passes in parallel - start";
+    std::vector<LocalZLayerExtrusions> layer_extrusions(m_layers.size());
+    std::atomic<size_t>                rejected_context_logs{ 0 };
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, m_local_z_intervals.size()),
+        [this, &layer_extrusions, &rejected_context_logs](const tbb::blocked_range<size_t> &range) {
+            for (size_t interval_idx = range.begin(); interval_idx < range.end(); ++ interval_idx) {
+                m_print->throw_if_canceled();
+                const LocalZInterval &interval = m_local_z_intervals[interval_idx];
+                if (!interval.has_mixed_paint || interval.sublayer_count <= 1 || interval.first_sublayer_idx >= m_local_z_sublayer_plan.size() ||
+                    interval.layer_id >= m_layers.size())
+                    continue;
+                build_local_z_layer_extrusions(*m_layers[interval.layer_id], m_local_z_sublayer_plan, interval.first_sublayer_idx,
+                                               std::min(m_local_z_sublayer_plan.size(), interval.first_sublayer_idx + interval.sublayer_count),
+                                               rejected_context_logs, layer_extrusions[interval.layer_id]);
+            }
+        });
+    m_local_z_layer_extrusions = std::move(layer_extrusions);
+    BOOST_LOG_TRIVIAL(debug) << "Building Local-Z perimeter passes in parallel - end";
 }
 
 template<typename ThrowOnCancel>
 static inline void apply_mm_segmentation(PrintObject &print_object, std::vector<std::vector<ExPolygons>> segmentation, ThrowOnCancel throw_on_cancel)
 {
+    Profiling::Scope profiling_scope("Apply MM segmentation", "MixedFilament", print_object.model_object()->name);
     assert(segmentation.size() == print_object.layer_count());
     tbb::parallel_for(
         tbb::blocked_range<size_t>(0, segmentation.size(), std::max(segmentation.size() / 128, size_t(1))),
@@ -2570,45 +2316,70 @@ void PrintObject::slice_volumes()
             layer->m_regions.emplace_back(new LayerRegion(layer, pr.get()));
     }
 
-    std::vector<float>                   slice_zs      = zs_from_layers(m_layers);
-    std::vector<VolumeSlices> objSliceByVolume;
-    if (!slice_zs.empty()) {
-        objSliceByVolume = slice_volumes_inner(
-            print->config(), this->config(), this->trafo_centered(),
-            this->model_object()->volumes, m_shared_regions->layer_ranges, slice_zs, throw_on_cancel_callback);
-    }
+    // Only the mixed filament options changed since the last slicing of this painted object, restore the regions
+    // as they were before the multi-material segmentation instead of slicing the meshes again.
+    const size_t num_total_filaments = print->mixed_filament_manager().total_filaments(print->config().filament_colour.size());
+    if (m_mixed_segmentation_input &&
+        (m_mixed_segmentation_input->num_regions != m_shared_regions->all_regions.size() ||
+         m_mixed_segmentation_input->num_total_filaments != num_total_filaments ||
+         m_mixed_segmentation_input->region_slices.size() > m_layers.size()))
+        m_mixed_segmentation_input.reset();
+    const bool replan_mixed_segmentation = m_mixed_segmentation_input != nullptr;
+    if (replan_mixed_segmentation) {
+        BOOST_LOG_TRIVIAL(info) << "Slicing volumes - reusing the retained multi-material segmentation input of object " << this->model_object()->name;
+        const MixedSegmentationInput &input = *m_mixed_segmentation_input;
+        // Top empty layers were removed when the input was retained.
+        while (m_layers.size() > input.region_slices.size()) {
+            delete m_layers.back();
+            m_layers.pop_back();
+        }
+        if (! m_layers.empty())
+            m_layers.back()->upper_layer = nullptr;
+        for (size_t layer_id = 0; layer_id < m_layers.size(); ++ layer_id)
+            for (size_t region_id = 0; region_id < input.num_regions; ++ region_id)
+                m_layers[layer_id]->regions()[region_id]->slices.surfaces = input.region_slices[layer_id][region_id];
+        firstLayerObjSliceByVolume = input.first_layer_slices_by_volume;
+    } else {
+        std::vector<float>                   slice_zs      = zs_from_layers(m_layers);
+        std::vector<VolumeSlices> objSliceByVolume;
+        if (!slice_zs.empty()) {
+            objSliceByVolume = slice_volumes_inner(
+                print->config(), this->config(), this->trafo_centered(),
+                this->model_object()->volumes, m_shared_regions->layer_ranges, slice_zs, throw_on_cancel_callback);
+        }
 
-    //BBS: "model_part" volumes are grouded according to their connections
-    //const auto           scaled_resolution = scaled<double>(print->config().resolution.value);
-    //firstLayerObjSliceByVolume = findPartVolumes(objSliceByVolume, this->model_object()->volumes);
-    //groupingVolumes(objSliceByVolumeParts, firstLayerObjSliceByGroups, scaled_resolution);
-    //applyNegtiveVolumes(this->model_object()->volumes, objSliceByVolume, firstLayerObjSliceByGroups, scaled_resolution);
-    firstLayerObjSliceByVolume = objSliceByVolume;
-
-    std::vector<std::vector<ExPolygons>> region_slices =
-        slices_to_regions(print->config(), *this, this->model_object()->volumes, *m_shared_regions, slice_zs,
-                          std::move(objSliceByVolume), PrintObject::clip_multipart_objects, throw_on_cancel_callback);
-
-    for (size_t region_id = 0; region_id < region_slices.size(); ++ region_id) {
-        std::vector<ExPolygons> &by_layer = region_slices[region_id];
-        for (size_t layer_id = 0; layer_id < by_layer.size(); ++ layer_id)
-            m_layers[layer_id]->regions()[region_id]->slices.append(std::move(by_layer[layer_id]), stInternal);
-    }
-    region_slices.clear();
+        //BBS: "model_part" volumes are grouded according to their connections
+        //const auto           scaled_resolution = scaled<double>(print->config().resolution.value);
+        //firstLayerObjSliceByVolume = findPartVolumes(objSliceByVolume, this->model_object()->volumes);
+        //groupingVolumes(objSliceByVolumeParts, firstLayerObjSliceByGroups, scaled_resolution);
+        //applyNegtiveVolumes(this->model_object()->volumes, objSliceByVolume, firstLayerObjSliceByGroups, scaled_resolution);
+        firstLayerObjSliceByVolume = objSliceByVolume;
+
+        std::vector<std::vector<ExPolygons>> region_slices =
+            slices_to_regions(print->config(), *this, this->model_object()->volumes, *m_shared_regions, slice_zs,
+                              std::move(objSliceByVolume), PrintObject::clip_multipart_objects, throw_on_cancel_callback);
+
+        for (size_t region_id = 0; region_id < region_slices.size(); ++ region_id) {
+            std::vector<ExPolygons> &by_layer = region_slices[region_id];
+            for (size_t layer_id = 0; layer_id < by_layer.size(); ++ layer_id)
+                m_layers[layer_id]->regions()[region_id]->slices.append(std::move(by_layer[layer_id]), stInternal);
+        }
+        region_slices.clear();
 
-    BOOST_LOG_TRIVIAL(debug) << "Slicing volumes - removing top empty layers";
-    while (! m_layers.empty()) {
-        const Layer *layer = m_layers.back();
-        if (! layer->empty())
-            break;
-        delete layer;
-        m_layers.pop_back();
-    }
-    if (! m_layers.empty())
-        m_layers.back()->upper_layer = nullptr;
-    m_print->throw_if_canceled();
+        BOOST_LOG_TRIVIAL(debug) << "Slicing volumes - removing top empty layers";
+        while (! m_layers.empty()) {
+            const Layer *layer = m_layers.back();
+            if (! layer->empty())
+                break;
+            delete layer;
+            m_layers.pop_back();
+        }
+        if (! m_layers.empty())
+            m_layers.back()->upper_layer = nullptr;
+        m_print->throw_if_canceled();
 
-    this->apply_conical_overhang();
+        this->apply_conical_overhang();
+    }
 
     // Is any ModelVolume multi-material painted?
     if (const auto& volumes = this->model_object()->volumes;
@@ -2626,7 +2397,29 @@ void PrintObject::slice_volumes()
         }
 
         BOOST_LOG_TRIVIAL(debug) << "Slicing volumes - MMU segmentation";
-        std::vector<std::vector<ExPolygons>> mm_segmentation = multi_material_segmentation_by_painting(*this, [print]() { print->throw_if_canceled(); });
+        std::vector<std::vector<ExPolygons>> mm_segmentation;
+        if (replan_mixed_segmentation) {
+            mm_segmentation = m_mixed_segmentation_input->painted_segmentation;
+        } else {
+            mm_segmentation = multi_material_segmentation_by_painting(*this, [print]() { print->throw_if_canceled(); });
+        }
+        // Retain the input of the mixed filament passes below, see PrintObject::invalidate_mixed_segmentation().
+        // Without mixed filaments no mixed option can reuse it: adding one changes num_total_filaments, which discards it.
+        if (! replan_mixed_segmentation && num_total_filaments > print->config().filament_colour.size()) {
+            auto input = std::make_unique<MixedSegmentationInput>();
+            input->num_regions         = m_shared_regions->all_regions.size();
+            input->num_total_filaments = num_total_filaments;
+            input->region_slices.reserve(m_layers.size());
+            for (const Layer *layer : m_layers) {
+                std::vector<Surfaces> &slices = input->region_slices.emplace_back();
+                slices.reserve(layer->regions().size());
+                for (const LayerRegion *layerm : layer->regions())
+                    slices.emplace_back(layerm->slices.surfaces);
+            }
+            input->first_layer_slices_by_volume = firstLayerObjSliceByVolume;
+            input->painted_segmentation         = mm_segmentation;
+            m_mixed_segmentation_input          = std::move(input);
+        }
         apply_mixed_surface_indentation(*this, mm_segmentation);
         // Same-layer pointillisme is applied in G-code path domain (segment-level assignment),
         // not by XY state mask splitting, to avoid boolean-induced voids.
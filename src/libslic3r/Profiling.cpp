@@ -0,0 +1,219 @@
+#include "Profiling.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+#include <boost/nowide/fstream.hpp>
+
+#include "nlohmann/json.hpp"
+
+#ifdef WIN32
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <unistd.h>
+    #include <sys/resource.h>
+    #ifdef __APPLE__
+        #include <mach/mach.h>
+    #endif
+    #ifdef __linux__
+        #include <fstream>
+    #endif
+#endif
+
+namespace Slic3r {
+namespace Profiling {
+
+namespace detail {
+    std::atomic<bool> enabled { false };
+}
+
+namespace {
+
+struct Event
+{
+    // 'X' for a complete scope, 'C' for a counter.
+    char         phase;
+    std::string  name;
+    const char  *category;
+    int64_t      ts;
+    int64_t      dur;
+    uint32_t     tid;
+    std::string  object;
+    double       value;
+};
+
+struct Events
+{
+    std::mutex          mutex;
+    std::vector<Event>  events;
+};
+
+Events& events()
+{
+    static Events instance;
+    return instance;
+}
+
+const std::chrono::steady_clock::time_point& epoch()
+{
+    static const std::chrono::steady_clock::time_point instance = std::chrono::steady_clock::now();
+    return instance;
+}
+
+// Small sequential thread IDs read better in the trace viewers than hashes of std::thread::id.
+uint32_t thread_id()
+{
+    static std::atomic<uint32_t> next_id { 1 };
+    thread_local const uint32_t  id = next_id.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void record(Event &&event)
+{
+    Events &ev = events();
+    std::lock_guard<std::mutex> lock(ev.mutex);
+    ev.events.emplace_back(std::move(event));
+}
+
+} // namespace
+
+std::pair<size_t, size_t> process_memory()
+{
+    size_t resident = 0;
+    size_t peak     = 0;
+#ifdef WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        resident = size_t(pmc.WorkingSetSize);
+        peak     = size_t(pmc.PeakWorkingSetSize);
+    }
+#else
+    #ifdef __APPLE__
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t info_count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &info_count) == KERN_SUCCESS)
+        resident = size_t(info.resident_size);
+    #elif defined(__linux__)
+    size_t        size = 0, pages = 0;
+    std::ifstream statm("/proc/self/statm");
+    if (statm && (statm >> size >> pages))
+        resident = pages * size_t(sysconf(_SC_PAGE_SIZE));
+    #endif
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        peak = size_t(usage.ru_maxrss);
+    #ifndef __APPLE__
+        // getrusage returns the value in kB everywhere but on macOS.
+        peak *= 1024;
+    #endif
+    }
+#endif
+    return { resident, peak };
+}
+
+void enable(bool enable)
+{
+    if (enable)
+        // Fix the time base before the first event is recorded.
+        epoch();
+    detail::enabled.store(enable, std::memory_order_relaxed);
+}
+
+void clear()
+{
+    Events &ev = events();
+    std::lock_guard<std::mutex> lock(ev.mutex);
+    ev.events.clear();
+}
+
+int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch()).count();
+}
+
+void complete(std::string_view name, const char *category, int64_t begin_us, std::string_view object)
+{
+    if (! enabled())
+        return;
+    const int64_t end_us = now_us();
+    record({ 'X', std::string(name), category, begin_us, end_us - begin_us, thread_id(), std::string(object), 0. });
+}
+
+void counter(const char *name, double value)
+{
+    if (! enabled())
+        return;
+    record({ 'C', name, "counter", now_us(), 0, thread_id(), std::string(), value });
+}
+
+void sample_memory()
+{
+    if (! enabled())
+        return;
+    auto [resident, peak] = process_memory();
+    const int64_t ts = now_us();
+    const uint32_t tid = thread_id();
+    if (resident > 0)
+        record({ 'C', "Resident memory (MB)", "memory", ts, 0, tid, std::string(), double(resident) / (1024. * 1024.) });
+    if (peak > 0)
+        record({ 'C', "Peak memory (MB)", "memory", ts, 0, tid, std::string(), double(peak) / (1024. * 1024.) });
+}
+
+bool export_chrome_trace(const std::string &path)
+{
+    nlohmann::json trace_events = nlohmann::json::array();
+    {
+        Events &ev = events();
+        std::lock_guard<std::mutex> lock(ev.mutex);
+        for (const Event &event : ev.events) {
+            nlohmann::json j = {
+                { "name", event.name }, { "cat", event.category }, { "ph", std::string(1, event.phase) },
+                { "ts", event.ts }, { "pid", 1 }, { "tid", event.tid }
+            };
+            if (event.phase == 'X') {
+                j["dur"] = event.dur;
+                if (! event.object.empty())
+                    j["args"] = { { "object", event.object } };
+            } else
+                j["args"] = { { "value", event.value } };
+            trace_events.emplace_back(std::move(j));
+        }
+    }
+    boost::nowide::ofstream out(path);
+    if (! out) {
+        BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << ": could not open " << path << " for writing";
+        return false;
+    }
+    out << nlohmann::json{ { "traceEvents", std::move(trace_events) }, { "displayTimeUnit", "ms" } }.dump();
+    out.close();
+    if (! out) {
+        BOOST_LOG_TRIVIAL(error) << __FUNCTION__ << ": failed writing " << path;
+        return false;
+    }
+    BOOST_LOG_TRIVIAL(info) << __FUNCTION__ << ": profiling trace written to " << path;
+    return true;
+}
+
+Session::Session(std::string path) : m_path(std::move(path))
+{
+    if (! m_path.empty()) {
+        clear();
+        enable(true);
+        sample_memory();
+    }
+}
+
+Session::~Session()
+{
+    if (! m_path.empty()) {
+        sample_memory();
+        enable(false);
+        export_chrome_trace(m_path);
+    }
+}
+
+} // namespace Profiling
+} // namespace Slic3r
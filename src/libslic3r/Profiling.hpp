@@ -0,0 +1,77 @@
+#ifndef slic3r_Profiling_hpp_
+#define slic3r_Profiling_hpp_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace Slic3r {
+namespace Profiling {
+
+// Lightweight instrumentation of the slicing pipeline: timed scopes, counters and memory samples collected from any thread
+// and exported as Chrome trace events (chrome://tracing or https://ui.perfetto.dev).
+// The probes are always compiled in. Until enabled, a probe costs a single relaxed atomic load.
+
+namespace detail {
+    extern std::atomic<bool> enabled;
+}
+
+inline bool enabled() { return detail::enabled.load(std::memory_order_relaxed); }
+void        enable(bool enable);
+// Drop all the events collected so far.
+void        clear();
+
+// Microseconds since the first use of the profiler, the time base of the events.
+int64_t     now_us();
+// Record a scope of the calling thread, which started at begin_us and ends now.
+// The object name, if not empty, is stored with the event to tell apart the same step of different objects.
+void        complete(std::string_view name, const char *category, int64_t begin_us, std::string_view object = {});
+void        counter(const char *name, double value);
+// Record the resident and the peak resident memory of the process as counters.
+void        sample_memory();
+// Resident and peak resident memory of the process in bytes, zeros if not available. Works with the profiler disabled.
+std::pair<size_t, size_t> process_memory();
+
+// Write the events collected so far in the Chrome trace event format. Returns false if the file could not be written.
+bool        export_chrome_trace(const std::string &path);
+
+// Records its life time as a scope of the calling thread. The name, category and object are referenced, not copied,
+// they have to outlive the Scope.
+class Scope
+{
+public:
+    Scope(const char *name, const char *category, std::string_view object = {}) :
+        m_name(name), m_category(category), m_object(object), m_begin_us(enabled() ? now_us() : -1) {}
+    ~Scope() { if (m_begin_us >= 0) complete(m_name, m_category, m_begin_us, m_object); }
+
+    Scope(const Scope &) = delete;
+    Scope& operator=(const Scope &) = delete;
+
+private:
+    const char       *m_name;
+    const char       *m_category;
+    std::string_view  m_object;
+    int64_t           m_begin_us;
+};
+
+// Enables the profiler for its life time and writes the collected events into path when destroyed.
+// An empty path makes the Session a no-op.
+class Session
+{
+public:
+    explicit Session(std::string path);
+    ~Session();
+
+    Session(const Session &) = delete;
+    Session& operator=(const Session &) = delete;
+
+private:
+    std::string m_path;
+};
+
+} // namespace Profiling
+} // namespace Slic3r
+
+#endif // slic3r_Profiling_hpp_
@@ -1,7 +1,18 @@
 #include "filament_mixer.h"
 
 #include <algorithm>
+#include <array>
+#include <cassert>
 #include <cmath>
+#include <numeric>
+#include <vector>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SLIC3R_FILAMENT_MIXER_SSE2
+#endif
 
 #include "filament_mixer_model.h"
 
@@ -13,12 +24,12 @@ inline float clamp01(float x)
     return std::max(0.0f, std::min(1.0f, x));
 }
 
-inline float srgb_to_linear(float x)
+float srgb_to_linear(float x)
 {
     return (x >= 0.04045f) ? std::pow((x + 0.055f) / 1.055f, 2.4f) : x / 12.92f;
 }
 
-inline float linear_to_srgb(float x)
+float linear_to_srgb(float x)
 {
     return (x >= 0.0031308f) ? (1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f) : (12.92f * x);
 }
@@ -34,6 +45,187 @@ inline float to_f01(unsigned char x)
     return static_cast<float>(x) / 255.0f;
 }
 
+namespace model = ::filament_mixer::detail;
+
+// Each feature of the polynomial model of degree >= 2 is the product of two features of lower degree. The factors are chosen
+// so that the products are rounded as in compute_poly_features(): the monomials of the colour channels are exact integers,
+// the powers of t are multiplied up one by one and the two parts multiplied last.
+struct PolyProgram
+{
+    // Feature of the input i.
+    std::array<int, model::N_INPUTS>    input_feature;
+    // Feature i is the product of the features lhs[i] and rhs[i], for features of degree >= 2.
+    std::array<int, model::N_FEATURES>  lhs;
+    std::array<int, model::N_FEATURES>  rhs;
+    std::array<bool, model::N_FEATURES> is_product;
+};
+
+const PolyProgram& poly_program()
+{
+    static const PolyProgram program = []() {
+        PolyProgram out;
+        auto find = [](const std::array<int, model::N_INPUTS> &powers) {
+            for (int i = 0; i < model::N_FEATURES; ++i)
+                if (std::equal(powers.begin(), powers.end(), model::POWERS[i]))
+                    return i;
+            return -1;
+        };
+        const int t_input = model::N_INPUTS - 1;
+        for (int j = 0; j < model::N_INPUTS; ++j) {
+            std::array<int, model::N_INPUTS> powers {};
+            powers[j] = 1;
+            out.input_feature[j] = find(powers);
+        }
+        for (int i = 0; i < model::N_FEATURES; ++i) {
+            std::array<int, model::N_INPUTS> powers;
+            std::copy(model::POWERS[i], model::POWERS[i] + model::N_INPUTS, powers.begin());
+            out.is_product[i] = std::accumulate(powers.begin(), powers.end(), 0) >= 2;
+            if (!out.is_product[i])
+                continue;
+            const int t_power = powers[t_input];
+            std::array<int, model::N_INPUTS> lhs_powers = powers;
+            std::array<int, model::N_INPUTS> rhs_powers {};
+            if (t_power == std::accumulate(powers.begin(), powers.end(), 0)) {
+                // t^k = t^(k-1) * t
+                --lhs_powers[t_input];
+                rhs_powers[t_input] = 1;
+            } else if (t_power > 0) {
+                // channels * t^k
+                lhs_powers[t_input] = 0;
+                rhs_powers[t_input] = t_power;
+            } else {
+                const int j = int(std::find_if(powers.begin(), powers.end(), [](int p) { return p > 0; }) - powers.begin());
+                --lhs_powers[j];
+                rhs_powers[j] = 1;
+            }
+            out.lhs[i] = find(lhs_powers);
+            out.rhs[i] = find(rhs_powers);
+            // Features are ordered by degree, thus the factors are evaluated before their product.
+            assert(out.lhs[i] >= 0 && out.lhs[i] < i && out.rhs[i] >= 0 && out.rhs[i] < i);
+        }
+        return out;
+    }();
+    return program;
+}
+
+// Number of samples evaluated at once.
+constexpr int BLOCK = 8;
+
+#if defined(__AVX2__)
+constexpr int SIMD_WIDTH = 4;
+using Vec = __m256d;
+inline Vec  vec_load(const double *p) { return _mm256_load_pd(p); }
+inline void vec_store(double *p, Vec v) { _mm256_store_pd(p, v); }
+inline Vec  vec_set1(double x) { return _mm256_set1_pd(x); }
+inline Vec  vec_mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+inline Vec  vec_add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+#elif defined(SLIC3R_FILAMENT_MIXER_SSE2)
+constexpr int SIMD_WIDTH = 2;
+using Vec = __m128d;
+inline Vec  vec_load(const double *p) { return _mm_load_pd(p); }
+inline void vec_store(double *p, Vec v) { _mm_store_pd(p, v); }
+inline Vec  vec_set1(double x) { return _mm_set1_pd(x); }
+inline Vec  vec_mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+inline Vec  vec_add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+#else
+constexpr int SIMD_WIDTH = 1;
+using Vec = double;
+inline Vec  vec_load(const double *p) { return *p; }
+inline void vec_store(double *p, Vec v) { *p = v; }
+inline Vec  vec_set1(double x) { return x; }
+inline Vec  vec_mul(Vec a, Vec b) { return a * b; }
+inline Vec  vec_add(Vec a, Vec b) { return a + b; }
+#endif
+
+static_assert(BLOCK % SIMD_WIDTH == 0, "BLOCK has to be a multiple of SIMD_WIDTH");
+
+// Evaluates the polynomial model for a block of samples, the inputs r1, g1, b1, r2, g2, b2 in [0, 255] and t
+// of sample l at input[i][l]. Returns the unclamped channels of sample l at out[c][l].
+// Multiplications and additions are not fused to keep the rounding of the scalar model.
+void eval_model_block(const double (&input)[model::N_INPUTS][BLOCK], double (&out)[3][BLOCK])
+{
+    const PolyProgram &program = poly_program();
+    alignas(32) double features[model::N_FEATURES][BLOCK];
+    alignas(32) double sums[3][BLOCK];
+    for (int l = 0; l < BLOCK; ++l)
+        features[0][l] = 1.;
+    for (int j = 0; j < model::N_INPUTS; ++j)
+        std::copy(input[j], input[j] + BLOCK, features[program.input_feature[j]]);
+    for (int c = 0; c < 3; ++c)
+        std::fill(sums[c], sums[c] + BLOCK, model::INTERCEPT[c]);
+
+    for (int i = 0; i < model::N_FEATURES; ++i) {
+        const Vec coef[3] = { vec_set1(model::COEF[i][0]), vec_set1(model::COEF[i][1]), vec_set1(model::COEF[i][2]) };
+        for (int l = 0; l < BLOCK; l += SIMD_WIDTH) {
+            Vec f;
+            if (program.is_product[i]) {
+                f = vec_mul(vec_load(&features[program.lhs[i]][l]), vec_load(&features[program.rhs[i]][l]));
+                vec_store(&features[i][l], f);
+            } else
+                f = vec_load(&features[i][l]);
+            for (int c = 0; c < 3; ++c)
+                vec_store(&sums[c][l], vec_add(vec_load(&sums[c][l]), vec_mul(f, coef[c])));
+        }
+    }
+    for (int c = 0; c < 3; ++c)
+        std::copy(sums[c], sums[c] + BLOCK, out[c]);
+}
+
+// Evaluates the model for count samples in blocks of BLOCK: load(idx, l, input) fills the inputs of sample idx into the lane l
+// of the block, store(idx, l, out) picks up its result. The lanes past count repeat the last sample.
+template<typename LoadFn, typename StoreFn>
+void for_each_block(size_t count, LoadFn &&load, StoreFn &&store)
+{
+    alignas(32) double input[model::N_INPUTS][BLOCK];
+    alignas(32) double out[3][BLOCK];
+    for (size_t begin = 0; begin < count; begin += BLOCK) {
+        const size_t end = std::min(count, begin + BLOCK);
+        for (size_t l = begin; l < begin + BLOCK; ++l)
+            load(std::min(l, end - 1), l - begin, input);
+        eval_model_block(input, out);
+        for (size_t l = begin; l < end; ++l)
+            store(l, l - begin, out);
+    }
+}
+
+inline unsigned char truncate_u8(double x)
+{
+    // Matches the truncation of filament_mixer::lerp().
+    int val = static_cast<int>(x);
+    return static_cast<unsigned char>(std::clamp(val, 0, 255));
+}
+
+// Tabulated sRGB transfer functions, linearly interpolated.
+constexpr int TRANSFER_LUT_SIZE = 4096;
+
+struct TransferLut
+{
+    std::array<float, TRANSFER_LUT_SIZE + 1> to_linear;
+    std::array<float, TRANSFER_LUT_SIZE + 1> to_srgb;
+};
+
+const TransferLut& transfer_lut()
+{
+    static const TransferLut lut = []() {
+        TransferLut out;
+        for (int i = 0; i <= TRANSFER_LUT_SIZE; ++i) {
+            const float x = float(i) / float(TRANSFER_LUT_SIZE);
+            out.to_linear[i] = srgb_to_linear(x);
+            out.to_srgb[i]   = linear_to_srgb(x);
+        }
+        return out;
+    }();
+    return lut;
+}
+
+inline float lut_eval(const std::array<float, TRANSFER_LUT_SIZE + 1> &lut, float x)
+{
+    const float pos = clamp01(x) * float(TRANSFER_LUT_SIZE);
+    const int   idx = std::min(int(pos), TRANSFER_LUT_SIZE - 1);
+    const float f   = pos - float(idx);
+    return lut[idx] + (lut[idx + 1] - lut[idx]) * f;
+}
+
 } // namespace
 
 void filament_mixer_lerp(unsigned char r1, unsigned char g1, unsigned char b1,
@@ -78,4 +270,97 @@ void filament_mixer_lerp_linear_float(float r1, float g1, float b1,
     *out_b = srgb_to_linear(clamp01(out_sb));
 }
 
+void filament_mixer_lerp_batch(const unsigned char* rgb1, const unsigned char* rgb2, const float* t, size_t count,
+                               unsigned char* out_rgb)
+{
+    for_each_block(count,
+        [rgb1, rgb2, t](size_t idx, size_t l, double (&input)[7][BLOCK]) {
+            for (int c = 0; c < 3; ++c) {
+                input[c][l]     = double(rgb1[idx * 3 + c]);
+                input[3 + c][l] = double(rgb2[idx * 3 + c]);
+            }
+            input[6][l] = double(t[idx]);
+        },
+        [rgb1, rgb2, t, out_rgb](size_t idx, size_t l, const double (&out)[3][BLOCK]) {
+            for (int c = 0; c < 3; ++c)
+                out_rgb[idx * 3 + c] = t[idx] <= 0.f ? rgb1[idx * 3 + c] : t[idx] >= 1.f ? rgb2[idx * 3 + c] : truncate_u8(out[c][l]);
+        });
+}
+
+void filament_mixer_lerp_float_batch(const float* rgb1, const float* rgb2, const float* t, size_t count,
+                                     float* out_rgb)
+{
+    for_each_block(count,
+        [rgb1, rgb2, t](size_t idx, size_t l, double (&input)[7][BLOCK]) {
+            for (int c = 0; c < 3; ++c) {
+                input[c][l]     = double(clamp01(rgb1[idx * 3 + c])) * 255.;
+                input[3 + c][l] = double(clamp01(rgb2[idx * 3 + c])) * 255.;
+            }
+            input[6][l] = double(t[idx]);
+        },
+        [rgb1, rgb2, t, out_rgb](size_t idx, size_t l, const double (&out)[3][BLOCK]) {
+            for (int c = 0; c < 3; ++c)
+                out_rgb[idx * 3 + c] = t[idx] <= 0.f ? clamp01(rgb1[idx * 3 + c]) :
+                                       t[idx] >= 1.f ? clamp01(rgb2[idx * 3 + c]) :
+                                                       clamp01(float(out[c][l] / 255.));
+        });
+}
+
+void filament_mixer_lerp_linear_float_batch(const float* rgb1, const float* rgb2, const float* t, size_t count,
+                                            float* out_rgb)
+{
+    const TransferLut &lut = transfer_lut();
+    for_each_block(count,
+        [rgb1, rgb2, t, &lut](size_t idx, size_t l, double (&input)[7][BLOCK]) {
+            for (int c = 0; c < 3; ++c) {
+                input[c][l]     = double(lut_eval(lut.to_srgb, rgb1[idx * 3 + c])) * 255.;
+                input[3 + c][l] = double(lut_eval(lut.to_srgb, rgb2[idx * 3 + c])) * 255.;
+            }
+            input[6][l] = double(t[idx]);
+        },
+        [rgb1, rgb2, t, out_rgb, &lut](size_t idx, size_t l, const double (&out)[3][BLOCK]) {
+            for (int c = 0; c < 3; ++c)
+                out_rgb[idx * 3 + c] = t[idx] <= 0.f ? clamp01(rgb1[idx * 3 + c]) :
+                                       t[idx] >= 1.f ? clamp01(rgb2[idx * 3 + c]) :
+                                                       lut_eval(lut.to_linear, float(out[c][l] / 255.));
+        });
+}
+
+void filament_mixer_blend_batch(const unsigned char* colors_rgb, size_t num_colors, const float* weights, size_t count,
+                                unsigned char* out_rgb)
+{
+    std::fill(out_rgb, out_rgb + count * 3, (unsigned char)0);
+    std::vector<float> accumulated(count, 0.f);
+    std::vector<float> t(count, 0.f);
+    for (size_t color_idx = 0; color_idx < num_colors; ++color_idx) {
+        const unsigned char *color = colors_rgb + color_idx * 3;
+        bool                 any   = false;
+        for (size_t idx = 0; idx < count; ++idx) {
+            const float w = weights[idx * num_colors + color_idx];
+            if (w > 0.f) {
+                accumulated[idx] += w;
+                t[idx] = w / accumulated[idx];
+                any    = true;
+            } else
+                t[idx] = 0.f;
+        }
+        if (!any)
+            continue;
+        for_each_block(count,
+            [out_rgb, color, &t](size_t idx, size_t l, double (&input)[7][BLOCK]) {
+                for (int c = 0; c < 3; ++c) {
+                    input[c][l]     = double(out_rgb[idx * 3 + c]);
+                    input[3 + c][l] = double(color[c]);
+                }
+                input[6][l] = double(t[idx]);
+            },
+            [out_rgb, color, &t](size_t idx, size_t l, const double (&out)[3][BLOCK]) {
+                if (t[idx] <= 0.f)
+                    return;
+                for (int c = 0; c < 3; ++c)
+                    out_rgb[idx * 3 + c] = t[idx] >= 1.f ? color[c] : truncate_u8(out[c][l]);
+            });
+    }
+}
+
 } // namespace Slic3r
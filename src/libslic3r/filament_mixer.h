@@ -1,6 +1,8 @@
 #ifndef SLIC3R_FILAMENT_MIXER_H
 #define SLIC3R_FILAMENT_MIXER_H
 
+#include <cstddef>
+
 namespace Slic3r {
 
 void filament_mixer_lerp(unsigned char r1, unsigned char g1, unsigned char b1,
@@ -18,6 +20,26 @@ void filament_mixer_lerp_linear_float(float r1, float g1, float b1,
                                       float t,
                                       float* out_r, float* out_g, float* out_b);
 
+// Batch versions of the above mixing count pairs of colours, colours are interleaved RGB triplets.
+// The polynomial model is evaluated for blocks of colours at once with SSE2 / AVX2 if the build targets them.
+// filament_mixer_lerp_batch() returns the same colours as filament_mixer_lerp().
+void filament_mixer_lerp_batch(const unsigned char* rgb1, const unsigned char* rgb2, const float* t, size_t count,
+                               unsigned char* out_rgb);
+
+// Unlike filament_mixer_lerp_float(), the colours are not quantized to 8 bits.
+void filament_mixer_lerp_float_batch(const float* rgb1, const float* rgb2, const float* t, size_t count,
+                                     float* out_rgb);
+
+// The sRGB transfer functions are tabulated, differing from the exact ones by less than 1e-4.
+void filament_mixer_lerp_linear_float_batch(const float* rgb1, const float* rgb2, const float* t, size_t count,
+                                            float* out_rgb);
+
+// Blends num_colors colours for each of count weight vectors stored row by row in weights (count x num_colors),
+// accumulating the colours of positive weight pairwise in their order as MixedFilamentManager::blend_color_multi() does.
+// Colours with all weights zero are black.
+void filament_mixer_blend_batch(const unsigned char* colors_rgb, size_t num_colors, const float* weights, size_t count,
+                                unsigned char* out_rgb);
+
 } // namespace Slic3r
 
 #endif
@@ -3226,25 +3226,11 @@ void Sidebar::update_mixed_filament_panel()
         if (total == 0)
             return fallback;
 
-        unsigned int first_id = 0;
-        for (size_t id = 1; id <= num_physical; ++id) {
-            if (counts[id] > 0) {
-                first_id = unsigned(id);
-                break;
-            }
-        }
-        if (first_id == 0 || first_id > colors.size())
-            return fallback;
-
-        std::string blended = colors[first_id - 1];
-        int         acc     = int(counts[first_id]);
-        for (size_t id = size_t(first_id + 1); id <= num_physical; ++id) {
-            if (counts[id] == 0 || id > colors.size())
-                continue;
-            blended = MixedFilamentManager::blend_color(blended, colors[id - 1], acc, int(counts[id]));
-            acc += int(counts[id]);
-        }
-        return blended;
+        std::vector<std::pair<std::string, int>> color_percents;
+        for (size_t id = 1; id <= std::min(num_physical, colors.size()); ++id)
+            if (counts[id] > 0)
+                color_percents.emplace_back(colors[id - 1], int(counts[id]));
+        return color_percents.empty() ? fallback : MixedFilamentManager::blend_color_multi(color_percents);
     };
 
     const bool height_weighted_mode = get_mixed_mode(false);
@@ -20,3 +20,193 @@ SCENARIO("Origin manipulation", "[GCode]") {
     	}
     }
 }
+
+// A layer printed faster than slow_down_layer_time of the default config.
+static const std::string cooling_test_layer =
+    "G1 Z0.4 F9000\n"
+    "G1 X10 Y10\n"
+    "G1 F3000;_EXTRUDE_SET_SPEED\n"
+    "G1 X50 Y10 E1.5\n"
+    "G1 X50 Y50 E3\n"
+    ";_EXTRUDE_END\n"
+    "G1 X10 Y10 F9000\n"
+    "G1 F1800;_EXTRUDE_SET_SPEED;_EXTERNAL_PERIMETER\n"
+    "G1 X10 Y50 E4.5\n"
+    ";_EXTRUDE_END\n";
+
+// Feed the snippets of a layer to the cooling buffer of a G-code generator with the default config overridden by config.
+// The typed moves of a single snippet are replaced by the typed moves of the output.
+static std::string process_cooling_layer(const std::vector<std::string> &snippets, const DynamicPrintConfig &config = DynamicPrintConfig(),
+    const std::vector<unsigned int> &extruders = { 0 }, bool analytic_slowdown = false, GCodeMoves *moves = nullptr)
+{
+    FullPrintConfig print_config = FullPrintConfig::defaults();
+    print_config.apply(config, true);
+    GCode gcodegen;
+    gcodegen.apply_print_config(print_config);
+    gcodegen.writer().set_extruders(extruders);
+    CoolingBuffer cooling_buffer(gcodegen);
+    cooling_buffer.set_analytic_slowdown(analytic_slowdown);
+    std::string out;
+    for (size_t i = 0; i < snippets.size(); ++ i)
+        out += cooling_buffer.process_layer(std::string(snippets[i]), 2, i + 1 == snippets.size(), moves);
+    return out;
+}
+
+SCENARIO("Cooling buffer fed by snippets", "[GCode]") {
+    GIVEN("A layer printed faster than slow_down_layer_time") {
+        const std::string &layer = cooling_test_layer;
+        const std::string  whole = process_cooling_layer({ layer });
+        THEN("the layer is slowed down") {
+            REQUIRE(whole.find("F3000") == std::string::npos);
+        }
+        WHEN("the layer is fed in snippets split inside the lines") {
+            for (size_t split : { size_t(5), size_t(30), size_t(60), layer.size() - 3 })
+                THEN("the output matches the layer fed at once, split at " + std::to_string(split)) {
+                    REQUIRE(process_cooling_layer({ layer.substr(0, split), layer.substr(split) }) == whole);
+                }
+        }
+        WHEN("the layer is fed in snippets split at the line ends") {
+            std::vector<std::string> snippets;
+            for (size_t begin = 0; begin < layer.size();) {
+                size_t end = layer.find('\n', begin) + 1;
+                snippets.emplace_back(layer.substr(begin, end - begin));
+                begin = end;
+            }
+            THEN("the output matches the layer fed at once") {
+                REQUIRE(process_cooling_layer(snippets) == whole);
+            }
+        }
+    }
+}
+
+SCENARIO("Cooling buffer analytic slow down", "[GCode]") {
+    GIVEN("A layer printed faster than slow_down_layer_time") {
+        for (double layer_time : { 5., 10., 100. }) {
+            DynamicPrintConfig config;
+            config.set_deserialize_strict({ { "slow_down_layer_time", std::to_string(layer_time) } });
+            THEN("the G-code matches the iterative slow down, slow_down_layer_time " + std::to_string(layer_time)) {
+                REQUIRE(process_cooling_layer({ cooling_test_layer }, config, { 0 }, true) == process_cooling_layer({ cooling_test_layer }, config));
+            }
+        }
+    }
+    GIVEN("A layer printed by two extruders with different minimum speeds") {
+        const std::string layer = cooling_test_layer +
+            "T1\n"
+            "G1 X20 Y20 F9000\n"
+            "G1 F6000;_EXTRUDE_SET_SPEED\n"
+            "G1 X60 Y20 E1.5\n"
+            "G1 F2400;_EXTRUDE_SET_SPEED\n"
+            "G1 X60 Y60 E3\n"
+            ";_EXTRUDE_END\n";
+        DynamicPrintConfig config;
+        config.set_deserialize_strict({ { "slow_down_min_speed", "10,35" }, { "slow_down_layer_time", "8,8" } });
+        const std::string out = process_cooling_layer({ layer }, config, { 0, 1 }, true);
+        THEN("the G-code matches the iterative slow down") {
+            REQUIRE(out == process_cooling_layer({ layer }, config, { 0, 1 }));
+        }
+        THEN("the second extruder is not slowed down below its minimum speed") {
+            REQUIRE(out.find("F2100") != std::string::npos);
+        }
+    }
+}
+
+// The layer of cooling_test_layer emitted by a G-code writer, which records its moves.
+static std::string writer_test_layer(GCodeWriter &writer)
+{
+    writer.set_extruders({ 0 });
+    writer.set_extruder(0);
+    writer.set_record_moves(true);
+    std::string gcode = writer.travel_to_z(0.4);
+    gcode += writer.travel_to_xy(Vec2d(10.0004, 10.123));
+    gcode += writer.set_speed(3000, "", ";_EXTRUDE_SET_SPEED");
+    gcode += writer.extrude_to_xy(Vec2d(50.17, 10.), 1.53);
+    gcode += writer.extrude_arc_to_xy(Vec2d(50.17, 50.), Vec2d(0., 20.), 1.47, true);
+    gcode += ";_EXTRUDE_END\n";
+    gcode += writer.retract();
+    gcode += writer.travel_to_xy(Vec2d(10., 10.));
+    gcode += writer.unretract();
+    gcode += writer.set_speed(1800, "", ";_EXTRUDE_SET_SPEED;_EXTERNAL_PERIMETER");
+    gcode += writer.extrude_to_xy(Vec2d(10., 50.), 1.5);
+    gcode += ";_EXTRUDE_END\n";
+    return gcode;
+}
+
+// The G0 / G1 / G2 / G3 lines of gcode as read by GCodeReader.
+static GCodeMoves read_moves(const std::string &gcode)
+{
+    GCodeMoves  moves;
+    GCodeReader reader;
+    reader.parse_buffer(gcode, [&gcode, &moves](GCodeReader &, const GCodeReader::GCodeLine &line) {
+        std::string_view cmd = line.cmd();
+        if (cmd.size() == 2 && cmd[0] == 'G' && cmd[1] >= '0' && cmd[1] <= '3') {
+            GCodeMove &move = moves.emplace_back();
+            move.type = GCodeMove::Type(cmd[1] - '0');
+            for (int axis = 0; axis < int(NUM_AXES); ++ axis)
+                if (line.has(Axis(axis))) {
+                    move.mask |= 1 << axis;
+                    move.axis[axis] = line.value(Axis(axis));
+                }
+            move.line_start = line.raw_view().data() - gcode.data();
+            move.line_end   = move.line_start + line.raw_view().size() + 1;
+        }
+    });
+    return moves;
+}
+
+static bool same_moves(const GCodeMoves &moves1, const GCodeMoves &moves2)
+{
+    return std::equal(moves1.begin(), moves1.end(), moves2.begin(), moves2.end(), [](const GCodeMove &move1, const GCodeMove &move2) {
+        if (move1.type != move2.type || move1.mask != move2.mask || move1.line_start != move2.line_start || move1.line_end != move2.line_end)
+            return false;
+        for (int axis = 0; axis < int(NUM_AXES); ++ axis)
+            if (move1.has(Axis(axis)) && move1.value(Axis(axis)) != move2.value(Axis(axis)))
+                return false;
+        return true;
+    });
+}
+
+SCENARIO("Typed moves recorded by the G-code writer", "[GCode]") {
+    GIVEN("A layer emitted by the G-code writer") {
+        GCodeWriter       writer;
+        const std::string layer = writer_test_layer(writer);
+        THEN("the moves bound to the layer read the same as the text") {
+            GCodeMoves moves = writer.moves().bind(layer);
+            REQUIRE(moves.size() == writer.moves().size());
+            REQUIRE(same_moves(moves, read_moves(layer)));
+        }
+        WHEN("a line of the layer is dropped and another one is edited") {
+            std::string edited = layer;
+            size_t      line2  = edited.find('\n') + 1;
+            edited.erase(0, line2);
+            edited.replace(edited.find("X50.17"), 6, "X50.18");
+            THEN("the moves of the other lines are bound") {
+                GCodeMoves moves = writer.moves().bind(edited);
+                REQUIRE(moves.size() + 2 == writer.moves().size());
+                GCodeMoves read = read_moves(edited);
+                read.erase(std::find_if(read.begin(), read.end(), [&edited](const GCodeMove &move) { return edited.compare(move.line_start, 9, "G1 X50.18") == 0; }));
+                REQUIRE(same_moves(moves, read));
+            }
+        }
+    }
+}
+
+SCENARIO("Typed moves through the cooling buffer and the fan mover", "[GCode]") {
+    GIVEN("A layer emitted by the G-code writer") {
+        GCodeWriter       writer;
+        const std::string layer = writer_test_layer(writer);
+        GCodeMoves        moves = writer.moves().bind(layer);
+        const std::string out   = process_cooling_layer({ layer }, DynamicPrintConfig(), { 0 }, false, &moves);
+        THEN("the cooling buffer output matches the output of the layer parsed") {
+            REQUIRE(out == process_cooling_layer({ layer }));
+            REQUIRE(out.find("F3000") == std::string::npos);
+        }
+        THEN("the typed moves of the cooling buffer output read the same as the text") {
+            REQUIRE(same_moves(moves, read_moves(out)));
+        }
+        THEN("the fan mover output matches the output of the layer parsed") {
+            FanMover fan_mover_parsed(writer, 1.f, true, false, false, 0.f);
+            FanMover fan_mover_typed(writer, 1.f, true, false, false, 0.f);
+            REQUIRE(fan_mover_typed.process_gcode(out, true, &moves) == fan_mover_parsed.process_gcode(out, true));
+        }
+    }
+}
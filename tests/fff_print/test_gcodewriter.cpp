@@ -1,6 +1,10 @@
 #include <catch2/catch.hpp>
 
+#include <chrono>
+#include <iomanip>
+#include <iostream>
 #include <memory>
+#include <sstream>
 
 #include "libslic3r/GCodeWriter.hpp"
 
@@ -94,3 +98,158 @@ SCENARIO("set_speed emits values with fixed-point output.", "[GCodeWriter]") {
         }
     }
 }
+
+SCENARIO("Moves appended to a buffer match the moves returned as strings", "[GCodeWriter]") {
+    GIVEN("Two GCodeWriter instances with a single extruder") {
+        GCodeWriter returning, appending;
+        for (GCodeWriter *writer : { &returning, &appending }) {
+            writer->set_extruders({ 0 });
+            writer->set_extruder(0);
+        }
+        WHEN("The same moves are emitted by both") {
+            std::string returned, appended;
+            for (int i = 0; i < 100; ++ i) {
+                const Vec2d pt(0.37 * i, 200. - 1.13 * i);
+                returned += returning.travel_to_xy(pt, "travel");
+                appending.travel_to_xy(appended, pt, "travel");
+                returned += returning.extrude_to_xy(pt + Vec2d(1., 0.), 0.0123 * i, "extrude");
+                appending.extrude_to_xy(appended, pt + Vec2d(1., 0.), 0.0123 * i, "extrude");
+                returned += returning.extrude_arc_to_xy(pt, Vec2d(0.5, 0.), 0.01, i % 2 == 0);
+                appending.extrude_arc_to_xy(appended, pt, Vec2d(0.5, 0.), 0.01, i % 2 == 0);
+                returned += returning.extrude_to_xyz(Vec3d(pt.x(), pt.y(), 0.2 + 0.01 * i), 0.02);
+                appending.extrude_to_xyz(appended, Vec3d(pt.x(), pt.y(), 0.2 + 0.01 * i), 0.02);
+            }
+            THEN("The G-code is the same") {
+                REQUIRE(! appended.empty());
+                REQUIRE(appended == returned);
+            }
+        }
+    }
+}
+
+SCENARIO("Commands appended to a buffer match the commands returned as strings", "[GCodeWriter]") {
+    GIVEN("Two GCodeWriter instances with two extruders") {
+        GCodeWriter returning, appending;
+        for (GCodeWriter *writer : { &returning, &appending }) {
+            writer->set_extruders({ 0, 1 });
+            writer->set_extruder(0);
+        }
+        WHEN("The same commands are emitted by both") {
+            std::string returned, appended;
+            for (int i = 0; i < 20; ++ i) {
+                const unsigned int extruder_id = unsigned(i % 2);
+                returned += returning.set_temperature(200 + i, i % 3 == 0, int(extruder_id));
+                appending.set_temperature(appended, 200 + i, i % 3 == 0, int(extruder_id));
+                returned += returning.set_bed_temperature(60 + i / 4, i % 5 == 0);
+                appending.set_bed_temperature(appended, 60 + i / 4, i % 5 == 0);
+                returned += returning.set_print_acceleration(1000 + 500 * (i % 3));
+                appending.set_print_acceleration(appended, 1000 + 500 * (i % 3));
+                returned += returning.set_travel_acceleration(3000 + 500 * (i % 2));
+                appending.set_travel_acceleration(appended, 3000 + 500 * (i % 2));
+                returned += returning.set_jerk_xy(8. + 0.25 * (i % 4));
+                appending.set_jerk_xy(appended, 8. + 0.25 * (i % 4));
+                returned += returning.set_pressure_advance(0.0125 * i);
+                appending.set_pressure_advance(appended, 0.0125 * i);
+                returned += returning.set_extruder(extruder_id);
+                appending.set_extruder(appended, extruder_id);
+                returned += returning.set_speed(1800. + 0.5 * i, "", ";_EXTRUDE_SET_SPEED");
+                appending.set_speed(appended, 1800. + 0.5 * i, "", ";_EXTRUDE_SET_SPEED");
+                returned += returning.set_fan(5 * i);
+                appending.set_fan(appended, 5 * i);
+                returned += returning.extrude_to_xy(Vec2d(i, i), 0.5);
+                appending.extrude_to_xy(appended, Vec2d(i, i), 0.5);
+                returned += returning.reset_e();
+                appending.reset_e(appended);
+            }
+            THEN("The G-code is the same") {
+                REQUIRE(! appended.empty());
+                REQUIRE(appended == returned);
+            }
+        }
+    }
+}
+
+SCENARIO("GCodeAppender formats numbers as std::ostream does", "[GCodeWriter]") {
+    const std::vector<double> values { 0., 1., 9., 7.5, 120., 0.04, 0.0001, 1e-5, 123456., 1234567., 0.025, -0.5, 2500.5 };
+    for (double value : values) {
+        for (int precision : { 2, 4, 6 }) {
+            std::ostringstream general, fixed;
+            general << std::setprecision(precision) << value;
+            fixed << std::fixed << std::setprecision(precision) << value;
+            std::string   out;
+            GCodeAppender appender(out);
+            appender.emit_general(value, precision) << " ";
+            appender.emit_fixed(value, precision);
+            REQUIRE(out == general.str() + " " + fixed.str());
+        }
+    }
+    GIVEN("A GCodeWriter instance") {
+        GCodeWriter writer;
+        THEN("The pressure advance is emitted with 4 significant digits") {
+            REQUIRE_THAT(writer.set_pressure_advance(0.04), Catch::Equals("M900 K0.04; Override pressure advance value\n"));
+            REQUIRE_THAT(writer.set_pressure_advance(0.123456), Catch::Equals("M900 K0.1235; Override pressure advance value\n"));
+        }
+    }
+}
+
+// Run explicitly with: fff_print_tests "[Benchmark]"
+TEST_CASE("GCodeWriter appending benchmark", "[.][Benchmark][GCodeWriter]") {
+    GCodeWriter writer;
+    writer.set_extruders({ 0 });
+    writer.set_extruder(0);
+
+    const size_t layers = 200;
+    const size_t moves  = 20000;
+    size_t       size   = 0;
+    auto time_ms = [&writer, &size, layers, moves](bool append) {
+        std::string layer_gcode;
+        const auto begin = std::chrono::steady_clock::now();
+        for (size_t layer = 0; layer < layers; ++ layer) {
+            if (append)
+                // Reuse the buffer of the previous layer.
+                layer_gcode.clear();
+            else
+                layer_gcode = std::string();
+            for (size_t i = 0; i < moves; ++ i) {
+                const Vec2d pt(0.001 * double(i), 0.002 * double(layer));
+                if (append)
+                    writer.extrude_to_xy(layer_gcode, pt, 0.01, "perimeter");
+                else
+                    layer_gcode += writer.extrude_to_xy(pt, 0.01, "perimeter");
+            }
+            size += layer_gcode.size();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    };
+    const double returned_ms = time_ms(false);
+    const double appended_ms = time_ms(true);
+    REQUIRE(size > 0);
+
+    const size_t lines = 1000000;
+    auto format_ms = [lines](bool appender) {
+        std::string out;
+        size_t      size  = 0;
+        const auto  begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lines; ++ i) {
+            const double pa = 0.0001 * double(i % 1000);
+            if (appender) {
+                out.clear();
+                GCodeAppender gcode(out);
+                gcode << "M900 K";
+                gcode.emit_general(pa, 4) << "; Override pressure advance value\n";
+                size += out.size();
+            } else {
+                std::ostringstream gcode;
+                gcode << "M900 K" << std::setprecision(4) << pa << "; Override pressure advance value\n";
+                size += gcode.str().size();
+            }
+        }
+        REQUIRE(size > 0);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    };
+    const double ostringstream_ms = format_ms(false);
+    const double appender_ms      = format_ms(true);
+
+    std::cout << layers * moves << " moves: returned strings " << returned_ms << " ms, appended to a reused buffer " << appended_ms << " ms; "
+              << lines << " lines: std::ostringstream " << ostringstream_ms << " ms, GCodeAppender " << appender_ms << " ms" << std::endl;
+}
@@ -3,6 +3,7 @@
 #include "libslic3r/libslic3r.h"
 #include "libslic3r/Print.hpp"
 #include "libslic3r/Layer.hpp"
+#include "libslic3r/GCode/ToolOrdering.hpp"
 
 #include "test_data.hpp"
 
@@ -138,3 +139,46 @@ SCENARIO("Print: Brim generation", "[Print]") {
         }
     }
 }
+
+SCENARIO("Print: Mixed filament cadence phases", "[Print]") {
+    GIVEN("Two cubes printed with mixed filaments alternating filament 1 with filaments 2 and 3 on every other layer") {
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+        config.set_deserialize_strict({
+            { "filament_diameter",          "1.75,1.75,1.75" },
+            { "filament_colour",            "#FF0000;#00FF00;#0000FF" },
+            { "enable_prime_tower",         "0" },
+            // The generated rows disabled, two custom rows starting both with filament 1.
+            { "mixed_filament_definitions", "1,2,0,0,50,0,g,w,m0;1,3,0,0,50,0,g,w,m0;2,3,0,0,50,0,g,w,m0;"
+                                            "1,2,1,1,50,0,g,w,m0,12;1,3,1,1,50,0,g,w,m0,12" }
+        });
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({ TestMesh::cube_20x20x20, TestMesh::cube_20x20x20 }, print, model, config);
+        model.objects[0]->config.set("extruder", 4);
+        model.objects[1]->config.set("extruder", 5);
+        print.apply(model, config);
+        print.process();
+        REQUIRE(print.mixed_filament_manager().enabled_count() == 2);
+
+        WHEN("The tool ordering is computed") {
+            ToolOrdering tool_ordering(print, (unsigned int)-1);
+            const ToolOrdering::MixedPhaseStats &stats = tool_ordering.mixed_phase_stats();
+            THEN("One of the rows is shifted by a layer and the estimated tool changes drop") {
+                // In phase the layers alternate between filament 1 alone and filaments 2 and 3, 1.5 tool changes a layer.
+                // Shifted every layer prints filament 1 and one of the others, a single tool change a layer.
+                REQUIRE(stats.rows_shifted == 1);
+                REQUIRE(stats.tool_changes_after < stats.tool_changes_before);
+                const size_t num_layers = print.objects().front()->layer_count();
+                REQUIRE(stats.tool_changes_before == Approx(1.5 * double(num_layers)).margin(2.));
+                REQUIRE(stats.tool_changes_after == Approx(double(num_layers)).margin(2.));
+            }
+            THEN("The layers are collected with the shifted cadence") {
+                for (const LayerTools &layer_tools : tool_ordering.layer_tools())
+                    if (layer_tools.has_object) {
+                        REQUIRE(layer_tools.extruders.size() == 2);
+                        REQUIRE(layer_tools.has_extruder(0));
+                    }
+            }
+        }
+    }
+}
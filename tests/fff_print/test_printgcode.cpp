@@ -2,11 +2,17 @@
 
 #include "libslic3r/libslic3r.h"
 #include "libslic3r/GCodeReader.hpp"
+#include "libslic3r/GCode/GCodeProcessor.hpp"
 
 #include "test_data.hpp"
 
 #include <algorithm>
+#include <sstream>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/regex.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <boost/nowide/fstream.hpp>
 
 using namespace Slic3r;
 using namespace Slic3r::Test;
@@ -269,3 +275,228 @@ SCENARIO( "PrintGCode basic functionality", "[PrintGCode]") {
         }
     }
 }
+
+SCENARIO("PrintGCode time estimate", "[PrintGCode]") {
+    auto same_mode = [](const PrintEstimatedStatistics::Mode &lhs, const PrintEstimatedStatistics::Mode &rhs) {
+        return lhs.time == rhs.time && lhs.prepare_time == rhs.prepare_time && lhs.custom_gcode_times == rhs.custom_gcode_times &&
+               lhs.moves_times == rhs.moves_times && lhs.roles_times == rhs.roles_times && lhs.layers_times == rhs.layers_times;
+    };
+    const size_t normal  = size_t(PrintEstimatedStatistics::ETimeMode::Normal);
+    const size_t stealth = size_t(PrintEstimatedStatistics::ETimeMode::Stealth);
+    GIVEN("G-code of the print test objects") {
+        for (const auto &[test_mesh, mesh_name] : Slic3r::Test::mesh_names) {
+            DYNAMIC_SECTION("Test object " << mesh_name) {
+                Slic3r::Print print;
+                Slic3r::Model model;
+                Slic3r::Test::init_print({test_mesh}, print, model, {
+                    { "gcode_comments",                 true },
+                    { "silent_mode",                    false }
+                    });
+                const std::string gcode = Slic3r::Test::gcode(print);
+                const boost::filesystem::path temp = boost::filesystem::unique_path();
+                {
+                    boost::nowide::ofstream out(temp.string(), std::ios::binary);
+                    out << gcode;
+                }
+                auto estimate = [&temp](bool stealth) {
+                    GCodeProcessor processor;
+                    processor.enable_stealth_time_estimator(stealth);
+                    processor.process_file(temp.string());
+                    return processor.get_result().print_statistics;
+                };
+                const PrintEstimatedStatistics normal_only  = estimate(false);
+                const PrintEstimatedStatistics both_modes   = estimate(true);
+                const PrintEstimatedStatistics both_modes_2 = estimate(true);
+                boost::nowide::remove(temp.string().c_str());
+
+                // The normal mode estimate is not affected by planning the stealth mode alongside.
+                REQUIRE(normal_only.modes[normal].time > 0.f);
+                REQUIRE(same_mode(normal_only.modes[normal], both_modes.modes[normal]));
+                // Both modes estimate the same times when processed again.
+                REQUIRE(both_modes.modes[stealth].time > 0.f);
+                REQUIRE(same_mode(both_modes.modes[normal], both_modes_2.modes[normal]));
+                REQUIRE(same_mode(both_modes.modes[stealth], both_modes_2.modes[stealth]));
+            }
+        }
+    }
+}
+
+SCENARIO("PrintGCode statistics patched in place", "[PrintGCode]") {
+    GIVEN("A print test object exported without M73 progress") {
+        auto export_gcode = [](bool in_place) {
+            Slic3r::Print print;
+            Slic3r::Model model;
+            Slic3r::Test::init_print({TestMesh::gt2_teeth}, print, model, {
+                { "gcode_comments",                 true },
+                { "disable_m73",                    true },
+                { "gcode_in_place_statistics",      in_place }
+                });
+            return Slic3r::Test::gcode(print);
+        };
+        // Lines without the padding, skipping the blank ones and the time stamp.
+        auto statistics_lines = [](const std::string &gcode) {
+            std::vector<std::string> lines;
+            for (size_t begin = 0, end; begin < gcode.size(); begin = end + 1) {
+                end = std::min(gcode.find('\n', begin), gcode.size());
+                std::string line = gcode.substr(begin, end - begin);
+                line.erase(line.find_last_not_of(' ') + 1);
+                if (! line.empty() && ! boost::starts_with(line, "; generated by"))
+                    lines.emplace_back(std::move(line));
+            }
+            return lines;
+        };
+        const std::string rewritten = export_gcode(false);
+        const std::string patched   = export_gcode(true);
+        THEN("The statistics were patched into the padded placeholders") {
+            REQUIRE(patched.find("_GP_ESTIMATED_PRINTING_TIME_PLACEHOLDER") == std::string::npos);
+            const size_t layer_number = patched.find("; total layer number: ");
+            REQUIRE(layer_number != std::string::npos);
+            // Padded to 64 characters.
+            REQUIRE(patched.find('\n', layer_number) == layer_number + 63);
+        }
+        THEN("The G-code matches the rewritten one up to the padding") {
+            REQUIRE(statistics_lines(patched) == statistics_lines(rewritten));
+        }
+    }
+    GIVEN("A print test object exported with M73 progress") {
+        auto export_gcode = [](bool in_place) {
+            Slic3r::Print print;
+            Slic3r::Model model;
+            Slic3r::Test::init_print({TestMesh::gt2_teeth}, print, model, {
+                { "gcode_comments",                 true },
+                { "disable_m73",                    false },
+                { "gcode_in_place_statistics",      in_place }
+                });
+            return Slic3r::Test::gcode(print);
+        };
+        // Progress lines "M73 P<percent> R<minutes>" in the order written.
+        auto progress = [](const std::string &gcode) {
+            std::vector<std::pair<int, int>> out;
+            for (size_t pos = gcode.find("\nM73 P"); pos != std::string::npos; pos = gcode.find("\nM73 P", pos + 1)) {
+                int percent = 0, minutes = 0;
+                REQUIRE(sscanf(gcode.c_str() + pos, "\nM73 P%d R%d", &percent, &minutes) == 2);
+                out.emplace_back(percent, minutes);
+            }
+            return out;
+        };
+        const std::string rewritten = export_gcode(false);
+        const std::string patched   = export_gcode(true);
+        THEN("The progress estimated by the pre-pass is written before the layer changes") {
+            const std::vector<std::pair<int, int>> lines = progress(patched);
+            REQUIRE(lines.size() >= 3);
+            REQUIRE(lines.front() == progress(rewritten).front());
+            REQUIRE(lines.back() == std::make_pair(100, 0));
+            for (size_t i = 1; i < lines.size(); ++ i) {
+                REQUIRE(lines[i].first >= lines[i - 1].first);
+                REQUIRE(lines[i].second <= lines[i - 1].second);
+            }
+            // Besides the first and the last progress line, the progress lines are followed by a layer change.
+            size_t layer_changes = 0;
+            for (size_t pos = patched.find("\nM73 P"); pos != std::string::npos; pos = patched.find("\nM73 P", pos + 1)) {
+                size_t next_line = pos + 1;
+                while (patched.compare(next_line, 4, "M73 ") == 0)
+                    next_line = patched.find('\n', next_line) + 1;
+                if (patched.compare(next_line, 13, ";LAYER_CHANGE") == 0)
+                    ++ layer_changes;
+            }
+            REQUIRE(layer_changes == lines.size() - 2);
+        }
+        THEN("The estimated printing time matches the rewritten G-code") {
+            const std::string estimate = "; estimated printing time (normal mode) = ";
+            const size_t patched_estimate   = patched.find(estimate);
+            const size_t rewritten_estimate = rewritten.find(estimate);
+            REQUIRE(patched_estimate != std::string::npos);
+            REQUIRE(rewritten_estimate != std::string::npos);
+            REQUIRE(patched.substr(patched_estimate, patched.find('\n', patched_estimate) - patched_estimate) ==
+                    rewritten.substr(rewritten_estimate, rewritten.find('\n', rewritten_estimate) - rewritten_estimate));
+        }
+    }
+}
+
+SCENARIO("PrintGCode layers generated ahead", "[PrintGCode]") {
+    GIVEN("A print test object exported with and without the layers generated in parallel") {
+        Slic3r::Print print;
+        Slic3r::Model model;
+        // Layers are only generated ahead if the retraction at the layer change brings the extruder to a known state.
+        Slic3r::Test::init_print({TestMesh::gt2_teeth}, print, model, {
+            { "gcode_comments",                 true },
+            { "single_extruder_multi_material", false },
+            { "retract_when_changing_layer",    true }
+            });
+        print.set_parallel_gcode_layers(false);
+        const std::string serial   = Slic3r::Test::gcode(print);
+        print.set_parallel_gcode_layers(true);
+        const std::string parallel = Slic3r::Test::gcode(print);
+
+        // Lines of the G-code split at the layer changes. The progress and the estimated print time change with
+        // the travels of the layers generated ahead and the header holds the time of the export, they are left out.
+        auto layers = [](const std::string &gcode) {
+            std::vector<std::vector<std::string>> out(1);
+            std::istringstream in(gcode);
+            for (std::string line; std::getline(in, line);) {
+                if (boost::starts_with(line, "M73 ") || boost::starts_with(line, "; estimated printing time") ||
+                    boost::starts_with(line, "; generated by"))
+                    continue;
+                if (line == ";LAYER_CHANGE")
+                    out.emplace_back();
+                out.back().emplace_back(std::move(line));
+            }
+            return out;
+        };
+        // A layer generated ahead starts from an unknown position, thus the travel to its first point is split into
+        // the XY and Z moves and the extrusion role is marked again. Up to the first extrusion, the lines of a layer
+        // are compared without the travels and the extrusion role markers. The travels have to end at the same position.
+        struct LayerStart
+        {
+            std::vector<std::string> lines;
+            Vec3f                    end;
+            size_t                   size { 0 };
+        };
+        auto layer_start = [](const std::vector<std::string> &layer) {
+            LayerStart  start;
+            GCodeReader reader;
+            for (; start.size < layer.size(); ++ start.size) {
+                const std::string &line      = layer[start.size];
+                bool               travel    = false;
+                bool               extruding = false;
+                reader.parse_line(line, [&travel, &extruding](GCodeReader &self, const GCodeReader::GCodeLine &gline) {
+                    travel    = gline.travel();
+                    extruding = gline.extruding(self) && (gline.has(X) || gline.has(Y));
+                });
+                if (extruding)
+                    break;
+                if (! travel && ! boost::starts_with(line, ";TYPE:") && line != "; layer generated ahead")
+                    start.lines.emplace_back(line);
+            }
+            start.end = Vec3f(reader.x(), reader.y(), reader.z());
+            return start;
+        };
+        const std::vector<std::vector<std::string>> serial_layers   = layers(serial);
+        const std::vector<std::vector<std::string>> parallel_layers = layers(parallel);
+        const size_t adopted = std::count_if(parallel_layers.begin(), parallel_layers.end(), [](const std::vector<std::string> &layer) {
+            return std::find(layer.begin(), layer.end(), "; layer generated ahead") != layer.end();
+        });
+
+        THEN("Layers generated ahead are adopted") {
+            REQUIRE(adopted > 0);
+        }
+        THEN("All layers are exported") {
+            REQUIRE(parallel_layers.size() == serial_layers.size());
+        }
+        THEN("The G-code matches the serial G-code line by line, except for the start of the layers generated ahead") {
+            for (size_t i = 0; i < std::min(serial_layers.size(), parallel_layers.size()); ++ i) {
+                const std::vector<std::string> &s = serial_layers[i];
+                const std::vector<std::string> &p = parallel_layers[i];
+                if (std::find(p.begin(), p.end(), "; layer generated ahead") == p.end()) {
+                    REQUIRE(p == s);
+                    continue;
+                }
+                const LayerStart s_start = layer_start(s);
+                const LayerStart p_start = layer_start(p);
+                REQUIRE(p_start.lines == s_start.lines);
+                REQUIRE(p_start.end == s_start.end);
+                REQUIRE(std::vector<std::string>(p.begin() + p_start.size, p.end()) == std::vector<std::string>(s.begin() + s_start.size, s.end()));
+            }
+        }
+    }
+}
@@ -3,6 +3,13 @@
 #include "libslic3r/libslic3r.h"
 #include "libslic3r/Print.hpp"
 #include "libslic3r/Layer.hpp"
+#include "libslic3r/MultiMaterialSegmentation.hpp"
+#include "libslic3r/TriangleSelector.hpp"
+
+#include <chrono>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
 
 #include "test_data.hpp"
 
@@ -87,3 +94,238 @@ SCENARIO("PrintObject: object layer heights", "[PrintObject]") {
 #endif
     }
 }
+
+SCENARIO("PrintObject: content fingerprint", "[PrintObject]") {
+    GIVEN("Two cubes of separate meshes and a copy of the first cube") {
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({TestMesh::cube_20x20x20, TestMesh::cube_20x20x20}, print, model);
+        model.add_object(*model.objects.front());
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+        WHEN("The model is applied") {
+            print.apply(model, config);
+            REQUIRE(print.objects().size() == 3);
+            THEN("The copy has the fingerprint of its source") {
+                REQUIRE(print.objects()[0]->content_fingerprint() == print.objects()[2]->content_fingerprint());
+            }
+            THEN("The cube of a separate mesh has a different fingerprint") {
+                REQUIRE(print.objects()[0]->content_fingerprint() != print.objects()[1]->content_fingerprint());
+            }
+        }
+        WHEN("The copy gets its own number of walls") {
+            model.objects.back()->config.set("wall_loops", 5);
+            print.apply(model, config);
+            THEN("The fingerprints of the copy and its source differ") {
+                REQUIRE(print.objects()[0]->content_fingerprint() != print.objects()[2]->content_fingerprint());
+            }
+        }
+    }
+}
+
+SCENARIO("PrintObject: slice cache", "[PrintObject]") {
+    GIVEN("A cube sliced with a slice cache directory") {
+        const boost::filesystem::path cache_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("slice_cache_%%%%-%%%%-%%%%");
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({TestMesh::cube_20x20x20}, print, model, config);
+        print.set_slice_cache_dir(cache_dir.string());
+        print.process();
+        const PrintObject &sliced = *print.objects().front();
+        auto num_entries = [&cache_dir]() {
+            return std::distance(boost::filesystem::directory_iterator(cache_dir), boost::filesystem::directory_iterator());
+        };
+        REQUIRE(num_entries() == 1);
+
+        WHEN("The cube is sliced again with another nozzle temperature") {
+            config.set_deserialize_strict("nozzle_temperature", "215");
+            Slic3r::Print cached_print;
+            Slic3r::Model cached_model;
+            Slic3r::Test::init_print({TestMesh::cube_20x20x20}, cached_print, cached_model, config);
+            const PrintObject &cached = *cached_print.objects().front();
+            THEN("The object has the same cache key") {
+                REQUIRE(cached.slice_cache_key() == sliced.slice_cache_key());
+            }
+            // Replace the entry of the cube with the slices of a pyramid, so that the layers tell whether they were loaded
+            // from the cache or sliced again.
+            const boost::filesystem::path pyramid_cache_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("slice_cache_%%%%-%%%%-%%%%");
+            Slic3r::Print pyramid_print;
+            Slic3r::Model pyramid_model;
+            Slic3r::Test::init_print({TestMesh::pyramid}, pyramid_print, pyramid_model, config);
+            pyramid_print.set_slice_cache_dir(pyramid_cache_dir.string());
+            pyramid_print.process();
+            const PrintObject &pyramid = *pyramid_print.objects().front();
+            const boost::filesystem::path cube_entry = boost::filesystem::directory_iterator(cache_dir)->path();
+            boost::filesystem::copy_file(boost::filesystem::directory_iterator(pyramid_cache_dir)->path(), cube_entry,
+                                         boost::filesystem::copy_options::overwrite_existing);
+            boost::filesystem::remove_all(pyramid_cache_dir);
+
+            cached_print.set_slice_cache_dir(cache_dir.string());
+            cached_print.process();
+            THEN("The layers are loaded from the cache entry") {
+                REQUIRE(num_entries() == 1);
+                REQUIRE(pyramid.layer_count() != sliced.layer_count());
+                REQUIRE(cached.layer_count() == pyramid.layer_count());
+                for (size_t i = 0; i < pyramid.layer_count(); ++ i) {
+                    REQUIRE(cached.get_layer(int(i))->print_z == Approx(pyramid.get_layer(int(i))->print_z));
+                    REQUIRE(area(cached.get_layer(int(i))->lslices) == Approx(area(pyramid.get_layer(int(i))->lslices)));
+                }
+            }
+        }
+        WHEN("The cube is sliced again with another layer height") {
+            config.set_deserialize_strict("layer_height", "0.3");
+            Slic3r::Print resliced_print;
+            Slic3r::Model resliced_model;
+            Slic3r::Test::init_print({TestMesh::cube_20x20x20}, resliced_print, resliced_model, config);
+            THEN("The object gets another cache key") {
+                REQUIRE(resliced_print.objects().front()->slice_cache_key() != sliced.slice_cache_key());
+            }
+        }
+        WHEN("The cube is sliced again with a variable layer height") {
+            Slic3r::Print resliced_print;
+            Slic3r::Model resliced_model;
+            Slic3r::Test::init_print({TestMesh::cube_20x20x20}, resliced_print, resliced_model, config);
+            resliced_model.objects.front()->layer_height_profile.set({ 0., 0.2, 10., 0.2, 10., 0.1, 20., 0.1 });
+            resliced_print.apply(resliced_model, config);
+            THEN("The object gets another cache key") {
+                REQUIRE(resliced_print.objects().front()->slice_cache_key() != sliced.slice_cache_key());
+            }
+        }
+        WHEN("A layer height range of the cube is moved") {
+            auto sliced_with_range = [&config](coordf_t range_min) {
+                Slic3r::Print range_print;
+                Slic3r::Model range_model;
+                Slic3r::Test::init_print({TestMesh::cube_20x20x20}, range_print, range_model, config);
+                ModelConfig range_config;
+                range_config.set("wall_loops", 3);
+                range_model.objects.front()->layer_config_ranges[{ range_min, range_min + 5. }] = range_config;
+                range_print.apply(range_model, config);
+                return range_print.objects().front()->slice_cache_key();
+            };
+            THEN("The object gets another cache key") {
+                REQUIRE(sliced_with_range(5.) != sliced_with_range(10.));
+            }
+        }
+        boost::filesystem::remove_all(cache_dir);
+    }
+}
+
+SCENARIO("PrintObject: seam visibility key", "[PrintObject]") {
+    GIVEN("A cube") {
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+        Slic3r::Print print;
+        Slic3r::Model model;
+        Slic3r::Test::init_print({TestMesh::cube_20x20x20}, print, model, config);
+        const PrintObjectFingerprint key = print.objects().front()->seam_visibility_key();
+        WHEN("The print config changes") {
+            config.set_deserialize_strict({ { "nozzle_temperature", "215" }, { "layer_height", "0.3" } });
+            print.apply(model, config);
+            THEN("The key is kept") {
+                REQUIRE(print.objects().front()->seam_visibility_key() == key);
+            }
+        }
+        WHEN("The cube is scaled") {
+            model.objects.front()->scale(1.5);
+            print.apply(model, config);
+            THEN("The key changes") {
+                REQUIRE(print.objects().front()->seam_visibility_key() != key);
+            }
+        }
+    }
+}
+
+SCENARIO("PrintObject: retained mixed filament segmentation", "[PrintObject]") {
+    GIVEN("A sphere half painted with the mixed filament of two filaments") {
+        Slic3r::Model model;
+        ModelObject *object = model.add_object();
+        object->name = "painted_sphere.stl";
+        ModelVolume *volume = object->add_volume(TriangleMesh(its_make_sphere(10., PI / 18.)));
+        object->add_instance();
+        TriangleSelector selector(volume->mesh());
+        for (int facet_idx = 0; facet_idx < int(volume->mesh().facets_count()); facet_idx += 2)
+            selector.set_facet(facet_idx, EnforcerBlockerType::Extruder3);
+        volume->mmu_segmentation_facets.set(selector);
+        object->ensure_on_bed();
+        object->translate(100., 100., 0.);
+
+        DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+        config.set_deserialize_strict({
+            { "layer_height",                "0.2" },
+            { "filament_diameter",           "1.75,1.75" },
+            { "filament_colour",             "#FF0000;#0000FF" },
+            { "mixed_filament_cycle_layers", "4" }
+        });
+        auto process = [&model](Slic3r::Print &print, const DynamicPrintConfig &config) {
+            print.apply(model, config);
+            print.validate();
+            print.set_status_silent();
+            print.process();
+        };
+        Slic3r::Print print;
+        process(print, config);
+        REQUIRE(print.mixed_filament_manager().enabled_count() > 0);
+
+        WHEN("Only the mixed filament layer cycle changes") {
+            config.set_deserialize_strict("mixed_filament_cycle_layers", "2");
+            process(print, config);
+            Slic3r::Print fresh;
+            process(fresh, config);
+            THEN("The layers restored from the retained segmentation match a full re-slice") {
+                const PrintObject &replanned = *print.objects().front();
+                const PrintObject &sliced    = *fresh.objects().front();
+                REQUIRE(replanned.layer_count() == sliced.layer_count());
+                for (size_t layer_id = 0; layer_id < sliced.layer_count(); ++ layer_id) {
+                    const Layer &a = *replanned.get_layer(int(layer_id));
+                    const Layer &b = *sliced.get_layer(int(layer_id));
+                    REQUIRE(a.print_z == Approx(b.print_z));
+                    REQUIRE(a.region_count() == b.region_count());
+                    for (size_t region_id = 0; region_id < b.region_count(); ++ region_id) {
+                        double area_a = 0., area_b = 0.;
+                        for (const Surface &surface : a.get_region(int(region_id))->slices.surfaces)
+                            area_a += surface.area();
+                        for (const Surface &surface : b.get_region(int(region_id))->slices.surfaces)
+                            area_b += surface.area();
+                        REQUIRE(area_a == Approx(area_b));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Run explicitly with: fff_print_tests "[Benchmark]"
+TEST_CASE("PrintObject: painted facets projection benchmark", "[.][Benchmark][PrintObject]") {
+    Slic3r::Print print;
+    Slic3r::Model model;
+    ModelObject *object = model.add_object();
+    object->name = "painted_sphere.stl";
+    ModelVolume *volume = object->add_volume(TriangleMesh(its_make_sphere(20., PI / 180.)));
+    object->add_instance();
+    // Every other facet painted, the densest painting without splitting the facets.
+    TriangleSelector selector(volume->mesh());
+    for (int facet_idx = 0; facet_idx < int(volume->mesh().facets_count()); facet_idx += 2)
+        selector.set_facet(facet_idx, EnforcerBlockerType::Extruder1);
+    volume->mmu_segmentation_facets.set(selector);
+    object->ensure_on_bed();
+    object->translate(100., 100., 0.);
+
+    DynamicPrintConfig config = DynamicPrintConfig::full_print_config();
+    // The segmentation takes the outer wall width as is, the automatic width (0) would produce a negative spacing.
+    config.set_deserialize_strict({
+        { "layer_height",          "0.1" },
+        { "outer_wall_line_width", "0.42" }
+    });
+    print.apply(model, config);
+    print.validate();
+    print.set_status_silent();
+    print.process();
+    const PrintObject &print_object = *print.objects().front();
+
+    const auto begin = std::chrono::steady_clock::now();
+    std::vector<std::vector<ExPolygons>> segmentation = multi_material_segmentation_by_painting(print_object, []() {});
+    const double segmentation_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    REQUIRE(segmentation.size() == print_object.layer_count());
+
+    std::cout << volume->mesh().facets_count() / 2 << " painted facets, " << print_object.layer_count() << " layers: segmentation "
+              << segmentation_ms << " ms" << std::endl;
+}
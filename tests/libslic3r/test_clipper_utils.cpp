@@ -1,9 +1,14 @@
 #include <catch2/catch.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <numeric>
 #include <iostream>
 #include <boost/filesystem.hpp>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 #include "libslic3r/ClipperUtils.hpp"
 #include "libslic3r/ExPolygon.hpp"
 #include "libslic3r/SVG.hpp"
@@ -299,3 +304,106 @@ TEST_CASE("Traversing Clipper PolyTree", "[ClipperUtils]") {
         REQUIRE(count_polys(output) == reference.size());
     }
 }
+
+// Boolean operations and offsets mixing the code paths sharing the Clipper workspace of a thread.
+static std::vector<ExPolygons> clipper_workspace_operations(const Polygons &rings)
+{
+    Polygons   shifted = rings;
+    for (Polygon &ring : shifted)
+        ring.translate(scaled<coord_t>(1.3), scaled<coord_t>(0.7));
+    ExPolygons united  = union_ex(rings);
+    ExPolygons others  = union_ex(shifted);
+    std::vector<ExPolygons> out;
+    out.emplace_back(united);
+    out.emplace_back(intersection_ex(united, others));
+    out.emplace_back(diff_ex(united, others, ApplySafetyOffset::Yes));
+    out.emplace_back(xor_ex(united, others));
+    out.emplace_back(offset_ex(united, scaled<float>(0.4)));
+    out.emplace_back(offset_ex(united, - scaled<float>(0.3)));
+    out.emplace_back(offset2_ex(united, - scaled<float>(0.5), scaled<float>(0.2)));
+    out.emplace_back(closing_ex(shifted, scaled<float>(0.2), scaled<float>(0.2)));
+    out.emplace_back(offset_ex(shifted, - scaled<float>(0.1)));
+    Polylines lines;
+    for (coord_t y = 0; y < scaled<coord_t>(40.); y += scaled<coord_t>(1.))
+        lines.emplace_back(Point(0, y), Point(scaled<coord_t>(40.), y + scaled<coord_t>(3.)));
+    ExPolygons clipped;
+    for (const Polyline &pl : intersection_pl(lines, united))
+        clipped.emplace_back(Polygon(pl.points));
+    out.emplace_back(std::move(clipped));
+    return out;
+}
+
+TEST_CASE("Thread local Clipper workspace", "[ClipperUtils]") {
+    Polygons rings;
+    for (int i = 0; i < 5; ++ i)
+        for (int j = 0; j < 5; ++ j) {
+            Polygon outer = Polygon::new_scale({ { 0., 0. }, { 6., 0. }, { 6., 6. }, { 0., 6. } });
+            Polygon inner = Polygon::new_scale({ { 2., 2. }, { 2., 4. }, { 4., 4. }, { 4., 2. } });
+            outer.translate(scaled<coord_t>(7. * i + 0.3 * j), scaled<coord_t>(7. * j));
+            inner.translate(scaled<coord_t>(7. * i + 0.3 * j), scaled<coord_t>(7. * j));
+            rings.emplace_back(std::move(outer));
+            rings.emplace_back(std::move(inner));
+        }
+
+    ClipperUtils::ClipperWorkspace::set_enabled(false);
+    const std::vector<ExPolygons> reference = clipper_workspace_operations(rings);
+    ClipperUtils::ClipperWorkspace::set_enabled(true);
+    REQUIRE(! reference[1].empty());
+    REQUIRE(! reference.back().empty());
+
+    SECTION("Reused workspaces return the same results") {
+        std::vector<std::vector<ExPolygons>> results(64);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, results.size()), [&rings, &results](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                results[i] = clipper_workspace_operations(rings);
+        });
+        for (const std::vector<ExPolygons> &result : results)
+            REQUIRE(result == reference);
+    }
+
+    SECTION("Nested operations use a private workspace") {
+        ClipperUtils::ClipperWorkspace::Lease lease;
+        lease.clipper().AddPaths(ClipperUtils::PolygonsProvider(rings), ClipperLib::ptSubject, true);
+        REQUIRE(clipper_workspace_operations(rings) == reference);
+        ClipperLib::Paths united;
+        lease.clipper().Execute(ClipperLib::ctUnion, united, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+        REQUIRE(united.size() == rings.size());
+    }
+}
+
+// Run explicitly with: libslic3r_tests "[Benchmark]"
+TEST_CASE("Thread local Clipper workspace benchmark", "[.][Benchmark][ClipperUtils]") {
+    // Painted layer like input: many small islands clipped by a few stripes.
+    Polygons islands;
+    for (int i = 0; i < 20; ++ i)
+        for (int j = 0; j < 20; ++ j) {
+            Polygon island = Polygon::new_scale({ { 0., 0. }, { 1.5, 0.2 }, { 1.8, 1.4 }, { 0.9, 2.1 }, { -0.2, 1.2 } });
+            island.translate(scaled<coord_t>(2.5 * i), scaled<coord_t>(2.5 * j));
+            islands.emplace_back(std::move(island));
+        }
+    Polygons stripes;
+    for (int i = 0; i < 25; ++ i)
+        stripes.emplace_back(Polygon::new_scale({ { 2. * i, -1. }, { 2. * i + 1., -1. }, { 2. * i + 1., 51. }, { 2. * i, 51. } }));
+
+    const size_t layers = 400;
+    std::atomic<size_t> pieces { 0 };
+    auto time_ms = [&islands, &stripes, &pieces, layers](bool enabled) {
+        ClipperUtils::ClipperWorkspace::set_enabled(enabled);
+        const auto begin = std::chrono::steady_clock::now();
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, layers), [&islands, &stripes, &pieces](const tbb::blocked_range<size_t> &range) {
+            for (size_t layer = range.begin(); layer < range.end(); ++ layer)
+                for (const Polygon &island : islands) {
+                    ExPolygons painted = intersection_ex(Polygons{ island }, stripes);
+                    ExPolygons rest    = diff_ex(Polygons{ island }, stripes);
+                    pieces += offset_ex(painted, - scaled<float>(0.05)).size() + rest.size();
+                }
+        });
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    };
+    const double fresh_ms  = time_ms(false);
+    const double reused_ms = time_ms(true);
+    ClipperUtils::ClipperWorkspace::set_enabled(true);
+    REQUIRE(pieces > 0);
+
+    std::cout << layers * islands.size() << " islands: fresh Clipper " << fresh_ms << " ms, thread local workspace " << reused_ms << " ms" << std::endl;
+}
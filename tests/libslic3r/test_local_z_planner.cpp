@@ -0,0 +1,234 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "libslic3r/ClipperUtils.hpp"
+#include "libslic3r/LocalZPlanner.hpp"
+#include "libslic3r/MixedFilament.hpp"
+#include "libslic3r/Profiling.hpp"
+
+using namespace Slic3r;
+
+static ExPolygon make_rectangle(double x0, double y0, double x1, double y1)
+{
+    return ExPolygon(Polygon({ { scaled(x0), scaled(y0) }, { scaled(x1), scaled(y0) }, { scaled(x1), scaled(y1) }, { scaled(x0), scaled(y1) } }));
+}
+
+static ExPolygon make_circle(double cx, double cy, double radius, size_t num_points)
+{
+    Polygon poly;
+    poly.points.reserve(num_points);
+    for (size_t i = 0; i < num_points; ++ i) {
+        const double angle = 2. * PI * double(i) / double(num_points);
+        poly.points.emplace_back(scaled(cx + radius * std::cos(angle)), scaled(cy + radius * std::sin(angle)));
+    }
+    return ExPolygon(poly);
+}
+
+static void require_heights(const std::vector<double> &heights, const std::vector<double> &expected)
+{
+    REQUIRE(heights.size() == expected.size());
+    for (size_t i = 0; i < heights.size(); ++ i)
+        REQUIRE(heights[i] == Approx(expected[i]).margin(1e-9));
+}
+
+TEST_CASE("Local-Z pass heights", "[LocalZ]") {
+    SECTION("Preferred heights are cycled, the remainder closes the interval") {
+        require_heights(build_local_z_pass_heights(0.2, 0.04, 0.16, 0.06, 0.04), { 0.06, 0.04, 0.06, 0.04 });
+        require_heights(build_local_z_pass_heights(0.2, 0.04, 0.16, 0.08, 0.), { 0.08, 0.08, 0.04 });
+    }
+    SECTION("Without preferred heights the interval is split uniformly") {
+        require_heights(build_local_z_pass_heights(0.2, 0.04, 0.16, 0., 0.), { 0.1, 0.1 });
+        require_heights(build_local_z_pass_heights(0.3, 0.04, 0.16, 0., 0.), { 0.1, 0.1, 0.1 });
+        require_heights(build_local_z_pass_heights(0.06, 0.04, 0.16, 0., 0.), { 0.06 });
+    }
+    SECTION("Alternating heights follow the gradient ratio") {
+        require_heights(build_local_z_alternating_pass_heights(0.2, 0.04, 0.16, 0.13, 0.07), { 0.13, 0.07 });
+        require_heights(build_local_z_alternating_pass_heights(0.4, 0.04, 0.16, 0.13, 0.07), { 0.13, 0.07, 0.13, 0.07 });
+        // Too thin to be split in two.
+        require_heights(build_local_z_alternating_pass_heights(0.07, 0.04, 0.16, 0.13, 0.07), { 0.07 });
+    }
+    SECTION("Fitting to the interval") {
+        std::vector<double> passes { 0.05, 0.05 };
+        REQUIRE(fit_pass_heights_to_interval(passes, 0.12, 0.04, 0.08));
+        require_heights(passes, { 0.05, 0.07 });
+        passes = { 0.08, 0.08 };
+        REQUIRE(! fit_pass_heights_to_interval(passes, 0.2, 0.04, 0.08));
+        passes = { 0.08, 0.08, 0.08 };
+        REQUIRE(fit_pass_heights_to_interval(passes, 0.14, 0.04, 0.08));
+        require_heights(passes, { 0.06, 0.04, 0.04 });
+    }
+}
+
+// Object of num_layers layers of layer_height, a 20x10mm block with its right half painted by the mixed filament state
+// of painted_channel on the layers [first_painted, last_painted).
+static void make_painted_block(size_t num_layers, double layer_height, size_t num_channels, size_t painted_channel, size_t first_painted,
+                               size_t last_painted, std::vector<LocalZPlanLayer> &layers, std::vector<std::vector<ExPolygons>> &segmentation)
+{
+    layers.assign(num_layers, LocalZPlanLayer());
+    segmentation.assign(num_layers, std::vector<ExPolygons>(num_channels));
+    for (size_t layer_id = 0; layer_id < num_layers; ++ layer_id) {
+        layers[layer_id].print_z = layer_height * double(layer_id + 1);
+        layers[layer_id].height  = layer_height;
+        layers[layer_id].slices  = { make_rectangle(0., 0., 20., 10.) };
+        if (layer_id >= first_painted && layer_id < last_painted)
+            segmentation[layer_id][painted_channel] = { make_rectangle(10., 0., 20., 10.) };
+    }
+}
+
+TEST_CASE("Local-Z plan of a painted block", "[LocalZ]") {
+    const std::vector<std::string> colours = { "#FF0000", "#0000FF" };
+    MixedFilamentManager mgr;
+    // A single custom gradient row mixing 25% of the second filament into the first, filament state 3.
+    mgr.load_custom_entries("1,2,1,1,25,0,g,w,m0", colours);
+    REQUIRE(mgr.is_mixed(3, 2));
+
+    std::vector<LocalZPlanLayer>          layers;
+    std::vector<std::vector<ExPolygons>> segmentation;
+    make_painted_block(10, 0.2, 3, 2, 3, 7, layers, segmentation);
+    const double block_area = area(layers.front().slices);
+
+    SECTION("Heights derived from the gradient") {
+        LocalZPlanParams params;
+        params.lower_bound = 0.04;
+        params.upper_bound = 0.16;
+        const LocalZPlan plan = build_local_z_plan(layers, segmentation, mgr, 2, params);
+
+        REQUIRE(plan.intervals.size() == 10);
+        REQUIRE(plan.plans.size() == 14);
+        REQUIRE(plan.stats.mixed_intervals == 4);
+        REQUIRE(plan.stats.split_intervals == 4);
+        REQUIRE(plan.stats.split_passes == 8);
+        REQUIRE(plan.stats.split_passes_with_painted_masks == 8);
+        REQUIRE(plan.stats.alternating_height_intervals == 4);
+        REQUIRE(plan.stats.strict_ab_assignments == 8);
+        REQUIRE(plan.stats.sublayers == 14);
+
+        for (const LocalZInterval &interval : plan.intervals) {
+            const bool painted = interval.layer_id >= 3 && interval.layer_id < 7;
+            INFO("layer " << interval.layer_id);
+            REQUIRE(interval.has_mixed_paint == painted);
+            REQUIRE(interval.sublayer_count == (painted ? 2 : 1));
+            REQUIRE(interval.z_hi == Approx(0.2 * double(interval.layer_id + 1)));
+            REQUIRE(interval.sublayer_height == Approx(painted ? 0.07 : 0.2));
+
+            const SubLayerPlan &first = plan.plans[interval.first_sublayer_idx];
+            const SubLayerPlan &last  = plan.plans[interval.first_sublayer_idx + interval.sublayer_count - 1];
+            REQUIRE(first.z_lo == Approx(interval.z_lo));
+            REQUIRE(last.z_hi == Approx(interval.z_hi));
+            if (painted) {
+                // 0.07 mm of the 25% component first, then 0.13 mm of the 75% component, the same order on every layer.
+                REQUIRE(first.split_interval);
+                REQUIRE(first.flow_height == Approx(0.07));
+                REQUIRE(last.flow_height == Approx(0.13));
+                REQUIRE(first.painted_masks_by_extruder[0].empty());
+                REQUIRE(area(first.painted_masks_by_extruder[1]) == Approx(0.5 * block_area));
+                REQUIRE(area(last.painted_masks_by_extruder[0]) == Approx(0.5 * block_area));
+                REQUIRE(last.painted_masks_by_extruder[1].empty());
+                // Only the top sub-layer carries the unpainted rest of the layer.
+                REQUIRE(first.base_masks.empty());
+                REQUIRE(area(last.base_masks) == Approx(0.5 * block_area));
+            } else {
+                REQUIRE(! first.split_interval);
+                REQUIRE(first.flow_height == Approx(0.2));
+                REQUIRE(area(first.base_masks) == Approx(block_area));
+            }
+        }
+    }
+
+    SECTION("Preferred heights alternate the components pass by pass") {
+        LocalZPlanParams params;
+        params.lower_bound = 0.04;
+        params.upper_bound = 0.16;
+        params.preferred_a = 0.06;
+        params.preferred_b = 0.04;
+        const LocalZPlan plan = build_local_z_plan(layers, segmentation, mgr, 2, params);
+
+        REQUIRE(plan.plans.size() == 6 + 4 * 4);
+        REQUIRE(plan.stats.alternating_height_intervals == 0);
+        const LocalZInterval &interval = plan.intervals[3];
+        REQUIRE(interval.sublayer_count == 4);
+        const std::vector<double> expected_heights = { 0.06, 0.04, 0.06, 0.04 };
+        for (size_t pass_idx = 0; pass_idx < 4; ++ pass_idx) {
+            const SubLayerPlan &pass = plan.plans[interval.first_sublayer_idx + pass_idx];
+            REQUIRE(pass.pass_index == pass_idx);
+            REQUIRE(pass.flow_height == Approx(expected_heights[pass_idx]));
+            REQUIRE(! pass.painted_masks_by_extruder[pass_idx % 2].empty());
+            REQUIRE(pass.painted_masks_by_extruder[1 - pass_idx % 2].empty());
+        }
+    }
+
+    SECTION("Rows out of the Local-Z mode keep the nominal layers") {
+        MixedFilamentManager pointillism;
+        pointillism.load_custom_entries("1,2,1,1,25,0,g,w,m1", colours);
+        LocalZPlanParams params;
+        const LocalZPlan plan = build_local_z_plan(layers, segmentation, pointillism, 2, params);
+        REQUIRE(plan.plans.size() == 10);
+        REQUIRE(plan.stats.mixed_intervals == 0);
+    }
+}
+
+// Synthetic painted object for the benchmark: num_layers layers of 0.2 mm, each with an 80x80mm square painted by
+// num_islands circles of points_per_island points, the islands cycling through the mixed rows layer by layer.
+static void make_benchmark_object(size_t num_layers, size_t num_physical, size_t num_mixed_rows, size_t num_islands, size_t points_per_island,
+                                  std::vector<LocalZPlanLayer> &layers, std::vector<std::vector<ExPolygons>> &segmentation)
+{
+    layers.assign(num_layers, LocalZPlanLayer());
+    segmentation.assign(num_layers, std::vector<ExPolygons>(num_physical + num_mixed_rows));
+    const size_t grid   = size_t(std::ceil(std::sqrt(double(num_islands))));
+    const double pitch  = 80. / double(grid);
+    for (size_t layer_id = 0; layer_id < num_layers; ++ layer_id) {
+        layers[layer_id].print_z = 0.2 * double(layer_id + 1);
+        layers[layer_id].height  = 0.2;
+        layers[layer_id].slices  = { make_rectangle(0., 0., 80., 80.) };
+        for (size_t island_idx = 0; island_idx < num_islands; ++ island_idx) {
+            const double cx = pitch * (double(island_idx % grid) + 0.5);
+            const double cy = pitch * (double(island_idx / grid) + 0.5);
+            // Wobble the radius along Z to change the masks from layer to layer.
+            const double radius = pitch * (0.3 + 0.1 * std::sin(0.1 * double(layer_id + island_idx)));
+            segmentation[layer_id][num_physical + (layer_id + island_idx) % num_mixed_rows].emplace_back(make_circle(cx, cy, radius, points_per_island));
+        }
+    }
+}
+
+// Run explicitly with: libslic3r_tests "[Benchmark]"
+TEST_CASE("Local-Z planner benchmark", "[.][Benchmark][LocalZ]") {
+    const size_t num_physical = 4;
+    const std::vector<std::string> colours = { "#FF0000", "#00FF00", "#0000FF", "#FFFF00" };
+
+    std::cout << "layers  mixed_rows  islands  points  intervals  sublayers  split_intervals  time_ms  resident_mb  peak_mb" << std::endl;
+    for (size_t num_layers : { 200, 1000 })
+        for (size_t num_mixed_rows : { 1, 4, 24 })
+            for (size_t num_islands : { 1, 16 })
+                for (size_t points_per_island : { 32, 256 }) {
+                    // All the ordered pairs of the physical filaments with gradients of 25%, 50% and 75%.
+                    std::string rows;
+                    for (size_t row_idx = 0; row_idx < num_mixed_rows; ++ row_idx) {
+                        const size_t pair_idx = row_idx % 12;
+                        const size_t a        = pair_idx / 3 + 1;
+                        const size_t b        = (a + pair_idx % 3) % num_physical + 1;
+                        rows += std::to_string(a) + "," + std::to_string(b) + ",1,1," + std::to_string(25 + 25 * ((row_idx / 12) % 3)) + ",0,g,w,m0;";
+                    }
+                    MixedFilamentManager mgr;
+                    mgr.load_custom_entries(rows, colours);
+                    REQUIRE(mgr.enabled_count() == num_mixed_rows);
+
+                    std::vector<LocalZPlanLayer>          layers;
+                    std::vector<std::vector<ExPolygons>> segmentation;
+                    make_benchmark_object(num_layers, num_physical, num_mixed_rows, num_islands, points_per_island, layers, segmentation);
+
+                    LocalZPlanParams params;
+                    const auto       begin = std::chrono::steady_clock::now();
+                    const LocalZPlan plan  = build_local_z_plan(layers, segmentation, mgr, num_physical, params);
+                    const double     time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+                    const auto [resident, peak] = Profiling::process_memory();
+
+                    REQUIRE(plan.intervals.size() == num_layers);
+                    REQUIRE(plan.stats.split_intervals == num_layers);
+                    std::cout << num_layers << "  " << num_mixed_rows << "  " << num_islands << "  " << points_per_island << "  "
+                              << plan.intervals.size() << "  " << plan.plans.size() << "  " << plan.stats.split_intervals << "  "
+                              << time_ms << "  " << double(resident) / (1024. * 1024.) << "  " << double(peak) / (1024. * 1024.) << std::endl;
+                }
+}
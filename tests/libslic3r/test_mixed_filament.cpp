@@ -0,0 +1,395 @@
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "libslic3r/BoundingBox.hpp"
+#include "libslic3r/ClipperUtils.hpp"
+#include "libslic3r/MixedFilament.hpp"
+#include "libslic3r/MixedFilamentPalette.hpp"
+#include "libslic3r/MultiMaterialSegmentation.hpp"
+#include "libslic3r/filament_mixer.h"
+
+using namespace Slic3r;
+
+static MixedFilamentManager make_mixed_manager(int gradient_mode, bool advanced_dithering)
+{
+    const std::vector<std::string> colours = { "#FF0000", "#00FF00", "#0000FF", "#FFFF00" };
+    MixedFilamentManager mgr;
+    mgr.auto_generate(colours);
+    // Custom rows: plain cadence, manual pattern, weighted 3-way gradient, disabled row.
+    mgr.load_custom_entries("1,2,1,1,25,0,g,w,m0;"
+                            "1,3,1,1,50,0,g,w,m0,11234;"
+                            "2,3,1,1,50,0,g134,w50/25/25,m1;"
+                            "3,4,0,1,60,0,g,w,m0",
+                            colours);
+    mgr.apply_gradient_settings(gradient_mode, 0.04f, 0.16f, 4, advanced_dithering);
+    return mgr;
+}
+
+TEST_CASE("Mixed filament resolve plan matches parsing path", "[MixedFilament]") {
+    const size_t num_physical = 4;
+    for (int gradient_mode : { 0, 1 })
+        for (bool advanced_dithering : { false, true }) {
+            const MixedFilamentManager reference = make_mixed_manager(gradient_mode, advanced_dithering);
+            MixedFilamentManager       compiled  = reference;
+            compiled.build_resolve_plan(num_physical);
+            REQUIRE(reference.resolve_plan(num_physical) == nullptr);
+            REQUIRE(compiled.resolve_plan(num_physical) != nullptr);
+            REQUIRE(compiled.enabled_count() == reference.enabled_count());
+
+            const unsigned int last_id = unsigned(reference.total_filaments(num_physical)) + 2;
+            for (unsigned int id = 1; id <= last_id; ++id) {
+                REQUIRE(compiled.mixed_index_from_filament_id(id, num_physical) == reference.mixed_index_from_filament_id(id, num_physical));
+                for (int layer = -3; layer < 60; ++layer) {
+                    const float height  = 0.04f;
+                    const float print_z = height * float(layer + 1);
+                    for (bool force_height : { false, true })
+                        REQUIRE(compiled.resolve(id, num_physical, layer, print_z, height, force_height) ==
+                                reference.resolve(id, num_physical, layer, print_z, height, force_height));
+                }
+            }
+        }
+}
+
+TEST_CASE("Mixed filament resolve plan is dropped on mutation", "[MixedFilament]") {
+    MixedFilamentManager mgr = make_mixed_manager(0, false);
+    mgr.build_resolve_plan(4);
+    REQUIRE(mgr.resolve_plan(4) != nullptr);
+    REQUIRE(mgr.resolve_plan(3) == nullptr);
+    mgr.mixed_filaments().front().enabled = false;
+    REQUIRE(mgr.resolve_plan(4) == nullptr);
+}
+
+// Stripe splitting as done before split_masks_into_stripes(): clip every stripe on its own, union per extruder and assign
+// whatever is left to the fallback extruder.
+static std::vector<ExPolygons> split_masks_into_stripes_reference(const ExPolygons &masks, const std::vector<unsigned int> &sequence, size_t phase,
+                                                                  size_t num_extruders, unsigned int fallback_extruder, coord_t pitch, bool vertical)
+{
+    const BoundingBox bbox = get_extents(masks);
+    std::vector<Polygons> stripes_by_slot(sequence.size());
+    const int axis = vertical ? 0 : 1;
+    coord_t   rem  = bbox.min(axis) % pitch;
+    if (rem < 0)
+        rem += pitch;
+    size_t stripe_idx = 0;
+    for (coord_t c = bbox.min(axis) - rem; c < bbox.max(axis); c += pitch, ++ stripe_idx) {
+        Point pmin, pmax;
+        pmin(axis)     = std::max(c, bbox.min(axis));
+        pmax(axis)     = std::min<coord_t>(c + pitch, bbox.max(axis));
+        pmin(1 - axis) = bbox.min(1 - axis);
+        pmax(1 - axis) = bbox.max(1 - axis);
+        stripes_by_slot[(stripe_idx + phase) % sequence.size()].emplace_back(BoundingBox(pmin, pmax).polygon());
+    }
+    std::vector<ExPolygons> out(num_extruders);
+    for (size_t slot = 0; slot < sequence.size(); ++ slot)
+        if (sequence[slot] >= 1 && sequence[slot] <= num_extruders && ! stripes_by_slot[slot].empty())
+            append(out[sequence[slot] - 1], intersection_ex(masks, stripes_by_slot[slot], ApplySafetyOffset::Yes));
+    ExPolygons assigned;
+    for (ExPolygons &expolys : out) {
+        expolys = union_ex(expolys);
+        append(assigned, expolys);
+    }
+    append(out[fallback_extruder - 1], diff_ex(masks, union_ex(assigned), ApplySafetyOffset::Yes));
+    out[fallback_extruder - 1] = union_ex(out[fallback_extruder - 1]);
+    return out;
+}
+
+// A square with a square hole and a triangle, off the grid of the stripes and of the dither cells.
+static ExPolygons pointillism_test_masks()
+{
+    ExPolygon square(Polygon({ { scaled(-12.3), scaled(-7.1) }, { scaled(18.9), scaled(-7.1) }, { scaled(18.9), scaled(21.7) }, { scaled(-12.3), scaled(21.7) } }));
+    square.holes.emplace_back(Polygon({ { scaled(-2.), scaled(0.) }, { scaled(-2.), scaled(9.) }, { scaled(7.), scaled(9.) }, { scaled(7.), scaled(0.) } }));
+    return { square, ExPolygon(Polygon({ { scaled(25.), scaled(0.) }, { scaled(41.), scaled(3.) }, { scaled(30.), scaled(17.) } })) };
+}
+
+TEST_CASE("Pointillism stripe split matches the clipping of single stripes", "[MixedFilament]") {
+    const ExPolygons masks = pointillism_test_masks();
+    const coord_t    pitch = scaled(0.44);
+    const size_t     num_extruders = 4;
+
+    for (const std::vector<unsigned int> &sequence : { std::vector<unsigned int>{ 1, 2 }, std::vector<unsigned int>{ 1, 1, 2, 3, 3, 3 },
+                                                       std::vector<unsigned int>{ 4, 2, 2, 1 } })
+        for (size_t phase : { 0, 1, 5 })
+            for (bool vertical : { true, false }) {
+                std::vector<ExPolygons> split     = split_masks_into_stripes(masks, sequence, phase, num_extruders, sequence.front(), pitch, vertical);
+                std::vector<ExPolygons> reference = split_masks_into_stripes_reference(masks, sequence, phase, num_extruders, sequence.front(), pitch, vertical);
+                REQUIRE(split.size() == num_extruders);
+                for (size_t extruder_idx = 0; extruder_idx < num_extruders; ++ extruder_idx) {
+                    INFO("extruder " << extruder_idx + 1 << ", phase " << phase << ", vertical " << vertical);
+                    REQUIRE(split[extruder_idx].size() == reference[extruder_idx].size());
+                    REQUIRE(area(split[extruder_idx]) == Approx(area(reference[extruder_idx])).epsilon(1e-6));
+                    REQUIRE(area(xor_ex(split[extruder_idx], reference[extruder_idx])) < 1e-6 * area(masks));
+                }
+            }
+
+    // Slots of extruders out of range go to the fallback extruder. The reference leaves them separated from the neighbor
+    // stripes of the fallback extruder by the safety offset, here they are merged and the masks are covered without gaps.
+    const std::vector<unsigned int> sequence = { 2, 0, 4, 7 };
+    std::vector<ExPolygons> split     = split_masks_into_stripes(masks, sequence, 0, num_extruders, 2, pitch, true);
+    std::vector<ExPolygons> reference = split_masks_into_stripes_reference(masks, sequence, 0, num_extruders, 2, pitch, true);
+    REQUIRE(split[1].size() < reference[1].size());
+    REQUIRE(area(diff_ex(reference[1], split[1])) < 1e-6 * area(masks));
+    REQUIRE(area(split[3]) == Approx(area(reference[3])).epsilon(1e-6));
+    REQUIRE(area(diff_ex(masks, union_ex(split[1], split[3]))) < 1e-6 * area(masks));
+}
+
+TEST_CASE("Dither tiles spread the slots in proportion", "[MixedFilament]") {
+    for (bool blue_noise : { false, true })
+        for (const std::vector<unsigned int> &sequence : { std::vector<unsigned int>{ 1, 2 }, std::vector<unsigned int>{ 1, 1, 2, 3, 3, 3 },
+                                                           std::vector<unsigned int>{ 4, 2, 2, 1 } })
+            for (size_t phase : { 0, 1, 5 }) {
+                const DitherTile tile = build_dither_tile(sequence, phase, blue_noise);
+                REQUIRE(tile.cells.size() == tile.size * tile.size);
+                std::vector<size_t> expected(5, 0), counted(5, 0);
+                for (unsigned int extruder_id : sequence)
+                    expected[extruder_id] += tile.cells.size();
+                for (unsigned int extruder_id : tile.cells)
+                    ++counted[extruder_id];
+                for (size_t extruder_id = 1; extruder_id < 5; ++extruder_id) {
+                    INFO("blue noise " << blue_noise << ", extruder " << extruder_id << ", phase " << phase);
+                    // Each slot gets its share of the cells up to the rounding of the thresholds.
+                    REQUIRE(std::abs(double(counted[extruder_id]) - double(expected[extruder_id]) / double(sequence.size())) <= double(sequence.size()));
+                }
+                // The tile repeats over the plane.
+                REQUIRE(tile.extruder(-1, -1) == tile.cells.back());
+                REQUIRE(tile.extruder(int64_t(tile.size), 1) == tile.cells[tile.size]);
+            }
+
+    // No two cells of the same extruder next to each other in the checkerboard of the 50% ordered dither.
+    const DitherTile tile = build_dither_tile({ 1, 2 }, 0, false);
+    for (int64_t y = 0; y < int64_t(tile.size); ++ y)
+        for (int64_t x = 0; x < int64_t(tile.size); ++ x) {
+            REQUIRE(tile.extruder(x, y) != tile.extruder(x + 1, y));
+            REQUIRE(tile.extruder(x, y) != tile.extruder(x, y + 1));
+        }
+}
+
+TEST_CASE("Dither cells partition the masks", "[MixedFilament]") {
+    const coord_t cell_size     = scaled(0.44);
+    const size_t  num_extruders = 4;
+
+    // The masks as they are touch the cell grid with some of their vertices and edges, shifted they cross it everywhere.
+    for (const Point &shift : { Point(0, 0), Point(scaled(0.0123), scaled(0.0456)) }) {
+        ExPolygons masks = pointillism_test_masks();
+        for (ExPolygon &expoly : masks)
+            expoly.translate(shift);
+        const double masks_area = area(masks);
+
+        for (bool blue_noise : { false, true })
+            for (const std::vector<unsigned int> &sequence : { std::vector<unsigned int>{ 1, 2 }, std::vector<unsigned int>{ 1, 1, 2, 3, 3, 3 },
+                                                               std::vector<unsigned int>{ 4, 2, 0, 1 } }) {
+                const DitherTile        tile  = build_dither_tile(sequence, 1, blue_noise);
+                std::vector<ExPolygons> split = split_masks_into_dither_cells(masks, tile, num_extruders, sequence.front(), cell_size);
+                REQUIRE(split.size() == num_extruders);
+
+                // Reference: clip every cell on its own.
+                const BoundingBox       bbox = get_extents(masks);
+                std::vector<Polygons>   cells(num_extruders);
+                for (int64_t y = bbox.min.y() / cell_size - 1; y * cell_size < bbox.max.y(); ++ y)
+                    for (int64_t x = bbox.min.x() / cell_size - 1; x * cell_size < bbox.max.x(); ++ x) {
+                        unsigned int extruder_id = tile.extruder(x, y);
+                        if (extruder_id == 0 || extruder_id > num_extruders)
+                            extruder_id = sequence.front();
+                        cells[extruder_id - 1].emplace_back(BoundingBox(Point(x * cell_size, y * cell_size), Point((x + 1) * cell_size, (y + 1) * cell_size)).polygon());
+                    }
+
+                ExPolygons split_union;
+                for (size_t extruder_idx = 0; extruder_idx < num_extruders; ++ extruder_idx) {
+                    INFO("shift " << shift.x() << ", blue noise " << blue_noise << ", extruder " << extruder_idx + 1);
+                    const ExPolygons reference = intersection_ex(masks, cells[extruder_idx]);
+                    REQUIRE(area(split[extruder_idx]) == Approx(area(reference)).epsilon(1e-6));
+                    REQUIRE(area(xor_ex(split[extruder_idx], reference)) < 1e-6 * masks_area);
+                    append(split_union, split[extruder_idx]);
+                    for (size_t other_idx = extruder_idx + 1; other_idx < num_extruders; ++ other_idx)
+                        REQUIRE(area(intersection_ex(split[extruder_idx], split[other_idx])) < 1e-6 * masks_area);
+                }
+                REQUIRE(area(diff_ex(masks, union_ex(split_union))) < 1e-6 * masks_area);
+            }
+    }
+}
+
+static void random_mixer_samples(size_t count, std::vector<unsigned char> &rgb1, std::vector<unsigned char> &rgb2, std::vector<float> &t)
+{
+    std::mt19937                          rng(42);
+    std::uniform_int_distribution<int>    channel(0, 255);
+    std::uniform_real_distribution<float> ratio(-0.1f, 1.1f);
+    rgb1.resize(count * 3);
+    rgb2.resize(count * 3);
+    t.resize(count);
+    for (size_t i = 0; i < count * 3; ++ i) {
+        rgb1[i] = (unsigned char)channel(rng);
+        rgb2[i] = (unsigned char)channel(rng);
+    }
+    for (float &ti : t)
+        ti = ratio(rng);
+}
+
+TEST_CASE("Batch filament mixing matches the scalar mixer", "[MixedFilament]") {
+    // Not a multiple of the block size to exercise the padding.
+    const size_t               count = 1001;
+    std::vector<unsigned char> rgb1, rgb2;
+    std::vector<float>         t;
+    random_mixer_samples(count, rgb1, rgb2, t);
+
+    std::vector<unsigned char> out(count * 3);
+    filament_mixer_lerp_batch(rgb1.data(), rgb2.data(), t.data(), count, out.data());
+    for (size_t i = 0; i < count; ++ i) {
+        unsigned char r, g, b;
+        filament_mixer_lerp(rgb1[i * 3], rgb1[i * 3 + 1], rgb1[i * 3 + 2], rgb2[i * 3], rgb2[i * 3 + 1], rgb2[i * 3 + 2], t[i], &r, &g, &b);
+        INFO("sample " << i << ", t " << t[i]);
+        REQUIRE(int(out[i * 3]) == int(r));
+        REQUIRE(int(out[i * 3 + 1]) == int(g));
+        REQUIRE(int(out[i * 3 + 2]) == int(b));
+    }
+
+    std::vector<float> frgb1(count * 3), frgb2(count * 3), fout(count * 3), linear_out(count * 3);
+    for (size_t i = 0; i < count * 3; ++ i) {
+        frgb1[i] = float(rgb1[i]) / 255.f;
+        frgb2[i] = float(rgb2[i]) / 255.f;
+    }
+    filament_mixer_lerp_float_batch(frgb1.data(), frgb2.data(), t.data(), count, fout.data());
+    filament_mixer_lerp_linear_float_batch(frgb1.data(), frgb2.data(), t.data(), count, linear_out.data());
+    for (size_t i = 0; i < count; ++ i) {
+        float r, g, b;
+        filament_mixer_lerp_float(frgb1[i * 3], frgb1[i * 3 + 1], frgb1[i * 3 + 2], frgb2[i * 3], frgb2[i * 3 + 1], frgb2[i * 3 + 2], t[i], &r, &g, &b);
+        INFO("sample " << i << ", t " << t[i]);
+        // The scalar version truncates to 8 bits, the batch one does not.
+        REQUIRE(std::abs(fout[i * 3] - r) <= 1.f / 255.f + 1e-6f);
+        REQUIRE(std::abs(fout[i * 3 + 1] - g) <= 1.f / 255.f + 1e-6f);
+        REQUIRE(std::abs(fout[i * 3 + 2] - b) <= 1.f / 255.f + 1e-6f);
+        // One sRGB step of the 8-bit truncation is up to 3.2 / 255 in linear space.
+        filament_mixer_lerp_linear_float(frgb1[i * 3], frgb1[i * 3 + 1], frgb1[i * 3 + 2], frgb2[i * 3], frgb2[i * 3 + 1], frgb2[i * 3 + 2], t[i], &r, &g, &b);
+        REQUIRE(std::abs(linear_out[i * 3] - r) <= 3.3f / 255.f);
+        REQUIRE(std::abs(linear_out[i * 3 + 1] - g) <= 3.3f / 255.f);
+        REQUIRE(std::abs(linear_out[i * 3 + 2] - b) <= 3.3f / 255.f);
+    }
+}
+
+TEST_CASE("Batch blending of N colours matches the pairwise blending", "[MixedFilament]") {
+    const std::vector<std::string>   hex     = { "#FF0000", "#00FF00", "#0000FF", "#FFFF00" };
+    const std::vector<unsigned char> colors  = { 255, 0, 0, 0, 255, 0, 0, 0, 255, 255, 255, 0 };
+    const std::vector<float>         weights = { 50, 25, 25, 0,
+                                                 0, 0, 0, 0,
+                                                 0, 30, 0, 70,
+                                                 10, 20, 30, 40,
+                                                 0, 0, 100, 0 };
+    const size_t                     count   = weights.size() / hex.size();
+
+    std::vector<unsigned char> out(count * 3);
+    filament_mixer_blend_batch(colors.data(), hex.size(), weights.data(), count, out.data());
+    for (size_t i = 0; i < count; ++ i) {
+        std::string expected = "#000000";
+        // Reference: pairwise blending of the hex colours.
+        int accumulated = 0;
+        for (size_t color_idx = 0; color_idx < hex.size(); ++ color_idx) {
+            const int w = int(weights[i * hex.size() + color_idx]);
+            if (w <= 0)
+                continue;
+            expected = accumulated == 0 ? hex[color_idx] : MixedFilamentManager::blend_color(expected, hex[color_idx], accumulated, w);
+            accumulated += w;
+        }
+        char buf[8];
+        sprintf(buf, "#%02X%02X%02X", out[i * 3], out[i * 3 + 1], out[i * 3 + 2]);
+        INFO("weights " << i);
+        REQUIRE(std::string(buf) == expected);
+    }
+    REQUIRE(MixedFilamentManager::blend_color_multi({ { hex[0], 50 }, { hex[1], 25 }, { hex[2], 25 } }) ==
+            MixedFilamentManager::blend_color(MixedFilamentManager::blend_color(hex[0], hex[1], 50, 25), hex[2], 75, 25));
+}
+
+TEST_CASE("CIEDE2000 colour difference", "[MixedFilament]") {
+    REQUIRE(color_delta_e("#000000", "#FFFFFF") == Approx(100.).epsilon(1e-3));
+    REQUIRE(color_delta_e("#26A69A", "#26A69A") == Approx(0.).margin(1e-9));
+    REQUIRE(color_delta_e("#FF0000", "#00FF00") == Approx(color_delta_e("#00FF00", "#FF0000")).epsilon(1e-9));
+    REQUIRE(color_delta_e("#808080", "#818181") < 1.);
+}
+
+TEST_CASE("Palette optimizer recovers the recipes of blended targets", "[MixedFilament]") {
+    const std::vector<std::string> colours = { "#FF0000", "#00FF00", "#0000FF", "#FFFF00" };
+    const std::vector<std::string> targets = {
+        "#FF0000",
+        MixedFilamentManager::blend_color_multi({ { colours[2], 1 }, { colours[3], 2 } }),
+        MixedFilamentManager::blend_color_multi({ { colours[0], 1 }, { colours[1], 1 }, { colours[2], 2 } }),
+        "#7F3FBF"
+    };
+    MixedFilamentPaletteParams params;
+    params.max_components   = 3;
+    params.max_cycle_layers = 4;
+    const std::vector<MixedFilamentRecipe> recipes = optimize_mixed_filament_palette(targets, colours, params);
+    REQUIRE(recipes.size() == targets.size());
+
+    REQUIRE(recipes[0].component_ids == std::vector<unsigned int>{ 1 });
+    for (size_t i = 0; i < recipes.size(); ++ i) {
+        const MixedFilamentRecipe &recipe = recipes[i];
+        INFO("target " << targets[i] << ", recipe " << recipe.color);
+        REQUIRE(!recipe.component_ids.empty());
+        REQUIRE(recipe.component_ids.size() <= params.max_components);
+        REQUIRE(recipe.component_ids.size() == recipe.layers.size());
+        REQUIRE(recipe.cycle_layers() <= params.max_cycle_layers);
+        REQUIRE(std::is_sorted(recipe.component_ids.begin(), recipe.component_ids.end()));
+        REQUIRE(recipe.delta_e == Approx(color_delta_e(targets[i], recipe.color)).margin(1e-9));
+        // The predicted colour is the one the mixed row is displayed with.
+        std::vector<std::pair<std::string, int>> color_percents;
+        for (size_t j = 0; j < recipe.component_ids.size(); ++ j)
+            color_percents.emplace_back(colours[recipe.component_ids[j] - 1], recipe.layers[j]);
+        REQUIRE(MixedFilamentManager::blend_color_multi(color_percents) == recipe.color);
+        if (i < 3)
+            REQUIRE(recipe.delta_e < 1e-6);
+    }
+
+    // Store the 3-component recipe as a mixed row, it prints the layers of the recipe.
+    const MixedFilamentRecipe &recipe = recipes[2];
+    REQUIRE(recipe.component_ids.size() == 3);
+    MixedFilamentManager mgr;
+    REQUIRE(mgr.add_custom_sequence(recipe.component_ids, recipe.layers, colours));
+    REQUIRE(mgr.mixed_filaments().size() == 1);
+    REQUIRE(mgr.display_colors().front() == recipe.color);
+    const unsigned int mixed_id = unsigned(colours.size() + 1);
+    std::vector<int>   counts(colours.size() + 1, 0);
+    for (int layer = 0; layer < 2 * recipe.cycle_layers(); ++ layer)
+        ++ counts[mgr.resolve(mixed_id, colours.size(), layer)];
+    for (size_t j = 0; j < recipe.component_ids.size(); ++ j)
+        REQUIRE(counts[recipe.component_ids[j]] == 2 * recipe.layers[j]);
+
+    REQUIRE(!mgr.add_custom_sequence({ 1 }, { 1 }, colours));
+    REQUIRE(!mgr.add_custom_sequence({ 1, 1 }, { 1, 2 }, colours));
+    REQUIRE(!mgr.add_custom_sequence({ 1, 5 }, { 1, 2 }, colours));
+}
+
+// Run explicitly with: libslic3r_tests "[Benchmark]"
+TEST_CASE("Batch filament mixing benchmark", "[.][Benchmark][MixedFilament]") {
+    const size_t               count = 100000;
+    std::vector<unsigned char> rgb1, rgb2;
+    std::vector<float>         t;
+    random_mixer_samples(count, rgb1, rgb2, t);
+    std::vector<unsigned char> out(count * 3);
+    std::vector<float>         frgb1(count * 3), frgb2(count * 3), fout(count * 3);
+    for (size_t i = 0; i < count * 3; ++ i) {
+        frgb1[i] = float(rgb1[i]) / 255.f;
+        frgb2[i] = float(rgb2[i]) / 255.f;
+    }
+
+    auto time_ms = [](auto &&fn) {
+        const auto begin = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    };
+    const double scalar_ms = time_ms([&]() {
+        for (size_t i = 0; i < count; ++ i)
+            filament_mixer_lerp(rgb1[i * 3], rgb1[i * 3 + 1], rgb1[i * 3 + 2], rgb2[i * 3], rgb2[i * 3 + 1], rgb2[i * 3 + 2], t[i],
+                                &out[i * 3], &out[i * 3 + 1], &out[i * 3 + 2]);
+    });
+    const double batch_ms = time_ms([&]() { filament_mixer_lerp_batch(rgb1.data(), rgb2.data(), t.data(), count, out.data()); });
+    const double scalar_linear_ms = time_ms([&]() {
+        for (size_t i = 0; i < count; ++ i)
+            filament_mixer_lerp_linear_float(frgb1[i * 3], frgb1[i * 3 + 1], frgb1[i * 3 + 2], frgb2[i * 3], frgb2[i * 3 + 1], frgb2[i * 3 + 2], t[i],
+                                             &fout[i * 3], &fout[i * 3 + 1], &fout[i * 3 + 2]);
+    });
+    const double batch_linear_ms = time_ms([&]() { filament_mixer_lerp_linear_float_batch(frgb1.data(), frgb2.data(), t.data(), count, fout.data()); });
+
+    std::cout << count << " samples: lerp " << scalar_ms << " ms, lerp_batch " << batch_ms << " ms, lerp_linear_float " << scalar_linear_ms
+              << " ms, lerp_linear_float_batch " << batch_linear_ms << " ms" << std::endl;
+}